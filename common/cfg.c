@@ -51,6 +51,147 @@ strdup_or_null(const char *s)
     return s?strdup(s):s;
 }
 
+/**
+ * Compare settings.
+ *
+ */
+static int
+engine_config_strdiff(const char* s1, const char* s2)
+{
+    if (!s1 || !s2) {
+        return s1 != s2;
+    }
+    return strcmp(s1, s2) != 0;
+}
+
+static void
+engine_config_diff_str(const char* name, const char* s1, const char* s2)
+{
+    if (engine_config_strdiff(s1, s2)) {
+        ods_log_info("[%s] %s changed from %s to %s", conf_str, name,
+            s1?s1:"(none)", s2?s2:"(none)");
+    }
+}
+
+static void
+engine_config_diff_int(const char* name, long i1, long i2)
+{
+    if (i1 != i2) {
+        ods_log_info("[%s] %s changed from %ld to %ld", conf_str, name,
+            i1, i2);
+    }
+}
+
+/**
+ * Settings that are only read at startup: warn if they were changed.
+ *
+ */
+static void
+engine_config_fixed(const char* name, const char* oldval, const char* newval)
+{
+    if (engine_config_strdiff(oldval, newval)) {
+        ods_log_warning("[%s] %s changed, restart to apply", conf_str, name);
+    }
+    free((void*)newval);
+}
+
+static int
+engine_config_repositories_differ(struct engineconfig_repository* r1,
+    struct engineconfig_repository* r2)
+{
+    for (; r1 && r2; r1 = r1->next, r2 = r2->next) {
+        if (engine_config_strdiff(r1->name, r2->name) ||
+            engine_config_strdiff(r1->module, r2->module) ||
+            engine_config_strdiff(r1->tokenlabel, r2->tokenlabel) ||
+            engine_config_strdiff(r1->pin, r2->pin) ||
+            r1->use_pubkey != r2->use_pubkey ||
+            r1->require_backup != r2->require_backup ||
+            r1->allow_extract != r2->allow_extract) {
+            return 1;
+        }
+    }
+    return r1 != r2;
+}
+
+static int
+engine_config_listeners_differ(struct engineconfig_listener* l1,
+    struct engineconfig_listener* l2)
+{
+    for (; l1 && l2; l1 = l1->next, l2 = l2->next) {
+        if (engine_config_strdiff(l1->address, l2->address) ||
+            engine_config_strdiff(l1->port, l2->port)) {
+            return 1;
+        }
+    }
+    return l1 != l2;
+}
+
+/**
+ * Log what a reload changes.
+ *
+ */
+static void
+engine_config_diff(engineconfig_type* oldcfg, engineconfig_type* newcfg)
+{
+    engine_config_diff_str("PolicyFile", oldcfg->policy_filename,
+        newcfg->policy_filename);
+    engine_config_diff_str("Enforcer/ZoneListFile",
+        oldcfg->zonelist_filename_enforcer,
+        newcfg->zonelist_filename_enforcer);
+    engine_config_diff_str("Signer/ZoneListFile",
+        oldcfg->zonelist_filename_signer, newcfg->zonelist_filename_signer);
+    engine_config_diff_str("ZoneFetchFile", oldcfg->zonefetch_filename,
+        newcfg->zonefetch_filename);
+    engine_config_diff_str("Logging", oldcfg->log_filename,
+        newcfg->log_filename);
+    engine_config_diff_str("DelegationSignerSubmitCommand",
+        oldcfg->delegation_signer_submit_command,
+        newcfg->delegation_signer_submit_command);
+    engine_config_diff_str("DelegationSignerRetractCommand",
+        oldcfg->delegation_signer_retract_command,
+        newcfg->delegation_signer_retract_command);
+    engine_config_diff_str("NotifyCommand", oldcfg->notify_command,
+        newcfg->notify_command);
+    engine_config_diff_int("Syslog", oldcfg->use_syslog, newcfg->use_syslog);
+    engine_config_diff_int("Enforcer/WorkerThreads",
+        oldcfg->num_worker_threads_enforcer,
+        newcfg->num_worker_threads_enforcer);
+    engine_config_diff_int("Signer/WorkerThreads",
+        oldcfg->num_worker_threads_signer, newcfg->num_worker_threads_signer);
+    engine_config_diff_int("SignerThreads", oldcfg->num_signer_threads,
+        newcfg->num_signer_threads);
+    engine_config_diff_int("ListenerThreads", oldcfg->num_listener_threads,
+        newcfg->num_listener_threads);
+    engine_config_diff_int("TransferConnections",
+        oldcfg->num_transfer_connections, newcfg->num_transfer_connections);
+    engine_config_diff_int("TransferConnectionsPerMaster",
+        oldcfg->num_transfer_connections_master,
+        newcfg->num_transfer_connections_master);
+    engine_config_diff_int("TransferWindow", oldcfg->transfer_window,
+        newcfg->transfer_window);
+    engine_config_diff_int("TrustedSignconf", oldcfg->trusted_signconf,
+        newcfg->trusted_signconf);
+    engine_config_diff_int("SignatureMemory", oldcfg->signature_memory,
+        newcfg->signature_memory);
+    engine_config_diff_int("ManualKeyGeneration", oldcfg->manual_keygen,
+        newcfg->manual_keygen);
+    engine_config_diff_int("Verbosity", oldcfg->verbosity, newcfg->verbosity);
+    engine_config_diff_int("AutomaticKeyGenerationPeriod",
+        (long) oldcfg->automatic_keygen_duration,
+        (long) newcfg->automatic_keygen_duration);
+    engine_config_diff_int("RolloverNotification",
+        (long) oldcfg->rollover_notification,
+        (long) newcfg->rollover_notification);
+    if (engine_config_repositories_differ(oldcfg->repositories,
+        newcfg->repositories)) {
+        ods_log_info("[%s] RepositoryList changed", conf_str);
+    }
+    if (engine_config_listeners_differ(oldcfg->interfaces,
+        newcfg->interfaces)) {
+        ods_log_info("[%s] Listener changed", conf_str);
+    }
+}
+
 /**
  * Configure engine.
  *
@@ -69,8 +210,8 @@ engine_config(const char* cfgfile,
     }
     ods_log_verbose("[%s] read cfgfile: %s", conf_str, cfgfile);
 
-    /* check syntax (slows down parsing configuration file) */
-    if (parse_file_check(cfgfile, rngfile) != ODS_STATUS_OK) {
+    /* parse and check syntax once, the values are read from this parse */
+    if (parse_conf_open(cfgfile, rngfile) != ODS_STATUS_OK) {
         ods_log_error("[%s] failed to read: unable to parse file %s",
             conf_str, cfgfile);
         return NULL;
@@ -83,6 +224,7 @@ engine_config(const char* cfgfile,
         if (!ecfg) {
             ods_log_error("[%s] failed to read: malloc failed", conf_str);
             ods_fclose(cfgfd);
+            parse_conf_close();
             return NULL;
         }
         if (oldcfg) {
@@ -106,6 +248,28 @@ engine_config(const char* cfgfile,
             ecfg->db_password = strdup_or_null(oldcfg->db_password);
             ecfg->db_port = oldcfg->db_port;
             ecfg->db_type = oldcfg->db_type;
+            engine_config_fixed("Enforcer/SocketFile",
+                oldcfg->clisock_filename_enforcer,
+                parse_conf_clisock_filename(cfgfile, 1));
+            engine_config_fixed("Signer/SocketFile",
+                oldcfg->clisock_filename_signer,
+                parse_conf_clisock_filename(cfgfile, 0));
+            engine_config_fixed("Enforcer/WorkingDirectory",
+                oldcfg->working_dir_enforcer,
+                parse_conf_working_dir(cfgfile, 1));
+            engine_config_fixed("Signer/WorkingDirectory",
+                oldcfg->working_dir_signer, parse_conf_working_dir(cfgfile, 0));
+            engine_config_fixed("Enforcer/Privileges/User",
+                oldcfg->username_enforcer, parse_conf_username(cfgfile, 1));
+            engine_config_fixed("Signer/Privileges/User",
+                oldcfg->username_signer, parse_conf_username(cfgfile, 0));
+            engine_config_fixed("Enforcer/PidFile",
+                oldcfg->pid_filename_enforcer,
+                parse_conf_pid_filename(cfgfile, 1));
+            engine_config_fixed("Signer/PidFile", oldcfg->pid_filename_signer,
+                parse_conf_pid_filename(cfgfile, 0));
+            engine_config_fixed("Enforcer/Datastore", oldcfg->datastore,
+                parse_conf_datastore(cfgfile));
         } else {
             ecfg->cfg_filename = strdup(cfgfile);
             ecfg->clisock_filename_enforcer = parse_conf_clisock_filename(cfgfile, 1);
@@ -141,6 +305,14 @@ engine_config(const char* cfgfile,
         ecfg->num_worker_threads_enforcer = parse_conf_worker_threads(cfgfile, 1);
         ecfg->num_worker_threads_signer = parse_conf_worker_threads(cfgfile, 0);
         ecfg->num_signer_threads = parse_conf_signer_threads(cfgfile);
+        ecfg->num_listener_threads = parse_conf_listener_threads(cfgfile);
+        ecfg->num_transfer_connections =
+            parse_conf_transfer_connections(cfgfile);
+        ecfg->num_transfer_connections_master =
+            parse_conf_transfer_connections_master(cfgfile);
+        ecfg->transfer_window = parse_conf_transfer_window(cfgfile);
+        ecfg->trusted_signconf = parse_conf_trusted_signconf(cfgfile);
+        ecfg->signature_memory = parse_conf_signature_memory(cfgfile);
         ecfg->manual_keygen = parse_conf_manual_keygen(cfgfile);
         ecfg->repositories = parse_conf_repositories(cfgfile);
         /* If any verbosity has been specified at cmd line we will use that */
@@ -152,14 +324,19 @@ engine_config(const char* cfgfile,
             parse_conf_rollover_notification(cfgfile);
         ecfg->interfaces = parse_conf_listener(cfgfile);
         ecfg->notify_command = parse_conf_notify_command(cfgfile);
+        if (oldcfg) {
+            engine_config_diff(oldcfg, ecfg);
+        }
 
         /* done */
         ods_fclose(cfgfd);
+        parse_conf_close();
         return ecfg;
     }
 
     ods_log_error("[%s] failed to read: unable to open file %s", conf_str,
         cfgfile);
+    parse_conf_close();
     return NULL;
 }
 
@@ -330,6 +507,22 @@ engine_config_print(FILE* out, engineconfig_type* config)
             }
             fprintf(out, "\t\t</Listener>\n");
         }
+        if (config->num_listener_threads > 1) {
+            fprintf(out, "\t\t<ListenerThreads>%i</ListenerThreads>\n",
+                config->num_listener_threads);
+        }
+        fprintf(out, "\t\t<TransferConnections>%i</TransferConnections>\n",
+            config->num_transfer_connections);
+        if (config->num_transfer_connections_master > 0) {
+            fprintf(out, "\t\t<TransferConnectionsPerMaster>%i"
+                "</TransferConnectionsPerMaster>\n",
+                config->num_transfer_connections_master);
+        }
+        fprintf(out, "\t\t<TransferWindow>%i</TransferWindow>\n",
+            config->transfer_window);
+        if (config->trusted_signconf) {
+            fprintf(out, "\t\t<TrustedSignconf/>\n");
+        }
 
         fprintf(out, "\t\t<WorkingDirectory>%s</WorkingDirectory>\n",
             config->working_dir_signer);
@@ -337,6 +530,10 @@ engine_config_print(FILE* out, engineconfig_type* config)
             config->num_worker_threads_signer);
         fprintf(out, "\t\t<SignerThreads>%i</SignerThreads>\n",
             config->num_signer_threads);
+        if (config->signature_memory >= 0) {
+            fprintf(out, "\t\t<SignatureMemory>%ld</SignatureMemory>\n",
+                config->signature_memory);
+        }
         if (config->notify_command) {
             fprintf(out, "\t\t<NotifyCommand>%s</NotifyCommand>\n",
                 config->notify_command);
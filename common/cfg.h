@@ -97,6 +97,12 @@ struct engineconfig_struct {
     int num_worker_threads_enforcer;
     int num_worker_threads_signer;
     int num_signer_threads;
+    int num_listener_threads;
+    int num_transfer_connections;
+    int num_transfer_connections_master; /* 0 if unlimited */
+    int transfer_window; /* messages of an outgoing transfer built ahead */
+    int trusted_signconf; /* skip the schema check of signconf files */
+    long signature_memory; /* Signer/SignatureMemory in MB, -1 if unlimited */
     int manual_keygen;
     int verbosity;
     int db_port; /* Datastore/MySQL/Host/@Port */
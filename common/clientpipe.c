@@ -30,10 +30,14 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <assert.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <arpa/inet.h>
 
 #include "log.h"
@@ -42,6 +46,25 @@
 
 #include "clientpipe.h"
 
+static pthread_key_t client_buf_key;
+static pthread_once_t client_buf_once = PTHREAD_ONCE_INIT;
+
+static void
+client_buf_key_create(void)
+{
+	(void)pthread_key_create(&client_buf_key, NULL);
+}
+
+/* Output buffer attached to this thread for sockfd, NULL if none */
+static struct client_buf *
+attached(int sockfd)
+{
+	struct client_buf *buf;
+	(void)pthread_once(&client_buf_once, client_buf_key_create);
+	buf = pthread_getspecific(client_buf_key);
+	return (buf && buf->sockfd == sockfd) ? buf : NULL;
+}
+
 /**
  * Create a message header
  * \param buf: buffer to write in, MUST be at least 3 octets.
@@ -55,14 +78,57 @@ header(char *buf, enum msg_type opc, uint16_t datalen) {
         *(uint16_t *)(buf+1) = htons(datalen);
 }
 
+/**
+ * Write n bytes to sockfd, -1 on failure. A blocking socket only fails
+ * with EAGAIN when its send timeout expired: the client stopped reading.
+ * It is shut down, so that further output to it fails right away and the
+ * command handler drops it.
+ */
+static ssize_t
+client_writen(int sockfd, const void *vptr, size_t n)
+{
+	const char *ptr = vptr;
+	size_t nleft = n;
+	ssize_t nwritten;
+	int flags;
+
+	while (nleft > 0) {
+		if ((nwritten = write(sockfd, ptr, nleft)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				return -1;
+			}
+			flags = fcntl(sockfd, F_GETFL, 0);
+			if (flags != -1 && !(flags & O_NONBLOCK)) {
+				ods_log_warning("[clientpipe] client stopped reading, "
+					"dropping it");
+				(void)shutdown(sockfd, SHUT_RDWR);
+				return -1;
+			}
+			continue;
+		}
+		nleft -= nwritten;
+		ptr += nwritten;
+	}
+	return n;
+}
+
 /* 1 on succes, 0 on fail */
 int
 client_exit(int sockfd, char exitcode)
 {
 	char ctrl[4];
+	struct client_buf *buf = attached(sockfd);
+	if (buf) {
+		(void)client_buf_flush(buf);
+		/* Output of the next command is sent right away */
+		buf->flushed = 0;
+	}
 	header(ctrl, CLIENT_OPC_EXIT, 1);
 	ctrl[3] = exitcode;
-	return (ods_writen(sockfd, ctrl, 4) != -1);
+	return (client_writen(sockfd, ctrl, 4) != -1);
 }
 
 /* 1 on succes, 0 on fail */
@@ -72,9 +138,9 @@ client_msg(int sockfd, char opc, const char *cmd, uint16_t count)
 	char ctrl[3];
 	if (sockfd == -1) return 0;
 	header(ctrl, opc, count);
-	if (ods_writen(sockfd, ctrl, 3) == -1)
+	if (client_writen(sockfd, ctrl, 3) == -1)
 		return 0;
-	return (ods_writen(sockfd, cmd, (size_t)count) != -1);
+	return (client_writen(sockfd, cmd, (size_t)count) != -1);
 }
 
 int
@@ -93,52 +159,205 @@ client_stderr(int sockfd, const char *cmd, uint16_t count)
 	return client_msg(sockfd, CLIENT_OPC_STDERR, cmd, count);
 }
 
-int
-client_printf(int sockfd, const char * format, ...)
+/**
+ * Format and send a message directly, not through the output buffer.
+ * Messages longer than ODS_SE_MAXLINE are formatted in an allocated
+ * buffer, up to CLIENT_MAXFRAME.
+ */
+static int
+client_vmsg(int sockfd, char opc, const char * format, va_list ap)
 {
 	char buf[ODS_SE_MAXLINE];
-	int msglen; /* len w/o \0 */
-	va_list ap;
+	char *msg = buf;
+	int msglen, ok; /* len w/o \0 */
+	va_list aq;
 
-	va_start(ap, format);
-		msglen = vsnprintf(buf, ODS_SE_MAXLINE, format, ap);
-	va_end(ap);
+	va_copy(aq, ap);
+		msglen = vsnprintf(buf, ODS_SE_MAXLINE, format, aq);
+	va_end(aq);
 	if (msglen < 0) {
 		ods_log_error("Failed parsing vsnprintf format.");
 		return 0;
 	}
 
 	if (msglen >= ODS_SE_MAXLINE) {
-		ods_log_error("[file] vsnprintf buffer too small. "
-			"Want to write %d bytes but only %d available.", 
-			msglen+1, ODS_SE_MAXLINE);
-		msglen = ODS_SE_MAXLINE;
+		if (msglen > CLIENT_MAXFRAME) {
+			ods_log_error("[file] vsnprintf buffer too small. "
+				"Want to write %d bytes but only %d available.",
+				msglen+1, CLIENT_MAXFRAME+1);
+			msglen = CLIENT_MAXFRAME;
+		}
+		if ((msg = malloc(msglen+1))) {
+			(void)vsnprintf(msg, msglen+1, format, ap);
+		} else {
+			msg = buf;
+			msglen = ODS_SE_MAXLINE-1;
+		}
+	}
+	ok = client_msg(sockfd, opc, msg, msglen);
+	if (msg != buf) free(msg);
+	return ok;
+}
+
+static int
+client_buf_vprintf(struct client_buf *buf, const char * format, va_list ap)
+{
+	int msglen; /* len w/o \0 */
+	int left = sizeof (buf->data) - buf->len;
+	va_list aq;
+
+	va_copy(aq, ap);
+		msglen = vsnprintf(buf->data + buf->len, left, format, aq);
+	va_end(aq);
+	if (msglen < 0) {
+		ods_log_error("Failed parsing vsnprintf format.");
+		return 0;
+	}
+	if (msglen >= left) {
+		/* Does not fit behind what is buffered, send that and retry. */
+		if (!client_buf_flush(buf))
+			return 0;
+		msglen = vsnprintf(buf->data, sizeof (buf->data), format, ap);
+		if (msglen < 0) {
+			ods_log_error("Failed parsing vsnprintf format.");
+			return 0;
+		}
+		if (msglen >= (int)sizeof (buf->data)) {
+			ods_log_error("[file] vsnprintf buffer too small. "
+				"Want to write %d bytes but only %d available.",
+				msglen+1, (int)sizeof (buf->data));
+			msglen = sizeof (buf->data) - 1;
+		}
 	}
-	return client_stdout(sockfd, buf, msglen);
+	buf->len += msglen;
+
+	/* Don't keep a slow command's output from the user for long */
+	if (buf->len > 0 && buf->data[buf->len-1] == '\n' &&
+			time(NULL) - buf->flushed >= CLIENT_FLUSH_INTERVAL)
+		return client_buf_flush(buf);
+	return 1;
+}
+
+int
+client_printf(int sockfd, const char * format, ...)
+{
+	struct client_buf *buf = attached(sockfd);
+	int ok;
+	va_list ap;
+
+	va_start(ap, format);
+	if (buf)
+		ok = client_buf_vprintf(buf, format, ap);
+	else
+		ok = client_vmsg(sockfd, CLIENT_OPC_STDOUT, format, ap);
+	va_end(ap);
+	return ok;
 }
 
 int
 client_printf_err(int sockfd, const char * format, ...)
 {
-	char buf[ODS_SE_MAXLINE];
-	int msglen;
+	int ok;
 	va_list ap;
 
+	/* Keep stdout and stderr in order */
+	(void)client_flush(sockfd);
 	va_start(ap, format);
-		msglen = vsnprintf(buf, ODS_SE_MAXLINE, format, ap);
+		ok = client_vmsg(sockfd, CLIENT_OPC_STDERR, format, ap);
 	va_end(ap);
-	if (msglen < 0) {
-		ods_log_error("Failed parsing vsnprintf format.");
-		return 0;
-	}
+	return ok;
+}
 
-	if (msglen >= ODS_SE_MAXLINE) {
-		ods_log_error("[file] vsnprintf buffer too small. "
-			"Want to write %d bytes but only %d available.", 
-			msglen+1, ODS_SE_MAXLINE);
-		msglen = ODS_SE_MAXLINE;
+void
+client_buf_init(struct client_buf *buf, int sockfd)
+{
+	buf->sockfd = sockfd;
+	buf->len = 0;
+	buf->fields = 0;
+	buf->flushed = 0;
+}
+
+void
+client_buf_attach(struct client_buf *buf)
+{
+	(void)pthread_once(&client_buf_once, client_buf_key_create);
+	(void)pthread_setspecific(client_buf_key, buf);
+}
+
+int
+client_buf_flush(struct client_buf *buf)
+{
+	int ok = 1;
+	if (buf->len)
+		ok = client_stdout(buf->sockfd, buf->data, buf->len);
+	buf->len = 0;
+	buf->flushed = time(NULL);
+	return ok;
+}
+
+int
+client_flush(int sockfd)
+{
+	struct client_buf *buf = attached(sockfd);
+	return buf ? client_buf_flush(buf) : 1;
+}
+
+int
+client_buf_printf(struct client_buf *buf, const char * format, ...)
+{
+	int ok;
+	va_list ap;
+
+	va_start(ap, format);
+		ok = client_buf_vprintf(buf, format, ap);
+	va_end(ap);
+	return ok;
+}
+
+int
+client_buf_json_begin(struct client_buf *buf)
+{
+	buf->fields = 0;
+	return client_buf_printf(buf, "{");
+}
+
+int
+client_buf_json_str(struct client_buf *buf, const char *name,
+	const char *value)
+{
+	char esc[ODS_SE_MAXLINE];
+	size_t n = 0;
+	const char *sep = buf->fields++ ? "," : "";
+
+	if (!value)
+		return client_buf_printf(buf, "%s\"%s\":null", sep, name);
+	for (; *value && n + 7 < sizeof (esc); value++) {
+		unsigned char c = *value;
+		if (c == '"' || c == '\\') {
+			esc[n++] = '\\';
+			esc[n++] = c;
+		} else if (c < 0x20) {
+			n += snprintf(esc + n, sizeof (esc) - n, "\\u%04x", c);
+		} else {
+			esc[n++] = c;
+		}
 	}
-	return client_stderr(sockfd, buf, msglen);
+	esc[n] = '\0';
+	return client_buf_printf(buf, "%s\"%s\":\"%s\"", sep, name, esc);
+}
+
+int
+client_buf_json_int(struct client_buf *buf, const char *name, long value)
+{
+	const char *sep = buf->fields++ ? "," : "";
+	return client_buf_printf(buf, "%s\"%s\":%ld", sep, name, value);
+}
+
+int
+client_buf_json_end(struct client_buf *buf)
+{
+	buf->fields = 0;
+	return client_buf_printf(buf, "}\n");
 }
 
 /**
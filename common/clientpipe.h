@@ -29,7 +29,16 @@
 #ifndef DAEMON_CLIENTPIPE_H
 #define DAEMON_CLIENTPIPE_H
 
+#include "config.h"
 #include <stdint.h>
+#include <time.h>
+
+/* Largest payload of a single message, the length field is 16 bits. */
+#define CLIENT_MAXFRAME 65535
+/* Receive buffer needed to hold one complete message including header */
+#define CLIENT_BUFSIZE (CLIENT_MAXFRAME + 3)
+/* Seconds complete lines may be held back before they are sent */
+#define CLIENT_FLUSH_INTERVAL 1
 
 /* 1 on succes 0 on fail*/
 int client_printf(int sockfd, const char * format, ...);
@@ -59,4 +68,47 @@ int client_stdin(int sockfd, const char *cmd, uint16_t count);
 int client_stdout(int sockfd, const char *cmd, uint16_t count);
 int client_stderr(int sockfd, const char *cmd, uint16_t count);
 
+/**
+ * Output buffer of a client connection. Output is collected and sent in
+ * messages of up to CLIENT_MAXFRAME octets instead of one message per
+ * client_printf call. The buffer is sent when full, at the end of a line
+ * when CLIENT_FLUSH_INTERVAL has passed since it was last sent, before
+ * anything is written to stderr and when the command is done
+ * (client_exit).
+ */
+struct client_buf {
+	int sockfd;
+	int len;
+	int fields; /* JSON fields written on the current line */
+	time_t flushed; /* last time the buffer was sent */
+	char data[CLIENT_MAXFRAME + 1];
+};
+
+void client_buf_init(struct client_buf *buf, int sockfd);
+
+/**
+ * Make buf the output buffer of the calling thread. From then on
+ * client_printf() to buf->sockfd is collected in buf. NULL detaches.
+ */
+void client_buf_attach(struct client_buf *buf);
+
+/* 1 on succes 0 on fail */
+int client_buf_printf(struct client_buf *buf, const char * format, ...);
+int client_buf_flush(struct client_buf *buf);
+/* Send what is buffered for sockfd by this thread, if anything */
+int client_flush(int sockfd);
+
+/**
+ * Write one JSON object per line ("JSON lines"). Start a line with
+ * client_buf_json_begin(), add fields and finish it with
+ * client_buf_json_end(). A NULL string is written as null.
+ * 1 on succes 0 on fail
+ */
+int client_buf_json_begin(struct client_buf *buf);
+int client_buf_json_str(struct client_buf *buf, const char *name,
+	const char *value);
+int client_buf_json_int(struct client_buf *buf, const char *name,
+	long value);
+int client_buf_json_end(struct client_buf *buf);
+
 #endif /* DAEMON_CLIENTPIPE_H */
@@ -155,28 +155,25 @@ cmdhandler_perform_command(const char *cmd, struct cmdhandler_ctx_struct* contex
 /**
  * Consume a message from the buffer
  * 
- * Read all complete messages in the buffer or until exit code is set.
- * Messages larger than ODS_SE_MAXLINE can be handled but will be 
- * truncated. On exit pos will indicate new position in buffer. when 
- * returning true an exit code is set.
+ * Read messages from the buffer until a command is complete. Messages
+ * larger than ODS_SE_MAXLINE can be handled but will be truncated. On
+ * exit pos will indicate new position in buffer.
  * 
  * \param buf, buffer containing user input. Must not be NULL.
  * \param[in|out] pos, count of meaningful octets in buf. Must not be 
  *      NULL or exceed buflen.
  * \param buflen, capacity of buf. Must not exceed ODS_SE_MAXLINE.
- * \param[out] exitcode, exit code for client, only meaningful on 
- *      return 1. Must not be NULL.
- * \param sockfd, pipe to client.
- * \param engine, central enigine object
- * \return 0: waiting for more data. 1: exit code is set.
+ * \param[out] cmd, the command, only meaningful on return 1. Must have
+ *      room for ODS_SE_MAXLINE+1 octets.
+ * \return 0: waiting for more data. 1: cmd is set.
  */
 static int
-extract_msg(char* buf, int *pos, int buflen, int *exitcode, struct cmdhandler_ctx_struct* context)
+extract_msg(char* buf, int *pos, int buflen, char *cmd)
 {
-    char data[ODS_SE_MAXLINE+1], opc;
+    char opc;
     uint16_t datalen;
     
-    assert(exitcode);
+    assert(cmd);
     assert(buf);
     assert(pos);
     assert(*pos <= buflen);
@@ -188,16 +185,13 @@ extract_msg(char* buf, int *pos, int buflen, int *exitcode, struct cmdhandler_ct
         datalen = ntohs(*(uint16_t *)(buf+1));
         if (datalen+3 <= *pos) {
             /* a complete message */
-            memset(data, 0, ODS_SE_MAXLINE+1);
-            memcpy(data, buf+3, datalen);
+            memset(cmd, 0, ODS_SE_MAXLINE+1);
+            memcpy(cmd, buf+3, datalen);
             *pos -= datalen+3;
             memmove(buf, buf+datalen+3, *pos);
-            ods_str_trim(data, 0);
+            ods_str_trim(cmd, 0);
 
-            if (opc == CLIENT_OPC_STDIN) {
-                *exitcode = cmdhandler_perform_command(data, context);
-                return 1;
-            }
+            if (opc == CLIENT_OPC_STDIN) return 1;
         } else if (datalen+3 > buflen) {
             /* Message is not going to fit! Discard the data already recvd */
             ods_log_error("[%s] Message received to big, truncating.", module_str);
@@ -212,78 +206,228 @@ extract_msg(char* buf, int *pos, int buflen, int *exitcode, struct cmdhandler_ct
     }
 }
 
+static void
+queue_push(struct cmdhandler_queue* queue, cmdhandler_ctx_type* context)
+{
+    context->next = NULL;
+    if (queue->tail) {
+        queue->tail->next = context;
+    } else {
+        queue->head = context;
+    }
+    queue->tail = context;
+}
+
+static cmdhandler_ctx_type*
+queue_pop(struct cmdhandler_queue* queue)
+{
+    cmdhandler_ctx_type* context = queue->head;
+    if (context) {
+        queue->head = context->next;
+        if (!queue->head) queue->tail = NULL;
+        context->next = NULL;
+    }
+    return context;
+}
+
+static void
+client_free(cmdhandler_ctx_type* context)
+{
+    ods_log_debug("[%s] done handling client %i", module_str, context->sockfd);
+    shutdown(context->sockfd, SHUT_RDWR);
+    close(context->sockfd);
+    free(context);
+}
+
 /**
- * Handle a client command.
- * \param cmdc, command handler data, must not be NULL
+ * Hand the command of a client to the workers.
+ *
  */
 static void
-cmdhandler_handle_client_conversation(struct cmdhandler_ctx_struct* context)
+cmdhandler_enqueue(cmdhandler_type* cmdhandler, cmdhandler_ctx_type* context)
 {
-    char buf[ODS_SE_MAXLINE+4]; /* enough space for hdr and \0 */
-    int bufpos, r, numread;
-    int exitcode = 0;
-
-    bufpos = 0;
-    for (;;) {
-        numread = read(context->sockfd, &buf[bufpos], ODS_SE_MAXLINE - bufpos + 3);
-        if (numread == 0) {
-            /* client closed pipe */
-            break;
-        } else if (numread < 0) {
-            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            } else if (errno == ECONNRESET) {
-                ods_log_debug("[%s] done handling client: %s", module_str, strerror(errno));
-                break;
-            } else {
-                /* error occured */
-                ods_log_error("[%s] read error: %s", module_str, strerror(errno));
-                break;
-            }
-        } else {
-            bufpos += numread;
-            r = extract_msg(buf, &bufpos, ODS_SE_MAXLINE, &exitcode, context);
-            if (r == -1) {
-                ods_log_error("[%s] Error receiving message from client.", module_str);
-                break;
-            } else if (r == 1) {
-                if (!client_exit(context->sockfd, exitcode)) {
-                    ods_log_error("[%s] Error sending message to client.", module_str);
-                }
-            }
-        }
+    struct cmd_func_block* fb = get_funcblock(context->cmd, cmdhandler);
+
+    context->readonly = fb && fb->readonly;
+    pthread_mutex_lock(&cmdhandler->lock);
+    queue_push(&cmdhandler->queue[context->readonly], context);
+    pthread_cond_signal(&cmdhandler->cond);
+    pthread_mutex_unlock(&cmdhandler->lock);
+}
+
+/**
+ * Take the next command to run. Read-only and mutating commands take
+ * turns, and neither may occupy all workers so a burst of one class
+ * can't starve the other. Must be called with cmdhandler->lock held.
+ *
+ */
+static cmdhandler_ctx_type*
+cmdhandler_dequeue(cmdhandler_type* cmdhandler)
+{
+    cmdhandler_ctx_type* context;
+    int i, readonly;
+
+    for (i = 0; i < 2; i++) {
+        readonly = (cmdhandler->next_readonly + i) % 2;
+        if (cmdhandler->running[readonly] >= CMDHANDLER_WORKERS - 1)
+            continue;
+        if (!(context = queue_pop(&cmdhandler->queue[readonly])))
+            continue;
+        cmdhandler->running[readonly]++;
+        cmdhandler->next_readonly = !readonly;
+        return context;
     }
+    return NULL;
 }
 
 /**
- * Accept client.
+ * Command worker. Runs commands of any client, one at a time, and hands
+ * the client back to the handler afterwards.
  *
  */
 static void
-cmdhandler_accept_client(void* arg)
+cmdhandler_worker(void* arg)
 {
-    int err;
-    cmdhandler_ctx_type* context = (cmdhandler_ctx_type*) arg;
-
-    ods_log_debug("[%s] accept client %i", module_str, context->sockfd);
+    cmdhandler_type* cmdhandler = (cmdhandler_type*) arg;
+    cmdhandler_ctx_type* context;
+    void* localcontext = NULL;
+    int exitcode;
+    char c = 0;
+
+    pthread_mutex_lock(&cmdhandler->lock);
+    while (!cmdhandler->need_to_exit) {
+        if (!(context = cmdhandler_dequeue(cmdhandler))) {
+            pthread_cond_wait(&cmdhandler->cond, &cmdhandler->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&cmdhandler->lock);
 
-    if (context->cmdhandler->createlocalcontext) {
-        context->localcontext = context->cmdhandler->createlocalcontext(context->globalcontext);
-        if (!context->localcontext) {
+        /* The local context lives as long as the worker, a failure is
+         * retried with the next command. */
+        if (cmdhandler->createlocalcontext && !localcontext) {
+            localcontext = cmdhandler->createlocalcontext(cmdhandler->globalcontext);
+        }
+        client_buf_init(&context->out, context->sockfd);
+        client_buf_attach(&context->out);
+        if (cmdhandler->createlocalcontext && !localcontext) {
             client_printf_err(context->sockfd, "Failed to open DB connection.\n");
-            client_exit(context->sockfd, 1);
-            return;
+            exitcode = 1;
+        } else {
+            context->localcontext = localcontext;
+            exitcode = cmdhandler_perform_command(context->cmd, context);
+        }
+        if (!client_exit(context->sockfd, exitcode)) {
+            ods_log_error("[%s] Error sending message to client.", module_str);
+        }
+        client_buf_attach(NULL);
+        context->localcontext = NULL;
+
+        pthread_mutex_lock(&cmdhandler->lock);
+        cmdhandler->running[context->readonly]--;
+        queue_push(&cmdhandler->done, context);
+        /* a slot for the other class of commands may have opened up */
+        pthread_cond_broadcast(&cmdhandler->cond);
+        if (write(cmdhandler->wakeup[1], &c, 1) < 0 && errno != EAGAIN) {
+            ods_log_error("[%s] unable to wake up handler: %s", module_str, strerror(errno));
+        }
+    }
+    pthread_mutex_unlock(&cmdhandler->lock);
+    if (localcontext && cmdhandler->destroylocalcontext) {
+        cmdhandler->destroylocalcontext(localcontext);
+    }
+}
+
+/**
+ * Read from an idle client. Queues its command once it is complete.
+ * \return 0: client is gone and must be freed. 1: still idle.
+ *      2: command queued.
+ */
+static int
+cmdhandler_read_client(cmdhandler_type* cmdhandler, cmdhandler_ctx_type* context)
+{
+    int numread;
+
+    numread = read(context->sockfd, &context->in[context->inpos],
+        ODS_SE_MAXLINE - context->inpos + 3);
+    if (numread == 0) {
+        /* client closed pipe */
+        return 0;
+    } else if (numread < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 1;
+        } else if (errno == ECONNRESET) {
+            ods_log_debug("[%s] done handling client: %s", module_str, strerror(errno));
+        } else {
+            /* error occured */
+            ods_log_error("[%s] read error: %s", module_str, strerror(errno));
         }
+        return 0;
     }
+    context->inpos += numread;
+    if (extract_msg(context->in, &context->inpos, ODS_SE_MAXLINE, context->cmd)) {
+        cmdhandler_enqueue(cmdhandler, context);
+        return 2;
+    }
+    return 1;
+}
 
-    cmdhandler_handle_client_conversation(context);
-    if (context->sockfd) {
-        shutdown(context->sockfd, SHUT_RDWR);
-        close(context->sockfd);
+/**
+ * Accept client.
+ *
+ */
+static cmdhandler_ctx_type*
+cmdhandler_accept_client(cmdhandler_type* cmdhandler)
+{
+    struct sockaddr_un cliaddr;
+    socklen_t clilen = sizeof(cliaddr);
+    cmdhandler_ctx_type* context;
+    struct timeval sndtimeo;
+    int flags, connfd;
+
+    connfd = accept(cmdhandler->listen_fd, (struct sockaddr *) &cliaddr, &clilen);
+    if (connfd < 0) {
+        if (errno != EINTR && errno != EWOULDBLOCK) {
+            ods_log_warning("[%s] accept() error: %s", module_str, strerror(errno));
+        }
+        return NULL;
+    }
+    if (connfd >= FD_SETSIZE) {
+        ods_log_warning("[%s] too many open files, dropping client", module_str);
+        close(connfd);
+        return NULL;
     }
-    if (context->cmdhandler->destroylocalcontext) {
-        context->cmdhandler->destroylocalcontext(context->localcontext);
+    /* Explicitely set to blocking, on BSD they would inherit
+     * O_NONBLOCK from parent */
+    flags = fcntl(connfd, F_GETFL, 0);
+    if (flags < 0) {
+        ods_log_error("[%s] unable to create, fcntl(F_GETFL) failed: %s",
+            module_str, strerror(errno));
+        close(connfd);
+        return NULL;
     }
+    if (fcntl(connfd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+        ods_log_error("[%s] unable to create, fcntl(F_SETFL) failed: %s",
+            module_str, strerror(errno));
+        close(connfd);
+        return NULL;
+    }
+    /* a client that stops reading must not hold a worker forever */
+    sndtimeo.tv_sec = CMDHANDLER_SEND_TIMEOUT;
+    sndtimeo.tv_usec = 0;
+    if (setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &sndtimeo,
+            sizeof(sndtimeo)) < 0) {
+        ods_log_warning("[%s] unable to set send timeout on client: %s",
+            module_str, strerror(errno));
+    }
+    ods_log_debug("[%s] accept client %i", module_str, connfd);
+    CHECKALLOC(context = (cmdhandler_ctx_type*) malloc(sizeof(cmdhandler_ctx_type)));
+    context->cmdhandler = cmdhandler;
+    context->sockfd = connfd;
+    context->globalcontext = cmdhandler->globalcontext;
+    context->localcontext = NULL;
+    context->inpos = 0;
+    context->next = NULL;
+    return context;
 }
 
 /**
@@ -345,7 +489,21 @@ cmdhandler_create(const char* filename, struct cmd_func_block** commands, void*
         close(listenfd);
         return NULL;
     }
-    CHECKALLOC(cmdh = (cmdhandler_type*) malloc(sizeof(cmdhandler_type)));
+    CHECKALLOC(cmdh = (cmdhandler_type*) calloc(1, sizeof(cmdhandler_type)));
+    if (pipe(cmdh->wakeup) != 0) {
+        ods_log_error("[%s] unable to create cmdhandler: pipe() failed: %s", module_str, strerror(errno));
+        close(listenfd);
+        free(cmdh);
+        return NULL;
+    }
+    /* Workers must never block on a full pipe, one byte pending is
+     * enough to wake up the handler. */
+    flags = fcntl(cmdh->wakeup[0], F_GETFL, 0);
+    (void)fcntl(cmdh->wakeup[0], F_SETFL, flags | O_NONBLOCK);
+    flags = fcntl(cmdh->wakeup[1], F_GETFL, 0);
+    (void)fcntl(cmdh->wakeup[1], F_SETFL, flags | O_NONBLOCK);
+    pthread_mutex_init(&cmdh->lock, NULL);
+    pthread_cond_init(&cmdh->cond, NULL);
     cmdh->listen_fd = listenfd;
     cmdh->listen_addr = servaddr;
     cmdh->need_to_exit = 0;
@@ -365,6 +523,10 @@ void
 cmdhandler_cleanup(cmdhandler_type* cmdhandler)
 {
     close(cmdhandler->listen_fd);
+    close(cmdhandler->wakeup[0]);
+    close(cmdhandler->wakeup[1]);
+    pthread_mutex_destroy(&cmdhandler->lock);
+    pthread_cond_destroy(&cmdhandler->cond);
     free(cmdhandler);
 }
 
@@ -375,28 +537,37 @@ cmdhandler_cleanup(cmdhandler_type* cmdhandler)
 void
 cmdhandler_start(cmdhandler_type* cmdhandler)
 {
-    struct sockaddr_un cliaddr;
-    socklen_t clilen;
-    cmdhandler_ctx_type* cmdclient;
-    janitor_thread_t cmdclientthread;
+    /* Clients waiting for their next command, only touched here. */
+    struct cmdhandler_queue idle = {NULL, NULL};
+    cmdhandler_ctx_type *cmdclient, *next, *prev;
     fd_set rset;
-    int flags, connfd = 0, ret = 0;
-    ssize_t i;
+    int i, maxfd, nclients = 0, ret = 0;
+    char c[64];
 
     ods_log_assert(cmdhandler);
     ods_log_debug("[%s] start", module_str);
 
-    FD_ZERO(&rset);
+    for (i = 0; i < CMDHANDLER_WORKERS; i++) {
+        janitor_thread_create(&cmdhandler->workers[i], cmdhandlerthreadclass, &cmdhandler_worker, (void*) cmdhandler);
+    }
+
     while (cmdhandler->need_to_exit == 0) {
-        clilen = sizeof(cliaddr);
-        FD_SET(cmdhandler->listen_fd, &rset);
-        ret = select(cmdhandler->listen_fd+1, &rset, NULL, NULL, NULL);
+        FD_ZERO(&rset);
+        FD_SET(cmdhandler->wakeup[0], &rset);
+        maxfd = cmdhandler->wakeup[0];
+        /* Stop accepting when full, new clients queue up in the
+         * listen backlog until others are done. */
+        if (nclients < CMDHANDLER_MAXCLIENTS) {
+            FD_SET(cmdhandler->listen_fd, &rset);
+            if (cmdhandler->listen_fd > maxfd) maxfd = cmdhandler->listen_fd;
+        }
+        for (cmdclient = idle.head; cmdclient; cmdclient = cmdclient->next) {
+            FD_SET(cmdclient->sockfd, &rset);
+            if (cmdclient->sockfd > maxfd) maxfd = cmdclient->sockfd;
+        }
+        ret = select(maxfd+1, &rset, NULL, NULL, NULL);
         /* Don't handle new connections when need to exit, this
          * removes the delay of the self_pipe_trick*/
-
-        /* Opportunistic join threads LIFO. */
-        janitor_thread_tryjoinall(cmdhandlerthreadclass);
-
         if (cmdhandler->need_to_exit) break;
         if (ret < 0) {
             if (errno != EINTR && errno != EWOULDBLOCK) {
@@ -405,41 +576,67 @@ cmdhandler_start(cmdhandler_type* cmdhandler)
             }
             continue;
         }
-        if (FD_ISSET(cmdhandler->listen_fd, &rset)) {
-            connfd = accept(cmdhandler->listen_fd, (struct sockaddr *) &cliaddr, &clilen);
-            if (connfd < 0) {
-                if (errno != EINTR && errno != EWOULDBLOCK) {
-                    ods_log_warning("[%s] accept() error: %s", module_str, strerror(errno));
-                }
+        /* Clients read from, a client may hand in a new command
+         * before the old one is done. */
+        prev = NULL;
+        for (cmdclient = idle.head; cmdclient; cmdclient = next) {
+            next = cmdclient->next;
+            if (!FD_ISSET(cmdclient->sockfd, &rset)) {
+                prev = cmdclient;
                 continue;
             }
-            /* Explicitely set to blocking, on BSD they would inherit
-             * O_NONBLOCK from parent */
-            flags = fcntl(connfd, F_GETFL, 0);
-            if (flags < 0) {
-                ods_log_error("[%s] unable to create, fcntl(F_GETFL) failed: %s",
-                    module_str, strerror(errno));
-                close(connfd);
+            ret = cmdhandler_read_client(cmdhandler, cmdclient);
+            if (ret == 1) {
+                prev = cmdclient;
                 continue;
             }
-            if (fcntl(connfd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
-                ods_log_error("[%s] unable to create, fcntl(F_SETFL) failed: %s",
-                    module_str, strerror(errno));
-                close(connfd);
-                continue;
+            /* unlink, it is either queued or gone */
+            if (prev) prev->next = next; else idle.head = next;
+            if (idle.tail == cmdclient) idle.tail = prev;
+            if (ret == 0) {
+                client_free(cmdclient);
+                nclients--;
+            }
+        }
+        /* Clients handed back by the workers */
+        if (FD_ISSET(cmdhandler->wakeup[0], &rset)) {
+            while (read(cmdhandler->wakeup[0], c, sizeof(c)) > 0)
+                ;
+            pthread_mutex_lock(&cmdhandler->lock);
+            next = cmdhandler->done.head;
+            cmdhandler->done.head = cmdhandler->done.tail = NULL;
+            pthread_mutex_unlock(&cmdhandler->lock);
+            while ((cmdclient = next)) {
+                next = cmdclient->next;
+                if (extract_msg(cmdclient->in, &cmdclient->inpos, ODS_SE_MAXLINE, cmdclient->cmd)) {
+                    cmdhandler_enqueue(cmdhandler, cmdclient);
+                } else {
+                    queue_push(&idle, cmdclient);
+                }
+            }
+        }
+        if (nclients < CMDHANDLER_MAXCLIENTS && FD_ISSET(cmdhandler->listen_fd, &rset)) {
+            if ((cmdclient = cmdhandler_accept_client(cmdhandler))) {
+                queue_push(&idle, cmdclient);
+                nclients++;
             }
-            /* client accepted, create new thread */
-            cmdclient = malloc(sizeof(cmdhandler_ctx_type));
-            cmdclient->cmdhandler = cmdhandler;
-            cmdclient->sockfd = connfd;
-            cmdclient->globalcontext = cmdhandler->globalcontext;
-            cmdclient->localcontext = NULL;
-            janitor_thread_create(&cmdclientthread, cmdhandlerthreadclass, &cmdhandler_accept_client, (void*) cmdclient);
         }
     }
 
-    /* join threads */
-    janitor_thread_joinall(cmdhandlerthreadclass);
+    /* Let the workers finish their current command and join them */
+    pthread_mutex_lock(&cmdhandler->lock);
+    cmdhandler->need_to_exit = 1;
+    pthread_cond_broadcast(&cmdhandler->cond);
+    pthread_mutex_unlock(&cmdhandler->lock);
+    for (i = 0; i < CMDHANDLER_WORKERS; i++) {
+        janitor_thread_join(cmdhandler->workers[i]);
+    }
+
+    while ((cmdclient = queue_pop(&idle))) client_free(cmdclient);
+    for (i = 0; i < 2; i++) {
+        while ((cmdclient = queue_pop(&cmdhandler->queue[i]))) client_free(cmdclient);
+    }
+    while ((cmdclient = queue_pop(&cmdhandler->done))) client_free(cmdclient);
 
     ods_log_debug("[%s] done", module_str);
     cmdhandler->stopped = 1;
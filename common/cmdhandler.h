@@ -33,17 +33,36 @@
 #define DAEMON_CMDHANDLER_H
 
 #include "config.h"
+#include <pthread.h>
 #include <sys/un.h>
 
 typedef struct cmdhandler_struct cmdhandler_type;
 
+/* Number of threads running client commands. At least 2, one of them is
+ * always left for the other class of commands (read-only/mutating). */
+#define CMDHANDLER_WORKERS 4
+/* Clients connected at once, further clients wait in the listen backlog. */
+#define CMDHANDLER_MAXCLIENTS 256
+/* Seconds a write to a client may block before the client is dropped. */
+#define CMDHANDLER_SEND_TIMEOUT 30
+
 #include "janitor.h"
+#include "clientpipe.h"
 
 typedef struct cmdhandler_ctx_struct {
     int sockfd;
     void* globalcontext;
     void* localcontext;
     cmdhandler_type* cmdhandler;
+    /* output to the client, collected in large messages */
+    struct client_buf out;
+    /* input from the client, read by the handler while no command runs */
+    char in[ODS_SE_MAXLINE+4];
+    int inpos;
+    /* command waiting for or being run by a worker */
+    char cmd[ODS_SE_MAXLINE+1];
+    int readonly;
+    struct cmdhandler_ctx_struct* next;
 } cmdhandler_ctx_type;
 
 struct cmd_func_block {
@@ -68,6 +87,14 @@ struct cmd_func_block {
      *       positive error code to return to user.
      */
     int (*run)(int sockfd, cmdhandler_ctx_type*, char *cmd);
+    /* 1 if the command does not change any state and may run next to
+     * other read-only commands, 0 (default) otherwise */
+    int readonly;
+};
+
+struct cmdhandler_queue {
+    cmdhandler_ctx_type* head;
+    cmdhandler_ctx_type* tail;
 };
 
 struct cmdhandler_struct {
@@ -76,6 +103,17 @@ struct cmdhandler_struct {
     int listen_fd;
     int need_to_exit;
     int stopped;
+    janitor_thread_t workers[CMDHANDLER_WORKERS];
+    /* wakes up the handler when a worker hands back a client */
+    int wakeup[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* guarded by lock: clients with a command to run, indexed by
+     * readonly, and clients whose command is done */
+    struct cmdhandler_queue queue[2];
+    int running[2];
+    int next_readonly;
+    struct cmdhandler_queue done;
     struct cmd_func_block** commands;
     void* globalcontext;
     void* (*createlocalcontext)(void*);
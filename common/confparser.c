@@ -41,55 +41,56 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/un.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 static const char* parser_str = "parser";
 
+/* Configuration file kept parsed by parse_conf_open() */
+static pthread_mutex_t parse_conf_lock = PTHREAD_MUTEX_INITIALIZER;
+static xmlDocPtr parse_conf_doc = NULL;
+static char* parse_conf_file = NULL;
+
+/* Compiled RelaxNG schemas, kept per rng file */
+typedef struct parse_schema_struct parse_schema_type;
+struct parse_schema_struct {
+    parse_schema_type* next;
+    char* rngfile;
+    time_t mtime; /* of the rng file when it was compiled */
+    xmlRelaxNGPtr schema;
+    int refcount; /* validations in progress with this schema */
+    int stale; /* replaced, free when no longer in use */
+};
+static pthread_mutex_t parse_schema_lock = PTHREAD_MUTEX_INITIALIZER;
+static parse_schema_type* parse_schemas = NULL;
+
 /**
- * Parse elements from the configuration file.
+ * Compile the rng file.
  *
  */
-ods_status
-parse_file_check(const char* cfgfile, const char* rngfile)
+static xmlRelaxNGPtr
+parse_schema_compile(const char* rngfile, ods_status* status)
 {
-    xmlDocPtr doc = NULL;
     xmlDocPtr rngdoc = NULL;
     xmlRelaxNGParserCtxtPtr rngpctx = NULL;
-    xmlRelaxNGValidCtxtPtr rngctx = NULL;
     xmlRelaxNGPtr schema = NULL;
-    int status;
-
-    if (!cfgfile || !rngfile) {
-        ods_log_error("[%s] no cfgfile or rngfile", parser_str);
-        return ODS_STATUS_ASSERT_ERR;
-    }
-    ods_log_assert(cfgfile);
-    ods_log_assert(rngfile);
-    ods_log_debug("[%s] check cfgfile %s with rngfile %s", parser_str,
-        cfgfile, rngfile);
 
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] unable to read cfgfile %s", parser_str,
-            cfgfile);
-        return ODS_STATUS_XML_ERR;
-    }
     /* Load rng document */
     rngdoc = xmlParseFile(rngfile);
     if (rngdoc == NULL) {
         ods_log_error("[%s] unable to read rngfile %s", parser_str,
             rngfile);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_XML_ERR;
+        *status = ODS_STATUS_XML_ERR;
+        return NULL;
     }
     /* Create an XML RelaxNGs parser context for the relax-ng document. */
     rngpctx = xmlRelaxNGNewDocParserCtxt(rngdoc);
     if (rngpctx == NULL) {
         xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
         ods_log_error("[%s] unable to create XML RelaxNGs parser context",
            parser_str);
-        return ODS_STATUS_XML_ERR;
+        *status = ODS_STATUS_XML_ERR;
+        return NULL;
     }
     /* Parse a schema definition resource and
      * build an internal XML schema structure.
@@ -98,43 +99,285 @@ parse_file_check(const char* cfgfile, const char* rngfile)
     if (schema == NULL) {
         ods_log_error("[%s] unable to parse a schema definition resource",
             parser_str);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_PARSE_ERR;
+        *status = ODS_STATUS_PARSE_ERR;
+    }
+    xmlRelaxNGFreeParserCtxt(rngpctx);
+    xmlFreeDoc(rngdoc);
+    return schema;
+}
+
+/**
+ * Get the compiled schema for the rng file, compile it if it is not
+ * cached yet or if the rng file changed since. Release it with
+ * parse_schema_release().
+ *
+ */
+static parse_schema_type*
+parse_schema_acquire(const char* rngfile, ods_status* status)
+{
+    parse_schema_type* entry;
+    parse_schema_type** prev;
+    struct stat st;
+    time_t mtime = 0;
+
+    if (stat(rngfile, &st) == 0) {
+        mtime = st.st_mtime;
+    }
+    pthread_mutex_lock(&parse_schema_lock);
+    for (prev = &parse_schemas; *prev; prev = &(*prev)->next) {
+        if (strcmp((*prev)->rngfile, rngfile) == 0) {
+            break;
+        }
+    }
+    entry = *prev;
+    if (entry && entry->mtime == mtime) {
+        entry->refcount++;
+        pthread_mutex_unlock(&parse_schema_lock);
+        return entry;
+    }
+    if (entry) {
+        ods_log_debug("[%s] rngfile %s changed, recompile", parser_str,
+            rngfile);
+        *prev = entry->next;
+        if (entry->refcount == 0) {
+            xmlRelaxNGFree(entry->schema);
+            free(entry->rngfile);
+            free(entry);
+        } else {
+            entry->stale = 1;
+        }
+    }
+    CHECKALLOC(entry = (parse_schema_type*) calloc(1, sizeof(*entry)));
+    entry->schema = parse_schema_compile(rngfile, status);
+    if (entry->schema == NULL) {
+        pthread_mutex_unlock(&parse_schema_lock);
+        free(entry);
+        return NULL;
+    }
+    CHECKALLOC(entry->rngfile = strdup(rngfile));
+    entry->mtime = mtime;
+    entry->refcount = 1;
+    entry->next = parse_schemas;
+    parse_schemas = entry;
+    pthread_mutex_unlock(&parse_schema_lock);
+    return entry;
+}
+
+/**
+ * Release a schema got with parse_schema_acquire().
+ *
+ */
+static void
+parse_schema_release(parse_schema_type* entry)
+{
+    pthread_mutex_lock(&parse_schema_lock);
+    entry->refcount--;
+    if (entry->stale && entry->refcount == 0) {
+        xmlRelaxNGFree(entry->schema);
+        free(entry->rngfile);
+        free(entry);
+    }
+    pthread_mutex_unlock(&parse_schema_lock);
+}
+
+/**
+ * Validate a parsed document with the rng file.
+ *
+ */
+static ods_status
+parse_doc_check(xmlDocPtr doc, const char* cfgfile, const char* rngfile)
+{
+    parse_schema_type* entry = NULL;
+    xmlRelaxNGValidCtxtPtr rngctx = NULL;
+    ods_status status = ODS_STATUS_OK;
+
+    entry = parse_schema_acquire(rngfile, &status);
+    if (entry == NULL) {
+        return status;
     }
     /* Create an XML RelaxNGs validation context. */
-    rngctx = xmlRelaxNGNewValidCtxt(schema);
+    rngctx = xmlRelaxNGNewValidCtxt(entry->schema);
     if (rngctx == NULL) {
         ods_log_error("[%s] unable to create RelaxNGs validation context",
             parser_str);
-        xmlRelaxNGFree(schema);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
+        parse_schema_release(entry);
         return ODS_STATUS_RNG_ERR;
     }
     /* Validate a document tree in memory. */
-    status = xmlRelaxNGValidateDoc(rngctx,doc);
-    if (status != 0) {
+    if (xmlRelaxNGValidateDoc(rngctx,doc) != 0) {
         ods_log_error("[%s] cfgfile validation failed %s", parser_str,
             cfgfile);
-        xmlRelaxNGFreeValidCtxt(rngctx);
-        xmlRelaxNGFree(schema);
-        xmlRelaxNGFreeParserCtxt(rngpctx);
-        xmlFreeDoc(rngdoc);
-        xmlFreeDoc(doc);
-        return ODS_STATUS_RNG_ERR;
+        status = ODS_STATUS_RNG_ERR;
     }
-
     xmlRelaxNGFreeValidCtxt(rngctx);
-    xmlRelaxNGFree(schema);
-    xmlRelaxNGFreeParserCtxt(rngpctx);
-    xmlFreeDoc(rngdoc);
+    parse_schema_release(entry);
+    return status;
+}
+
+/**
+ * Parse elements from the configuration file.
+ *
+ */
+ods_status
+parse_file_check(const char* cfgfile, const char* rngfile)
+{
+    xmlDocPtr doc = NULL;
+    ods_status status;
+
+    if (!cfgfile || !rngfile) {
+        ods_log_error("[%s] no cfgfile or rngfile", parser_str);
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    ods_log_assert(cfgfile);
+    ods_log_assert(rngfile);
+    ods_log_debug("[%s] check cfgfile %s with rngfile %s", parser_str,
+        cfgfile, rngfile);
+
+    /* Load XML document */
+    doc = xmlParseFile(cfgfile);
+    if (doc == NULL) {
+        ods_log_error("[%s] unable to read cfgfile %s", parser_str,
+            cfgfile);
+        return ODS_STATUS_XML_ERR;
+    }
+    status = parse_doc_check(doc, cfgfile, rngfile);
     xmlFreeDoc(doc);
+    return status;
+}
+
+/**
+ * Check that the file is well-formed and has the given elements, without
+ * validating it against a schema.
+ *
+ */
+ods_status
+parse_file_check_structure(const char* cfgfile, const char** xexprs)
+{
+    xmlDocPtr doc = NULL;
+    xmlXPathContextPtr xpathCtx = NULL;
+    xmlXPathObjectPtr xpathObj = NULL;
+    ods_status status = ODS_STATUS_OK;
+    int i;
+
+    if (!cfgfile || !xexprs) {
+        ods_log_error("[%s] no cfgfile or elements", parser_str);
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    ods_log_debug("[%s] check structure of cfgfile %s", parser_str,
+        cfgfile);
+    doc = xmlParseFile(cfgfile);
+    if (doc == NULL) {
+        ods_log_error("[%s] unable to read cfgfile %s", parser_str,
+            cfgfile);
+        return ODS_STATUS_XML_ERR;
+    }
+    xpathCtx = xmlXPathNewContext(doc);
+    if (xpathCtx == NULL) {
+        ods_log_error("[%s] unable to create new XPath context for "
+            "cfgfile %s", parser_str, cfgfile);
+        xmlFreeDoc(doc);
+        return ODS_STATUS_XML_ERR;
+    }
+    for (i = 0; xexprs[i] && status == ODS_STATUS_OK; i++) {
+        xpathObj = xmlXPathEvalExpression((const xmlChar*) xexprs[i],
+            xpathCtx);
+        if (xpathObj == NULL || xpathObj->nodesetval == NULL ||
+            xpathObj->nodesetval->nodeNr <= 0) {
+            ods_log_error("[%s] cfgfile %s has no element %s", parser_str,
+                cfgfile, xexprs[i]);
+            status = ODS_STATUS_RNG_ERR;
+        }
+        if (xpathObj) {
+            xmlXPathFreeObject(xpathObj);
+        }
+    }
+    xmlXPathFreeContext(xpathCtx);
+    xmlFreeDoc(doc);
+    return status;
+}
+
+/**
+ * Parse and check the configuration file once, and keep it parsed.
+ *
+ */
+ods_status
+parse_conf_open(const char* cfgfile, const char* rngfile)
+{
+    xmlDocPtr doc = NULL;
+    ods_status status;
+
+    if (!cfgfile || !rngfile) {
+        ods_log_error("[%s] no cfgfile or rngfile", parser_str);
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    ods_log_debug("[%s] open cfgfile %s with rngfile %s", parser_str,
+        cfgfile, rngfile);
+    doc = xmlParseFile(cfgfile);
+    if (doc == NULL) {
+        ods_log_error("[%s] unable to read cfgfile %s", parser_str,
+            cfgfile);
+        return ODS_STATUS_XML_ERR;
+    }
+    status = parse_doc_check(doc, cfgfile, rngfile);
+    if (status != ODS_STATUS_OK) {
+        xmlFreeDoc(doc);
+        return status;
+    }
+    pthread_mutex_lock(&parse_conf_lock);
+    if (parse_conf_doc) {
+        xmlFreeDoc(parse_conf_doc);
+    }
+    free(parse_conf_file);
+    parse_conf_doc = doc;
+    parse_conf_file = strdup(cfgfile);
+    pthread_mutex_unlock(&parse_conf_lock);
     return ODS_STATUS_OK;
 }
 
+/**
+ * Release the configuration file kept by parse_conf_open().
+ *
+ */
+void
+parse_conf_close(void)
+{
+    pthread_mutex_lock(&parse_conf_lock);
+    if (parse_conf_doc) {
+        xmlFreeDoc(parse_conf_doc);
+    }
+    free(parse_conf_file);
+    parse_conf_doc = NULL;
+    parse_conf_file = NULL;
+    pthread_mutex_unlock(&parse_conf_lock);
+}
+
+/**
+ * Get the parsed configuration file: the one kept by parse_conf_open(),
+ * or else a fresh parse. Release it with parse_conf_unload().
+ *
+ */
+static xmlDocPtr
+parse_conf_load(const char* cfgfile)
+{
+    pthread_mutex_lock(&parse_conf_lock);
+    if (parse_conf_doc && strcmp(parse_conf_file, cfgfile) == 0) {
+        /* keep the lock until parse_conf_unload() */
+        return parse_conf_doc;
+    }
+    pthread_mutex_unlock(&parse_conf_lock);
+    return xmlParseFile(cfgfile);
+}
+
+static void
+parse_conf_unload(xmlDocPtr doc)
+{
+    if (doc && doc == parse_conf_doc) {
+        pthread_mutex_unlock(&parse_conf_lock);
+    } else if (doc) {
+        xmlFreeDoc(doc);
+    }
+}
+
 /* TODO: look how the enforcer reads this now */
 
 /**
@@ -154,7 +397,7 @@ parse_conf_string(const char* cfgfile, const char* expr, int required)
     ods_log_assert(cfgfile);
 
     /* Load XML document */
-    doc = xmlParseFile(cfgfile);
+    doc = parse_conf_load(cfgfile);
     if (doc == NULL) {
         return NULL;
     }
@@ -163,7 +406,7 @@ parse_conf_string(const char* cfgfile, const char* expr, int required)
     if (xpathCtx == NULL) {
         ods_log_error("[%s] unable to create new XPath context for cfgile "
             "%s expr %s", parser_str, cfgfile, (char*) expr);
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         return NULL;
     }
     /* Get string */
@@ -179,7 +422,7 @@ parse_conf_string(const char* cfgfile, const char* expr, int required)
         if (xpathObj) {
             xmlXPathFreeObject(xpathObj);
         }
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         return NULL;
     }
     if (xpathObj->nodesetval != NULL &&
@@ -187,12 +430,12 @@ parse_conf_string(const char* cfgfile, const char* expr, int required)
         string = (const char*) xmlXPathCastToString(xpathObj);
         xmlXPathFreeContext(xpathCtx);
         xmlXPathFreeObject(xpathObj);
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         return string;
     }
     xmlXPathFreeContext(xpathCtx);
     xmlXPathFreeObject(xpathObj);
-    xmlFreeDoc(doc);
+    parse_conf_unload(doc);
     return NULL;
 }
 
@@ -213,7 +456,7 @@ parse_conf_repositories(const char* cfgfile)
     int i;
     struct engineconfig_repository *head = NULL, *cur = NULL, *prev = NULL;
 
-    doc = xmlParseFile(cfgfile);
+    doc = parse_conf_load(cfgfile);
     if (doc == NULL) {
         ods_log_error("[%s] could not parse <RepositoryList>: "
             "xmlParseFile() failed", parser_str);
@@ -221,7 +464,7 @@ parse_conf_repositories(const char* cfgfile)
     }
     xpathCtx = xmlXPathNewContext(doc);
     if(xpathCtx == NULL) {
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         ods_log_error("[%s] could not parse <RepositoryList>: "
             "xmlXPathNewContext() failed", parser_str);
         return NULL;
@@ -230,7 +473,7 @@ parse_conf_repositories(const char* cfgfile)
     xpathObj = xmlXPathEvalExpression(xexpr, xpathCtx);
     if(xpathObj == NULL) {
         xmlXPathFreeContext(xpathCtx);
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         ods_log_error("[%s] could not parse <RepositoryList>: "
             "xmlXPathEvalExpression failed", parser_str);
         return NULL;
@@ -242,6 +485,7 @@ parse_conf_repositories(const char* cfgfile)
             cur->name = NULL;
             cur->module = NULL;
             cur->pin = NULL;
+            cur->tokenlabel = NULL;
             cur->require_backup = 0;
             cur->use_pubkey = 1;
             cur->allow_extract = 0;
@@ -278,7 +522,7 @@ parse_conf_repositories(const char* cfgfile)
     xmlXPathFreeObject(xpathObj);
     xmlXPathFreeContext(xpathCtx);
     if (doc) {
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
     }
     return head;
 }
@@ -802,7 +1046,7 @@ parse_conf_listener(const char* cfgfile)
     ods_log_assert(cfgfile);
 
     /* Load XML document */
-    doc = xmlParseFile(cfgfile);
+    doc = parse_conf_load(cfgfile);
     if (doc == NULL) {
         ods_log_error("[%s] could not parse <Listener>: "
             "xmlParseFile() failed", parser_str);
@@ -811,7 +1055,7 @@ parse_conf_listener(const char* cfgfile)
     /* Create xpath evaluation context */
     xpathCtx = xmlXPathNewContext(doc);
     if(xpathCtx == NULL) {
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         ods_log_error("[%s] could not parse <Listener>: "
             "xmlXPathNewContext() failed", parser_str);
         return NULL;
@@ -821,7 +1065,7 @@ parse_conf_listener(const char* cfgfile)
     xpathObj = xmlXPathEvalExpression(xexpr, xpathCtx);
     if(xpathObj == NULL) {
         xmlXPathFreeContext(xpathCtx);
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
         ods_log_error("[%s] could not parse <Listener>: "
             "xmlXPathEvalExpression failed", parser_str);
         return NULL;
@@ -859,7 +1103,7 @@ parse_conf_listener(const char* cfgfile)
     xmlXPathFreeObject(xpathObj);
     xmlXPathFreeContext(xpathCtx);
     if (doc) {
-        xmlFreeDoc(doc);
+        parse_conf_unload(doc);
     }
     return head;
 }
@@ -896,3 +1140,96 @@ parse_conf_signer_threads(const char* cfgfile)
     /* no SignerThreads value configured, look at WorkerThreads */
     return parse_conf_worker_threads(cfgfile, 0);
 }
+
+int
+parse_conf_listener_threads(const char* cfgfile)
+{
+    int numlt = 1;
+    const char* str = parse_conf_string(cfgfile,
+                                        "//Configuration/Signer/ListenerThreads",
+                                        0);
+    if (str) {
+        if (strlen(str) > 0) {
+            numlt = atoi(str);
+        }
+        free((void*)str);
+    }
+    return numlt;
+}
+
+int
+parse_conf_transfer_connections(const char* cfgfile)
+{
+    int numtc = 50;
+    const char* str = parse_conf_string(cfgfile,
+                                        "//Configuration/Signer/TransferConnections",
+                                        0);
+    if (str) {
+        if (strlen(str) > 0) {
+            numtc = atoi(str);
+        }
+        free((void*)str);
+    }
+    return numtc;
+}
+
+int
+parse_conf_transfer_connections_master(const char* cfgfile)
+{
+    int numtc = 0;
+    const char* str = parse_conf_string(cfgfile,
+                                        "//Configuration/Signer/TransferConnectionsPerMaster",
+                                        0);
+    if (str) {
+        if (strlen(str) > 0) {
+            numtc = atoi(str);
+        }
+        free((void*)str);
+    }
+    return numtc;
+}
+
+int
+parse_conf_transfer_window(const char* cfgfile)
+{
+    int numtw = 16;
+    const char* str = parse_conf_string(cfgfile,
+                                        "//Configuration/Signer/TransferWindow",
+                                        0);
+    if (str) {
+        if (strlen(str) > 0) {
+            numtw = atoi(str);
+        }
+        free((void*)str);
+    }
+    return numtw;
+}
+
+int
+parse_conf_trusted_signconf(const char* cfgfile)
+{
+    const char* str = parse_conf_string(cfgfile,
+                                        "//Configuration/Signer/TrustedSignconf",
+                                        0);
+    if (str) {
+        free((void*)str);
+        return 1;
+    }
+    return 0;
+}
+
+long
+parse_conf_signature_memory(const char* cfgfile)
+{
+    long mb = -1;
+    const char* str = parse_conf_string(cfgfile,
+                                        "//Configuration/Signer/SignatureMemory",
+                                        0);
+    if (str) {
+        if (strlen(str) > 0) {
+            mb = atol(str);
+        }
+        free((void*)str);
+    }
+    return mb;
+}
@@ -39,7 +39,8 @@
 #include <stdint.h>
 
 /**
- * Check config file with rng file.
+ * Check config file with rng file. The compiled rng file is kept for
+ * later checks, until the rng file changes.
  * \param[in] cfgfile the configuration file name
  * \param[in] rngfile the rng file name
  * \return ods_status status
@@ -47,6 +48,34 @@
  */
 ods_status parse_file_check(const char* cfgfile, const char* rngfile);
 
+/**
+ * Check that the config file is well-formed and has the given elements,
+ * without validating it with an rng file.
+ * \param[in] cfgfile the configuration file name
+ * \param[in] xexprs NULL terminated list of xml expressions
+ * \return ods_status status
+ *
+ */
+ods_status parse_file_check_structure(const char* cfgfile,
+    const char** xexprs);
+
+/**
+ * Parse and check the configuration file once. Until parse_conf_close(),
+ * the parse_conf_* functions for this file use the parsed document instead
+ * of reading the file again.
+ * \param[in] cfgfile the configuration file name
+ * \param[in] rngfile the rng file name
+ * \return ods_status status
+ *
+ */
+ods_status parse_conf_open(const char* cfgfile, const char* rngfile);
+
+/**
+ * Release the configuration file kept by parse_conf_open().
+ *
+ */
+void parse_conf_close(void);
+
 /**
  * Parse elements from the configuration file.
  * \param[in] cfgfile configuration file
@@ -102,6 +131,12 @@ int parse_conf_verbosity(const char* cfgfile);
 /** Enforcer and signer specific */
 int parse_conf_worker_threads(const char* cfgfile, int is_enforcer);
 int parse_conf_signer_threads(const char* cfgfile);
+int parse_conf_listener_threads(const char* cfgfile);
+int parse_conf_transfer_connections(const char* cfgfile);
+int parse_conf_transfer_connections_master(const char* cfgfile);
+int parse_conf_transfer_window(const char* cfgfile);
+int parse_conf_trusted_signconf(const char* cfgfile);
+long parse_conf_signature_memory(const char* cfgfile);
 int parse_conf_manual_keygen(const char* cfgfile);
 int parse_conf_db_port(const char *cfgfile);
 time_t parse_conf_automatic_keygen_period(const char* cfgfile);
@@ -28,16 +28,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
+#include "log.h"
 #include "status.h"
 #include "datastructure.h"
 
+/* compact the store once this many bytes in it are no longer used */
+#define COLLECTION_COMPACT_MIN (16*1024*1024)
+/* times to read members back from the store before giving up */
+#define COLLECTION_READ_TRIES 3
+
 struct collection_class_struct {
     FILE* store;
+    char* fname;
     void* cargo;
     int (*member_destroy)(void* cargo, void* member);
     int (*member_dispose)(void* cargo, void* member, FILE*);
     int (*member_restore)(void* cargo, void* member, FILE*);
+    pthread_mutex_t lock;
+    size_t budget; /** bytes of stored members to keep in memory */
+    size_t resident; /** bytes of stored members in memory */
+    size_t live; /** bytes in store in use */
+    size_t garbage; /** bytes in store no longer in use */
+    size_t compact_min; /** garbage that triggers a compaction */
+    struct collection_instance_struct* instances;
 };
 
 struct collection_instance_struct {
@@ -47,20 +63,33 @@ struct collection_instance_struct {
     int iterator;
     int count; /** number of members in array */
     long location;
+    size_t stored; /** bytes at location in store */
+    struct collection_instance_struct* prev;
+    struct collection_instance_struct* next;
+    unsigned swapped : 1; /** members only in store */
+    unsigned dirty : 1; /** members changed since stored */
 };
 
 static int
 swapin(collection_t collection)
 {
     int i;
-    if(collection->count > 0) {
+    if(collection->swapped) {
         if(fseek(collection->method->store, collection->location, SEEK_SET))
             return 1;
         for(i=0; i<collection->count; i++) {
             if(collection->method->member_restore(collection->method->cargo,
-                    collection->array + collection->size * i, collection->method->store))
+                    collection->array + collection->size * i, collection->method->store)) {
+                /* still swapped, drop what was read so far */
+                while(--i >= 0) {
+                    collection->method->member_destroy(collection->method->cargo,
+                            collection->array + collection->size * i);
+                }
                 return 1;
+            }
         }
+        collection->swapped = 0;
+        collection->method->resident += collection->stored;
     }
     return 0;
 }
@@ -69,17 +98,145 @@ static int
 swapout(collection_t collection)
 {
     int i;
-    if(collection->count > 0) {
-        if(fseek(collection->method->store, 0, SEEK_END))
-            return 1;
-        collection->location = ftell(collection->method->store);
+    long location = -1;
+    long end = 0;
+    if(collection->dirty) {
+        /* the members stay resident at their old location until all
+         * of them are written */
+        if(collection->count > 0) {
+            if(fseek(collection->method->store, 0, SEEK_END))
+                goto error;
+            location = end = ftell(collection->method->store);
+            if(location < 0)
+                goto error;
+            for(i=0; i<collection->count; i++) {
+                if(collection->method->member_dispose(collection->method->cargo,
+                        collection->array + collection->size * i, collection->method->store))
+                    goto error;
+            }
+            if(fflush(collection->method->store))
+                goto error;
+            end = ftell(collection->method->store);
+            if(end < location)
+                goto error;
+        }
+        collection->method->resident -= collection->stored;
+        collection->method->live -= collection->stored;
+        collection->method->garbage += collection->stored;
+        collection->location = (location < 0 ? 0 : location);
+        collection->stored = (location < 0 ? 0 : end - location);
+        collection->method->resident += collection->stored;
+        collection->method->live += collection->stored;
+        collection->dirty = 0;
+    }
+    /* members are on disk, drop them from memory when over budget */
+    if(collection->method->resident > collection->method->budget) {
         for(i=0; i<collection->count; i++) {
-            if(collection->method->member_dispose(collection->method->cargo,
-                    collection->array + collection->size * i, collection->method->store))
-                return 1;
+            collection->method->member_destroy(collection->method->cargo,
+                    collection->array + collection->size * i);
         }
+        collection->swapped = 1;
+        collection->method->resident -= collection->stored;
     }
     return 0;
+error:
+    /* whatever got written is not used */
+    end = ftell(collection->method->store);
+    if(location >= 0 && end > location)
+        collection->method->garbage += end - location;
+    clearerr(collection->method->store);
+    return 1;
+}
+
+static int
+compact(collection_class klass)
+{
+    FILE* store;
+    collection_t collection;
+    long* locations = NULL;
+    char buf[BUFSIZ];
+    size_t len, n, i, count = 0;
+
+    if(!(store = fopen(klass->fname, "w+")))
+        return 1;
+    (void)unlink(klass->fname);
+    for(collection = klass->instances; collection; collection = collection->next) {
+        if(collection->stored != 0)
+            count++;
+    }
+    CHECKALLOC(locations = malloc((count ? count : 1) * sizeof(long)));
+    /* copy first, the old locations stay valid until all copies are made */
+    i = 0;
+    for(collection = klass->instances; collection; collection = collection->next) {
+        if(collection->stored == 0)
+            continue;
+        if(fseek(klass->store, collection->location, SEEK_SET))
+            goto error;
+        if((locations[i++] = ftell(store)) < 0)
+            goto error;
+        for(len = collection->stored; len > 0; len -= n) {
+            n = (len < sizeof(buf) ? len : sizeof(buf));
+            if(fread(buf, 1, n, klass->store) != n ||
+                    fwrite(buf, 1, n, store) != n)
+                goto error;
+        }
+    }
+    if(fflush(store))
+        goto error;
+    i = 0;
+    for(collection = klass->instances; collection; collection = collection->next) {
+        if(collection->stored != 0)
+            collection->location = locations[i++];
+    }
+    free(locations);
+    fclose(klass->store);
+    klass->store = store;
+    klass->garbage = 0;
+    klass->compact_min = COLLECTION_COMPACT_MIN;
+    return 0;
+error:
+    /* abandon the copy, the old store is still intact */
+    free(locations);
+    fclose(store);
+    clearerr(klass->store);
+    /* do not try again until the garbage has doubled */
+    klass->compact_min = 2 * klass->garbage;
+    return 1;
+}
+
+static void
+release(collection_t collection)
+{
+    collection_class klass = collection->method;
+    if(collection->iterator >= 0)
+        return;
+    if(swapout(collection)) {
+        /* still dirty, the members stay in memory and are written later */
+        ods_log_error("unable to write to collection store, keeping "
+            "collection in memory: %s", strerror(errno));
+        return;
+    }
+    if(klass->garbage > klass->compact_min && klass->garbage > klass->live) {
+        if(compact(klass))
+            ods_log_error("unable to compact collection store: %s",
+                strerror(errno));
+    }
+}
+
+static void
+acquire(collection_t collection)
+{
+    int tries = 0;
+    while(swapin(collection)) {
+        /* members read so far are lost, read them all again */
+        ods_log_error("unable to read from collection store: %s",
+            strerror(errno));
+        clearerr(collection->method->store);
+        if(++tries >= COLLECTION_READ_TRIES) {
+            /* going on would drop the members without telling */
+            ods_fatal_exit("unable to read from collection store");
+        }
+    }
 }
 
 void
@@ -92,27 +249,44 @@ collection_class_allocated(collection_class* klass, void *cargo,
     (*klass)->member_dispose = NULL;
     (*klass)->member_restore = NULL;
     (*klass)->store = NULL;
+    (*klass)->fname = NULL;
+    (*klass)->budget = 0;
+    (*klass)->resident = 0;
+    (*klass)->live = 0;
+    (*klass)->garbage = 0;
+    (*klass)->compact_min = COLLECTION_COMPACT_MIN;
+    (*klass)->instances = NULL;
+    pthread_mutex_init(&(*klass)->lock, NULL);
 }
 
 void
-collection_class_backed(collection_class* klass, char* fname, void *cargo,
+collection_class_backed(collection_class* klass, char* fname, size_t budget,
+        void *cargo,
         int (*member_destroy)(void* cargo, void* member),
         int (*member_dispose)(void* cargo, void* member, FILE*),
         int (*member_restore)(void* cargo, void* member, FILE*))
 {
-    CHECKALLOC(*klass = malloc(sizeof(struct collection_class_struct)));
-    (*klass)->cargo = cargo;
-    (*klass)->member_destroy = member_destroy;
+    collection_class_allocated(klass, cargo, member_destroy);
     (*klass)->member_dispose = member_dispose;
     (*klass)->member_restore = member_restore;
+    (*klass)->budget = budget;
+    CHECKALLOC((*klass)->fname = strdup(fname));
     (*klass)->store = fopen(fname, "w+");
+    if((*klass)->store) {
+        /* the store is private to this process */
+        (void)unlink(fname);
+    }
 }
 
 void
 collection_class_destroy(collection_class* klass)
 {
-    if (klass == NULL)
+    if (klass == NULL || *klass == NULL)
         return;
+    if((*klass)->store)
+        fclose((*klass)->store);
+    free((*klass)->fname);
+    pthread_mutex_destroy(&(*klass)->lock);
     free(*klass);
     *klass = NULL;
 }
@@ -127,17 +301,50 @@ collection_create_array(collection_t* collection, size_t membsize,
     (*collection)->array = NULL;
     (*collection)->iterator = -1;
     (*collection)->method = klass;
+    (*collection)->location = 0;
+    (*collection)->stored = 0;
+    (*collection)->swapped = 0;
+    (*collection)->dirty = 0;
+    (*collection)->prev = NULL;
+    (*collection)->next = NULL;
+    if(klass->store) {
+        pthread_mutex_lock(&klass->lock);
+        (*collection)->next = klass->instances;
+        if(klass->instances)
+            klass->instances->prev = *collection;
+        klass->instances = *collection;
+        pthread_mutex_unlock(&klass->lock);
+    }
 }
 
 void
 collection_destroy(collection_t* collection)
 {
     int i;
-    if(collection == NULL)
+    collection_class klass;
+    if(collection == NULL || *collection == NULL)
         return;
-    for (i=0; i < (*collection)->count; i++) {
-        (*collection)->method->member_destroy((*collection)->method->cargo,
-                &(*collection)->array[(*collection)->size * i]);
+    klass = (*collection)->method;
+    if(klass->store) {
+        pthread_mutex_lock(&klass->lock);
+        if((*collection)->prev)
+            (*collection)->prev->next = (*collection)->next;
+        else
+            klass->instances = (*collection)->next;
+        if((*collection)->next)
+            (*collection)->next->prev = (*collection)->prev;
+        if(!(*collection)->swapped)
+            klass->resident -= (*collection)->stored;
+        klass->live -= (*collection)->stored;
+        klass->garbage += (*collection)->stored;
+        pthread_mutex_unlock(&klass->lock);
+    }
+    /* members that are swapped out hold no allocated memory */
+    if(!(*collection)->swapped) {
+        for (i=0; i < (*collection)->count; i++) {
+            klass->member_destroy(klass->cargo,
+                    &(*collection)->array[(*collection)->size * i]);
+        }
     }
     if((*collection)->array)
         free((*collection)->array);
@@ -149,14 +356,19 @@ void
 collection_add(collection_t collection, void *data)
 {
     void* ptr;
-    if(collection->method->store)
-        swapin(collection);
+    if(collection->method->store) {
+        pthread_mutex_lock(&collection->method->lock);
+        acquire(collection);
+    }
     CHECKALLOC(ptr = realloc(collection->array, (collection->count+1)*collection->size));
     collection->array = ptr;
     memcpy(&collection->array[collection->size * collection->count], data, collection->size);
     collection->count += 1;
-    if(collection->method->store)
-        swapout(collection);
+    if(collection->method->store) {
+        collection->dirty = 1;
+        release(collection);
+        pthread_mutex_unlock(&collection->method->lock);
+    }
 }
 
 void
@@ -165,8 +377,10 @@ collection_del_index(collection_t collection, int index)
     void* ptr;
     if (index<0 || index >= collection->count)
         return;
-    if(collection->method->store)
-        swapin(collection);
+    if(collection->method->store) {
+        pthread_mutex_lock(&collection->method->lock);
+        acquire(collection);
+    }
     collection->method->member_destroy(collection->method->cargo, &collection->array[collection->size * index]);
     collection->count -= 1;
     memmove(&collection->array[collection->size * index], &collection->array[collection->size * (index + 1)], (collection->count - index) * collection->size);
@@ -177,8 +391,11 @@ collection_del_index(collection_t collection, int index)
         free(collection->array);
         collection->array = NULL;
     }
-    if(collection->method->store)
-        swapout(collection);
+    if(collection->method->store) {
+        collection->dirty = 1;
+        release(collection);
+        pthread_mutex_unlock(&collection->method->lock);
+    }
 }
 
 void
@@ -191,16 +408,22 @@ void*
 collection_iterator(collection_t collection)
 {
     if(collection->iterator < 0) {
-        if(collection->method->store)
-            swapin(collection);
+        if(collection->method->store) {
+            pthread_mutex_lock(&collection->method->lock);
+            acquire(collection);
+            pthread_mutex_unlock(&collection->method->lock);
+        }
         collection->iterator = collection->count;
     }
     collection->iterator -= 1;
     if(collection->iterator >= 0) {
         return &collection->array[collection->iterator * collection->size];
     } else {
-        if(collection->method->store)
-            swapout(collection);
+        if(collection->method->store) {
+            pthread_mutex_lock(&collection->method->lock);
+            release(collection);
+            pthread_mutex_unlock(&collection->method->lock);
+        }
         return NULL;
     }
 }
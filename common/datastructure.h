@@ -28,6 +28,7 @@
 #define UTIL_DATASTRUCTURE_H
 
 #include "config.h"
+#include <stdio.h>
 
 struct collection_class_struct;
 typedef struct collection_class_struct* collection_class;
@@ -45,7 +46,21 @@ void collection_create_array(collection_t* collection, size_t membsize, collecti
 void collection_class_allocated(collection_class* klass, void *cargo,
         int (*member_destroy)(void* cargo, void* member));
 
-void collection_class_backed(collection_class* klass, char* fname, void *cargo,
+/**
+ * Creates a collection class whose members are written to a store file.
+ * Members of a collection are written when the collection has changed,
+ * and are dropped from memory when more than budget bytes of stored
+ * members are in memory. They are read back when the collection is used.
+ * \param[out] klass the class to be initialized
+ * \param[in] fname store file, removed from the file system once opened
+ * \param[in] budget bytes of stored members to keep in memory
+ * \param[in] cargo passed to the member functions
+ * \param[in] member_destroy frees the memory held by a member
+ * \param[in] member_dispose writes a member to the store
+ * \param[in] member_restore reads a member from the store
+ */
+void collection_class_backed(collection_class* klass, char* fname,
+        size_t budget, void *cargo,
         int (*member_destroy)(void* cargo, void* member),
         int (*member_dispose)(void* cargo, void* member, FILE*),
         int (*member_restore)(void* cargo, void* member, FILE*));
@@ -351,6 +351,63 @@ duration2string_num_calloc_failed:
 }
 
 
+/**
+ * Convert a time to a duration string in a caller supplied buffer.
+ *
+ */
+int
+duration_time2str(time_t time, char* buf, size_t len)
+{
+    duration_type duration;
+    size_t pos = 1;
+    int D, T, ret = 0;
+
+    if (!buf || len < 2 || duration_set_time(&duration, time)) {
+        return -1;
+    }
+    D = duration.years > 0 || duration.months > 0 || duration.days > 0;
+    T = duration.hours > 0 || duration.minutes > 0 ||
+        duration.seconds > 0 || !D;
+    buf[0] = 'P';
+    buf[1] = '\0';
+    if (duration.years > 0 && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "%uY", (uint32_t) duration.years);
+        pos += ret;
+    }
+    if (duration.months > 0 && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "%uM", (uint32_t) duration.months);
+        pos += ret;
+    }
+    if (duration.days > 0 && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "%uD", (uint32_t) duration.days);
+        pos += ret;
+    }
+    if (T && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "T");
+        pos += ret;
+    }
+    if (duration.hours > 0 && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "%uH", (uint32_t) duration.hours);
+        pos += ret;
+    }
+    if (duration.minutes > 0 && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "%uM",
+            (uint32_t) duration.minutes);
+        pos += ret;
+    }
+    if ((duration.seconds > 0 || (!D && !duration.hours &&
+        !duration.minutes)) && ret >= 0 && pos < len) {
+        ret = snprintf(buf + pos, len - pos, "%uS",
+            (uint32_t) duration.seconds);
+        pos += ret;
+    }
+    if (ret < 0 || pos >= len) {
+        return -1;
+    }
+    return (int) pos;
+}
+
+
 /**
  * Convert a duration to a time.
  *
@@ -85,6 +85,17 @@ duration_type* duration_create_from_string(const char* str);
  */
 char* duration2string(duration_type* duration);
 
+/**
+ * Convert a time to a duration string, like duration_set_time() followed
+ * by duration2string() but without allocating.
+ * \param[in] time time to be converted
+ * \param[out] buf buffer for the string-format duration
+ * \param[in] len size of the buffer
+ * \return int length of the string, -1 if the buffer is too small
+ *
+ */
+int duration_time2str(time_t time, char* buf, size_t len);
+
 /**
  * Convert a duration to a time.
  * \param[in] duration duration to be converted
@@ -44,6 +44,8 @@ static int logging_to_syslog = 0;
 #include <stdlib.h> /* exit() */
 #include <string.h> /* strlen() */
 #include <pthread.h>
+#include <signal.h> /* pthread_sigmask() */
+#include <unistd.h> /* getpid() */
 
 #define LOG_DEEEBUG 8 /* ods_log_deeebug */
 
@@ -51,6 +53,32 @@ static FILE* logfile = NULL;
 static int log_level = LOG_CRIT;
 
 #define CTIME_LENGTH 26
+#define LOG_RING_SIZE 1048576 /* bytes of log lines queued for the writer */
+
+/**
+ * Lines for the log file are queued in a ring and written in batches by a
+ * writer thread, so that logging threads do not wait for the disk. If the
+ * ring is full, lines are dropped and counted. Errors and worse are not
+ * queued but written directly, after the queued lines, so that they are
+ * on disk before an abort.
+ * Lock order: log_write_lock, then log_lock.
+ *
+ */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER; /* ring */
+static pthread_mutex_t log_write_lock = PTHREAD_MUTEX_INITIALIZER; /* file */
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_t log_writer;
+static pid_t log_writer_pid = 0; /* process running the writer, 0 if none */
+static int log_async = 0;
+static int log_stop = 0;
+static char* log_ring = NULL;
+static char* log_batch = NULL;
+static size_t log_head = 0;
+static size_t log_used = 0;
+static unsigned long log_dropped = 0;
+static time_t log_time = 0;
+static char log_timestr[CTIME_LENGTH];
 
 /**
  * Use _r() functions on platforms that have. They are thread safe versions of
@@ -76,6 +104,176 @@ struct syslog_data sdata = SYSLOG_DATA_INIT;
 static const char* log_str = "log";
 static char* log_ident = NULL;
 
+
+/**
+ * Refresh the cached timestamp. Called with log_lock held.
+ *
+ */
+static void
+ods_log_timestamp(void)
+{
+    time_t now = time_now();
+    if (now != log_time) {
+        (void) ctime_r(&now, log_timestr);
+        log_timestr[CTIME_LENGTH-2] = '\0'; /* remove trailing linefeed */
+        log_time = now;
+    }
+}
+
+
+/**
+ * Write the queued lines to the log file. Called with log_write_lock held.
+ *
+ */
+static void
+ods_log_drain(void)
+{
+    size_t len = 0;
+    size_t first = 0;
+    pthread_mutex_lock(&log_lock);
+    if (!log_used && !log_dropped) {
+        pthread_mutex_unlock(&log_lock);
+        return;
+    }
+    if (log_dropped) {
+        ods_log_timestamp();
+        len = snprintf(log_batch, ODS_SE_MAXLINE, "[%s] %s[%i] %s: [%s] "
+            "%lu messages dropped, log writer too slow\n", log_timestr,
+            log_ident, LOG_WARNING, "warning", log_str, log_dropped);
+        if (len >= ODS_SE_MAXLINE) {
+            len = ODS_SE_MAXLINE - 1;
+        }
+        log_dropped = 0;
+    }
+    first = LOG_RING_SIZE - log_head;
+    if (first > log_used) {
+        first = log_used;
+    }
+    memcpy(log_batch + len, log_ring + log_head, first);
+    memcpy(log_batch + len + first, log_ring, log_used - first);
+    len += log_used;
+    log_head = 0;
+    log_used = 0;
+    pthread_mutex_unlock(&log_lock);
+    if (logfile) {
+        (void) fwrite(log_batch, 1, len, logfile);
+        fflush(logfile);
+    }
+}
+
+
+/**
+ * Log writer thread.
+ *
+ */
+static void*
+ods_log_writer(void* arg)
+{
+    (void) arg;
+    while (1) {
+        pthread_mutex_lock(&log_lock);
+        while (!log_used && !log_dropped && !log_stop) {
+            pthread_cond_wait(&log_cond, &log_lock);
+        }
+        if (log_stop) {
+            pthread_mutex_unlock(&log_lock);
+            break;
+        }
+        pthread_mutex_unlock(&log_lock);
+        pthread_mutex_lock(&log_write_lock);
+        ods_log_drain();
+        pthread_mutex_unlock(&log_write_lock);
+    }
+    return NULL;
+}
+
+
+/**
+ * Stop the writer thread of this process, and write what is left.
+ *
+ */
+static void
+ods_log_stop_writer(void)
+{
+    int running = 0;
+    pthread_mutex_lock(&log_lock);
+    running = (log_writer_pid != 0 && log_writer_pid == getpid());
+    if (running) {
+        log_stop = 1;
+        pthread_cond_signal(&log_cond);
+    }
+    pthread_mutex_unlock(&log_lock);
+    if (running) {
+        (void) pthread_join(log_writer, NULL);
+    }
+    pthread_mutex_lock(&log_write_lock);
+    ods_log_drain();
+    pthread_mutex_lock(&log_lock);
+    log_writer_pid = 0;
+    log_stop = 0;
+    pthread_mutex_unlock(&log_lock);
+    pthread_mutex_unlock(&log_write_lock);
+}
+
+
+/**
+ * Write what is queued before fork(), so that neither process writes the
+ * lines twice, and make sure no lock is held across the fork. The child
+ * starts its own writer on its first line.
+ *
+ */
+static void
+ods_log_prefork(void)
+{
+    pthread_mutex_lock(&log_write_lock);
+    if (log_batch) {
+        ods_log_drain();
+    }
+    pthread_mutex_lock(&log_lock);
+}
+
+static void
+ods_log_postfork(void)
+{
+    pthread_mutex_unlock(&log_lock);
+    pthread_mutex_unlock(&log_write_lock);
+}
+
+static void
+ods_log_exit(void)
+{
+    if (log_batch) {
+        ods_log_stop_writer();
+    }
+    log_async = 0;
+}
+
+
+/**
+ * Start the writer thread, with all signals blocked so that they keep
+ * going to the threads that handle them.
+ *
+ */
+static int
+ods_log_start_writer(void)
+{
+    sigset_t all, old;
+    int ret = 0;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    ret = pthread_create(&log_writer, NULL, ods_log_writer, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return ret;
+}
+
+static void
+ods_log_once(void)
+{
+    (void) pthread_atfork(ods_log_prefork, ods_log_postfork,
+        ods_log_postfork);
+    (void) atexit(ods_log_exit);
+}
+
 /**
  * Initialize logging.
  */
@@ -86,9 +284,17 @@ ods_log_init(const char *programname, int use_syslog, const char *targetname, in
     int facility;
     int error = 0;
 #endif /* HAVE_SYSLOG_H */
+    (void) pthread_once(&log_once, ods_log_once);
+    if (log_batch) {
+        ods_log_stop_writer();
+    }
+    log_async = 0;
+    pthread_mutex_lock(&log_write_lock);
     if(logfile && logfile != stderr && logfile != stdout) {
             ods_fclose(logfile);
     }
+    logfile = NULL;
+    pthread_mutex_unlock(&log_write_lock);
     if(log_ident) {
         free(log_ident);
         log_ident = NULL;
@@ -126,6 +332,11 @@ ods_log_init(const char *programname, int use_syslog, const char *targetname, in
     if(targetname && targetname[0]) {
         logfile = ods_fopen(targetname, NULL, "a");
         if (logfile) {
+            if (!log_ring) {
+                log_ring = (char*) malloc(LOG_RING_SIZE);
+                log_batch = (char*) malloc(LOG_RING_SIZE + ODS_SE_MAXLINE);
+            }
+            log_async = (log_ring && log_batch);
             ods_log_debug("[%s] new logfile %s", log_str, targetname);
             return;
         }
@@ -241,8 +452,10 @@ static void
 ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
 {
     char message[ODS_SE_MAXLINE];
-    static char nowstr[CTIME_LENGTH];
-    time_t now = time_now();
+    char line[ODS_SE_MAXLINE + 128];
+    size_t len = 0;
+    size_t first = 0;
+    int start = 0;
 
     vsnprintf(message, sizeof(message), s, args);
 
@@ -262,12 +475,66 @@ ods_log_vmsg(int priority, const char* t, const char* s, va_list args)
         return;
     }
 
-    (void) ctime_r(&now, nowstr);
-    nowstr[CTIME_LENGTH-2] = '\0'; /* remove trailing linefeed */
-
-    fprintf(logfile, "[%s] %s[%i] %s: %s\n", nowstr,
+    /* format all but the fixed width timestamp before taking the lock */
+    line[0] = '[';
+    line[CTIME_LENGTH-1] = ']';
+    line[CTIME_LENGTH] = ' ';
+    len = CTIME_LENGTH + 1;
+    len += snprintf(line + len, sizeof(line) - len, "%s[%i] %s: %s\n",
         log_ident, priority, t, message);
-    fflush(logfile);
+    if (len >= sizeof(line)) {
+        len = sizeof(line) - 1;
+        line[len-1] = '\n';
+    }
+
+    pthread_mutex_lock(&log_lock);
+    ods_log_timestamp();
+    memcpy(line + 1, log_timestr, CTIME_LENGTH - 2);
+    if (log_async && !log_stop && priority > LOG_ERR) {
+        if (log_used + len <= LOG_RING_SIZE) {
+            /* queue for the writer */
+            first = (log_head + log_used) % LOG_RING_SIZE;
+            if (first + len <= LOG_RING_SIZE) {
+                memcpy(log_ring + first, line, len);
+            } else {
+                memcpy(log_ring + first, line, LOG_RING_SIZE - first);
+                memcpy(log_ring, line + LOG_RING_SIZE - first,
+                    len - (LOG_RING_SIZE - first));
+            }
+            log_used += len;
+            if (log_writer_pid != getpid()) {
+                log_writer_pid = getpid();
+                start = 1;
+            }
+            pthread_cond_signal(&log_cond);
+            pthread_mutex_unlock(&log_lock);
+            if (start && ods_log_start_writer() != 0) {
+                /* no writer, write synchronously from now on */
+                pthread_mutex_lock(&log_lock);
+                log_async = 0;
+                log_writer_pid = 0;
+                pthread_mutex_unlock(&log_lock);
+                pthread_mutex_lock(&log_write_lock);
+                ods_log_drain();
+                pthread_mutex_unlock(&log_write_lock);
+            }
+            return;
+        }
+        log_dropped++;
+        pthread_mutex_unlock(&log_lock);
+        return;
+    }
+    pthread_mutex_unlock(&log_lock);
+    /* write it ourselves, after the lines already queued */
+    pthread_mutex_lock(&log_write_lock);
+    if (log_batch) {
+        ods_log_drain();
+    }
+    if (logfile) {
+        (void) fwrite(line, 1, len, logfile);
+        fflush(logfile);
+    }
+    pthread_mutex_unlock(&log_write_lock);
 }
 
 
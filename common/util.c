@@ -35,6 +35,7 @@
 #include "log.h"
 #include "util.h"
 
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <ldns/ldns.h>
 #include <signal.h>
@@ -257,6 +258,164 @@ util_b64_pton_calculate_size(size_t srcsize)
     return (((((srcsize + 3) / 4) * 3)) + 1);
 }
 
+static const char util_b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Append a base64 rdata field to the buffer.
+ *
+ */
+static ods_status
+util_b642buffer(ldns_buffer* buffer, const uint8_t* data, size_t len)
+{
+    char* out = NULL;
+    size_t i = 0;
+    if (len == 0) {
+        ldns_buffer_write_u8(buffer, '0');
+        return ODS_STATUS_OK;
+    }
+    if (!ldns_buffer_reserve(buffer, ((len + 2) / 3) * 4)) {
+        return ODS_STATUS_MALLOC_ERR;
+    }
+    out = (char*) ldns_buffer_current(buffer);
+    for (i = 0; i + 2 < len; i += 3) {
+        *out++ = util_b64[data[i] >> 2];
+        *out++ = util_b64[((data[i] & 0x03) << 4) | (data[i+1] >> 4)];
+        *out++ = util_b64[((data[i+1] & 0x0f) << 2) | (data[i+2] >> 6)];
+        *out++ = util_b64[data[i+2] & 0x3f];
+    }
+    if (i < len) {
+        *out++ = util_b64[data[i] >> 2];
+        if (i + 1 < len) {
+            *out++ = util_b64[((data[i] & 0x03) << 4) | (data[i+1] >> 4)];
+            *out++ = util_b64[(data[i+1] & 0x0f) << 2];
+        } else {
+            *out++ = util_b64[(data[i] & 0x03) << 4];
+            *out++ = '=';
+        }
+        *out++ = '=';
+    }
+    ldns_buffer_skip(buffer, out - (char*) ldns_buffer_current(buffer));
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Append a time rdata field to the buffer, YYYYMMDDHHmmSS. The 32 bit
+ * value is interpreted with serial arithmetic relative to now, like ldns.
+ *
+ */
+static ods_status
+util_time2buffer(ldns_buffer* buffer, uint32_t value, time_t now)
+{
+    struct tm tm;
+    time_t t = now + (int32_t) (value - (uint32_t) now);
+    if (!gmtime_r(&t, &tm)) {
+        return ODS_STATUS_ERR;
+    }
+    ldns_buffer_printf(buffer, "%04d%02d%02d%02d%02d%02d",
+        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+        tm.tm_min, tm.tm_sec);
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Convert an LDNS RR to presentation format.
+ *
+ */
+ods_status
+util_rr2buffer(ldns_buffer* buffer, const ldns_rr* rr)
+{
+    const ldns_rdf* rdf = NULL;
+    const uint8_t* data = NULL;
+    char addr[INET6_ADDRSTRLEN];
+    ods_status status = ODS_STATUS_OK;
+    time_t now = 0;
+    size_t count = 0;
+    size_t i = 0;
+
+    if (!buffer || !rr) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    /* types that ldns decorates with comments go the generic way */
+    switch (ldns_rr_get_type(rr)) {
+        case LDNS_RR_TYPE_A:
+        case LDNS_RR_TYPE_AAAA:
+        case LDNS_RR_TYPE_NS:
+        case LDNS_RR_TYPE_CNAME:
+        case LDNS_RR_TYPE_PTR:
+        case LDNS_RR_TYPE_MX:
+        case LDNS_RR_TYPE_RRSIG:
+        case LDNS_RR_TYPE_NSEC:
+            count = ldns_rr_rd_count(rr);
+            if (ldns_rr_owner(rr) && !ldns_rr_is_question(rr) && count > 0) {
+                break;
+            }
+            /* fallthrough */
+        default:
+            if (ldns_rr2buffer_str_fmt(buffer, NULL, rr) != LDNS_STATUS_OK) {
+                return ODS_STATUS_FWRITE_ERR;
+            }
+            return ODS_STATUS_OK;
+    }
+    (void) ldns_rdf2buffer_str_dname(buffer, ldns_rr_owner(rr));
+    ldns_buffer_printf(buffer, "\t%u\t", (unsigned) ldns_rr_ttl(rr));
+    (void) ldns_rr_class2buffer_str(buffer, ldns_rr_get_class(rr));
+    ldns_buffer_write_u8(buffer, '\t');
+    (void) ldns_rr_type2buffer_str(buffer, ldns_rr_get_type(rr));
+    ldns_buffer_write_u8(buffer, '\t');
+    for (i = 0; i < count && status == ODS_STATUS_OK; i++) {
+        if (i > 0) {
+            ldns_buffer_write_u8(buffer, ' ');
+        }
+        rdf = ldns_rr_rdf(rr, i);
+        if (!rdf) {
+            continue;
+        }
+        data = ldns_rdf_data(rdf);
+        switch (ldns_rdf_get_type(rdf)) {
+            case LDNS_RDF_TYPE_A:
+                if (ldns_rdf_size(rdf) != 4) {
+                    return ODS_STATUS_FWRITE_ERR;
+                }
+                ldns_buffer_printf(buffer, "%u.%u.%u.%u", data[0], data[1],
+                    data[2], data[3]);
+                break;
+            case LDNS_RDF_TYPE_AAAA:
+                if (ldns_rdf_size(rdf) != 16 ||
+                    !inet_ntop(AF_INET6, data, addr, sizeof(addr))) {
+                    return ODS_STATUS_FWRITE_ERR;
+                }
+                ldns_buffer_write(buffer, addr, strlen(addr));
+                break;
+            case LDNS_RDF_TYPE_B64:
+                status = util_b642buffer(buffer, data, ldns_rdf_size(rdf));
+                break;
+            case LDNS_RDF_TYPE_TIME:
+                if (ldns_rdf_size(rdf) != 4) {
+                    return ODS_STATUS_FWRITE_ERR;
+                }
+                if (!now) {
+                    now = time(NULL);
+                }
+                status = util_time2buffer(buffer, ldns_read_uint32(data), now);
+                break;
+            default:
+                if (ldns_rdf2buffer_str(buffer, rdf) != LDNS_STATUS_OK) {
+                    status = ODS_STATUS_FWRITE_ERR;
+                }
+                break;
+        }
+    }
+    ldns_buffer_write_u8(buffer, '\n');
+    if (status == ODS_STATUS_OK && !ldns_buffer_status_ok(buffer)) {
+        status = ODS_STATUS_MALLOC_ERR;
+    }
+    return status;
+}
+
+
 /**
  * Print an LDNS RR, check status.
  *
@@ -264,34 +423,44 @@ util_b64_pton_calculate_size(size_t srcsize)
 ods_status
 util_rr_print(FILE* fd, const ldns_rr* rr)
 {
-    char* result = NULL;
     ldns_buffer* tmp_buffer = NULL;
     ods_status status = ODS_STATUS_OK;
 
     if (!fd || !rr) {
         return ODS_STATUS_ASSERT_ERR;
     }
-
-    tmp_buffer = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+    tmp_buffer = ldns_buffer_new(LDNS_MIN_BUFLEN);
     if (!tmp_buffer) {
-            return ODS_STATUS_MALLOC_ERR;
+        return ODS_STATUS_MALLOC_ERR;
     }
-    if (ldns_rr2buffer_str_fmt(tmp_buffer, NULL, rr)
-                    == LDNS_STATUS_OK) {
-            /* export and return string, destroy rest */
-            result = ldns_buffer2str(tmp_buffer);
-            if (result) {
-                fprintf(fd, "%s", result);
-                status = ODS_STATUS_OK;
-                LDNS_FREE(result);
-            } else {
-                fprintf(fd, "; Unable to convert rr to string\n");
-                status = ODS_STATUS_FWRITE_ERR;
-            }
-    } else {
+    status = util_rr_print_buf(fd, tmp_buffer, rr);
+    ldns_buffer_free(tmp_buffer);
+    return status;
+}
+
+
+/**
+ * Print an LDNS RR, using a scratch buffer.
+ *
+ */
+ods_status
+util_rr_print_buf(FILE* fd, ldns_buffer* buffer, const ldns_rr* rr)
+{
+    ods_status status = ODS_STATUS_OK;
+
+    if (!fd || !buffer || !rr) {
+        return ODS_STATUS_ASSERT_ERR;
+    }
+    ldns_buffer_clear(buffer);
+    status = util_rr2buffer(buffer, rr);
+    if (status == ODS_STATUS_OK) {
+        if (fwrite(ldns_buffer_begin(buffer), 1, ldns_buffer_position(buffer),
+            fd) != ldns_buffer_position(buffer)) {
             status = ODS_STATUS_FWRITE_ERR;
+        }
+    } else {
+        fprintf(fd, "; Unable to convert rr to string\n");
     }
-    ldns_buffer_free(tmp_buffer);
     return status;
 }
 
@@ -104,6 +104,27 @@ int util_write_pidfile(const char* pidfile, pid_t pid);
  */
 ods_status util_rr_print(FILE* fd, const ldns_rr* rr);
 
+/**
+ * Print an LDNS RR, reusing a scratch buffer between calls.
+ * \param[in] fd file descriptor
+ * \param[in] buffer scratch buffer
+ * \param[in] rr RR
+ * \return ods_status status
+ *
+ */
+ods_status util_rr_print_buf(FILE* fd, ldns_buffer* buffer, const ldns_rr* rr);
+
+/**
+ * Append an LDNS RR in presentation format to a buffer. Common record
+ * types are formatted directly from wire data; the output is identical
+ * to ldns_rr2buffer_str().
+ * \param[in] buffer buffer
+ * \param[in] rr RR
+ * \return ods_status status
+ *
+ */
+ods_status util_rr2buffer(ldns_buffer* buffer, const ldns_rr* rr);
+
 /**
  * Calculates the size needed to store the result of b64_pton.
  * \param[in] len strlen
@@ -49,6 +49,7 @@
 #include "db/db_configuration.h"
 #include "db/db_connection.h"
 #include "db/database_version.h"
+#include "db/dbw.h"
 #include "hsmkey/hsm_key_factory.h"
 #include "libhsm.h"
 #include "locks.h"
@@ -103,6 +104,7 @@ engine_dealloc(engine_type* engine)
         db_configuration_list_free(engine->dbcfg_list);
     }
     hsm_key_factory_deinit();
+    dbw_snapshot_clear();
     free(engine);
 }
 
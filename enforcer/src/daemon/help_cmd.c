@@ -98,5 +98,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block help_funcblock = {
-	"help", &usage, &help, &handles, &run
+	"help", &usage, &help, &handles, &run, 1
 };
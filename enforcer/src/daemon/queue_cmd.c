@@ -122,7 +122,7 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block queue_funcblock = {
-	"queue", &usage, &help, NULL, &run
+	"queue", &usage, &help, NULL, &run, 1
 };
 
 static void
@@ -198,6 +198,16 @@ int db_clause_set_type(db_clause_t* clause, db_clause_type_t type);
  */
 int db_clause_set_operator(db_clause_t* clause, db_clause_operator_t clause_operator);
 
+/**
+ * Make the database clause a nested clause of the clauses in a database clause
+ * list, the clause takes ownership of the list. The clause must not have a
+ * field set.
+ * \param[in] a db_clause_t pointer.
+ * \param[in] clause_list a db_clause_list_t pointer.
+ * \return DB_ERROR_* on failure, otherwise DB_OK.
+ */
+int db_clause_set_list(db_clause_t* clause, db_clause_list_t* clause_list);
+
 /**
  * Check if the database clause is not empty.
  * \param[in] a db_clause_t pointer.
@@ -32,8 +32,26 @@
 
 
 #include <stdlib.h>
+#include <pthread.h>
 
+static unsigned long changes = 0;
+static pthread_mutex_t changes_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Called after anything was written, successful or not. */
+static void db_connection_changed(void) {
+    pthread_mutex_lock(&changes_lock);
+    changes++;
+    pthread_mutex_unlock(&changes_lock);
+}
+
+unsigned long db_connection_changes(void) {
+    unsigned long n;
+
+    pthread_mutex_lock(&changes_lock);
+    n = changes;
+    pthread_mutex_unlock(&changes_lock);
+    return n;
+}
 
 db_connection_t* db_connection_new(void) {
     db_connection_t* connection =
@@ -111,6 +129,8 @@ int db_connection_last_id(const db_connection_t* connection, int *last_id) {
 }
 
 int db_connection_create(const db_connection_t* connection, const db_object_t* object, const db_object_field_list_t* object_field_list, const db_value_set_t* value_set) {
+    int ret;
+
     if (!connection) {
         return DB_ERROR_UNKNOWN;
     }
@@ -127,7 +147,9 @@ int db_connection_create(const db_connection_t* connection, const db_object_t* o
         return DB_ERROR_UNKNOWN;
     }
 
-    return db_backend_create(connection->backend, object, object_field_list, value_set);
+    ret = db_backend_create(connection->backend, object, object_field_list, value_set);
+    db_connection_changed();
+    return ret;
 }
 
 db_result_list_t* db_connection_read(const db_connection_t* connection, const db_object_t* object, const db_join_list_t* join_list, const db_clause_list_t* clause_list) {
@@ -145,6 +167,8 @@ db_result_list_t* db_connection_read(const db_connection_t* connection, const db
 }
 
 int db_connection_update(const db_connection_t* connection, const db_object_t* object, const db_object_field_list_t* object_field_list, const db_value_set_t* value_set, const db_clause_list_t* clause_list) {
+    int ret;
+
     if (!connection) {
         return DB_ERROR_UNKNOWN;
     }
@@ -161,10 +185,14 @@ int db_connection_update(const db_connection_t* connection, const db_object_t* o
         return DB_ERROR_UNKNOWN;
     }
 
-    return db_backend_update(connection->backend, object, object_field_list, value_set, clause_list);
+    ret = db_backend_update(connection->backend, object, object_field_list, value_set, clause_list);
+    db_connection_changed();
+    return ret;
 }
 
 int db_connection_delete(const db_connection_t* connection, const db_object_t* object, const db_clause_list_t* clause_list) {
+    int ret;
+
     if (!connection) {
         return DB_ERROR_UNKNOWN;
     }
@@ -175,7 +203,9 @@ int db_connection_delete(const db_connection_t* connection, const db_object_t* o
         return DB_ERROR_UNKNOWN;
     }
 
-    return db_backend_delete(connection->backend, object, clause_list);
+    ret = db_backend_delete(connection->backend, object, clause_list);
+    db_connection_changed();
+    return ret;
 }
 
 int db_connection_count(const db_connection_t* connection, const db_object_t* object, const db_join_list_t* join_list, const db_clause_list_t* clause_list, size_t* count) {
@@ -194,3 +224,40 @@ int db_connection_count(const db_connection_t* connection, const db_object_t* ob
 
     return db_backend_count(connection->backend, object, join_list, clause_list, count);
 }
+
+int db_connection_transaction_begin(const db_connection_t* connection) {
+    if (!connection) {
+        return DB_ERROR_UNKNOWN;
+    }
+    if (!connection->backend) {
+        return DB_ERROR_UNKNOWN;
+    }
+
+    return db_backend_transaction_begin(connection->backend);
+}
+
+int db_connection_transaction_commit(const db_connection_t* connection) {
+    int ret;
+
+    if (!connection) {
+        return DB_ERROR_UNKNOWN;
+    }
+    if (!connection->backend) {
+        return DB_ERROR_UNKNOWN;
+    }
+
+    ret = db_backend_transaction_commit(connection->backend);
+    db_connection_changed();
+    return ret;
+}
+
+int db_connection_transaction_rollback(const db_connection_t* connection) {
+    if (!connection) {
+        return DB_ERROR_UNKNOWN;
+    }
+    if (!connection->backend) {
+        return DB_ERROR_UNKNOWN;
+    }
+
+    return db_backend_transaction_rollback(connection->backend);
+}
@@ -139,4 +139,33 @@ int db_connection_delete(const db_connection_t* connection, const db_object_t* o
  */
 int db_connection_count(const db_connection_t* connection, const db_object_t* object, const db_join_list_t* join_list, const db_clause_list_t* clause_list, size_t* count);
 
+/**
+ * Begin a transaction in the database.
+ * \param[in] connection a db_connection_t pointer.
+ * \return DB_ERROR_* on failure, otherwise DB_OK.
+ */
+int db_connection_transaction_begin(const db_connection_t* connection);
+
+/**
+ * Commit the current transaction in the database.
+ * \param[in] connection a db_connection_t pointer.
+ * \return DB_ERROR_* on failure, otherwise DB_OK.
+ */
+int db_connection_transaction_commit(const db_connection_t* connection);
+
+/**
+ * Roll back the current transaction in the database.
+ * \param[in] connection a db_connection_t pointer.
+ * \return DB_ERROR_* on failure, otherwise DB_OK.
+ */
+int db_connection_transaction_rollback(const db_connection_t* connection);
+
+/**
+ * Get the number of changes made to the database through any connection of
+ * this process. Creates, updates, deletes and transaction commits count.
+ * \return a counter that is different whenever the database might have
+ * changed since it was last read.
+ */
+unsigned long db_connection_changes(void);
+
 #endif
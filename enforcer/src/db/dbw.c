@@ -608,43 +608,19 @@ dbw_hsmkey_update(const db_connection_t *dbconn, struct dbrow *row)
     return r;
 }
 
-#define GT(x)   ((x)>0)
-#define LTE(x)   ((x)<=0)
+#define ROW(p) (*(struct dbrow * const *)(p))
+static int cmp_id(const void *l, const void *r) { return ROW(l)->id - ROW(r)->id; }
+static int cmp_int0(const void *l, const void *r) { return ROW(l)->int0 - ROW(r)->int0; }
+static int cmp_int1(const void *l, const void *r) { return ROW(l)->int1 - ROW(r)->int1; }
+static int cmp_int2(const void *l, const void *r) { return ROW(l)->int2 - ROW(r)->int2; }
 /**
- * cmp -,0,+: lt, eq, gt
+ * Rows come back from the database ordered by id, qsort keeps that
+ * O(n log n) where a first element pivot would go quadratic.
  */
-static void
-quicksort(struct dbrow **row, int first, int last,
-    int (*cmp)(struct dbrow*, struct dbrow*))
-{
-    /** not very efficient for already sorted lists! */
-    int pivot, j, i;
-    struct dbrow *temp;
-    if(first >= last) return;
-    pivot = i = first;
-    j = last;
-    while (i < j) {
-        while (i < last && LTE(cmp(row[i], row[pivot]))) i++;
-        while (GT(cmp(row[j], row[pivot]))) j--;
-        if (i < j) {
-            temp = row[i];
-            row[i] = row[j];
-            row[j] = temp;
-        }
-    }
-    temp = row[pivot];
-    row[pivot] = row[j];
-    row[j] = temp;
-    quicksort(row, first, j-1, cmp);
-    quicksort(row, j+1, last, cmp);
-}
-static int cmp_id(struct dbrow *l, struct dbrow *r) { return l->id - r->id; }
-static int cmp_int0(struct dbrow *l, struct dbrow *r) { return l->int0 - r->int0; }
-static int cmp_int1(struct dbrow *l, struct dbrow *r) { return l->int1 - r->int1; }
-static int cmp_int2(struct dbrow *l, struct dbrow *r) { return l->int2 - r->int2; }
-static void sort_list(struct dbw_list *list, int (*cmp)(struct dbrow*, struct dbrow*))
+static void sort_list(struct dbw_list *list, int (*cmp)(const void *, const void *))
 {
-    quicksort(list->set, 0, list->n-1, cmp);
+    if (list->n > 1)
+        qsort(list->set, list->n, sizeof (struct dbrow *), cmp);
 }
 static void sort_list_by_parent_id(struct dbw_list *list, int pidx)
 {
@@ -659,7 +635,7 @@ static void sort_list_by_parent_id(struct dbw_list *list, int pidx)
 static void
 sort_by_id(struct dbw_list *list)
 {
-    quicksort(list->set, 0, list->n-1, cmp_id);
+    sort_list(list, cmp_id);
 }
 
 
@@ -978,11 +954,20 @@ hsmkey_dbx_to_dbw(const hsm_key_t *dbx_item)
  */
 
 static struct dbw_list *
-dbw_zones(db_connection_t *dbconn, int fetch)
+dbw_zones(db_connection_t *dbconn, int fetch,
+    const db_clause_list_t *clause_list)
 {
     zone_list_db_t* dbx_list = NULL;
     size_t n = 0;
-    if (fetch) {
+    if (fetch && clause_list) {
+        dbx_list = zone_list_db_new(dbconn);
+        if (!dbx_list) return NULL;
+        if (zone_list_db_get_by_clauses(dbx_list, clause_list)) {
+            zone_list_db_free(dbx_list);
+            return NULL;
+        }
+        n = zone_list_db_size(dbx_list);
+    } else if (fetch) {
         dbx_list = zone_list_db_new_get(dbconn);
         if (!dbx_list) return NULL;
         n = zone_list_db_size(dbx_list);
@@ -1018,11 +1003,20 @@ dbw_zones(db_connection_t *dbconn, int fetch)
 }
 
 static struct dbw_list *
-dbw_keys(db_connection_t *dbconn, int fetch)
+dbw_keys(db_connection_t *dbconn, int fetch,
+    const db_clause_list_t *clause_list)
 {
     key_data_list_t* dbx_list = NULL;
     size_t n = 0;
-    if (fetch) {
+    if (fetch && clause_list) {
+        dbx_list = key_data_list_new(dbconn);
+        if (!dbx_list) return NULL;
+        if (key_data_list_get_by_clauses(dbx_list, clause_list)) {
+            key_data_list_free(dbx_list);
+            return NULL;
+        }
+        n = key_data_list_size(dbx_list);
+    } else if (fetch) {
         dbx_list = key_data_list_new_get(dbconn);
         if (!dbx_list) return NULL;
         n = key_data_list_size(dbx_list);
@@ -1058,11 +1052,20 @@ dbw_keys(db_connection_t *dbconn, int fetch)
 }
 
 static struct dbw_list *
-dbw_keystates(db_connection_t *dbconn, int fetch)
+dbw_keystates(db_connection_t *dbconn, int fetch,
+    const db_clause_list_t *clause_list)
 {
     key_state_list_t* dbx_list = NULL;
     size_t n = 0;
-    if (fetch) {
+    if (fetch && clause_list) {
+        dbx_list = key_state_list_new(dbconn);
+        if (!dbx_list) return NULL;
+        if (key_state_list_get_by_clauses(dbx_list, clause_list)) {
+            key_state_list_free(dbx_list);
+            return NULL;
+        }
+        n = key_state_list_size(dbx_list);
+    } else if (fetch) {
         dbx_list = key_state_list_new_get(dbconn);
         if (!dbx_list) return NULL;
         n = key_state_list_size(dbx_list);
@@ -1138,11 +1141,20 @@ dbw_keydependencies(db_connection_t *dbconn, int fetch)
 }
 
 static struct dbw_list *
-dbw_hsmkeys(db_connection_t *dbconn, int fetch)
+dbw_hsmkeys(db_connection_t *dbconn, int fetch,
+    const db_clause_list_t *clause_list)
 {
     hsm_key_list_t* dbx_list = NULL;
     size_t n = 0;
-    if (fetch) {
+    if (fetch && clause_list) {
+        dbx_list = hsm_key_list_new(dbconn);
+        if (!dbx_list) return NULL;
+        if (hsm_key_list_get_by_clauses(dbx_list, clause_list)) {
+            hsm_key_list_free(dbx_list);
+            return NULL;
+        }
+        n = hsm_key_list_size(dbx_list);
+    } else if (fetch) {
         dbx_list = hsm_key_list_new_get(dbconn);
         if (!dbx_list) return NULL;
         n = hsm_key_list_size(dbx_list);
@@ -1287,10 +1299,10 @@ dbw_fetch_filtered(db_connection_t *conn, int mask)
     }
     db->conn            = conn;
     db->policies        = dbw_policies(conn, mask&DBW_F_POLICY);
-    db->zones           = dbw_zones(conn, mask&DBW_F_ZONE);
-    db->keys            = dbw_keys(conn, mask&DBW_F_KEY);
-    db->keystates       = dbw_keystates(conn, mask&DBW_F_KEYSTATE);
-    db->hsmkeys         = dbw_hsmkeys(conn, mask&DBW_F_HSMKEY);
+    db->zones           = dbw_zones(conn, mask&DBW_F_ZONE, NULL);
+    db->keys            = dbw_keys(conn, mask&DBW_F_KEY, NULL);
+    db->keystates       = dbw_keystates(conn, mask&DBW_F_KEYSTATE, NULL);
+    db->hsmkeys         = dbw_hsmkeys(conn, mask&DBW_F_HSMKEY, NULL);
     db->policykeys      = dbw_policykeys(conn, mask&DBW_F_POLICYKEY);
     db->keydependencies = dbw_keydependencies(conn, mask&DBW_F_KEYDEPENDENCY);
     (void)pthread_rwlock_unlock(&db_lock);
@@ -1320,6 +1332,436 @@ dbw_fetch(db_connection_t *conn)
     return dbw_fetch_filtered(conn, DBW_F_ALL);
 }
 
+/**
+ *  SHARED SNAPSHOT
+ *
+ */
+
+static struct dbw_db *snapshot = NULL;
+static unsigned long snapshot_changes;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Must be called with snapshot_lock held. */
+static void
+snapshot_unref(struct dbw_db *db)
+{
+    if (--db->refs == 0) dbw_free(db);
+}
+
+struct dbw_db *
+dbw_snapshot(db_connection_t *conn)
+{
+    struct dbw_db *db;
+    unsigned long changes;
+
+    /* Fetching with the lock held makes concurrent callers wait for this
+     * fetch rather than each doing their own. */
+    pthread_mutex_lock(&snapshot_lock);
+    /* Counted before fetching: a write during the fetch makes the result
+     * stale right away. */
+    changes = db_connection_changes();
+    if (snapshot && snapshot_changes != changes) {
+        snapshot_unref(snapshot);
+        snapshot = NULL;
+    }
+    if (!snapshot && (snapshot = dbw_fetch(conn))) {
+        snapshot->conn = NULL; /* never to be committed */
+        snapshot->refs = 1; /* the cache's own reference */
+        snapshot_changes = changes;
+    }
+    if ((db = snapshot)) db->refs++;
+    pthread_mutex_unlock(&snapshot_lock);
+    return db;
+}
+
+void
+dbw_snapshot_release(struct dbw_db *db)
+{
+    if (!db) return;
+    pthread_mutex_lock(&snapshot_lock);
+    snapshot_unref(db);
+    /* Don't keep a stale copy of the database around until the next
+     * read-only command. */
+    if (snapshot && snapshot->refs == 1
+        && snapshot_changes != db_connection_changes())
+    {
+        snapshot_unref(snapshot);
+        snapshot = NULL;
+    }
+    pthread_mutex_unlock(&snapshot_lock);
+}
+
+void
+dbw_snapshot_clear(void)
+{
+    pthread_mutex_lock(&snapshot_lock);
+    if (snapshot) snapshot_unref(snapshot);
+    snapshot = NULL;
+    pthread_mutex_unlock(&snapshot_lock);
+}
+
+/**
+ *  SCOPED FETCHES
+ *
+ */
+
+/* Ids per nested OR clause, keeps the statement well inside the fixed size
+ * SQL buffer of the backends. */
+#define DBW_IDS_PER_QUERY 64
+
+typedef struct dbw_list *(*dbw_list_fetch)(db_connection_t *, int,
+    const db_clause_list_t *);
+
+/* Add "field = value" to clause_list, joined by op. */
+static int
+dbw_clause_int(db_clause_list_t *clause_list, const char *field,
+    db_clause_operator_t op, int value)
+{
+    db_clause_t *clause;
+
+    if (!(clause = db_clause_new())
+        || db_clause_set_field(clause, field)
+        || db_clause_set_type(clause, DB_CLAUSE_EQUAL)
+        || db_clause_set_operator(clause, op)
+        || db_value_from_int64(db_clause_get_value(clause), value)
+        || db_clause_list_add(clause_list, clause))
+    {
+        db_clause_free(clause);
+        return 1;
+    }
+    return 0;
+}
+
+static int
+dbw_clause_text(db_clause_list_t *clause_list, const char *field,
+    const char *value)
+{
+    db_clause_t *clause;
+
+    if (!(clause = db_clause_new())
+        || db_clause_set_field(clause, field)
+        || db_clause_set_type(clause, DB_CLAUSE_EQUAL)
+        || db_clause_set_operator(clause, DB_CLAUSE_OPERATOR_AND)
+        || db_value_from_text(db_clause_get_value(clause), value)
+        || db_clause_list_add(clause_list, clause))
+    {
+        db_clause_free(clause);
+        return 1;
+    }
+    return 0;
+}
+
+/* Add "(field = ids[0] OR field = ids[1] ...)" to clause_list. */
+static int
+dbw_clause_ids(db_clause_list_t *clause_list, const char *field,
+    const int *ids, size_t n)
+{
+    db_clause_list_t *nested;
+    db_clause_t *clause;
+
+    if (!(nested = db_clause_list_new())) return 1;
+    for (size_t i = 0; i < n; i++) {
+        if (dbw_clause_int(nested, field, DB_CLAUSE_OPERATOR_OR, ids[i])) {
+            db_clause_list_free(nested);
+            return 1;
+        }
+    }
+    if (!(clause = db_clause_new())
+        || db_clause_set_operator(clause, DB_CLAUSE_OPERATOR_AND)
+        || db_clause_set_list(clause, nested))
+    {
+        db_clause_free(clause);
+        db_clause_list_free(nested);
+        return 1;
+    }
+    if (db_clause_list_add(clause_list, clause)) {
+        db_clause_free(clause); /* frees nested as well */
+        return 1;
+    }
+    return 0;
+}
+
+/* Move all rows of src to the end of dst. */
+static int
+dbw_list_move(struct dbw_list *dst, struct dbw_list *src)
+{
+    struct dbrow **set;
+
+    if (!src->n) return 0;
+    set = realloc(dst->set, (dst->n + src->n) * sizeof (struct dbrow *));
+    if (!set) return 1;
+    memcpy(set + dst->n, src->set, src->n * sizeof (struct dbrow *));
+    dst->set = set;
+    dst->n += src->n;
+    src->n = 0;
+    return 0;
+}
+
+/**
+ * Fetch the rows whose field matches one of ids, DBW_IDS_PER_QUERY ids
+ * per query. If and_field is set rows must also have and_field = and_value.
+ */
+static struct dbw_list *
+dbw_fetch_ids(db_connection_t *conn, dbw_list_fetch fetch, const char *field,
+    const int *ids, size_t n, const char *and_field, int and_value)
+{
+    struct dbw_list *list, *chunk;
+    db_clause_list_t *clause_list;
+
+    if (!(list = fetch(conn, 0, NULL))) return NULL;
+    for (size_t i = 0; i < n; i += DBW_IDS_PER_QUERY) {
+        size_t m = n - i < DBW_IDS_PER_QUERY ? n - i : DBW_IDS_PER_QUERY;
+        chunk = NULL;
+        if ((clause_list = db_clause_list_new())
+            && !dbw_clause_ids(clause_list, field, ids + i, m)
+            && (!and_field || !dbw_clause_int(clause_list, and_field,
+                DB_CLAUSE_OPERATOR_AND, and_value)))
+        {
+            chunk = fetch(conn, 1, clause_list);
+        }
+        db_clause_list_free(clause_list);
+        if (!chunk || dbw_list_move(list, chunk)) {
+            dbw_list_free(chunk);
+            dbw_list_free(list);
+            return NULL;
+        }
+        dbw_list_free(chunk);
+    }
+    return list;
+}
+
+static int
+cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Sorted, distinct values of field idx of every row in list. */
+static int *
+dbw_list_ids(struct dbw_list *list, int idx, size_t *n)
+{
+    int *ids, *val;
+    void *ptr;
+    size_t m = 0;
+
+    *n = 0;
+    if (!(ids = malloc((list->n ? list->n : 1) * sizeof (int)))) return NULL;
+    for (size_t i = 0; i < list->n; i++) {
+        if (idx < 0) {
+            ids[i] = list->set[i]->id;
+            continue;
+        }
+        get_ref(list->set[i], idx, &val, &ptr);
+        ids[i] = *val;
+    }
+    qsort(ids, list->n, sizeof (int), cmp_int);
+    for (size_t i = 0; i < list->n; i++) {
+        if (!m || ids[m-1] != ids[i]) ids[m++] = ids[i];
+    }
+    *n = m;
+    return ids;
+}
+
+struct dbw_db *
+dbw_fetch_zones(db_connection_t *conn, const struct dbw_filter *filter)
+{
+    db_clause_list_t *clause_list = NULL;
+    struct dbw_policy *policy = NULL;
+    int nomatch = 0;
+
+    struct dbw_db *db = calloc(1, sizeof(struct dbw_db));
+    if (!db) {
+        ods_log_error("[dbw_fetch_zones] Memory allocation failure.");
+        return NULL;
+    }
+    if (pthread_rwlock_rdlock(&db_lock)) {
+        ods_log_error("[dbw_fetch_zones] Unable to obtain database read lock.");
+        free(db);
+        return NULL;
+    }
+    db->conn            = conn;
+    db->policies        = dbw_policies(conn, 1);
+    db->keys            = dbw_keys(conn, 0, NULL);
+    db->keystates       = dbw_keystates(conn, 0, NULL);
+    db->hsmkeys         = dbw_hsmkeys(conn, 0, NULL);
+    db->policykeys      = dbw_policykeys(conn, 0);
+    db->keydependencies = dbw_keydependencies(conn, 0);
+    if (db->policies && filter->policy) {
+        policy = dbw_get_policy(db, filter->policy);
+        nomatch = !policy;
+    }
+    if (db->policies && (filter->zone || policy)) {
+        if (!(clause_list = db_clause_list_new())
+            || (filter->zone && dbw_clause_text(clause_list, "name", filter->zone))
+            || (policy && dbw_clause_int(clause_list, "policyId",
+                DB_CLAUSE_OPERATOR_AND, policy->id)))
+        {
+            db_clause_list_free(clause_list);
+            clause_list = NULL;
+            nomatch = -1;
+        }
+    }
+    if (nomatch >= 0)
+        db->zones = dbw_zones(conn, !nomatch, clause_list);
+    (void)pthread_rwlock_unlock(&db_lock);
+    db_clause_list_free(clause_list);
+
+    if (!db->policies || !db->zones || !db->keys || !db->keystates ||
+            !db->hsmkeys || !db->policykeys || !db->keydependencies)
+    {
+        dbw_free(db);
+        ods_log_error("[dbw_fetch_zones] Failed to read from database.");
+        return NULL;
+    }
+    merge_pl_zn(db->policies, db->zones);
+    return db;
+}
+
+struct dbw_db *
+dbw_fetch_keys(db_connection_t *conn, struct dbw_zone **zones, size_t n,
+    int keyrole, int mask)
+{
+    struct dbw_list parents;
+    int *ids = NULL;
+    size_t nids = 0;
+
+    struct dbw_db *page = calloc(1, sizeof(struct dbw_db));
+    if (!page) {
+        ods_log_error("[dbw_fetch_keys] Memory allocation failure.");
+        return NULL;
+    }
+    memset(&parents, 0, sizeof (struct dbw_list));
+    if (!(parents.set = malloc((n ? n : 1) * sizeof (struct dbrow *)))) {
+        ods_log_error("[dbw_fetch_keys] Memory allocation failure.");
+        free(page);
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        parents.set[parents.n++] = (struct dbrow *)zones[i];
+    }
+    ids = dbw_list_ids(&parents, -1, &nids);
+
+    if (pthread_rwlock_rdlock(&db_lock)) {
+        ods_log_error("[dbw_fetch_keys] Unable to obtain database read lock.");
+        free(parents.set);
+        free(ids);
+        free(page);
+        return NULL;
+    }
+    page->conn            = conn;
+    page->policies        = dbw_policies(conn, 0);
+    page->zones           = dbw_zones(conn, 0, NULL);
+    page->policykeys      = dbw_policykeys(conn, 0);
+    page->keydependencies = dbw_keydependencies(conn, 0);
+    if (ids) {
+        page->keys = dbw_fetch_ids(conn, dbw_keys, "zoneId", ids, nids,
+            keyrole ? "role" : NULL, keyrole);
+    }
+    free(ids);
+    ids = NULL;
+    if (page->keys && (mask & DBW_F_KEYSTATE)) {
+        if ((ids = dbw_list_ids(page->keys, -1, &nids))) {
+            page->keystates = dbw_fetch_ids(conn, dbw_keystates, "keyDataId",
+                ids, nids, NULL, 0);
+        }
+        free(ids);
+    } else {
+        page->keystates = dbw_keystates(conn, 0, NULL);
+    }
+    if (page->keys && (mask & DBW_F_HSMKEY)) {
+        /* Field 1 of a key is its hsmkey_id */
+        if ((ids = dbw_list_ids(page->keys, 1, &nids))) {
+            page->hsmkeys = dbw_fetch_ids(conn, dbw_hsmkeys, "id", ids, nids,
+                NULL, 0);
+        }
+        free(ids);
+    } else {
+        page->hsmkeys = dbw_hsmkeys(conn, 0, NULL);
+    }
+    (void)pthread_rwlock_unlock(&db_lock);
+
+    if (!page->policies || !page->zones || !page->keys || !page->keystates ||
+            !page->hsmkeys || !page->policykeys || !page->keydependencies)
+    {
+        free(parents.set);
+        dbw_free(page);
+        ods_log_error("[dbw_fetch_keys] Failed to read from database.");
+        return NULL;
+    }
+    merge_zn_kd(&parents, page->keys);
+    merge_kd_ks(page->keys, page->keystates);
+    merge_hk_kd(page->hsmkeys, page->keys);
+    free(parents.set);
+    return page;
+}
+
+void
+dbw_free_keys(struct dbw_db *page)
+{
+    if (!page) return;
+    for (size_t i = 0; page->keys && i < page->keys->n; i++) {
+        struct dbw_zone *zone = ((struct dbw_key *)page->keys->set[i])->zone;
+        if (!zone || !zone->key) continue;
+        free(zone->key);
+        zone->key = NULL;
+        zone->key_count = 0;
+    }
+    dbw_free(page);
+}
+
+struct dbw_db *
+dbw_fetch_hsmkeys(db_connection_t *conn, const struct dbw_filter *filter)
+{
+    db_clause_list_t *clause_list = NULL;
+    struct dbw_policy *policy = NULL;
+
+    struct dbw_db *db = calloc(1, sizeof(struct dbw_db));
+    if (!db) {
+        ods_log_error("[dbw_fetch_hsmkeys] Memory allocation failure.");
+        return NULL;
+    }
+    if (pthread_rwlock_rdlock(&db_lock)) {
+        ods_log_error("[dbw_fetch_hsmkeys] Unable to obtain database read lock.");
+        free(db);
+        return NULL;
+    }
+    db->conn            = conn;
+    db->policies        = dbw_policies(conn, 1);
+    db->zones           = dbw_zones(conn, 0, NULL);
+    db->keys            = dbw_keys(conn, 0, NULL);
+    db->keystates       = dbw_keystates(conn, 0, NULL);
+    db->policykeys      = dbw_policykeys(conn, 0);
+    db->keydependencies = dbw_keydependencies(conn, 0);
+    if (db->policies && filter->policy)
+        policy = dbw_get_policy(db, filter->policy);
+    if (db->policies && filter->policy && !policy) {
+        db->hsmkeys = dbw_hsmkeys(conn, 0, NULL);
+    } else if (db->policies && (filter->hsmkey_state || policy)) {
+        if ((clause_list = db_clause_list_new())
+            && (!filter->hsmkey_state || !dbw_clause_int(clause_list, "state",
+                DB_CLAUSE_OPERATOR_AND, filter->hsmkey_state))
+            && (!policy || !dbw_clause_int(clause_list, "policyId",
+                DB_CLAUSE_OPERATOR_AND, policy->id)))
+        {
+            db->hsmkeys = dbw_hsmkeys(conn, 1, clause_list);
+        }
+        db_clause_list_free(clause_list);
+    } else if (db->policies) {
+        db->hsmkeys = dbw_hsmkeys(conn, 1, NULL);
+    }
+    (void)pthread_rwlock_unlock(&db_lock);
+
+    if (!db->policies || !db->zones || !db->keys || !db->keystates ||
+            !db->hsmkeys || !db->policykeys || !db->keydependencies)
+    {
+        dbw_free(db);
+        ods_log_error("[dbw_fetch_hsmkeys] Failed to read from database.");
+        return NULL;
+    }
+    merge_pl_hk(db->policies, db->hsmkeys);
+    return db;
+}
+
 static int
 dbw_commit_list(const db_connection_t *conn, struct dbw_list *list)
 {
@@ -1388,6 +1830,9 @@ dbw_commit(struct dbw_db *db)
         (void)pthread_rwlock_unlock(&db_lock);
         return 1;
     }
+    /* One transaction for all lists, so a large import is written with a
+     * single sync and either lands completely or not at all. */
+    int tx = !db_connection_transaction_begin(db->conn);
     int r = 0;
     r |= dbw_commit_list(db->conn, db->policies);
     r |= dbw_commit_list(db->conn, db->policykeys);
@@ -1396,6 +1841,12 @@ dbw_commit(struct dbw_db *db)
     r |= dbw_commit_list(db->conn, db->keys);
     r |= dbw_commit_list(db->conn, db->keystates);
     r |= dbw_commit_list(db->conn, db->keydependencies);
+    if (tx && r) {
+        (void)db_connection_transaction_rollback(db->conn);
+    } else if (tx && db_connection_transaction_commit(db->conn)) {
+        ods_log_error("[dbw_commit] Unable to commit transaction.");
+        r = 1;
+    }
     (void)pthread_rwlock_unlock(&db_lock);
     return r;
 }
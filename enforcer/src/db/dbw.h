@@ -358,6 +358,7 @@ struct dbw_db {
     struct dbw_list *hsmkeys;
     struct dbw_list *keystates;
     struct dbw_list *keydependencies;
+    int refs; /* users of a shared snapshot, see dbw_snapshot() */
 };
 
 /* DB operations */
@@ -389,6 +390,71 @@ struct dbw_db *dbw_fetch(db_connection_t *conn);
  */
 struct dbw_db *dbw_fetch_filtered(db_connection_t *conn, int mask);
 
+/**
+ * Filter for the scoped fetches below, pushed down into the queries.
+ * Unset (NULL or 0) members match everything.
+ */
+struct dbw_filter {
+    const char *zone;   /** zone name */
+    const char *policy; /** policy name */
+    int keyrole;        /** enum dbw_key_role */
+    int hsmkey_state;   /** enum dbw_hsmkey_state */
+};
+
+/**
+ * Fetch all policies and the zones matching filter, but no keys. Intended
+ * for listings over large databases: the keys of the zones can then be
+ * fetched a page of zones at a time with dbw_fetch_keys().
+ *
+ * return NULL on failure
+ */
+struct dbw_db *dbw_fetch_zones(db_connection_t *conn,
+    const struct dbw_filter *filter);
+
+/**
+ * Fetch the keys of zones[0..n), limited to keyrole if not 0. Key states
+ * and hsm keys are fetched as well when DBW_F_KEYSTATE or DBW_F_HSMKEY is
+ * in mask. The keys are linked into the zones, which must not have keys
+ * linked already. The result holds only the key lists and must be released
+ * with dbw_free_keys() before the zones are freed.
+ *
+ * return NULL on failure
+ */
+struct dbw_db *dbw_fetch_keys(db_connection_t *conn, struct dbw_zone **zones,
+    size_t n, int keyrole, int mask);
+
+/**
+ * Unlink the keys from their zones and free them.
+ */
+void dbw_free_keys(struct dbw_db *page);
+
+/**
+ * Fetch all policies and the hsm keys matching filter (policy and
+ * hsmkey_state), linked to their policies.
+ *
+ * return NULL on failure
+ */
+struct dbw_db *dbw_fetch_hsmkeys(db_connection_t *conn,
+    const struct dbw_filter *filter);
+
+/**
+ * Get the shared read-only copy of the complete database. It is fetched
+ * again only when something was written to the database since it was
+ * taken, so concurrent read-only commands share one fetch. The result must
+ * not be modified or committed and is released with dbw_snapshot_release().
+ *
+ * return NULL on failure
+ */
+struct dbw_db *dbw_snapshot(db_connection_t *conn);
+
+void dbw_snapshot_release(struct dbw_db *db);
+
+/**
+ * Drop the cached snapshot, users still holding it keep it until they
+ * release it.
+ */
+void dbw_snapshot_clear(void);
+
 /**
  * Commit changes to the database. Guarded by a R/W lock. Only records marked
  * as dirty will be considered for writing.
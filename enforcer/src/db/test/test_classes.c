@@ -337,6 +337,20 @@ void test_class_db_clause_list(void) {
 
     CU_ASSERT((clause_walk = db_clause_list_begin(clause_list)) == local_clause);
 
+    CU_ASSERT_PTR_NOT_NULL_FATAL((clause2 = db_clause_new()));
+    CU_ASSERT(db_clause_set_list(clause2, NULL));
+    CU_ASSERT(!db_clause_set_operator(clause2, DB_CLAUSE_OPERATOR_AND));
+    CU_ASSERT_FATAL(!db_clause_set_list(clause2, clause_list));
+    clause_list = NULL;
+    CU_ASSERT(db_clause_type(clause2) == DB_CLAUSE_NESTED);
+    CU_ASSERT(db_clause_list(clause2) && db_clause_list_begin(db_clause_list(clause2)) == local_clause);
+    CU_ASSERT_PTR_NULL(db_clause_get_value(clause2));
+    CU_ASSERT(!db_clause_not_empty(clause2));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL((clause_list = db_clause_list_new()));
+    CU_ASSERT_FATAL(!db_clause_list_add(clause_list, clause2));
+    clause2 = NULL;
+
     db_clause_list_free(clause_list);
     clause_list = NULL;
     CU_PASS("db_clause_list_free");
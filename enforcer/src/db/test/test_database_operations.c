@@ -1057,10 +1057,14 @@ void test_database_operations_read_object1(void) {
 }
 
 void test_database_operations_create_object2(void) {
+    unsigned long changes = db_connection_changes();
+
     CU_ASSERT_PTR_NOT_NULL_FATAL((test = test_new(connection)));
     CU_ASSERT_FATAL(!test_set_name(test, "name 2"));
     CU_ASSERT(!strcmp(test_name(test), "name 2"));
+    CU_ASSERT(db_connection_changes() == changes);
     CU_ASSERT_FATAL(!test_create(test));
+    CU_ASSERT(db_connection_changes() != changes);
 
     test_free(test);
     test = NULL;
@@ -1112,9 +1116,13 @@ void test_database_operations_update_object2(void) {
 }
 
 void test_database_operations_delete_object2(void) {
+    unsigned long changes;
+
     CU_ASSERT_PTR_NOT_NULL_FATAL((test = test_new(connection)));
     CU_ASSERT_FATAL(!test_get_by_id(test, &object2_id));
+    changes = db_connection_changes();
     CU_ASSERT_FATAL(!test_delete(test));
+    CU_ASSERT(db_connection_changes() != changes);
 
     test_free(test);
     test = NULL;
@@ -137,5 +137,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block repositorylist_funcblock = {
-	"repository list", &usage, &help, NULL, &run
+	"repository list", &usage, &help, NULL, &run, 1
 };
@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2017 Stichting NLnet Labs
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Run the enforcer for all zones against a private copy of the database
+ * and report the work it would cause, to plan HSM and signer capacity.
+ * Nothing is written to the database or the HSM.
+ */
+
+#include <getopt.h>
+#include "config.h"
+
+#include "cmdhandler.h"
+#include "daemon/enforcercommands.h"
+#include "daemon/engine.h"
+#include "file.h"
+#include "log.h"
+#include "str.h"
+#include "clientpipe.h"
+#include "duration.h"
+#include "enforcer/enforcer.h"
+#include "db/dbw.h"
+
+#include "enforcer/simulate_cmd.h"
+
+static const char *module_str = "simulate_cmd";
+
+#define MAX_ARGS 8
+/* Runs of one zone at the same moment before it is deferred, guards
+ * against a zone that keeps asking to be run again right away. */
+#define SIM_MAX_RUNS 16
+#define SIM_RETRY 60
+
+struct sim_period {
+    long keys;
+    long ds_submit;
+    long ds_retract;
+    long signconfs;
+    long resigns;
+};
+
+struct sim_event {
+    time_t at;
+    struct dbw_zone *zone;
+};
+
+/* Zones ordered by the time they need attention, a binary min-heap. Each
+ * zone is in it at most once. */
+struct sim_queue {
+    struct sim_event *ev;
+    size_t n;
+};
+
+struct sim_repository {
+    const char *name;
+    long keys;
+};
+
+/* Last IDs handed out per table, for rows created by the simulation. */
+struct sim_ids {
+    int key;
+    int keystate;
+    int keydependency;
+    int hsmkey;
+};
+
+static void
+usage(int sockfd)
+{
+    client_printf(sockfd,
+        "simulate\n"
+        "	[--days <n>]				aka -d\n"
+        "	[--hourly]				aka -H\n"
+        "	[--policy <policy>]			aka -P\n"
+        "	[--json]				aka -j\n"
+    );
+}
+
+static void
+help(int sockfd)
+{
+    client_printf(sockfd,
+        "Simulate the enforcer for all zones on a copy of the database and\n"
+        "report per day the HSM keys to generate, DS records to submit to\n"
+        "and retract from the parent, signconf files to write and zones the\n"
+        "signer re-signs. Parents are assumed to act on DS changes right\n"
+        "away. Nothing is written to the database or the HSM.\n"
+        "\nOptions:\n"
+        "days		number of days to simulate, default 30\n"
+        "hourly		report per hour instead of per day\n"
+        "policy		limit the simulation to the zones of the given policy\n"
+        "json		output one JSON object per period\n\n"
+    );
+}
+
+static void
+queue_push(struct sim_queue *q, time_t at, struct dbw_zone *zone)
+{
+    size_t i = q->n++, parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (q->ev[parent].at <= at) break;
+        q->ev[i] = q->ev[parent];
+        i = parent;
+    }
+    q->ev[i].at = at;
+    q->ev[i].zone = zone;
+}
+
+static struct sim_event
+queue_pop(struct sim_queue *q)
+{
+    struct sim_event top = q->ev[0], last = q->ev[--q->n];
+    size_t i = 0, child;
+
+    while ((child = 2*i + 1) < q->n) {
+        if (child + 1 < q->n && q->ev[child+1].at < q->ev[child].at) child++;
+        if (last.at <= q->ev[child].at) break;
+        q->ev[i] = q->ev[child];
+        i = child;
+    }
+    q->ev[i] = last;
+    return top;
+}
+
+static int
+max_id(struct dbw_list *list)
+{
+    int max = 0;
+    for (size_t n = 0; n < list->n; n++) {
+        if (list->set[n]->id > max) max = list->set[n]->id;
+    }
+    return max;
+}
+
+/* Remove rows marked DELETE from a list of children, keeping the order. */
+static void
+compact(void **set, int *count)
+{
+    int j = 0;
+    for (int i = 0; i < *count; i++) {
+        if (((struct dbrow *)set[i])->dirty == DBW_DELETE) continue;
+        set[j++] = set[i];
+    }
+    *count = j;
+}
+
+static void
+assign_id(struct dbrow *row, int *id)
+{
+    if (row->dirty != DBW_INSERT) return;
+    row->id = ++(*id);
+    row->dirty = DBW_CLEAN;
+}
+
+/**
+ * Like scrub_deleted() in lookahead_cmd.c, but only for the rows of one
+ * zone: unlink deleted rows and number new ones so the zone can be
+ * updated again. Deleted rows stay in the lists of the db and are freed
+ * with it, purging those lists after every event would not scale.
+ */
+static void
+scrub_zone(struct dbw_zone *zone, struct sim_ids *ids)
+{
+    for (int k = 0; k < zone->key_count; k++) {
+        struct dbw_key *key = zone->key[k];
+        if (key->dirty == DBW_DELETE) {
+            compact((void **)key->hsmkey->key, &key->hsmkey->key_count);
+            continue;
+        }
+        assign_id((struct dbrow *)key, &ids->key);
+        assign_id((struct dbrow *)key->hsmkey, &ids->hsmkey);
+        key->hsmkey_id = key->hsmkey->id;
+        compact((void **)key->keystate, &key->keystate_count);
+        for (int s = 0; s < key->keystate_count; s++) {
+            assign_id((struct dbrow *)key->keystate[s], &ids->keystate);
+            key->keystate[s]->key_id = key->id;
+        }
+        compact((void **)key->from_keydependency, &key->from_keydependency_count);
+        compact((void **)key->to_keydependency, &key->to_keydependency_count);
+    }
+    compact((void **)zone->key, &zone->key_count);
+    compact((void **)zone->keydependency, &zone->keydependency_count);
+    for (int d = 0; d < zone->keydependency_count; d++) {
+        struct dbw_keydependency *dep = zone->keydependency[d];
+        assign_id((struct dbrow *)dep, &ids->keydependency);
+        dep->fromkey_id = dep->fromkey->id;
+        dep->tokey_id = dep->tokey->id;
+    }
+}
+
+static int
+count_repository(struct sim_repository **repos, size_t *n, const char *name)
+{
+    struct sim_repository *r;
+
+    if (!name) name = "";
+    for (size_t i = 0; i < *n; i++) {
+        if (strcmp((*repos)[i].name, name)) continue;
+        (*repos)[i].keys++;
+        return 0;
+    }
+    if (!(r = realloc(*repos, (*n + 1) * sizeof (struct sim_repository))))
+        return 1;
+    r[*n].name = name;
+    r[*n].keys = 1;
+    *repos = r;
+    (*n)++;
+    return 0;
+}
+
+/* Number of times a zone is re-signed between from and to. */
+static long
+resigns_between(time_t from, time_t to, unsigned int interval)
+{
+    if (!interval || to <= from) return 0;
+    return (long)(to / interval - from / interval);
+}
+
+/**
+ * Run the enforcer for one zone and account for the work it causes.
+ * \return time the zone needs attention again, -1 if never.
+ */
+static time_t
+simulate_zone(engine_type *engine, struct dbw_db *db, struct dbw_zone *zone,
+    time_t now, struct sim_period *period, struct sim_repository **repos,
+    size_t *nrepos, struct sim_ids *ids)
+{
+    int zone_updated = 0, ds_changed = 0;
+    time_t t_next = update_mockup(engine, db, zone, now, &zone_updated);
+
+    zone->next_change = t_next;
+    for (int k = 0; k < zone->key_count; k++) {
+        struct dbw_key *key = zone->key[k];
+        if (key->dirty == DBW_DELETE) continue;
+        /* A new key on a new HSM key must be generated in the HSM, a
+         * new key on a shared HSM key not. */
+        if (key->dirty == DBW_INSERT && key->hsmkey->dirty == DBW_INSERT) {
+            period->keys++;
+            if (count_repository(repos, nrepos, key->hsmkey->repository)) {
+                ods_log_error("[%s] memory allocation failure", module_str);
+            }
+        }
+        switch (key->ds_at_parent) {
+            case DBW_DS_AT_PARENT_SUBMIT:
+                period->ds_submit++;
+                /* fall through */
+            case DBW_DS_AT_PARENT_SUBMITTED:
+                key->ds_at_parent = DBW_DS_AT_PARENT_SEEN;
+                ds_changed = 1;
+                break;
+            case DBW_DS_AT_PARENT_RETRACT:
+                period->ds_retract++;
+                /* fall through */
+            case DBW_DS_AT_PARENT_RETRACTED:
+                key->ds_at_parent = DBW_DS_AT_PARENT_UNSUBMITTED;
+                ds_changed = 1;
+                break;
+        }
+    }
+    if (zone->signconf_needs_writing) {
+        zone->signconf_needs_writing = 0;
+        /* A new signconf makes the signer re-sign the zone. */
+        period->signconfs++;
+        period->resigns++;
+    }
+    scrub_zone(zone, ids);
+    /* The parent took care of the DS, the zone can move on now. */
+    if (ds_changed) return now;
+    return t_next;
+}
+
+static void
+print_period(struct client_buf *out, const char *name, struct sim_period *p)
+{
+    client_buf_printf(out, "%-17s %8ld %10ld %11ld %10ld %9ld\n", name,
+        p->keys, p->ds_submit, p->ds_retract, p->signconfs, p->resigns);
+}
+
+static void
+print_json_period(struct client_buf *out, time_t t, struct sim_period *p)
+{
+    client_buf_json_begin(out);
+    client_buf_json_int(out, "period", t);
+    client_buf_json_int(out, "keys", p->keys);
+    client_buf_json_int(out, "ds_submit", p->ds_submit);
+    client_buf_json_int(out, "ds_retract", p->ds_retract);
+    client_buf_json_int(out, "signconfs", p->signconfs);
+    client_buf_json_int(out, "resigns", p->resigns);
+    client_buf_json_end(out);
+}
+
+static void
+report(struct client_buf *out, struct sim_period *period, size_t nperiods,
+    time_t first, time_t len, int bJson, struct sim_repository *repos,
+    size_t nrepos)
+{
+    struct sim_period total = {0, 0, 0, 0, 0}, peak = {0, 0, 0, 0, 0};
+    char tbuf[32];
+    struct tm tm;
+
+    if (!bJson) {
+        client_buf_printf(out, "%-17s %8s %10s %11s %10s %9s\n", "Period (UTC):",
+            "Keys:", "DS submit:", "DS retract:", "Signconfs:", "Resigns:");
+    }
+    for (size_t i = 0; i < nperiods; i++) {
+        struct sim_period *p = &period[i];
+        time_t t = first + (time_t)i * len;
+        if (bJson) {
+            print_json_period(out, t, p);
+            continue;
+        }
+        if (!gmtime_r(&t, &tm) || !strftime(tbuf, sizeof(tbuf),
+                len < 86400 ? "%Y-%m-%d %H:00" : "%Y-%m-%d", &tm))
+        {
+            strncpy(tbuf, "<error>", sizeof(tbuf));
+        }
+        print_period(out, tbuf, p);
+        total.keys += p->keys;
+        total.ds_submit += p->ds_submit;
+        total.ds_retract += p->ds_retract;
+        total.signconfs += p->signconfs;
+        total.resigns += p->resigns;
+        if (p->keys > peak.keys) peak.keys = p->keys;
+        if (p->ds_submit > peak.ds_submit) peak.ds_submit = p->ds_submit;
+        if (p->ds_retract > peak.ds_retract) peak.ds_retract = p->ds_retract;
+        if (p->signconfs > peak.signconfs) peak.signconfs = p->signconfs;
+        if (p->resigns > peak.resigns) peak.resigns = p->resigns;
+    }
+    if (bJson) return;
+    print_period(out, "Total:", &total);
+    print_period(out, "Peak:", &peak);
+    if (!nrepos) return;
+    client_buf_printf(out, "\n%-31s %8s\n", "Repository:", "Keys:");
+    for (size_t r = 0; r < nrepos; r++) {
+        client_buf_printf(out, "%-31s %8ld\n", repos[r].name, repos[r].keys);
+    }
+}
+
+static int
+run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
+{
+    int argc = 0;
+    char const *argv[MAX_ARGS];
+    int long_index = 0, opt = 0, bJson = 0, bHourly = 0, days = 30;
+    char const *policyname = NULL;
+    struct client_buf *out = &context->out;
+    db_connection_t* dbconn = getconnectioncontext(context);
+    engine_type* engine = getglobalcontext(context);
+
+    static struct option long_options[] = {
+        {"days", required_argument, 0, 'd'},
+        {"hourly", no_argument, 0, 'H'},
+        {"policy", required_argument, 0, 'P'},
+        {"json", no_argument, 0, 'j'},
+        {0, 0, 0, 0}
+    };
+
+    ods_log_debug("[%s] %s command", module_str, simulate_funcblock.cmdname);
+    if (!cmd) return -1;
+    argc = ods_str_explode(cmd, MAX_ARGS, argv);
+    if (argc == -1) {
+        client_printf_err(sockfd, "too many arguments\n");
+        return -1;
+    }
+
+    optind = 0;
+    while ((opt = getopt_long(argc, (char* const*)argv, "d:HP:j", long_options, &long_index)) != -1) {
+        switch (opt) {
+            case 'd':
+                days = atoi(optarg);
+                break;
+            case 'H':
+                bHourly = 1;
+                break;
+            case 'P':
+                policyname = optarg;
+                break;
+            case 'j':
+                bJson = 1;
+                break;
+            default:
+                client_printf_err(sockfd, "unknown arguments\n");
+                ods_log_error("[%s] unknown arguments for %s command",
+                    module_str, simulate_funcblock.cmdname);
+                return -1;
+        }
+    }
+    if (days <= 0 || days > 3660) {
+        client_printf_err(sockfd, "--days must be between 1 and 3660\n");
+        return -1;
+    }
+
+    /* A private copy, it is changed by the simulation but never
+     * committed. */
+    struct dbw_db *db = dbw_fetch(dbconn);
+    if (!db) {
+        client_printf_err(sockfd, "Unable to read from database!\n");
+        return 1;
+    }
+    struct dbw_policy *policy = NULL;
+    if (policyname && !(policy = dbw_get_policy(db, policyname))) {
+        client_printf_err(sockfd, "Unable to get policy %s from database!\n", policyname);
+        dbw_free(db);
+        return 1;
+    }
+
+    time_t now = time_now();
+    time_t end = now + (time_t)days * 86400;
+    time_t len = bHourly ? 3600 : 86400;
+    time_t first = now - now % len;
+    size_t nperiods = (end - first) / len + 1;
+    struct sim_period *period = calloc(nperiods, sizeof (struct sim_period));
+    struct sim_queue queue = {NULL, 0};
+    struct sim_repository *repos = NULL;
+    size_t nrepos = 0;
+    struct sim_ids ids;
+
+    queue.ev = malloc((db->zones->n + 1) * sizeof (struct sim_event));
+    if (!period || !queue.ev) {
+        client_printf_err(sockfd, "memory allocation error\n");
+        free(period);
+        free(queue.ev);
+        dbw_free(db);
+        return 1;
+    }
+    ids.key = max_id(db->keys);
+    ids.keystate = max_id(db->keystates);
+    ids.keydependency = max_id(db->keydependencies);
+    ids.hsmkey = max_id(db->hsmkeys);
+
+    /* Like the enforcer does at start up, visit every zone now. */
+    for (size_t z = 0; z < db->zones->n; z++) {
+        struct dbw_zone *zone = (struct dbw_zone *)db->zones->set[z];
+        if (policy && zone->policy != policy) continue;
+        if (zone->policy->passthrough) continue;
+        zone->scratch = 0;
+        queue_push(&queue, now, zone);
+    }
+    if (!bJson) {
+        client_buf_printf(out, "Simulating %d days for %zu zones.\n", days, queue.n);
+    }
+
+    /* Periodic re-signs only depend on the resign interval of the policy */
+    for (size_t p = 0; p < db->policies->n; p++) {
+        struct dbw_policy *pol = (struct dbw_policy *)db->policies->set[p];
+        if (policy && pol != policy) continue;
+        if (pol->passthrough || !pol->zone_count) continue;
+        for (size_t i = 0; i < nperiods; i++) {
+            time_t from = first + (time_t)i * len;
+            time_t to = from + len;
+            if (from < now) from = now;
+            if (to > end) to = end;
+            period[i].resigns += pol->zone_count *
+                resigns_between(from, to, pol->signatures_resign);
+        }
+    }
+
+    while (queue.n) {
+        struct sim_event ev = queue_pop(&queue);
+        struct dbw_zone *zone = ev.zone;
+        if (ev.at > end) break;
+        time_t t_next = simulate_zone(engine, db, zone, ev.at,
+            &period[(ev.at - first) / len], &repos, &nrepos, &ids);
+        if (t_next < 0) continue; /* nothing to be done ever */
+        if (t_next > ev.at) {
+            zone->scratch = 0;
+        } else if (++zone->scratch > SIM_MAX_RUNS) {
+            ods_log_warning("[%s] zone %s makes no progress, retry in %d "
+                "seconds", module_str, zone->name, SIM_RETRY);
+            zone->scratch = 0;
+            t_next = ev.at + SIM_RETRY;
+        } else {
+            t_next = ev.at;
+        }
+        queue_push(&queue, t_next, zone);
+    }
+
+    report(out, period, nperiods, first, len, bJson, repos, nrepos);
+    free(repos);
+    free(queue.ev);
+    free(period);
+    dbw_free(db);
+    return 0;
+}
+
+struct cmd_func_block simulate_funcblock = {
+    "simulate", &usage, &help, NULL, &run, 1
+};
@@ -37,11 +37,15 @@
 
 #include "hsmkey/hsmkey_list_cmd.h"
 
+static const char *module_str = "hsmkey_list_cmd";
+
 static void
 usage(int sockfd)
 {
     client_printf(sockfd,
         "hsmkey list\n"
+        "	[--policy <policy>]			aka -P\n"
+        "	[--json]				aka -j\n"
     );
 }
 
@@ -50,27 +54,81 @@ help(int sockfd)
 {
     client_printf(sockfd,
         "List generated but unassigned keys per policy.\n"
+        "\nOptions:\n"
+        "policy		limit the output to the given policy\n"
+        "json		output one JSON object per key\n\n"
     );
 }
 
 static int
 run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 {
+    #define NARGV 8
+    const char *argv[NARGV];
+    int argc, long_index = 0, opt = 0, json = 0;
+    struct dbw_filter filter = {NULL, NULL, 0, DBW_HSMKEY_UNUSED};
+    struct client_buf *buf = &context->out;
     db_connection_t* dbconn = getconnectioncontext(context);
-    engine_type* engine = getglobalcontext(context);
-    (void) cmd;
 
-    struct dbw_db *db = dbw_fetch(dbconn);
+    static struct option long_options[] = {
+        {"policy", required_argument, 0, 'P'},
+        {"json", no_argument, 0, 'j'},
+        {0, 0, 0, 0}
+    };
+
+    argc = ods_str_explode(cmd, NARGV, argv);
+    if (argc == -1) {
+        ods_log_error("[%s] too many arguments for %s command",
+                module_str, hsmkey_list_funcblock.cmdname);
+        client_printf_err(sockfd, "too many arguments\n");
+        return -1;
+    }
+    optind = 0;
+    while ((opt = getopt_long(argc, (char* const*)argv, "P:j", long_options, &long_index)) != -1) {
+        switch (opt) {
+            case 'P':
+                filter.policy = optarg;
+                break;
+            case 'j':
+                json = 1;
+                break;
+            default:
+                client_printf_err(sockfd, "unknown arguments\n");
+                ods_log_error("[%s] unknown arguments for %s command",
+                              module_str, hsmkey_list_funcblock.cmdname);
+                return -1;
+        }
+    }
+
+    /* Only the unused keys are read, not every key in the HSM. */
+    struct dbw_db *db = dbw_fetch_hsmkeys(dbconn, &filter);
     if (!db) return 1;
 
+    if (filter.policy && !dbw_get_policy(db, filter.policy)) {
+        client_printf_err(sockfd, "Unable to get policy %s from database!\n", filter.policy);
+        dbw_free(db);
+        return 1;
+    }
+
     for (size_t p = 0; p < db->policies->n; p++) {
         struct dbw_policy *policy = (struct dbw_policy *)db->policies->set[p];
         for (size_t hk = 0; hk < policy->hsmkey_count; hk++) {
             struct dbw_hsmkey *hsmkey = policy->hsmkey[hk];
             if (hsmkey->state != DBW_HSMKEY_UNUSED) continue;
-            client_printf(sockfd, "%s;%s;%s;%d;%d;%s\n", hsmkey->locator,
-                    hsmkey->repository, policy->name, hsmkey->bits,
-                    hsmkey->algorithm, dbw_enum2txt(dbw_key_role_txt, hsmkey->role));
+            if (!json) {
+                client_buf_printf(buf, "%s;%s;%s;%d;%d;%s\n", hsmkey->locator,
+                        hsmkey->repository, policy->name, hsmkey->bits,
+                        hsmkey->algorithm, dbw_enum2txt(dbw_key_role_txt, hsmkey->role));
+                continue;
+            }
+            client_buf_json_begin(buf);
+            client_buf_json_str(buf, "cka_id", hsmkey->locator);
+            client_buf_json_str(buf, "repository", hsmkey->repository);
+            client_buf_json_str(buf, "policy", policy->name);
+            client_buf_json_int(buf, "size", hsmkey->bits);
+            client_buf_json_int(buf, "algorithm", hsmkey->algorithm);
+            client_buf_json_str(buf, "keytype", dbw_enum2txt(dbw_key_role_txt, hsmkey->role));
+            client_buf_json_end(buf);
         }
     }
     dbw_free(db);
@@ -78,5 +136,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block hsmkey_list_funcblock = {
-    "hsmkey list", &usage, &help, NULL, &run
+    "hsmkey list", &usage, &help, NULL, &run, 1
 };
@@ -301,7 +301,7 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         return -1;
     }
 
-    struct dbw_db *db = dbw_fetch(dbconn);
+    struct dbw_db *db = dbw_snapshot(dbconn);
     if (!db) return -1;
     int r = 0;
     int exports = 0;
@@ -311,7 +311,7 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         r |= perform_keystate_export(sockfd, zone, keytype_int, keystate, ds, bsha1);
         exports++;
     }
-    dbw_free(db);
+    dbw_snapshot_release(db);
     if (zonename && !exports) {
         ods_log_error("[%s] Unknown zone: %s", module_str, zonename);
         client_printf_err(sockfd, "Unknown zone: %s\n", zonename);
@@ -321,5 +321,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block key_export_funcblock = {
-    "key export", &usage, &help, NULL, &run
+    "key export", &usage, &help, NULL, &run, 1
 };
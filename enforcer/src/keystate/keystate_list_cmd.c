@@ -165,55 +165,93 @@ map_keytime(const struct dbw_key *key, time_t now)
 	return strdup(ct);
 }
 
+/* Number of zones to fetch keys for at once. */
+#define ZONES_PER_PAGE 64
+
 static void
-print_sorted_keys(int sockfd, int keyrole, const char *keystate, struct dbw_zone *zone, void (printkey)(int sockfd, struct dbw_key *key, char *tchange))
+print_sorted_keys(struct client_buf *buf, const char *keystate, struct dbw_zone *zone, void (printkey)(struct client_buf *buf, struct dbw_key *key, char *tchange))
 {
     sort_keys((const struct dbw_key **)zone->key, zone->key_count);
     for (size_t k = 0; k < zone->key_count; k++) {
         struct dbw_key *key = zone->key[k];
-        if (keyrole && key->role != keyrole) continue;
         if (keystate && strcasecmp(map_keystate(key), keystate)) continue;
         char* tchange = map_keytime(key, time_now()); /* allocs */
-        (*printkey)(sockfd, key, tchange);
+        (*printkey)(buf, key, tchange);
         free(tchange);
     }
 
 }
 
+/**
+ * List the keys of all zones matching the filter. Only the zones are read
+ * up front, keys are fetched and printed ZONES_PER_PAGE zones at a time so
+ * output starts early and memory use does not grow with the number of
+ * keys. The keystate can not be expressed in SQL and is filtered here.
+ */
 static int
-perform_keystate_list(int sockfd, db_connection_t *dbconn, const char* zonename,
-    int keyrole, const char* keystate, void (printheader)(int sockfd),
-    void (printkey)(int sockfd, struct dbw_key *key, char* tchange))
+perform_keystate_list(struct client_buf *buf, db_connection_t *dbconn, const char* zonename,
+    const char *policyname, int keyrole, const char* keystate,
+    void (printheader)(struct client_buf *buf),
+    void (printkey)(struct client_buf *buf, struct dbw_key *key, char* tchange))
 {
-    struct dbw_db *db = dbw_fetch(dbconn);
+    struct dbw_filter filter = {zonename, policyname, keyrole, 0};
+    struct dbw_zone **zones;
+    int sockfd = buf->sockfd;
+    size_t n = 0;
+    int ret = 0;
+
+    struct dbw_db *db = dbw_fetch_zones(dbconn, &filter);
     if (!db) {
         client_printf_err(sockfd, "Unable to get list of keys, memory "
             "allocation or database error!\n");
         return 1;
     }
-    if (printheader) (*printheader)(sockfd);
+    if (printheader) (*printheader)(buf);
 
-    if (zonename) {
-        struct dbw_zone *zone = dbw_get_zone(db, zonename);
-        if (zone)
-            print_sorted_keys(sockfd, keyrole, keystate, zone, printkey);
-        else
-            client_printf_err(sockfd, "Unable to get zone %s from database!\n", zonename);
+    if (policyname && !dbw_get_policy(db, policyname)) {
+        client_printf_err(sockfd, "Unable to get policy %s from database!\n", policyname);
+        dbw_free(db);
+        return 0;
     }
-    else {
-        sort_policies((const struct dbw_policy **)db->policies->set, db->policies->n);
-
-        for (size_t i = 0; i < db->policies->n; i++) {
-            struct dbw_policy *policy = (struct dbw_policy *) db->policies->set[i];
-            sort_zones((const struct dbw_zone **)policy->zone, policy->zone_count);
-            for (size_t z = 0; z < policy->zone_count; z++) {
-                struct dbw_zone *zone = policy->zone[z];
-                print_sorted_keys(sockfd, keyrole, keystate, zone, printkey);
-            }
+    if (zonename && !db->zones->n) {
+        client_printf_err(sockfd, "Unable to get zone %s from database!\n", zonename);
+        dbw_free(db);
+        return 0;
+    }
+
+    zones = malloc(db->zones->n * sizeof (struct dbw_zone *));
+    if (db->zones->n && !zones) {
+        client_printf_err(sockfd, "Unable to get list of keys, memory "
+            "allocation or database error!\n");
+        dbw_free(db);
+        return 1;
+    }
+    /* Output order: by policy, then by zone */
+    sort_policies((const struct dbw_policy **)db->policies->set, db->policies->n);
+    for (size_t i = 0; i < db->policies->n; i++) {
+        struct dbw_policy *policy = (struct dbw_policy *) db->policies->set[i];
+        sort_zones((const struct dbw_zone **)policy->zone, policy->zone_count);
+        for (size_t z = 0; z < policy->zone_count; z++)
+            zones[n++] = policy->zone[z];
+    }
+
+    for (size_t i = 0; i < n; i += ZONES_PER_PAGE) {
+        size_t count = n - i < ZONES_PER_PAGE ? n - i : ZONES_PER_PAGE;
+        struct dbw_db *page = dbw_fetch_keys(dbconn, zones + i, count,
+            keyrole, DBW_F_KEYSTATE|DBW_F_HSMKEY);
+        if (!page) {
+            client_printf_err(sockfd, "Unable to get list of keys, memory "
+                "allocation or database error!\n");
+            ret = 1;
+            break;
         }
+        for (size_t z = i; z < i + count; z++)
+            print_sorted_keys(buf, keystate, zones[z], printkey);
+        dbw_free_keys(page);
     }
+    free(zones);
     dbw_free(db);
-    return 0;
+    return ret;
 }
 
 static void
@@ -224,7 +262,9 @@ usage(int sockfd)
         "	[--verbose]				aka -v\n"
         "	[--debug]				aka -d\n"
         "	[--parsable]				aka -p\n"
+        "	[--json]				aka -j\n"
         "	[--zone]				aka -z  \n"
+        "	[--policy]				aka -P  \n"
         "	[--type]				aka -t  \n"
         "	[--state]				aka -e  \n"
         "	[--all]                                 aka -a  \n"
@@ -240,24 +280,26 @@ help(int sockfd)
         "verbose		also show additional key parameters\n"
         "debug		print information about the keystate\n"
         "parsable	output machine parsable list\n"
+        "json		output one JSON object per key\n"
         "zone		limit the output to the specific zone\n"
+        "policy		limit the output to the zones of the given policy\n"
         "keytype	limit the output to the given type, can be ZSK, KSK, or CSK\n"
         "keystate	limit the output to the given state\n"
         "all		print keys in all states (including generate) \n\n");
 }
 
 static void
-printcompatheader(int sockfd)
+printcompatheader(struct client_buf *buf)
 {
-    client_printf(sockfd, "Keys:\n");
-    client_printf(sockfd, "%-31s %-8s %-9s %s\n", "Zone:", "Keytype:", "State:",
+    client_buf_printf(buf, "Keys:\n");
+    client_buf_printf(buf, "%-31s %-8s %-9s %s\n", "Zone:", "Keytype:", "State:",
             "Date of next transition:");
 }
 
 static void
-printcompatkey(int sockfd, struct dbw_key * key, char* tchange)
+printcompatkey(struct client_buf *buf, struct dbw_key * key, char* tchange)
 {
-    client_printf(sockfd,
+    client_buf_printf(buf,
         "%-31s %-8s %-9s %s\n",
         key->zone->name,
         dbw_enum2txt(dbw_key_role_txt, key->role),
@@ -266,19 +308,19 @@ printcompatkey(int sockfd, struct dbw_key * key, char* tchange)
 }
 
 static void
-printverboseheader(int sockfd)
+printverboseheader(struct client_buf *buf)
 {
-    client_printf(sockfd, "Keys:\n");
-    client_printf(sockfd, "%-31s %-8s %-9s %-24s %-5s %-10s %-32s %-11s %s\n", "Zone:", "Keytype:", "State:",
+    client_buf_printf(buf, "Keys:\n");
+    client_buf_printf(buf, "%-31s %-8s %-9s %-24s %-5s %-10s %-32s %-11s %s\n", "Zone:", "Keytype:", "State:",
             "Date of next transition:", "Size:", "Algorithm:", "CKA_ID:",
             "Repository:", "KeyTag:");
 }
 
 static void
-printverbosekey(int sockfd, struct dbw_key * key, char* tchange)
+printverbosekey(struct client_buf *buf, struct dbw_key * key, char* tchange)
 {
     (void)tchange;
-    client_printf(sockfd,
+    client_buf_printf(buf,
         "%-31s %-8s %-9s %-24s %-5d %-10d %-32s %-11s %d\n",
         key->zone->name,
         dbw_enum2txt(dbw_key_role_txt, key->role),
@@ -292,9 +334,9 @@ printverbosekey(int sockfd, struct dbw_key * key, char* tchange)
 }
 
 static void
-printverboseparsablekey(int sockfd, struct dbw_key * key, char* tchange)
+printverboseparsablekey(struct client_buf *buf, struct dbw_key * key, char* tchange)
 {
-    client_printf(sockfd,
+    client_buf_printf(buf,
         "%s;%s;%s;%s;%d;%d;%s;%s;%d\n",
         key->zone->name,
         dbw_enum2txt(dbw_key_role_txt, key->role),
@@ -308,18 +350,18 @@ printverboseparsablekey(int sockfd, struct dbw_key * key, char* tchange)
 }
 
 static void
-printdebugheader(int sockfd) {
-    client_printf(sockfd,
+printdebugheader(struct client_buf *buf) {
+    client_buf_printf(buf,
             "Keys:\nZone:                           Key role:     "
             "DS:          DNSKEY:      RRSIGDNSKEY: RRSIG:       "
             "Pub: Act: Id:\n");
 }
 
 static void
-printdebugkey_fmt(int sockfd, char const *fmt, struct dbw_key *key, char const  *tchange)
+printdebugkey_fmt(struct client_buf *buf, char const *fmt, struct dbw_key *key, char const  *tchange)
 {
     (void)tchange;
-    client_printf(sockfd, fmt,
+    client_buf_printf(buf, fmt,
         key->zone->name,
         dbw_enum2txt(dbw_key_role_txt, key->role),
         dbw_enum2txt(dbw_keystate_state_txt, dbw_get_keystate(key, DBW_DS)->state), /*  TODO */
@@ -332,35 +374,69 @@ printdebugkey_fmt(int sockfd, char const *fmt, struct dbw_key *key, char const
 }
 
 static void
-printdebugkey(int sockfd, struct dbw_key *key, char *tchange)
+printdebugkey(struct client_buf *buf, struct dbw_key *key, char *tchange)
 {
-    printdebugkey_fmt(sockfd, "%-31s %-13s %-12s %-12s %-12s %-12s %d %4d    %s\n", key, tchange);
+    printdebugkey_fmt(buf, "%-31s %-13s %-12s %-12s %-12s %-12s %d %4d    %s\n", key, tchange);
 }
 
 static void
-printdebugparsablekey(int sockfd, struct dbw_key *key, char *tchange)
+printdebugparsablekey(struct client_buf *buf, struct dbw_key *key, char *tchange)
 {
-    printdebugkey_fmt(sockfd, "%s;%s;%s;%s;%s;%s;%d;%d;%s\n", key, tchange);
+    printdebugkey_fmt(buf, "%s;%s;%s;%s;%s;%s;%d;%d;%s\n", key, tchange);
+}
+
+static const char *
+keystate_txt(struct dbw_key *key, int type)
+{
+    struct dbw_keystate *ks = dbw_get_keystate(key, type);
+    return ks ? dbw_enum2txt(dbw_keystate_state_txt, ks->state) : NULL;
+}
+
+static void
+printjsonkey(struct client_buf *buf, struct dbw_key *key, char *tchange)
+{
+    client_buf_json_begin(buf);
+    client_buf_json_str(buf, "zone", key->zone->name);
+    client_buf_json_str(buf, "keytype", dbw_enum2txt(dbw_key_role_txt, key->role));
+    client_buf_json_str(buf, "state", map_keystate(key));
+    client_buf_json_str(buf, "next_transition", tchange);
+    if (key->hsmkey) {
+        client_buf_json_int(buf, "size", key->hsmkey->bits);
+        client_buf_json_int(buf, "algorithm", key->hsmkey->algorithm);
+        client_buf_json_str(buf, "cka_id", key->hsmkey->locator);
+        client_buf_json_str(buf, "repository", key->hsmkey->repository);
+    }
+    client_buf_json_int(buf, "keytag", key->keytag);
+    client_buf_json_str(buf, "ds", keystate_txt(key, DBW_DS));
+    client_buf_json_str(buf, "dnskey", keystate_txt(key, DBW_DNSKEY));
+    client_buf_json_str(buf, "rrsigdnskey", keystate_txt(key, DBW_RRSIGDNSKEY));
+    client_buf_json_str(buf, "rrsig", keystate_txt(key, DBW_RRSIG));
+    client_buf_json_int(buf, "publish", key->publish);
+    client_buf_json_int(buf, "active", key->active_ksk | key->active_zsk);
+    client_buf_json_end(buf);
 }
 
 static int
 run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 {
-    #define NARGV 12
+    #define NARGV 16
     const char *argv[NARGV];
     int success, argIndex;
-    int argc = 0, bVerbose = 0, bDebug = 0, bParsable = 0, bAll = 0;
+    int argc = 0, bVerbose = 0, bDebug = 0, bParsable = 0, bAll = 0, bJson = 0;
     int long_index = 0, opt = 0;
     const char* keytype = NULL;
     const char* keystate = NULL;
     const char* zonename = NULL;
+    const char* policyname = NULL;
     db_connection_t* dbconn = getconnectioncontext(context);
 
     static struct option long_options[] = {
         {"verbose", no_argument, 0, 'v'},
         {"debug", no_argument, 0, 'd'},
         {"parsable", no_argument, 0, 'p'},
+        {"json", no_argument, 0, 'j'},
         {"zone", required_argument, 0, 'z'},
+        {"policy", required_argument, 0, 'P'},
         {"keytype", required_argument, 0, 't'},
         {"keystate", required_argument, 0, 'e'},
         {"all", no_argument, 0, 'a'},
@@ -378,7 +454,7 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         return -1;
     }
     optind = 0;
-    while ((opt = getopt_long(argc, (char* const*)argv, "vdpz:t:e:a", long_options, &long_index) ) != -1) {
+    while ((opt = getopt_long(argc, (char* const*)argv, "vdpjz:P:t:e:a", long_options, &long_index) ) != -1) {
         switch (opt) {
             case 'v':
                 bVerbose = 1;
@@ -389,9 +465,15 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
             case 'p':
                 bParsable = 1;
                 break;
+            case 'j':
+                bJson = 1;
+                break;
             case 'z':
                 zonename = optarg;
                 break;
+            case 'P':
+                policyname = optarg;
+                break;
             case 't':
                 keytype = optarg;
                 break;
@@ -429,31 +511,34 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         return -1;
     }
 
-    if (bDebug) {
+    if (bJson) {
+        success = perform_keystate_list(&context->out, dbconn, zonename, policyname,
+            keyrole, keystate, NULL, &printjsonkey);
+    } else if (bDebug) {
         if (bParsable) {
-            success = perform_keystate_list(sockfd, dbconn, zonename, keyrole,
-                keystate, NULL, &printdebugparsablekey);
+            success = perform_keystate_list(&context->out, dbconn, zonename, policyname,
+                keyrole, keystate, NULL, &printdebugparsablekey);
         } else {
-            success = perform_keystate_list(sockfd, dbconn, zonename, keyrole,
-                keystate, &printdebugheader, &printdebugkey);
+            success = perform_keystate_list(&context->out, dbconn, zonename, policyname,
+                keyrole, keystate, &printdebugheader, &printdebugkey);
         }
     } else if (bVerbose) {
         if (bParsable) {
-            success = perform_keystate_list(sockfd, dbconn, zonename, keyrole,
-                keystate, NULL, &printverboseparsablekey);
+            success = perform_keystate_list(&context->out, dbconn, zonename, policyname,
+                keyrole, keystate, NULL, &printverboseparsablekey);
         } else {
-            success = perform_keystate_list(sockfd, dbconn, zonename, keyrole,
-                keystate, &printverboseheader, &printverbosekey);
+            success = perform_keystate_list(&context->out, dbconn, zonename, policyname,
+                keyrole, keystate, &printverboseheader, &printverbosekey);
         }
     } else {
         if (bParsable)
             client_printf_err(sockfd, "-p option only available in combination with -v and -d.\n");
-        success = perform_keystate_list(sockfd, dbconn, zonename, keyrole,
-            keystate, &printcompatheader, &printcompatkey);
+        success = perform_keystate_list(&context->out, dbconn, zonename, policyname,
+            keyrole, keystate, &printcompatheader, &printcompatkey);
     }
     return success;
 }
 
 struct cmd_func_block key_list_funcblock = {
-	"key list", &usage, &help, NULL, &run
+	"key list", &usage, &help, NULL, &run, 1
 };
@@ -80,7 +80,7 @@ map_keytime(const struct dbw_zone *zone, const struct dbw_key *key)
 }
 
 static void
-print_key(int sockfd, const char* fmt, const struct dbw_key *key)
+print_key(struct client_buf *buf, const char* fmt, const struct dbw_key *key)
 {
     const char *role;
     switch (key->role) {
@@ -91,47 +91,83 @@ print_key(int sockfd, const char* fmt, const struct dbw_key *key)
             assert(0);
     }
     char *tchange = map_keytime(key->zone, key);
-    client_printf(sockfd, fmt, key->zone->name, role, tchange);
+    if (fmt) {
+        client_buf_printf(buf, fmt, key->zone->name, role, tchange);
+    } else {
+        client_buf_json_begin(buf);
+        client_buf_json_str(buf, "zone", key->zone->name);
+        client_buf_json_str(buf, "keytype", role);
+        client_buf_json_str(buf, "rollover", tchange);
+        client_buf_json_end(buf);
+    }
     free(tchange);
 }
 
+/* Number of zones to fetch keys for at once. */
+#define ZONES_PER_PAGE 64
+
 /**
  * List all keys and their rollover time. If listed_zone is set limit
- * to that zone
- * \param sockfd client socket
+ * to that zone, if listed_policy is set to the zones of that policy.
+ * Keys are fetched ZONES_PER_PAGE zones at a time.
+ * \param buf output to the client
  * \param listed_zone name of the zone
+ * \param listed_policy name of the policy
+ * \param json print JSON lines instead of a table
  * \param dbconn active database connection
  * \return 0 ok, 1 fail.
  */
 static int
-perform_rollover_list(int sockfd, const char *listed_zone,
-    db_connection_t *dbconn)
+perform_rollover_list(struct client_buf *buf, const char *listed_zone,
+    const char *listed_policy, int json, db_connection_t *dbconn)
 {
-    struct dbw_list *keys;
-    const char* fmt = "%-31s %-8s %-30s\n";
-
-    struct dbw_db *db = dbw_fetch(dbconn);
-    /*struct dbw_list *policies = dbw_policies_all_filtered(dbconn, NULL, listed_zone, 0);*/
+    struct dbw_filter filter = {listed_zone, listed_policy, 0, 0};
+    struct dbw_zone **zones;
+    int sockfd = buf->sockfd;
+    size_t n = 0;
+    const char* fmt = json ? NULL : "%-31s %-8s %-30s\n";
 
+    struct dbw_db *db = dbw_fetch_zones(dbconn, &filter);
     if (!db) {
         ods_log_error("[%s] error enumerating rollovers", module_str);
         client_printf(sockfd, "error enumerating rollovers\n");
         return 1;
     }
-    client_printf(sockfd, "Keys:\n");
-    client_printf(sockfd, fmt, "Zone:", "Keytype:", "Rollover expected:");
+    zones = malloc((db->zones->n + 1) * sizeof (struct dbw_zone *));
+    if (!zones) {
+        ods_log_error("[%s] error enumerating rollovers", module_str);
+        client_printf(sockfd, "error enumerating rollovers\n");
+        dbw_free(db);
+        return 1;
+    }
+    if (!json) {
+        client_buf_printf(buf, "Keys:\n");
+        client_buf_printf(buf, fmt, "Zone:", "Keytype:", "Rollover expected:");
+    }
 
     for (size_t p = 0; p < db->policies->n; p++) {
         struct dbw_policy *policy = (struct dbw_policy *)db->policies->set[p];
-        for (size_t z = 0; z < policy->zone_count; z++) {
-            struct dbw_zone *zone = policy->zone[z];
-            if (listed_zone && strcmp(listed_zone, zone->name)) continue;
-            for (size_t k = 0; k < zone->key_count; k++) {
-                struct dbw_key *key = zone->key[k];
-                print_key(sockfd, fmt, key);
-            }
+        for (size_t z = 0; z < policy->zone_count; z++)
+            zones[n++] = policy->zone[z];
+    }
+    for (size_t i = 0; i < n; i += ZONES_PER_PAGE) {
+        size_t count = n - i < ZONES_PER_PAGE ? n - i : ZONES_PER_PAGE;
+        struct dbw_db *page = dbw_fetch_keys(dbconn, zones + i, count, 0, 0);
+        if (!page) {
+            ods_log_error("[%s] error enumerating rollovers", module_str);
+            client_printf(sockfd, "error enumerating rollovers\n");
+            free(zones);
+            dbw_free(db);
+            return 1;
         }
+        for (size_t z = i; z < i + count; z++) {
+            struct dbw_zone *zone = zones[z];
+            for (size_t k = 0; k < zone->key_count; k++)
+                print_key(buf, fmt, zone->key[k]);
+        }
+        dbw_free_keys(page);
     }
+    free(zones);
     dbw_free(db);
     return 0;
 }
@@ -142,6 +178,8 @@ usage(int sockfd)
     client_printf(sockfd, 
         "rollover list\n"
         "	[--zone <zone>]				aka -z\n"
+        "	[--policy <policy>]			aka -P\n"
+        "	[--json]				aka -j\n"
     );
 }
 
@@ -151,20 +189,24 @@ help(int sockfd)
 	client_printf(sockfd,
 		"List the expected dates and times of upcoming rollovers. This can be used to get an idea of upcoming works.\n"
 		"\nOptions:\n"
-		"zone	name of the zone\n\n");
+		"zone	name of the zone\n"
+		"policy	limit the output to the zones of the given policy\n"
+		"json	output one JSON object per key\n\n");
 }
 
 static int
 run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 {
-	#define NARGV 4
+	#define NARGV 8
 	const char *argv[NARGV];
-	int argc = 0, long_index = 0, opt = 0;
-	const char *zone = NULL;
+	int argc = 0, long_index = 0, opt = 0, json = 0;
+	const char *zone = NULL, *policy = NULL;
         db_connection_t* dbconn = getconnectioncontext(context);
 
 	static struct option long_options[] = {
 		{"zone", required_argument, 0, 'z'},
+		{"policy", required_argument, 0, 'P'},
+		{"json", no_argument, 0, 'j'},
 		{0, 0, 0, 0}
 	};
 	
@@ -180,11 +222,17 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 	}
 
 	optind = 0;
-	while ((opt = getopt_long(argc, (char* const*)argv, "z:", long_options, &long_index)) != -1) {
+	while ((opt = getopt_long(argc, (char* const*)argv, "z:P:j", long_options, &long_index)) != -1) {
 		switch (opt) {
 			case 'z':
 				zone = optarg;
 				break;
+			case 'P':
+				policy = optarg;
+				break;
+			case 'j':
+				json = 1;
+				break;
 			default:
 				client_printf_err(sockfd, "unknown arguments\n");
 				ods_log_error("[%s] unknown arguments for %s command",
@@ -192,9 +240,9 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 				return -1;
 		}
 	}
-	return perform_rollover_list(sockfd, zone, dbconn);
+	return perform_rollover_list(&context->out, zone, policy, json, dbconn);
 }
 
 struct cmd_func_block rollover_list_funcblock = {
-	"rollover list", &usage, &help, NULL, &run
+	"rollover list", &usage, &help, NULL, &run, 1
 };
@@ -31,6 +31,7 @@
  * list: zone, policy, next change, signconfpath
  */
 
+#include <getopt.h>
 #include "config.h"
 
 #include "cmdhandler.h"
@@ -50,14 +51,21 @@ static const char *module_str = "zone_list_cmd";
 static void
 usage(int sockfd)
 {
-    client_printf(sockfd, "zone list\n");
+    client_printf(sockfd,
+        "zone list\n"
+        "	[--policy <policy>]			aka -P\n"
+        "	[--json]				aka -j\n"
+    );
 }
 
 static void
 help(int sockfd)
 {
     client_printf(sockfd,
-        "List all zones currently in the database.\n\n"
+        "List all zones currently in the database.\n"
+        "\nOptions:\n"
+        "policy		limit the output to the zones of the given policy\n"
+        "json		output one JSON object per zone\n\n"
     );
 }
 
@@ -75,30 +83,88 @@ time_to_human(time_t t, char *buf, size_t buflen)
 
 }
 
+static void
+printzone(struct client_buf *out, struct dbw_zone *z)
+{
+    char buf[32];
+    client_buf_printf(out, "%-31s %-13s %-26s %-34s\n", z->name, z->policy->name,
+        time_to_human(z->next_change, buf, sizeof(buf)), z->signconf_path);
+}
+
+static void
+printjsonzone(struct client_buf *out, struct dbw_zone *z)
+{
+    client_buf_json_begin(out);
+    client_buf_json_str(out, "zone", z->name);
+    client_buf_json_str(out, "policy", z->policy->name);
+    client_buf_json_int(out, "next_change", z->next_change);
+    client_buf_json_str(out, "signconf", z->signconf_path);
+    client_buf_json_end(out);
+}
+
 static int
 run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 {
-    const char* fmt = "%-31s %-13s %-26s %-34s\n";
-    char buf[32];
+    #define NARGV 8
+    const char *argv[NARGV];
+    int argc, long_index = 0, opt = 0, bJson = 0;
+    struct dbw_filter filter = {NULL, NULL, 0, 0};
+    struct client_buf *out = &context->out;
     db_connection_t* dbconn = getconnectioncontext(context);
     engine_type* engine = getglobalcontext(context);
-    (void)cmd;
+
+    static struct option long_options[] = {
+        {"policy", required_argument, 0, 'P'},
+        {"json", no_argument, 0, 'j'},
+        {0, 0, 0, 0}
+    };
 
     ods_log_debug("[%s] %s command", module_str, zone_list_funcblock.cmdname);
 
-    struct dbw_db *db = dbw_fetch_filtered(dbconn, DBW_F_POLICY|DBW_F_ZONE);
-    if (!db) return 1;
+    argc = ods_str_explode(cmd, NARGV, argv);
+    if (argc == -1) {
+        ods_log_error("[%s] too many arguments for %s command",
+                module_str, zone_list_funcblock.cmdname);
+        client_printf_err(sockfd, "too many arguments\n");
+        return -1;
+    }
+    optind = 0;
+    while ((opt = getopt_long(argc, (char* const*)argv, "P:j", long_options, &long_index)) != -1) {
+        switch (opt) {
+            case 'P':
+                filter.policy = optarg;
+                break;
+            case 'j':
+                bJson = 1;
+                break;
+            default:
+                client_printf_err(sockfd, "unknown arguments\n");
+                ods_log_error("[%s] unknown arguments for %s command",
+                              module_str, zone_list_funcblock.cmdname);
+                return -1;
+        }
+    }
 
-    client_printf(sockfd, "Database set to: %s\n", engine->config->datastore);
+    struct dbw_db *db = dbw_fetch_zones(dbconn, &filter);
+    if (!db) return 1;
 
-    if (!db->zones->n) {
-        client_printf(sockfd, "No zones in database.\n");
+    if (filter.policy && !dbw_get_policy(db, filter.policy)) {
+        client_printf_err(sockfd, "Unable to get policy %s from database!\n", filter.policy);
         dbw_free(db);
-        return 0;
+        return 1;
+    }
+
+    if (!bJson) {
+        client_buf_printf(out, "Database set to: %s\n", engine->config->datastore);
+        if (!db->zones->n) {
+            client_buf_printf(out, "No zones in database.\n");
+            dbw_free(db);
+            return 0;
+        }
+        client_buf_printf(out, "Zones:\n");
+        client_buf_printf(out, "%-31s %-13s %-26s %-34s\n", "Zone:",
+            "Policy:", "Next change:", "Signer Configuration:");
     }
-    client_printf(sockfd, "Zones:\n");
-    client_printf(sockfd, fmt, "Zone:", "Policy:", "Next change:",
-        "Signer Configuration:");
 
     sort_policies((const struct dbw_policy **)db->policies->set, db->policies->n);
     for (size_t p = 0; p < db->policies->n; p++) {
@@ -107,9 +173,10 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         sort_zones((const struct dbw_zone **)policy->zone, policy->zone_count);
 
         for (size_t i = 0; i < policy->zone_count; i++) {
-            struct dbw_zone *z = policy->zone[i];
-            client_printf(sockfd, fmt, z->name, z->policy->name,
-                time_to_human(z->next_change, buf, sizeof(buf)), z->signconf_path);
+            if (bJson)
+                printjsonzone(out, policy->zone[i]);
+            else
+                printzone(out, policy->zone[i]);
         }
     }
     dbw_free(db);
@@ -117,5 +184,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block zone_list_funcblock = {
-    "zone list", &usage, &help, NULL, &run
+    "zone list", &usage, &help, NULL, &run, 1
 };
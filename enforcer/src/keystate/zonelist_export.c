@@ -85,7 +85,7 @@ int zonelist_export(int sockfd, db_connection_t* dbconn, const char* filename, i
         return ZONELIST_EXPORT_ERR_MEMORY;
     }
 
-    struct dbw_db *db = dbw_fetch(dbconn);
+    struct dbw_db *db = dbw_snapshot(dbconn);
     if (!db) {
         client_printf_err(sockfd, "Unable to get list of zones, memory"
             "allocation or database error!\n");
@@ -138,11 +138,11 @@ int zonelist_export(int sockfd, db_connection_t* dbconn, const char* filename, i
         {
             client_printf_err(sockfd, "Unable to create XML elements for zone %s!\n", zone->name);
             xmlFreeDoc(doc);
-            dbw_free(db);
+            dbw_snapshot_release(db);
             return ZONELIST_EXPORT_ERR_XML;
         }
     }
-    dbw_free(db);
+    dbw_snapshot_release(db);
 
     if (snprintf(path, sizeof(path), "%s.new", filename) >= (int)sizeof(path)) {
         client_printf_err(sockfd, "Unable to write zonelist, memory allocation error!\n");
@@ -84,5 +84,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block zonelist_export_funcblock = {
-    "zonelist export", &usage, &help, NULL, &run
+    "zonelist export", &usage, &help, NULL, &run, 1
 };
@@ -31,14 +31,13 @@
 #include "log.h"
 #include "clientpipe.h"
 #include "db/dbw.h"
-#include "utils/kc_helper.h"
 #include "hsmkey/hsm_key_factory.h"
 #include "enforcer/enforce_task.h"
 #include "keystate/zonelist_export.h"
 
 #include <string.h>
-#include <libxml/parser.h>
-#include <libxml/tree.h>
+#include <stdlib.h>
+#include <libxml/xmlreader.h>
 
 #include "keystate/zonelist_import.h"
 
@@ -164,119 +163,230 @@ zone_xml_cmp(struct dbw_db *db, struct dbw_zone *zone, struct xml_zone *xml)
         || strcasecmp(zone->output_adapter_type, xml->outadapter_type));
 }
 
+/* Zones read from the zonelist XML */
+struct xml_zonelist {
+    struct xml_zone *zone;
+    size_t n;
+    size_t size;
+};
+
+static int
+xml_zone_namecmp(const void *a, const void *b)
+{
+    return strcmp(((const struct xml_zone *)a)->name,
+        ((const struct xml_zone *)b)->name);
+}
+
+static int
+dbw_zone_namecmp(const void *a, const void *b)
+{
+    return strcmp((*(struct dbw_zone * const *)a)->name,
+        (*(struct dbw_zone * const *)b)->name);
+}
+
+static void
+xml_zonelist_free(struct xml_zonelist *list)
+{
+    for (size_t i = 0; i < list->n; i++)
+        xml_zone_scrub(&list->zone[i]);
+    free(list->zone);
+}
+
+/**
+ * Stream the zonelist XML, validating it against the rng file on the way,
+ * and collect its zones sorted by name. Only one <Zone> element is held in
+ * memory at a time.
+ */
 static int
-process_xml(int sockfd, xmlNodePtr root, struct dbw_db *db)
+read_zonelist(int sockfd, const char *zonelist_path, struct xml_zonelist *list)
 {
+    xmlTextReaderPtr reader;
     xmlNodePtr node;
-    struct xml_zone xz;
+    struct xml_zone xz, *grown;
+    int ret;
 
-    for (; root; root = root->next) {
-        if (root->type != XML_ELEMENT_NODE) continue;
-        if (strcmp((char*)root->name, "ZoneList")) continue;
-        for (node = root->children; node; node = node->next) {
-            if (node->type != XML_ELEMENT_NODE) continue;
-            memset(&xz, 0, sizeof (struct xml_zone));
-            if (xml_read_child(node, &xz)) {
-                client_printf_err(sockfd, "Unable to create zone %s from XML, XML "
-                    "content may be improperly formatted.\n", xz.name?xz.name:"[unknown]");
-                return 1;
-            }
-            if (!validate_zone(sockfd, &xz)) {
-                client_printf_err(sockfd, "Unable to create zone %s from XML, XML "
-                    "content may be invalid.\n", xz.name?xz.name:"[unknown]");
+    if (!(reader = xmlReaderForFile(zonelist_path, NULL, 0))) {
+        client_printf_err(sockfd, "Unable to read/parse zonelist XML file %s!\n",
+            zonelist_path);
+        return 1;
+    }
+    if (xmlTextReaderRelaxNGValidate(reader,
+        OPENDNSSEC_SCHEMA_DIR "/zonelist.rng"))
+    {
+        client_printf_err(sockfd, "Unable to validate the zonelist XML!\n");
+        xmlFreeTextReader(reader);
+        return 1;
+    }
+    while ((ret = xmlTextReaderRead(reader)) == 1) {
+        if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT
+            || xmlTextReaderDepth(reader) != 1)
+        {
+            continue;
+        }
+        if (!(node = xmlTextReaderExpand(reader))) {
+            ret = -1;
+            break;
+        }
+        memset(&xz, 0, sizeof (struct xml_zone));
+        if (xml_read_child(node, &xz)) {
+            client_printf_err(sockfd, "Unable to create zone %s from XML, XML "
+                "content may be improperly formatted.\n", xz.name?xz.name:"[unknown]");
+            xml_zone_scrub(&xz);
+            xmlFreeTextReader(reader);
+            return 1;
+        }
+        if (!validate_zone(sockfd, &xz)) {
+            client_printf_err(sockfd, "Unable to create zone %s from XML, XML "
+                "content may be invalid.\n", xz.name?xz.name:"[unknown]");
+            xml_zone_scrub(&xz);
+            xmlFreeTextReader(reader);
+            return 1;
+        }
+        if (list->n == list->size) {
+            list->size = list->size ? list->size * 2 : 64;
+            grown = realloc(list->zone, list->size * sizeof (struct xml_zone));
+            if (!grown) {
+                client_printf_err(sockfd, "zonelist import memory error.\n");
                 xml_zone_scrub(&xz);
+                xmlFreeTextReader(reader);
                 return 1;
             }
-            struct dbw_policy *p = dbw_get_policy(db, xz.policy);
+            list->zone = grown;
+        }
+        list->zone[list->n++] = xz;
+    }
+    if (ret != 0 || xmlTextReaderIsValid(reader) != 1) {
+        client_printf_err(sockfd, "Unable to validate the zonelist XML!\n");
+        xmlFreeTextReader(reader);
+        return 1;
+    }
+    xmlFreeTextReader(reader);
+
+    qsort(list->zone, list->n, sizeof (struct xml_zone), xml_zone_namecmp);
+    for (size_t i = 1; i < list->n; i++) {
+        if (!strcmp(list->zone[i-1].name, list->zone[i].name)) {
+            client_printf_err(sockfd, "Zone %s is listed more than once in "
+                "the zonelist XML.\n", list->zone[i].name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Walk the zones from the XML and the zones in the database side by side,
+ * both sorted by name, and mark every database zone to be inserted,
+ * updated or left alone. Zones only in the database keep scratch 0.
+ */
+static int
+process_zones(int sockfd, struct xml_zonelist *list, struct dbw_db *db)
+{
+    struct dbw_zone **existing;
+    struct dbw_policy *p = NULL;
+    size_t n = db->zones->n, j = 0;
+    int cmp;
+
+    existing = malloc((n ? n : 1) * sizeof (struct dbw_zone *));
+    if (!existing) {
+        client_printf_err(sockfd, "zonelist import memory error.\n");
+        return 1;
+    }
+    memcpy(existing, db->zones->set, n * sizeof (struct dbw_zone *));
+    qsort(existing, n, sizeof (struct dbw_zone *), dbw_zone_namecmp);
+
+    for (size_t i = 0; i < list->n; i++) {
+        struct xml_zone *xz = &list->zone[i];
+        if (!p || strcmp(p->name, xz->policy)) {
+            p = dbw_get_policy(db, xz->policy);
             if (!p) {
-                client_printf_err(sockfd, "Can't find policy %s in database.\n", xz.policy);
-                xml_zone_scrub(&xz);
+                client_printf_err(sockfd, "Can't find policy %s in database.\n", xz->policy);
+                free(existing);
                 return 1;
             }
-            struct dbw_zone *zone = dbw_get_zone(db, xz.name);
-            if (!zone) { /* create new  */
-                zone = calloc(1, sizeof (struct dbw_zone));
-                if (!zone) {
-                    client_printf_err(sockfd, "zonelist import memory error.\n");
-                    xml_zone_scrub(&xz);
-                    return 1;
-                }
-                zone->dirty = DBW_INSERT;
-                zone->scratch = 2;
-                zone->name                = xz.name;
-                zone->policy              = p;
-                zone->signconf_path       = xz.signconf;
-                zone->input_adapter_uri   = xz.inadapter_uri;
-                zone->input_adapter_type  = xz.inadapter_type;
-                zone->output_adapter_uri  = xz.outadapter_uri;
-                zone->output_adapter_type = xz.outadapter_type;
-                if (dbw_add_zone(db, p, zone)) {
-                    client_printf_err(sockfd, "zonelist import memory error.\n");
-                    dbw_zone_free((struct dbrow *)zone);
-                    return 1;
-                }
-            } else {
-                zone->scratch = 1;
-                if (!zone_xml_cmp(db, zone, &xz)) {
-                    zone->dirty = DBW_CLEAN;
-                    xml_zone_scrub(&xz);
-                    client_printf(sockfd, "Zone %s already up-to-date\n", zone->name);
-                    continue;
-                }
-                zone->scratch = 3;
-                zone->dirty = DBW_UPDATE;
-                free(zone->signconf_path);
-                free(zone->input_adapter_uri);
-                free(zone->input_adapter_type);
-                free(zone->output_adapter_uri);
-                free(zone->output_adapter_type);
-                free(xz.name);
-                zone->policy              = p;
-                zone->signconf_path       = xz.signconf;
-                zone->input_adapter_uri   = xz.inadapter_uri;
-                zone->input_adapter_type  = xz.inadapter_type;
-                zone->output_adapter_uri  = xz.outadapter_uri;
-                zone->output_adapter_type = xz.outadapter_type;
+        }
+        cmp = 1;
+        while (j < n && (cmp = strcmp(existing[j]->name, xz->name)) < 0)
+            j++;
+        if (j == n || cmp > 0) { /* create new  */
+            struct dbw_zone *zone = calloc(1, sizeof (struct dbw_zone));
+            if (!zone) {
+                client_printf_err(sockfd, "zonelist import memory error.\n");
+                free(existing);
+                return 1;
             }
+            zone->dirty = DBW_INSERT;
+            zone->scratch = 2;
+            zone->name                = xz->name;
+            zone->policy              = p;
+            zone->signconf_path       = xz->signconf;
+            zone->input_adapter_uri   = xz->inadapter_uri;
+            zone->input_adapter_type  = xz->inadapter_type;
+            zone->output_adapter_uri  = xz->outadapter_uri;
+            zone->output_adapter_type = xz->outadapter_type;
+            free(xz->policy);
+            memset(xz, 0, sizeof (struct xml_zone));
+            if (dbw_add_zone(db, p, zone)) {
+                client_printf_err(sockfd, "zonelist import memory error.\n");
+                dbw_zone_free((struct dbrow *)zone);
+                free(existing);
+                return 1;
+            }
+            continue;
+        }
+        struct dbw_zone *zone = existing[j++];
+        zone->scratch = 1;
+        if (!zone_xml_cmp(db, zone, xz)) {
+            zone->dirty = DBW_CLEAN;
+            client_printf(sockfd, "Zone %s already up-to-date\n", zone->name);
+            continue;
         }
+        zone->scratch = 3;
+        zone->dirty = DBW_UPDATE;
+        free(zone->signconf_path);
+        free(zone->input_adapter_uri);
+        free(zone->input_adapter_type);
+        free(zone->output_adapter_uri);
+        free(zone->output_adapter_type);
+        free(xz->name);
+        free(xz->policy);
+        zone->policy              = p;
+        zone->signconf_path       = xz->signconf;
+        zone->input_adapter_uri   = xz->inadapter_uri;
+        zone->input_adapter_type  = xz->inadapter_type;
+        zone->output_adapter_uri  = xz->outadapter_uri;
+        zone->output_adapter_type = xz->outadapter_type;
+        memset(xz, 0, sizeof (struct xml_zone));
     }
+    free(existing);
     return 0;
 }
 
 int zonelist_import(int sockfd, engine_type* engine, db_connection_t *dbconn,
     int do_delete, const char* zonelist_path)
 {
-    xmlDocPtr doc;
-    xmlNodePtr root;
-    struct dbw_db *db = dbw_fetch(dbconn);
-    if (!db) return ZONELIST_IMPORT_ERR_DATABASE;
+    struct xml_zonelist list;
 
     /* Validate, parse and walk the XML. */
     if (!zonelist_path)
         zonelist_path = engine->config->zonelist_filename_enforcer;
-     
-    if (check_zonelist(zonelist_path, 0, NULL, 0)) {
-        client_printf_err(sockfd, "Unable to validate the zonelist XML!\n");
-        dbw_free(db);
-        return ZONELIST_IMPORT_ERR_XML;
-    } else if (!(doc = xmlParseFile(zonelist_path))) {
-        client_printf_err(sockfd, "Unable to read/parse zonelist XML file %s!\n",
-            zonelist_path);
-        dbw_free(db);
-        return ZONELIST_IMPORT_ERR_XML;
-    } else if (!(root = xmlDocGetRootElement(doc))) {
-        client_printf_err(sockfd, "Unable to get the root element in the zonelist XML!\n");
-        xmlFreeDoc(doc);
-        dbw_free(db);
+
+    memset(&list, 0, sizeof (struct xml_zonelist));
+    if (read_zonelist(sockfd, zonelist_path, &list)) {
+        xml_zonelist_free(&list);
         return ZONELIST_IMPORT_ERR_XML;
     }
 
+    struct dbw_db *db = dbw_fetch(dbconn);
+    if (!db) {
+        xml_zonelist_free(&list);
+        return ZONELIST_IMPORT_ERR_DATABASE;
+    }
     for (size_t z = 0; z < db->zones->n; z++) {
         /* All zones not mentioned xml will be deleted */
         db->zones->set[z]->scratch = 0;
     }
-    int r = process_xml(sockfd, root, db);
-    xmlFreeDoc(doc);
+    int r = process_zones(sockfd, &list, db);
+    xml_zonelist_free(&list);
     if (r) {
         dbw_free(db);
         return ZONELIST_IMPORT_ERR_XML;
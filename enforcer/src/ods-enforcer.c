@@ -101,13 +101,13 @@ version(FILE* out)
  * Consume messages in buffer
  * 
  * Read all complete messages in the buffer or until EXIT message 
- * is read. Messages larger than ODS_SE_MAXLINE can be handled but
+ * is read. Messages larger than CLIENT_MAXFRAME can be handled but
  * will be truncated.
  * 
  * \param buf: buffer to read from. Must not be NULL.
  * \param pos: length of valid data in buffer, must never exceed buflen.
  *           Must not be NULL.
- * \param buflen: Capacity of buf, must not exeed ODS_SE_MAXLINE.
+ * \param buflen: Capacity of buf, must not exeed CLIENT_BUFSIZE.
  * \param exitcode[out]: Return code from the daemon, only valid
  *                       when returned 1. Must not be NULL.
  * \return: -1 An error occured
@@ -118,14 +118,14 @@ version(FILE* out)
 static int
 extract_msg(char* buf, int *pos, int buflen, int *exitcode, int sockfd)
 {
-    char data[ODS_SE_MAXLINE+1], opc;
+    char opc;
     int datalen;
     
     assert(buf);
     assert(pos);
     assert(exitcode);
     assert(*pos <= buflen);
-    assert(ODS_SE_MAXLINE >= buflen);
+    assert(CLIENT_BUFSIZE >= buflen);
     
     while (1) {
         /* Do we have a complete header? */
@@ -134,37 +134,38 @@ extract_msg(char* buf, int *pos, int buflen, int *exitcode, int sockfd)
         datalen = (buf[1]<<8) | (buf[2]&0xFF);
 	datalen &= 0xFFFF; /* hopefully sooth tainted data checker */
         if (datalen+3 <= *pos) {
-            /* a complete message */
-            memset(data, 0, ODS_SE_MAXLINE+1);
-            memcpy(data, buf+3, datalen);
-            *pos -= datalen+3;
-            memmove(buf, buf+datalen+3, *pos);
-          
+            /* a complete message, written out as is */
             if (opc == CLIENT_OPC_EXIT) {
                 fflush(stdout);
                 if (datalen != 1) return -1;
                 *exitcode = (int)buf[3];
+                *pos -= datalen+3;
+                memmove(buf, buf+datalen+3, *pos);
                 return 1;
             }
             switch (opc) {
                 case CLIENT_OPC_STDOUT:
-                    fprintf(stdout, "%s", data);
+                    fwrite(buf+3, 1, datalen, stdout);
                     break;
                 case CLIENT_OPC_STDERR:
-                    fprintf(stderr, "%s", data);
+                    fwrite(buf+3, 1, datalen, stderr);
                     break;
                 case CLIENT_OPC_PROMPT:
-                    fprintf(stdout, "%s", data); 
+                    fwrite(buf+3, 1, datalen, stdout);
                     fflush(stdout);
                     /* listen for input here */
                     if (!client_handleprompt(sockfd)) {
                         fprintf(stderr, "\n");
                         *exitcode = 300;
+                        *pos -= datalen+3;
+                        memmove(buf, buf+datalen+3, *pos);
                         return 1;
                     }
 		default:
 			break;
             }
+            *pos -= datalen+3;
+            memmove(buf, buf+datalen+3, *pos);
             continue;
         } else if (datalen+3 > buflen) {
             /* Message is not going to fit! Discard the data already 
@@ -195,7 +196,7 @@ interface_start(const char* cmd, const char* servsock_filename)
     fd_set rset;
     int sockfd, flags, exitcode = 0;
     int ret, n, r, error = 0, inbuf_pos = 0;
-    char userbuf[ODS_SE_MAXLINE], inbuf[ODS_SE_MAXLINE];
+    char userbuf[ODS_SE_MAXLINE], inbuf[CLIENT_BUFSIZE];
 
     assert(servsock_filename);
 
@@ -309,7 +310,7 @@ interface_start(const char* cmd, const char* servsock_filename)
             }
             /* Handle data coming from the daemon */
             if (FD_ISSET(sockfd, &rset)) { /*daemon pipe is readable*/
-                n = read(sockfd, inbuf+inbuf_pos, ODS_SE_MAXLINE-inbuf_pos);
+                n = read(sockfd, inbuf+inbuf_pos, CLIENT_BUFSIZE-inbuf_pos);
                 if (n == 0) { /* daemon closed pipe */
                     fprintf(stderr, "[Remote closed connection]\n");
                     error = 206;
@@ -321,7 +322,7 @@ interface_start(const char* cmd, const char* servsock_filename)
                     break;
                 }
                 inbuf_pos += n;
-                r = extract_msg(inbuf, &inbuf_pos, ODS_SE_MAXLINE, &exitcode, sockfd);
+                r = extract_msg(inbuf, &inbuf_pos, CLIENT_BUFSIZE, &exitcode, sockfd);
                 if (r == -1) {
                     fprintf(stderr, "Error handling message from daemon\n");
                     error = 208;
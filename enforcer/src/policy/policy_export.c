@@ -458,7 +458,7 @@ int policy_export_all(int sockfd, db_connection_t* connection, const char* filen
 
     xmlDocSetRootElement(doc, root);
 
-    struct dbw_db *db = dbw_fetch(connection);
+    struct dbw_db *db = dbw_snapshot(connection);
     if (!db) {
         xmlFreeDoc(doc);
         return POLICY_EXPORT_ERR_MEMORY;
@@ -467,12 +467,12 @@ int policy_export_all(int sockfd, db_connection_t* connection, const char* filen
         struct dbw_policy *policy = (struct dbw_policy *)db->policies->set[p];
         ret = __policy_export(sockfd, policy, root);
         if (ret != POLICY_EXPORT_OK) {
-            dbw_free(db);
+            dbw_snapshot_release(db);
             xmlFreeDoc(doc);
             return ret;
         }
     }
-    dbw_free(db);
+    dbw_snapshot_release(db);
 
     if (filename) {
         unlink(path);
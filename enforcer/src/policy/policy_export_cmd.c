@@ -115,7 +115,7 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
             return 1;
         }
     } else if (policy_name) {
-        struct dbw_db *db = dbw_fetch(dbconn);
+        struct dbw_db *db = dbw_snapshot(dbconn);
         if (!db) {
             client_printf_err(sockfd, "Unable to read from database!\n");
             return 1;
@@ -123,14 +123,14 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         struct dbw_policy *policy = dbw_get_policy(db, policy_name);
         if (!policy) {
             client_printf_err(sockfd, "Unable to find policy %s!\n", policy_name);
-            dbw_free(db);
+            dbw_snapshot_release(db);
             return 1;
         }
         if (policy_export(sockfd, policy, NULL) != POLICY_EXPORT_OK) {
-            dbw_free(db);
+            dbw_snapshot_release(db);
             return 1;
         }
-        dbw_free(db);
+        dbw_snapshot_release(db);
     } else {
         client_printf_err(sockfd, "Either --all or --policy needs to be given!\n");
         return 1;
@@ -140,5 +140,5 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 struct cmd_func_block policy_export_funcblock = {
-    "policy export", &usage, &help, NULL, &run
+    "policy export", &usage, &help, NULL, &run, 1
 };
@@ -64,7 +64,7 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
     engine_type* engine = getglobalcontext(context);
     (void)cmd;
 
-    struct dbw_db *db = dbw_fetch(dbconn);
+    struct dbw_db *db = dbw_snapshot(dbconn);
     if (!db) return 1;
     client_printf(sockfd, fmt, "Policy:", "Description:");
 
@@ -72,10 +72,10 @@ run(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         struct dbw_policy *policy = (struct dbw_policy *)db->policies->set[p];
         client_printf(sockfd, fmt, policy->name, policy->description);
     }
-    dbw_free(db);
+    dbw_snapshot_release(db);
     return 0;
 }
 
 struct cmd_func_block policy_list_funcblock = {
-	"policy list", &usage, &help, NULL, &run
+	"policy list", &usage, &help, NULL, &run, 1
 };
@@ -31,258 +31,297 @@
 #include "clientpipe.h"
 #include "duration.h"
 #include "db/dbw.h"
-#include "utils/kc_helper.h"
+#include "confparser.h"
 
 #include "signconf/signconf_xml.h"
 
-#include <libxml/parser.h>
-#include <libxml/tree.h>
+#include <libxml/xmlwriter.h>
+#include <sys/stat.h>
+#include <errno.h>
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
-static int __free(char **p) {
-    if (!p || !*p) {
-        return 1;
-    }
-    free(*p);
-    *p = NULL;
-    return 0;
-}
-
 /**
- * Export the signconf XML for the given zone that uses the given policy.
- * \param[in] sockfd a socket fd.
- * \param[in] policy a policy_t pointer.
- * \param[in] zone a zone_db_t pointer.
- * \param[in] force if non-zero it will force the export for all zones even if
- * there are no updates for the zones.
- * \return SIGNCONF_EXPORT_ERR_* on error, otherwise SIGNCONF_EXPORT_OK or
- * SIGNCONF_EXPORT_NO_CHANGE.
+ * Write an element with a duration as content.
+ * \return a negative value on error.
  */
 static int
-signconf_xml_export(int sockfd, struct dbw_zone *zone, int force)
+signconf_xml_duration(xmlTextWriterPtr writer, const char *name, time_t time)
 {
-    char path[PATH_MAX];
-    xmlDocPtr doc;
-    xmlNodePtr root;
-    xmlNodePtr node;
-    xmlNodePtr node2;
-    xmlNodePtr node3;
-    xmlNodePtr node4;
-    xmlNodePtr node5;
-    xmlNodePtr keys;
-    duration_type* duration;
-    char* duration_text = NULL;
-    char text[1024];
-    int error;
-    struct dbw_policy *policy = zone->policy;
+    char text[64];
 
-    if (!force && !zone->signconf_needs_writing) return SIGNCONF_EXPORT_NO_CHANGE;
-
-    if (snprintf(path, sizeof(path), "%s.new", zone->signconf_path) >= (int)sizeof(path)) {
-        ods_log_error("[signconf_export] Unable to write updated XML for"
-            " zone %s, path to long!", zone->name);
-        if (sockfd > -1)
-            client_printf_err(sockfd, "Unable to write updated XML for zone"
-                " %s, path to long!\n", zone->name);
-        return SIGNCONF_EXPORT_ERR_MEMORY;
+    if (duration_time2str(time, text, sizeof(text)) < 0) {
+        return -1;
     }
+    return xmlTextWriterWriteElement(writer, (xmlChar*)name, (xmlChar*)text);
+}
 
-    if (!(duration = duration_create())) {
-        ods_log_error("[signconf_export] Unable to process signconf for zone"
-            " %s, memory allocation error!", zone->name);
-        if (sockfd > -1)
-            client_printf_err(sockfd, "Unable to process signconf for zone"
-                " %s, memory allocation error!\n", zone->name);
-        return SIGNCONF_EXPORT_ERR_MEMORY;
-    }
+/**
+ * Write an element with an unsigned integer as content.
+ * \return a negative value on error.
+ */
+static int
+signconf_xml_uint(xmlTextWriterPtr writer, const char *name, unsigned int value)
+{
+    return xmlTextWriterWriteFormatElement(writer, (xmlChar*)name, "%u", value);
+}
 
-    if (!(doc = xmlNewDoc((xmlChar*)"1.0"))
-        || !(root = xmlNewNode(NULL, (xmlChar*)"SignerConfiguration"))
-        || !(node = xmlNewChild(root, NULL, (xmlChar*)"Zone", NULL)))
-    {
-        ods_log_error("[signconf_export] Unable to create XML elements for"
-            " zone %s, memory allocation error!", zone->name);
-        if (sockfd > -1)
-            client_printf_err(sockfd, "Unable to create XML elements for zone"
-                " %s, memory allocation error!\n", zone->name);
-        if (doc) xmlFreeDoc(doc);
-        duration_cleanup(duration);
-        return SIGNCONF_EXPORT_ERR_MEMORY;
+/**
+ * Write an empty element.
+ * \return a negative value on error.
+ */
+static int
+signconf_xml_empty(xmlTextWriterPtr writer, const char *name)
+{
+    if (xmlTextWriterStartElement(writer, (xmlChar*)name) < 0) {
+        return -1;
     }
+    return xmlTextWriterEndElement(writer);
+}
 
-    xmlDocSetRootElement(doc, root);
+/**
+ * Write the signconf XML for the given zone to a memory buffer.
+ * \param[in] writer a xmlTextWriterPtr.
+ * \param[in] zone a zone_db_t pointer.
+ * \return 0 on success, otherwise the number of the element that failed.
+ */
+static int
+signconf_xml_write(xmlTextWriterPtr writer, struct dbw_zone *zone)
+{
+    struct dbw_policy *policy = zone->policy;
+    int error = 1;
 
-    error = 1;
-    if (!xmlNewProp(node, (xmlChar*)"name", (xmlChar*)zone->name)
+    if (xmlTextWriterSetIndent(writer, 1) < 0
+        || xmlTextWriterSetIndentString(writer, (xmlChar*)"  ") < 0
+        || xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL) < 0
+        || xmlTextWriterStartElement(writer, (xmlChar*)"SignerConfiguration") < 0
+        || xmlTextWriterStartElement(writer, (xmlChar*)"Zone") < 0
+        || xmlTextWriterWriteAttribute(writer, (xmlChar*)"name", (xmlChar*)zone->name) < 0
         || !(error = 26)
-        || (policy->passthrough && !(node2 = xmlNewChild(node, NULL, (xmlChar*)"Passthrough", NULL)))
+        || (policy->passthrough && signconf_xml_empty(writer, "Passthrough") < 0)
         || !(error = 2)
-        || !(node2 = xmlNewChild(node, NULL, (xmlChar*)"Signatures", NULL))
+        || xmlTextWriterStartElement(writer, (xmlChar*)"Signatures") < 0
         || !(error = 3)
-        || duration_set_time(duration, policy->signatures_resign)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Resign", (xmlChar*)duration_text))
-        || __free(&duration_text)
+        || signconf_xml_duration(writer, "Resign", policy->signatures_resign) < 0
         || !(error = 4)
-        || duration_set_time(duration, policy->signatures_refresh)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Refresh", (xmlChar*)duration_text))
-        || __free(&duration_text)
+        || signconf_xml_duration(writer, "Refresh", policy->signatures_refresh) < 0
         || !(error = 5)
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Validity", NULL))
+        || xmlTextWriterStartElement(writer, (xmlChar*)"Validity") < 0
         || !(error = 6)
-        || duration_set_time(duration, policy->signatures_validity_default)
-        || !(duration_text = duration2string(duration))
-        || !(node4 = xmlNewChild(node3, NULL, (xmlChar*)"Default", (xmlChar*)duration_text))
-        || __free(&duration_text)
+        || signconf_xml_duration(writer, "Default", policy->signatures_validity_default) < 0
         || !(error = 7)
-        || duration_set_time(duration, policy->signatures_validity_denial)
-        || !(duration_text = duration2string(duration))
-        || !(node4 = xmlNewChild(node3, NULL, (xmlChar*)"Denial", (xmlChar*)duration_text))
-        || __free(&duration_text)
+        || signconf_xml_duration(writer, "Denial", policy->signatures_validity_denial) < 0
         || !(error = 8)
-        || (policy->signatures_validity_keyset > 0 ?
-             duration_set_time(duration, policy->signatures_validity_keyset)
-          || !(duration_text = duration2string(duration))
-          || !(node4 = xmlNewChild(node3, NULL, (xmlChar*)"Keyset", (xmlChar*)duration_text))
-          || __free(&duration_text)
-          || !(error = 100) : 0)
-        || duration_set_time(duration, policy->signatures_jitter)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Jitter", (xmlChar*)duration_text))
-        || __free(&duration_text)
+        || (policy->signatures_validity_keyset > 0
+            && signconf_xml_duration(writer, "Keyset", policy->signatures_validity_keyset) < 0)
+        || xmlTextWriterEndElement(writer) < 0
+        || signconf_xml_duration(writer, "Jitter", policy->signatures_jitter) < 0
         || !(error = 9)
-        || duration_set_time(duration, policy->signatures_inception_offset)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"InceptionOffset", (xmlChar*)duration_text))
-        || __free(&duration_text)
+        || signconf_xml_duration(writer, "InceptionOffset", policy->signatures_inception_offset) < 0
         || !(error = 10)
         || (policy->signatures_max_zone_ttl
-            && (duration_set_time(duration, policy->signatures_max_zone_ttl)
-                || !(duration_text = duration2string(duration))
-                || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"MaxZoneTTL", (xmlChar*)duration_text))
-                || __free(&duration_text)))
+            && signconf_xml_duration(writer, "MaxZoneTTL", policy->signatures_max_zone_ttl) < 0)
+        || xmlTextWriterEndElement(writer) < 0
 
         || !(error = 11)
-        || !(node2 = xmlNewChild(node, NULL, (xmlChar*)"Denial", NULL))
+        || xmlTextWriterStartElement(writer, (xmlChar*)"Denial") < 0
         || !(error = 12)
         || (policy->denial_type == POLICY_DENIAL_TYPE_NSEC
-            && !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"NSEC", NULL)))
+            && signconf_xml_empty(writer, "NSEC") < 0)
         || !(error = 13)
         || (policy->denial_type == POLICY_DENIAL_TYPE_NSEC3
-            && (!(node3 = xmlNewChild(node2, NULL, (xmlChar*)"NSEC3", NULL))
+            && (xmlTextWriterStartElement(writer, (xmlChar*)"NSEC3") < 0
                 || !(error = 14)
                 || (policy->denial_ttl
-                    && (duration_set_time(duration, policy->denial_ttl)
-                        || !(duration_text = duration2string(duration))
-                        || !(node4 = xmlNewChild(node3, NULL, (xmlChar*)"TTL", (xmlChar*)duration_text))
-                        || __free(&duration_text)))
+                    && signconf_xml_duration(writer, "TTL", policy->denial_ttl) < 0)
                 || !(error = 15)
                 || (policy->denial_optout
-                    && !(node4 = xmlNewChild(node3, NULL, (xmlChar*)"OptOut", NULL)))
+                    && signconf_xml_empty(writer, "OptOut") < 0)
                 || !(error = 16)
-                || !(node4 = xmlNewChild(node3, NULL, (xmlChar*)"Hash", NULL))
+                || xmlTextWriterStartElement(writer, (xmlChar*)"Hash") < 0
                 || !(error = 17)
-                || snprintf(text, sizeof(text), "%u", policy->denial_algorithm) >= (int)sizeof(text)
-                || !(node5 = xmlNewChild(node4, NULL, (xmlChar*)"Algorithm", (xmlChar*)text))
+                || signconf_xml_uint(writer, "Algorithm", policy->denial_algorithm) < 0
                 || !(error = 18)
-                || snprintf(text, sizeof(text), "%u", policy->denial_iterations) >= (int)sizeof(text)
-                || !(node5 = xmlNewChild(node4, NULL, (xmlChar*)"Iterations", (xmlChar*)text))
+                || signconf_xml_uint(writer, "Iterations", policy->denial_iterations) < 0
                 || !(error = 19)
-                || !(node5 = xmlNewChild(node4, NULL, (xmlChar*)"Salt", (xmlChar*)policy->denial_salt))))
+                || xmlTextWriterWriteElement(writer, (xmlChar*)"Salt", (xmlChar*)policy->denial_salt) < 0
+                || xmlTextWriterEndElement(writer) < 0
+                || xmlTextWriterEndElement(writer) < 0))
+        || xmlTextWriterEndElement(writer) < 0
 
         || !(error = 20)
-        || !(keys = xmlNewChild(node, NULL, (xmlChar*)"Keys", NULL))
+        || xmlTextWriterStartElement(writer, (xmlChar*)"Keys") < 0
         || !(error = 21)
-        || duration_set_time(duration, policy->keys_ttl)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(keys, NULL, (xmlChar*)"TTL", (xmlChar*)duration_text))
-        || __free(&duration_text)
-
-        || !(error = 22)
-        || !(node2 = xmlNewChild(node, NULL, (xmlChar*)"SOA", NULL))
-        || !(error = 23)
-        || duration_set_time(duration, policy->zone_soa_ttl)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"TTL", (xmlChar*)duration_text))
-        || __free(&duration_text)
-        || !(error = 24)
-        || duration_set_time(duration, policy->zone_soa_minimum)
-        || !(duration_text = duration2string(duration))
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Minimum", (xmlChar*)duration_text))
-        || __free(&duration_text)
-        || !(error = 25)
-        || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Serial", (xmlChar*)dbw_soa_serial_txt[policy->zone_soa_serial]))
-        )
+        || signconf_xml_duration(writer, "TTL", policy->keys_ttl) < 0)
     {
-        ods_log_error("[signconf_export] Unable to create XML elements for"
-            " zone %s! [%d]", zone->name, error);
-        if (sockfd > -1) client_printf_err(sockfd, "Unable to create XML"
-            " elements for zone %s!\n", zone->name);
-        __free(&duration_text);
-        duration_cleanup(duration);
-        xmlFreeDoc(doc);
-        return SIGNCONF_EXPORT_ERR_XML;
+        return error;
     }
-    __free(&duration_text);
-    duration_cleanup(duration);
 
     for (size_t k = 0; k < zone->key_count; k++) {
         struct dbw_key *key = zone->key[k];
         error = 100;
-        if (!(node2 = xmlNewChild(keys, NULL, (xmlChar*)"Key", NULL))
+        if (xmlTextWriterStartElement(writer, (xmlChar*)"Key") < 0
             || !(error = 101)
-            || (key->role == KEY_DATA_ROLE_ZSK
-                && !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Flags", (xmlChar*)"256")))
-            || !(error = 102)
-            || (key->role != KEY_DATA_ROLE_ZSK
-                && !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Flags", (xmlChar*)"257")))
+            || xmlTextWriterWriteElement(writer, (xmlChar*)"Flags",
+                (xmlChar*)(key->role == KEY_DATA_ROLE_ZSK ? "256" : "257")) < 0
             || !(error = 103)
-            || snprintf(text, sizeof(text), "%u", key->algorithm) >= (int)sizeof(text)
-            || !(error = 104)
-            || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Algorithm", (xmlChar*)text))
+            || signconf_xml_uint(writer, "Algorithm", key->algorithm) < 0
             || !(error = 105)
-            || !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Locator",(xmlChar*)key->hsmkey->locator))
+            || xmlTextWriterWriteElement(writer, (xmlChar*)"Locator", (xmlChar*)key->hsmkey->locator) < 0
             || !(error = 106)
             || (key->active_ksk
                 && (key->role | KEY_DATA_ROLE_KSK)
-                && !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"KSK", NULL)))
+                && signconf_xml_empty(writer, "KSK") < 0)
             || !(error = 107)
             || (key->active_zsk
                 && (key->role | KEY_DATA_ROLE_ZSK)
-                && !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"ZSK", NULL)))
+                && signconf_xml_empty(writer, "ZSK") < 0)
             || !(error = 108)
             || (key->publish
-                && !(node3 = xmlNewChild(node2, NULL, (xmlChar*)"Publish", NULL)))
+                && signconf_xml_empty(writer, "Publish") < 0)
             /* TODO:
              * What about <Deactivate/> ?
              */
-            )
+            || xmlTextWriterEndElement(writer) < 0)
         {
-            ods_log_error("[signconf_export] Unable to create key XML elements"
-               " for zone %s! [%d]", zone->name, error);
-            if (sockfd > -1)
-                client_printf_err(sockfd, "Unable to create key XML elements"
-                    " for zone %s!\n", zone->name);
-            xmlFreeDoc(doc);
-            return SIGNCONF_EXPORT_ERR_XML;
+            return error;
+        }
+    }
+
+    error = 22;
+    if (xmlTextWriterEndElement(writer) < 0
+        || xmlTextWriterStartElement(writer, (xmlChar*)"SOA") < 0
+        || !(error = 23)
+        || signconf_xml_duration(writer, "TTL", policy->zone_soa_ttl) < 0
+        || !(error = 24)
+        || signconf_xml_duration(writer, "Minimum", policy->zone_soa_minimum) < 0
+        || !(error = 25)
+        || xmlTextWriterWriteElement(writer, (xmlChar*)"Serial", (xmlChar*)dbw_soa_serial_txt[policy->zone_soa_serial]) < 0
+        || xmlTextWriterEndDocument(writer) < 0)
+    {
+        return error;
+    }
+    return 0;
+}
+
+/**
+ * Check if the file already has the given content.
+ * \param[in] path the file name.
+ * \param[in] buf the content.
+ * \return non-zero if the file content is the same.
+ */
+static int
+signconf_xml_unchanged(const char *path, xmlBufferPtr buf)
+{
+    struct stat st;
+    size_t len = (size_t)xmlBufferLength(buf);
+    char *content;
+    FILE *fd;
+    int same;
+
+    if (stat(path, &st) || (size_t)st.st_size != len
+        || !(fd = fopen(path, "r")))
+    {
+        return 0;
+    }
+    if (!(content = malloc(len + 1))) {
+        fclose(fd);
+        return 0;
+    }
+    same = fread(content, 1, len, fd) == len
+        && !memcmp(content, xmlBufferContent(buf), len);
+    free(content);
+    fclose(fd);
+    return same;
+}
+
+/**
+ * Export the signconf XML for the given zone that uses the given policy.
+ * \param[in] sockfd a socket fd.
+ * \param[in] policy a policy_t pointer.
+ * \param[in] zone a zone_db_t pointer.
+ * \param[in] force if non-zero it will force the export for all zones even if
+ * there are no updates for the zones.
+ * \return SIGNCONF_EXPORT_ERR_* on error, otherwise SIGNCONF_EXPORT_OK or
+ * SIGNCONF_EXPORT_NO_CHANGE.
+ */
+static int
+signconf_xml_export(int sockfd, struct dbw_zone *zone, int force)
+{
+    char path[PATH_MAX];
+    xmlBufferPtr buf;
+    xmlTextWriterPtr writer;
+    FILE *fd;
+    int error;
+
+    if (!force && !zone->signconf_needs_writing) return SIGNCONF_EXPORT_NO_CHANGE;
+
+    if (snprintf(path, sizeof(path), "%s.new", zone->signconf_path) >= (int)sizeof(path)) {
+        ods_log_error("[signconf_export] Unable to write updated XML for"
+            " zone %s, path to long!", zone->name);
+        if (sockfd > -1)
+            client_printf_err(sockfd, "Unable to write updated XML for zone"
+                " %s, path to long!\n", zone->name);
+        return SIGNCONF_EXPORT_ERR_MEMORY;
+    }
+
+    if (!(buf = xmlBufferCreate())
+        || !(writer = xmlNewTextWriterMemory(buf, 0)))
+    {
+        ods_log_error("[signconf_export] Unable to create XML writer for"
+            " zone %s, memory allocation error!", zone->name);
+        if (sockfd > -1)
+            client_printf_err(sockfd, "Unable to create XML writer for zone"
+                " %s, memory allocation error!\n", zone->name);
+        if (buf) xmlBufferFree(buf);
+        return SIGNCONF_EXPORT_ERR_MEMORY;
+    }
+
+    error = signconf_xml_write(writer, zone);
+    /* Flushes the writer into buf */
+    xmlFreeTextWriter(writer);
+    if (error) {
+        ods_log_error("[signconf_export] Unable to create XML elements for"
+            " zone %s! [%d]", zone->name, error);
+        if (sockfd > -1) client_printf_err(sockfd, "Unable to create XML"
+            " elements for zone %s!\n", zone->name);
+        xmlBufferFree(buf);
+        return SIGNCONF_EXPORT_ERR_XML;
+    }
+
+    /* Leave an identical file alone, the signer has nothing to reload */
+    if (signconf_xml_unchanged(zone->signconf_path, buf)) {
+        xmlBufferFree(buf);
+        if (zone->signconf_needs_writing) {
+            zone->signconf_needs_writing = 0;
+            dbw_mark_dirty((struct dbrow *)zone);
         }
+        return SIGNCONF_EXPORT_NO_CHANGE;
     }
 
     unlink(path);
-    if (xmlSaveFormatFileEnc(path, doc, "UTF-8", 1) == -1) {
+    error = 1;
+    if ((fd = fopen(path, "w"))) {
+        error = fwrite(xmlBufferContent(buf), 1, xmlBufferLength(buf), fd)
+            != (size_t)xmlBufferLength(buf);
+        error = fclose(fd) || error;
+    }
+    xmlBufferFree(buf);
+    if (error) {
         ods_log_error("[signconf_export] Unable to write signconf for zone "
-            "%s, LibXML error!", zone->name);
+            "%s, %s!", zone->name, strerror(errno));
         if (sockfd > -1)
             client_printf_err(sockfd, "Unable to write signconf for zone "
-                "%s, LibXML error!\n", zone->name);
-        xmlFreeDoc(doc);
+                "%s, %s!\n", zone->name, strerror(errno));
+        unlink(path);
         return SIGNCONF_EXPORT_ERR_FILE;
     }
-    xmlFreeDoc(doc);
 
-    if (check_rng(path, OPENDNSSEC_SCHEMA_DIR "/signconf.rng", 0)) {
+    if (parse_file_check(path, OPENDNSSEC_SCHEMA_DIR "/signconf.rng")
+        != ODS_STATUS_OK)
+    {
         ods_log_error("[signconf_export] Unable to validate the exported "
             "signconf XML for zone %s!", zone->name);
         if (sockfd > -1)
@@ -322,6 +361,8 @@ signconf_export_zone(char const *zonename, db_connection_t* dbconn)
     int ret = signconf_xml_export(-1, zone, 1);
     if (ret == SIGNCONF_EXPORT_OK) {
         ret = dbw_commit(db);
+    } else if (ret == SIGNCONF_EXPORT_NO_CHANGE && dbw_commit(db)) {
+        ret = SIGNCONF_EXPORT_ERR_DATABASE;
     }
     dbw_free(db);
     return ret;
@@ -378,7 +378,7 @@ adapi_del_rr(zone_type* zone, ldns_rr* rr, int backup)
  *
  */
 ods_status
-adapi_printzone(FILE* fd, zone_type* zone)
+adapi_printzone(FILE* fd, zone_type* zone, int threads)
 {
     ods_status status = ODS_STATUS_OK;
     if (!fd || !zone || !zone->db) {
@@ -386,7 +386,7 @@ adapi_printzone(FILE* fd, zone_type* zone)
             "name database missing", adapi_str);
         return ODS_STATUS_ASSERT_ERR;
     }
-    namedb_export(fd, zone->db, &status);
+    namedb_export_parallel(fd, zone->db, threads, &status);
     return status;
 }
 
@@ -110,10 +110,11 @@ ods_status adapi_del_rr(zone_type* zone, ldns_rr* rr, int backup);
  * Print zonefile.
  * \param[in] fd file descriptor
  * \param[in] zone zone
+ * \param[in] threads number of formatting threads
  * \return ods_status status
  *
  */
-ods_status adapi_printzone(FILE* fd, zone_type* zone);
+ods_status adapi_printzone(FILE* fd, zone_type* zone, int threads);
 
 /**
  * Print axfr.
@@ -130,6 +130,92 @@ addns_read_line:
 }
 
 
+/**
+ * Read the next RR from the wire format transfer spool. RRs are taken
+ * from the answer section of the spooled messages, without conversion
+ * to presentation format. A NULL return with *mark set to
+ * XFRD_SPOOL_BEGIN or XFRD_SPOOL_END signals a transfer boundary.
+ *
+ */
+static ldns_rr*
+addns_read_wire_rr(FILE* fd, ldns_rr_list** rrs, size_t* next, int* mark,
+    ldns_status* status, unsigned int* l)
+{
+    ldns_pkt* pkt = NULL;
+    uint8_t hdr[XFRD_SPOOL_HDRLEN];
+    uint8_t* wire = NULL;
+    size_t len = 0;
+
+    *mark = 0;
+    *status = LDNS_STATUS_OK;
+    while (1) {
+        if (*rrs && *next < ldns_rr_list_rr_count(*rrs)) {
+            if (l) {
+                (*l)++;
+            }
+            return ldns_rr_list_rr(*rrs, (*next)++);
+        }
+        if (*rrs) {
+            ldns_rr_list_free(*rrs);
+            *rrs = NULL;
+            *next = 0;
+        }
+        if (fread(hdr, 1, sizeof(hdr), fd) != sizeof(hdr)) {
+            /* EOF or truncated record */
+            return NULL;
+        }
+        len = ldns_read_uint16(hdr + 1);
+        if (hdr[0] == XFRD_SPOOL_BEGIN || hdr[0] == XFRD_SPOOL_END) {
+            *mark = hdr[0];
+            return NULL;
+        } else if (hdr[0] != XFRD_SPOOL_DATA) {
+            ods_log_error("[%s] bogus xfrd spool record type %u",
+                adapter_str, (unsigned) hdr[0]);
+            *status = LDNS_STATUS_ERR;
+            return NULL;
+        }
+        CHECKALLOC(wire = (uint8_t*) malloc(len ? len : 1));
+        if (fread(wire, 1, len, fd) != len) {
+            /* truncated record */
+            free(wire);
+            return NULL;
+        }
+        *status = ldns_wire2pkt(&pkt, wire, len);
+        free(wire);
+        if (*status != LDNS_STATUS_OK) {
+            ods_log_error("[%s] bogus xfrd spool packet: %s", adapter_str,
+                ldns_get_errorstr_by_id(*status));
+            return NULL;
+        }
+        /* take over the answer section, the RRs are handed out one by one */
+        *rrs = ldns_pkt_answer(pkt);
+        ldns_pkt_set_answer(pkt, NULL);
+        ldns_pkt_free(pkt);
+        *next = 0;
+    }
+    return NULL;
+}
+
+
+/**
+ * Free the RRs from the wire format transfer spool that were not
+ * handed out.
+ *
+ */
+static void
+addns_free_wire_rrs(ldns_rr_list** rrs, size_t* next)
+{
+    if (*rrs) {
+        while (*next < ldns_rr_list_rr_count(*rrs)) {
+            ldns_rr_free(ldns_rr_list_rr(*rrs, (*next)++));
+        }
+        ldns_rr_list_free(*rrs);
+        *rrs = NULL;
+    }
+    *next = 0;
+}
+
+
 /**
  * Read pkt from file.
  *
@@ -161,6 +247,11 @@ addns_read_pkt(FILE* fd, zone_type* zone)
     char* xfrd;
     char* fin;
     char* fout;
+    ldns_rr_list* rrs = NULL;
+    size_t next = 0;
+    int is_wire = 0;
+    int mark = 0;
+    int c = 0;
 
     ods_log_assert(fd);
     ods_log_assert(zone);
@@ -168,16 +259,32 @@ addns_read_pkt(FILE* fd, zone_type* zone)
 
 
     fpos = ftell(fd);
-    len = adutil_readline_frm_file(fd, line, &l, 1);
-    if (len < 0) {
-        /* -1 EOF */
+    line[0] = '\0';
+    c = getc(fd);
+    if (c == EOF) {
         return ODS_STATUS_EOF;
-    }
-    adutil_rtrim_line(line, &len);
-    if (ods_strcmp(";;BEGINPACKET", line) != 0) {
-        ods_log_error("[%s] bogus xfrd file zone %s, missing ;;BEGINPACKET (was %s)",
-            adapter_str, zone->name, line);
-        return ODS_STATUS_ERR;
+    } else if (c == XFRD_SPOOL_BEGIN) {
+        /* wire format spool */
+        if (fread(line, 1, XFRD_SPOOL_HDRLEN - 1, fd) !=
+            XFRD_SPOOL_HDRLEN - 1) {
+            return ODS_STATUS_EOF;
+        }
+        line[0] = '\0';
+        is_wire = 1;
+    } else {
+        /* presentation format, as written by earlier versions */
+        ungetc(c, fd);
+        len = adutil_readline_frm_file(fd, line, &l, 1);
+        if (len < 0) {
+            /* -1 EOF */
+            return ODS_STATUS_EOF;
+        }
+        adutil_rtrim_line(line, &len);
+        if (ods_strcmp(";;BEGINPACKET", line) != 0) {
+            ods_log_error("[%s] bogus xfrd file zone %s, missing "
+                ";;BEGINPACKET (was %s)", adapter_str, zone->name, line);
+            return ODS_STATUS_ERR;
+        }
     }
     startpos = fpos;
     fpos = ftell(fd);
@@ -204,7 +311,9 @@ begin_pkt:
     ttl = adapi_get_ttl(zone);
 
     /* read RRs */
-    while ((rr = addns_read_rr(fd, line, &orig, &prev, &ttl, &status, &l))
+    while ((rr = (is_wire ?
+        addns_read_wire_rr(fd, &rrs, &next, &mark, &status, &l) :
+        addns_read_rr(fd, line, &orig, &prev, &ttl, &status, &l)))
         != NULL) {
         /* update file position */
         fpos = ftell(fd);
@@ -379,8 +488,17 @@ begin_pkt:
         ldns_rdf_deep_free(prev);
         prev = NULL;
     }
+    if (is_wire) {
+        addns_free_wire_rrs(&rrs, &next);
+    } else if (ods_strcmp(";;ENDPACKET", line) == 0) {
+        mark = XFRD_SPOOL_END;
+    } else if (ods_strcmp(";;BEGINPACKET", line) == 0) {
+        mark = XFRD_SPOOL_BEGIN;
+    } else {
+        mark = 0;
+    }
     /* check again */
-    if (ods_strcmp(";;ENDPACKET", line) == 0) {
+    if (mark == XFRD_SPOOL_END) {
         ods_log_verbose("[%s] xfr zone %s on disk complete, commit to db",
             adapter_str, zone->name);
             startpos = 0;
@@ -388,7 +506,7 @@ begin_pkt:
         ods_log_warning("[%s] xfr zone %s on disk incomplete, rollback",
             adapter_str, zone->name);
         namedb_rollback(zone->db, 1);
-        if (ods_strcmp(";;BEGINPACKET", line) == 0) {
+        if (mark == XFRD_SPOOL_BEGIN) {
             result = ODS_STATUS_OK;
             startpos = fpos;
             goto begin_pkt;
@@ -505,6 +623,8 @@ dnsin_create(void)
     CHECKALLOC(addns = (dnsin_type*) malloc(sizeof(dnsin_type)));
     addns->request_xfr = NULL;
     addns->allow_notify = NULL;
+    addns->allow_notify_index = NULL;
+    addns->allow_notify_retired = NULL;
     addns->tsig = NULL;
     return addns;
 }
@@ -520,12 +640,33 @@ dnsout_create(void)
     dnsout_type* addns = NULL;
     CHECKALLOC(addns = (dnsout_type*) malloc(sizeof(dnsout_type)));
     addns->provide_xfr = NULL;
+    addns->provide_xfr_index = NULL;
+    addns->provide_xfr_retired = NULL;
     addns->do_notify = NULL;
     addns->tsig = NULL;
     return addns;
 }
 
 
+/**
+ * Replace a compiled ACL. Query handlers look the index up without
+ * holding the zone list lock, so the old one is not freed here but kept
+ * until the adapter is cleaned up, like the ACL lists it points into.
+ *
+ */
+static void
+addns_index_replace(acl_index_type** index, acl_index_type** retired,
+    acl_type* acl)
+{
+    acl_index_type* old = *index;
+    *index = acl_index_create(acl);
+    if (old) {
+        old->next = *retired;
+        *retired = old;
+    }
+}
+
+
 /**
  * Read DNS input adapter.
  *
@@ -551,6 +692,8 @@ dnsin_read(dnsin_type* addns, const char* filename)
         addns->tsig = parse_addns_tsig(filename);
         addns->request_xfr = parse_addns_request_xfr(filename, addns->tsig);
         addns->allow_notify = parse_addns_allow_notify(filename, addns->tsig);
+        addns_index_replace(&addns->allow_notify_index,
+            &addns->allow_notify_retired, addns->allow_notify);
         ods_fclose(fd);
         return ODS_STATUS_OK;
     }
@@ -609,6 +752,8 @@ dnsout_read(dnsout_type* addns, const char* filename)
     if (fd) {
         addns->tsig = parse_addns_tsig(filename);
         addns->provide_xfr = parse_addns_provide_xfr(filename, addns->tsig);
+        addns_index_replace(&addns->provide_xfr_index,
+            &addns->provide_xfr_retired, addns->provide_xfr);
         addns->do_notify = parse_addns_do_notify(filename, addns->tsig);
         ods_fclose(fd);
         return ODS_STATUS_OK;
@@ -895,6 +1040,8 @@ dnsin_cleanup(dnsin_type* addns)
     if (!addns) {
         return;
     }
+    acl_index_cleanup(addns->allow_notify_index);
+    acl_index_cleanup(addns->allow_notify_retired);
     acl_cleanup(addns->request_xfr);
     acl_cleanup(addns->allow_notify);
     tsig_cleanup(addns->tsig);
@@ -912,6 +1059,8 @@ dnsout_cleanup(dnsout_type* addns)
     if (!addns) {
         return;
     }
+    acl_index_cleanup(addns->provide_xfr_index);
+    acl_index_cleanup(addns->provide_xfr_retired);
     acl_cleanup(addns->provide_xfr);
     acl_cleanup(addns->do_notify);
     tsig_cleanup(addns->tsig);
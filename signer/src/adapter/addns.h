@@ -49,6 +49,8 @@ typedef struct dnsin_struct dnsin_type;
 struct dnsin_struct {
     acl_type* request_xfr;
     acl_type* allow_notify;
+    acl_index_type* allow_notify_index;
+    acl_index_type* allow_notify_retired;
     tsig_type* tsig;
     time_t last_modified;
 };
@@ -60,6 +62,8 @@ struct dnsin_struct {
 typedef struct dnsout_struct dnsout_type;
 struct dnsout_struct {
     acl_type* provide_xfr;
+    acl_index_type* provide_xfr_index;
+    acl_index_type* provide_xfr_retired;
     acl_type* do_notify;
     tsig_type* tsig;
     time_t last_modified;
@@ -39,15 +39,65 @@
 #include "log.h"
 #include "status.h"
 #include "util.h"
+#include "locks.h"
 #include "signer/zone.h"
 
 #include <ldns/ldns.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static const char* adapter_str = "adapter";
 static ods_status adfile_read_file(FILE* fd, zone_type* zone);
 
+/** Number of threads used for parsing large zone files. */
+static int adfile_threads = 1;
+
+/**
+ * A chunk of a memory mapped zone file. Chunks always start at a RR with an
+ * explicit owner name, or directly after an $INCLUDE directive.
+ *
+ */
+typedef struct adfile_chunk_struct adfile_chunk_type;
+struct adfile_chunk_struct {
+    const char* start;
+    size_t len;
+    unsigned int line; /* line number at chunk start */
+    const ldns_rdf* origin; /* $ORIGIN at chunk start */
+    uint32_t ttl; /* $TTL at chunk start */
+    ldns_rdf* prev; /* previous owner, only set after $INCLUDE */
+    char* include; /* $INCLUDE filename, chunk holds no RRs */
+    /* parse results */
+    ldns_rr_list* rrs;
+    unsigned int* lines;
+    ldns_status status;
+    unsigned int errline;
+    char* errstr;
+    int done;
+};
+
+/**
+ * Parallel zone file parser.
+ *
+ */
+typedef struct adfile_parser_struct adfile_parser_type;
+struct adfile_parser_struct {
+    adfile_chunk_type* chunks;
+    size_t num_chunks;
+    size_t max_chunks;
+    size_t next_chunk; /* next chunk to be parsed */
+    size_t merged; /* chunks merged into the namedb */
+    ldns_rdf** origins; /* every $ORIGIN seen during the scan */
+    size_t num_origins;
+    int need_to_exit;
+    pthread_mutex_t parser_lock;
+    pthread_cond_t parser_cond;
+};
+
 
 /**
  * Read the next RR from zone file.
@@ -290,6 +340,648 @@ adfile_read_file(FILE* fd, zone_type* zone)
 }
 
 
+/**
+ * Set the number of parser and writer threads.
+ *
+ */
+void
+adfile_set_threads(int threads)
+{
+    adfile_threads = threads > 0 ? threads : 1;
+}
+
+
+/**
+ * Parse a domain name as ldns_rr_new_frm_str() would for owner names.
+ *
+ */
+static ldns_rdf*
+adfile_parse_dname(const char* str, const ldns_rdf* origin)
+{
+    ldns_rdf* dname = NULL;
+    if (strcmp(str, "@") == 0) {
+        return origin ? ldns_rdf_clone(origin) : NULL;
+    }
+    dname = ldns_dname_new_frm_str(str);
+    if (!dname) {
+        return NULL;
+    }
+    if (!ldns_dname_str_absolute(str)) {
+        if (!origin || ldns_dname_cat(dname, origin) != LDNS_STATUS_OK) {
+            ldns_rdf_deep_free(dname);
+            return NULL;
+        }
+    }
+    return dname;
+}
+
+
+/**
+ * Fast path for the most common RR types, bypassing the generic ldns
+ * presentation format parser. Only plain, unescaped input is accepted;
+ * return 0 if the line has to be parsed by ldns_rr_new_frm_str().
+ *
+ */
+static int
+adfile_parse_rr_fast(ldns_rr** rr, const char* line, uint32_t default_ttl,
+    const ldns_rdf* origin, ldns_rdf** prev)
+{
+    const char* token[6];
+    size_t toklen[6];
+    const char* p = line;
+    char str[LDNS_MAX_DOMAINLEN*4+1];
+    int ntokens = 0;
+    int has_owner = 0;
+    int t = 0;
+    uint32_t ttl = default_ttl ? default_ttl : LDNS_DEFAULT_TTL;
+    ldns_rr_type type = 0;
+    ldns_rdf* owner = NULL;
+    ldns_rdf* rdata = NULL;
+    uint8_t addr[16];
+
+    if (strpbrk(line, "\\\"")) {
+        return 0;
+    }
+    has_owner = !isspace((int)line[0]);
+    while (*p) {
+        while (isspace((int)*p)) {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        if (ntokens == 6) {
+            return 0;
+        }
+        token[ntokens] = p;
+        while (*p && !isspace((int)*p)) {
+            p++;
+        }
+        toklen[ntokens] = p - token[ntokens];
+        if (toklen[ntokens] >= sizeof(str)) {
+            return 0;
+        }
+        ntokens++;
+    }
+    if (has_owner) {
+        t++;
+    }
+    /* [ttl] [class] type rdata */
+    if (t < ntokens && isdigit((int)token[t][0])) {
+        if (strspn(token[t], "0123456789") != toklen[t]) {
+            return 0;
+        }
+        ttl = (uint32_t) strtoul(token[t], NULL, 10);
+        t++;
+    }
+    if (t < ntokens && toklen[t] == 2 && strncasecmp(token[t], "IN", 2) == 0) {
+        t++;
+    }
+    if (t + 2 != ntokens) {
+        return 0;
+    }
+    memcpy(str, token[t], toklen[t]);
+    str[toklen[t]] = '\0';
+    if (strcasecmp(str, "A") == 0) {
+        type = LDNS_RR_TYPE_A;
+    } else if (strcasecmp(str, "AAAA") == 0) {
+        type = LDNS_RR_TYPE_AAAA;
+    } else if (strcasecmp(str, "NS") == 0) {
+        type = LDNS_RR_TYPE_NS;
+    } else if (strcasecmp(str, "CNAME") == 0) {
+        type = LDNS_RR_TYPE_CNAME;
+    } else if (strcasecmp(str, "PTR") == 0) {
+        type = LDNS_RR_TYPE_PTR;
+    } else {
+        return 0;
+    }
+    /* rdata */
+    memcpy(str, token[t+1], toklen[t+1]);
+    str[toklen[t+1]] = '\0';
+    if (type == LDNS_RR_TYPE_A) {
+        if (inet_pton(AF_INET, str, addr) != 1) {
+            return 0;
+        }
+        rdata = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_A, 4, addr);
+    } else if (type == LDNS_RR_TYPE_AAAA) {
+        if (inet_pton(AF_INET6, str, addr) != 1) {
+            return 0;
+        }
+        rdata = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_AAAA, 16, addr);
+    } else {
+        rdata = adfile_parse_dname(str, origin);
+    }
+    if (!rdata) {
+        return 0;
+    }
+    /* owner */
+    if (has_owner) {
+        memcpy(str, token[0], toklen[0]);
+        str[toklen[0]] = '\0';
+        owner = adfile_parse_dname(str, origin);
+    } else if (prev && *prev) {
+        owner = ldns_rdf_clone(*prev);
+    } else if (origin) {
+        owner = ldns_rdf_clone(origin);
+    }
+    if (!owner) {
+        ldns_rdf_deep_free(rdata);
+        return 0;
+    }
+    *rr = ldns_rr_new();
+    if (!*rr) {
+        ldns_rdf_deep_free(owner);
+        ldns_rdf_deep_free(rdata);
+        return 0;
+    }
+    if (has_owner && prev) {
+        if (*prev) {
+            ldns_rdf_deep_free(*prev);
+        }
+        *prev = ldns_rdf_clone(owner);
+    }
+    ldns_rr_set_owner(*rr, owner);
+    ldns_rr_set_ttl(*rr, ttl);
+    ldns_rr_set_class(*rr, LDNS_RR_CLASS_IN);
+    ldns_rr_set_type(*rr, type);
+    ldns_rr_push_rdf(*rr, rdata);
+    return 1;
+}
+
+
+/**
+ * Has the merger asked the parser threads to stop?
+ *
+ */
+static int
+adfile_parser_exiting(adfile_parser_type* parser)
+{
+    int need_to_exit;
+    pthread_mutex_lock(&parser->parser_lock);
+    need_to_exit = parser->need_to_exit;
+    pthread_mutex_unlock(&parser->parser_lock);
+    return need_to_exit;
+}
+
+
+/**
+ * Parse one chunk of a memory mapped zone file.
+ *
+ */
+static void
+adfile_parse_chunk(adfile_parser_type* parser, adfile_chunk_type* chunk,
+    char* line)
+{
+    ldns_rr* rr = NULL;
+    ldns_rdf* orig = NULL;
+    ldns_rdf* prev = NULL;
+    ldns_rdf* tmp = NULL;
+    uint32_t ttl = chunk->ttl;
+    const char *endptr;  /* unused */
+    size_t pos = 0;
+    size_t max_lines = 0;
+    unsigned int l = chunk->line;
+    int len = 0;
+    int offset = 0;
+
+    chunk->rrs = ldns_rr_list_new();
+    if (!chunk->rrs) {
+        chunk->status = LDNS_STATUS_MEM_ERR;
+        return;
+    }
+    if (chunk->origin) {
+        orig = ldns_rdf_clone(chunk->origin);
+    }
+    if (chunk->prev) {
+        prev = ldns_rdf_clone(chunk->prev);
+    }
+    while ((len = adutil_readline_frm_buf(chunk->start, chunk->len, &pos,
+        line, &l, 0)) >= 0) {
+        if (adfile_parser_exiting(parser)) {
+            break;
+        }
+        adutil_rtrim_line(line, &len);
+        if (line[0] == '$') {
+            if (strncmp(line, "$ORIGIN", 7) == 0 && isspace((int)line[7])) {
+                offset = 8;
+                while (isspace((int)line[offset])) {
+                    offset++;
+                }
+                tmp = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, line + offset);
+                if (!tmp) {
+                    chunk->status = LDNS_STATUS_SYNTAX_DNAME_ERR;
+                    chunk->errline = l;
+                    chunk->errstr = strdup(line);
+                    break;
+                }
+                if (orig) {
+                    ldns_rdf_deep_free(orig);
+                }
+                orig = tmp;
+                continue;
+            } else if (strncmp(line, "$TTL", 4) == 0 &&
+                isspace((int)line[4])) {
+                offset = 5;
+                while (isspace((int)line[offset])) {
+                    offset++;
+                }
+                ttl = ldns_str2period(line + offset, &endptr);
+                continue;
+            }
+            /* this can be an owner name */
+        } else if (line[0] == ';' || line[0] == '\n') {
+            continue;
+        }
+        if (adutil_whitespace_line(line, len)) {
+            continue;
+        }
+        rr = NULL;
+        if (adfile_parse_rr_fast(&rr, line, ttl, orig, &prev)) {
+            chunk->status = LDNS_STATUS_OK;
+        } else {
+            chunk->status = ldns_rr_new_frm_str(&rr, line, ttl, orig, &prev);
+        }
+        if (chunk->status == LDNS_STATUS_SYNTAX_EMPTY) {
+            if (rr) {
+                ldns_rr_free(rr);
+            }
+            chunk->status = LDNS_STATUS_OK;
+            continue;
+        } else if (chunk->status != LDNS_STATUS_OK) {
+            if (rr) {
+                ldns_rr_free(rr);
+            }
+            chunk->errline = l;
+            chunk->errstr = strdup(line);
+            break;
+        }
+        if (ldns_rr_list_rr_count(chunk->rrs) >= max_lines) {
+            max_lines = max_lines ? max_lines * 2 : 1024;
+            chunk->lines = (unsigned int*) realloc(chunk->lines,
+                max_lines * sizeof(unsigned int));
+            if (!chunk->lines) {
+                ldns_rr_free(rr);
+                chunk->status = LDNS_STATUS_MEM_ERR;
+                break;
+            }
+        }
+        chunk->lines[ldns_rr_list_rr_count(chunk->rrs)] = l;
+        ldns_rr_list_push_rr(chunk->rrs, rr);
+    }
+    if (orig) {
+        ldns_rdf_deep_free(orig);
+    }
+    if (prev) {
+        ldns_rdf_deep_free(prev);
+    }
+}
+
+
+/**
+ * Parser thread: parse chunks until there are no more, but stay within a
+ * window of chunks ahead of the merge, to bound memory usage.
+ *
+ */
+static void
+adfile_parser_thread(void* arg)
+{
+    adfile_parser_type* parser = (adfile_parser_type*) arg;
+    adfile_chunk_type* chunk = NULL;
+    size_t window = (size_t) ADFILE_PARSER_WINDOW * adfile_threads;
+    char* line = NULL;
+
+    CHECKALLOC(line = (char*) malloc(SE_ADFILE_MAXLINE + 1));
+    pthread_mutex_lock(&parser->parser_lock);
+    while (!parser->need_to_exit && parser->next_chunk < parser->num_chunks) {
+        if (parser->next_chunk >= parser->merged + window) {
+            pthread_cond_wait(&parser->parser_cond, &parser->parser_lock);
+            continue;
+        }
+        chunk = &parser->chunks[parser->next_chunk++];
+        if (chunk->include) {
+            continue;
+        }
+        pthread_mutex_unlock(&parser->parser_lock);
+        adfile_parse_chunk(parser, chunk, line);
+        pthread_mutex_lock(&parser->parser_lock);
+        chunk->done = 1;
+        pthread_cond_broadcast(&parser->parser_cond);
+    }
+    pthread_mutex_unlock(&parser->parser_lock);
+    free(line);
+}
+
+
+/**
+ * Add a new chunk to the parser.
+ *
+ */
+static adfile_chunk_type*
+adfile_parser_add_chunk(adfile_parser_type* parser, const char* start,
+    unsigned int line, const ldns_rdf* origin, uint32_t ttl)
+{
+    adfile_chunk_type* chunk = NULL;
+    if (parser->num_chunks >= parser->max_chunks) {
+        parser->max_chunks = parser->max_chunks ? parser->max_chunks * 2 : 64;
+        CHECKALLOC(parser->chunks = (adfile_chunk_type*) realloc(
+            parser->chunks, parser->max_chunks * sizeof(adfile_chunk_type)));
+    }
+    chunk = &parser->chunks[parser->num_chunks++];
+    memset(chunk, 0, sizeof(adfile_chunk_type));
+    chunk->start = start;
+    chunk->line = line;
+    chunk->origin = origin;
+    chunk->ttl = ttl;
+    chunk->status = LDNS_STATUS_OK;
+    return chunk;
+}
+
+
+/**
+ * Split a memory mapped zone file into chunks that can be parsed
+ * independently. The scan keeps track of $ORIGIN and $TTL, so that each
+ * chunk knows the state in effect at its start.
+ *
+ */
+static ods_status
+adfile_parser_scan(adfile_parser_type* parser, const char* map, size_t size,
+    zone_type* zone)
+{
+    adfile_chunk_type* chunk = NULL;
+    ldns_rdf* orig = NULL;
+    ldns_rdf* owner_orig = NULL;
+    ldns_rdf* tmp = NULL;
+    uint32_t ttl = adapi_get_ttl(zone);
+    const char *endptr;  /* unused */
+    char owner[LDNS_MAX_DOMAINLEN*4+1];
+    char* line = NULL;
+    size_t pos = 0;
+    size_t entry = 0;
+    size_t owner_len = 0;
+    unsigned int l = 0;
+    unsigned int entry_line = 0;
+    int len = 0;
+    int offset = 0;
+
+    owner[0] = '\0';
+    orig = adapi_get_origin(zone);
+    if (!orig) {
+        ods_log_error("[%s] error getting default value for $ORIGIN",
+            adapter_str);
+        return ODS_STATUS_ERR;
+    }
+    CHECKALLOC(line = (char*) malloc(SE_ADFILE_MAXLINE + 1));
+    chunk = adfile_parser_add_chunk(parser, map, l, orig, ttl);
+    while (1) {
+        entry = pos;
+        entry_line = l;
+        len = adutil_readline_frm_buf(map, size, &pos, line, &l, 0);
+        if (len < 0) {
+            break;
+        }
+        adutil_rtrim_line(line, &len);
+        if (line[0] == '$') {
+            if (strncmp(line, "$ORIGIN", 7) == 0 && isspace((int)line[7])) {
+                offset = 8;
+                while (isspace((int)line[offset])) {
+                    offset++;
+                }
+                tmp = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, line + offset);
+                if (tmp) {
+                    CHECKALLOC(parser->origins = (ldns_rdf**) realloc(
+                        parser->origins,
+                        (parser->num_origins + 1) * sizeof(ldns_rdf*)));
+                    parser->origins[parser->num_origins++] = tmp;
+                    orig = tmp;
+                }
+                /* syntax errors are reported by the parser threads */
+                continue;
+            } else if (strncmp(line, "$TTL", 4) == 0 &&
+                isspace((int)line[4])) {
+                offset = 5;
+                while (isspace((int)line[offset])) {
+                    offset++;
+                }
+                ttl = ldns_str2period(line + offset, &endptr);
+                continue;
+            } else if (strncmp(line, "$INCLUDE", 8) == 0 &&
+                isspace((int)line[8])) {
+                offset = 9;
+                while (isspace((int)line[offset])) {
+                    offset++;
+                }
+                chunk->len = (map + entry) - chunk->start;
+                chunk = adfile_parser_add_chunk(parser, map + entry,
+                    entry_line, orig, ttl);
+                chunk->include = strdup(line + offset);
+                chunk->len = pos - entry;
+                chunk->done = 1;
+                chunk = adfile_parser_add_chunk(parser, map + pos, l, orig,
+                    ttl);
+                if (owner[0]) {
+                    /* RRs without owner continue the previous owner */
+                    chunk->prev = adfile_parse_dname(owner, owner_orig);
+                }
+                continue;
+            }
+        } else if (line[0] == ';' || line[0] == '\n' ||
+            isspace((int)line[0])) {
+            continue;
+        }
+        if (adutil_whitespace_line(line, len)) {
+            continue;
+        }
+        /* RR with explicit owner: safe to start a new chunk here */
+        if ((size_t) ((map + entry) - chunk->start) >= ADFILE_CHUNK_SIZE) {
+            chunk->len = (map + entry) - chunk->start;
+            chunk = adfile_parser_add_chunk(parser, map + entry, entry_line,
+                orig, ttl);
+        }
+        owner_len = strcspn(line, " \t");
+        if (owner_len < sizeof(owner)) {
+            memcpy(owner, line, owner_len);
+            owner[owner_len] = '\0';
+            owner_orig = orig;
+        } else {
+            owner[0] = '\0';
+        }
+    }
+    chunk->len = (map + size) - chunk->start;
+    free(line);
+    return ODS_STATUS_OK;
+}
+
+
+/**
+ * Clean up parser.
+ *
+ */
+static void
+adfile_parser_cleanup(adfile_parser_type* parser)
+{
+    size_t i = 0;
+    for (i = 0; i < parser->num_chunks; i++) {
+        if (parser->chunks[i].rrs) {
+            ldns_rr_list_deep_free(parser->chunks[i].rrs);
+        }
+        if (parser->chunks[i].prev) {
+            ldns_rdf_deep_free(parser->chunks[i].prev);
+        }
+        free(parser->chunks[i].lines);
+        free(parser->chunks[i].include);
+        free(parser->chunks[i].errstr);
+    }
+    for (i = 0; i < parser->num_origins; i++) {
+        ldns_rdf_deep_free(parser->origins[i]);
+    }
+    free(parser->chunks);
+    free(parser->origins);
+    pthread_mutex_destroy(&parser->parser_lock);
+    pthread_cond_destroy(&parser->parser_cond);
+}
+
+
+/**
+ * Merge the RRs of a parsed chunk into the zone, in file order.
+ *
+ */
+static ods_status
+adfile_merge_chunk(adfile_chunk_type* chunk, zone_type* zone,
+    uint32_t* new_serial)
+{
+    ods_status result = ODS_STATUS_OK;
+    FILE* fd_include = NULL;
+    ldns_rr* rr = NULL;
+    size_t i = 0;
+    size_t count = 0;
+
+    if (chunk->include) {
+        fd_include = ods_fopen(chunk->include, NULL, "r");
+        if (!fd_include) {
+            ods_log_error("[%s] unable to open include file %s",
+                adapter_str, chunk->include);
+            return ODS_STATUS_ERR;
+        }
+        result = adfile_read_file(fd_include, zone);
+        ods_fclose(fd_include);
+        if (result != ODS_STATUS_OK) {
+            ods_log_error("[%s] error in include file %s",
+                adapter_str, chunk->include);
+        }
+        return result;
+    }
+    if (chunk->status != LDNS_STATUS_OK) {
+        ods_log_error("[%s] error parsing RR at line %i (%s): %s",
+            adapter_str, chunk->errline,
+            ldns_get_errorstr_by_id(chunk->status),
+            chunk->errstr?chunk->errstr:"");
+        return ODS_STATUS_ERR;
+    }
+    count = ldns_rr_list_rr_count(chunk->rrs);
+    for (i = 0; i < count; i++) {
+        rr = ldns_rr_list_rr(chunk->rrs, i);
+        /* SOA? */
+        if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+            *new_serial =
+              ldns_rdf2native_int32(ldns_rr_rdf(rr, SE_SOA_RDATA_SERIAL));
+        }
+        /* add to the database */
+        result = adapi_add_rr(zone, rr, 0);
+        if (result == ODS_STATUS_UNCHANGED) {
+            ods_log_debug("[%s] skipping RR at line %i (duplicate)",
+                adapter_str, chunk->lines[i]);
+            ldns_rr_free(rr);
+            result = ODS_STATUS_OK;
+        } else if (result != ODS_STATUS_OK) {
+            ods_log_error("[%s] error adding RR at line %i", adapter_str,
+                chunk->lines[i]);
+            ldns_rr_free(rr);
+            i++;
+            break;
+        }
+    }
+    /* RRs are either owned by the zone or freed by now */
+    for (; i < count; i++) {
+        ldns_rr_free(ldns_rr_list_rr(chunk->rrs, i));
+    }
+    ldns_rr_list_free(chunk->rrs);
+    chunk->rrs = NULL;
+    free(chunk->lines);
+    chunk->lines = NULL;
+    return result;
+}
+
+
+/**
+ * Read memory mapped zone file with multiple parser threads. The file is
+ * split into chunks that are parsed concurrently, and merged into the
+ * zone in file order by the calling thread.
+ *
+ */
+static ods_status
+adfile_read_map(const char* map, size_t size, zone_type* zone)
+{
+    adfile_parser_type parser;
+    janitor_thread_t* threads = NULL;
+    ods_status result = ODS_STATUS_OK;
+    uint32_t new_serial = 0;
+    size_t i = 0;
+    int nthreads = 0;
+
+    memset(&parser, 0, sizeof(adfile_parser_type));
+    pthread_mutex_init(&parser.parser_lock, NULL);
+    pthread_cond_init(&parser.parser_cond, NULL);
+    result = adfile_parser_scan(&parser, map, size, zone);
+    if (result != ODS_STATUS_OK) {
+        adfile_parser_cleanup(&parser);
+        return result;
+    }
+    ods_log_debug("[%s] zone %s: parse %lu chunks with %i threads",
+        adapter_str, zone->name, (unsigned long) parser.num_chunks,
+        adfile_threads);
+    CHECKALLOC(threads = (janitor_thread_t*) calloc(adfile_threads,
+        sizeof(janitor_thread_t)));
+    for (nthreads = 0; nthreads < adfile_threads; nthreads++) {
+        janitor_thread_create(&threads[nthreads], workerthreadclass,
+            (janitor_runfn_t)adfile_parser_thread, &parser);
+    }
+    for (i = 0; i < parser.num_chunks; i++) {
+        pthread_mutex_lock(&parser.parser_lock);
+        while (!parser.chunks[i].done) {
+            pthread_cond_wait(&parser.parser_cond, &parser.parser_lock);
+        }
+        pthread_mutex_unlock(&parser.parser_lock);
+        result = adfile_merge_chunk(&parser.chunks[i], zone, &new_serial);
+        pthread_mutex_lock(&parser.parser_lock);
+        parser.merged = i + 1;
+        if (result != ODS_STATUS_OK) {
+            parser.need_to_exit = 1;
+        }
+        pthread_cond_broadcast(&parser.parser_cond);
+        pthread_mutex_unlock(&parser.parser_lock);
+        if (result != ODS_STATUS_OK) {
+            break;
+        }
+    }
+    for (nthreads = 0; nthreads < adfile_threads; nthreads++) {
+        janitor_thread_join(threads[nthreads]);
+    }
+    free(threads);
+    adfile_parser_cleanup(&parser);
+    /* input zone ok, set inbound serial and apply differences */
+    if (result == ODS_STATUS_OK) {
+        result = namedb_examine(zone->db);
+        if (result != ODS_STATUS_OK) {
+            ods_log_error("[%s] unable to read file: zonefile contains errors",
+                adapter_str);
+            return result;
+        }
+        adapi_set_serial(zone, new_serial);
+    }
+    return result;
+}
+
+
 /**
  * Read zone from zonefile.
  *
@@ -300,6 +992,8 @@ adfile_read(void* zone)
     FILE* fd = NULL;
     zone_type* adzone = (zone_type*) zone;
     ods_status status = ODS_STATUS_OK;
+    struct stat st;
+    void* map = NULL;
     if (!adzone || !adzone->adinbound || !adzone->adinbound->configstr) {
         ods_log_error("[%s] unable to read file: no input adapter",
             adapter_str);
@@ -309,7 +1003,25 @@ adfile_read(void* zone)
     if (!fd) {
         return ODS_STATUS_FOPEN_ERR;
     }
-    status = adfile_read_file(fd, adzone);
+    if (adfile_threads > 1 && fstat(fileno(fd), &st) == 0 &&
+        S_ISREG(st.st_mode) && st.st_size >= ADFILE_PARALLEL_MINSIZE) {
+        map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+            fileno(fd), 0);
+        if (map == MAP_FAILED) {
+            ods_log_warning("[%s] unable to mmap file %s (%s), reading "
+                "sequentially", adapter_str, adzone->adinbound->configstr,
+                strerror(errno));
+            map = NULL;
+        }
+    }
+    if (map) {
+        (void) madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+        status = adfile_read_map((const char*) map, (size_t) st.st_size,
+            adzone);
+        munmap(map, (size_t) st.st_size);
+    } else {
+        status = adfile_read_file(fd, adzone);
+    }
     ods_fclose(fd);
     if (status == ODS_STATUS_OK) {
         adapi_trans_full(zone, 0);
@@ -350,7 +1062,13 @@ adfile_write(void* zone, const char* filename)
     }
     fd = ods_fopen(tmpname, NULL, "w");
     if (fd) {
-        status = adapi_printzone(fd, adzone);
+        (void) setvbuf(fd, NULL, _IOFBF, ADFILE_WRITE_BUFSIZE);
+        status = adapi_printzone(fd, adzone, adfile_threads);
+        if (fflush(fd) != 0 && status == ODS_STATUS_OK) {
+            ods_log_error("[%s] unable to write zone %s file %s: %s",
+                adapter_str, adzone->name, tmpname, strerror(errno));
+            status = ODS_STATUS_FWRITE_ERR;
+        }
         ods_fclose(fd);
         if (status == ODS_STATUS_OK) {
             if (adzone->adoutbound->error) {
@@ -43,6 +43,22 @@
  */
 /** NULL */
 
+/* Zone files of at least this size are parsed with multiple threads */
+#define ADFILE_PARALLEL_MINSIZE (4*1024*1024)
+/* Target size of the chunks that are handed to the parser threads */
+#define ADFILE_CHUNK_SIZE (1024*1024)
+/* Number of chunks per thread that may be parsed ahead of the merge */
+#define ADFILE_PARSER_WINDOW 4
+/* Size of the stdio buffer used when writing the signed zone file */
+#define ADFILE_WRITE_BUFSIZE (1024*1024)
+
+/**
+ * Set the number of threads used for parsing and writing large zone files.
+ * \param[in] threads number of parser and writer threads
+ *
+ */
+void adfile_set_threads(int threads);
+
 /**
  * Read zone from input file adapter.
  * \param[in] zone zone reference
@@ -40,12 +40,61 @@ static const char* adapter_str = "adapter";
 
 
 /**
- * Read one line from zone file.
+ * Source of characters for adutil_readline(), like fgetc().
  *
  */
-int
-adutil_readline_frm_file(FILE* fd, char* line, unsigned int* l,
-    int keep_comments)
+typedef int (*adutil_getc_func)(void* src, unsigned int* l);
+
+/**
+ * Memory buffer as a source of characters.
+ *
+ */
+typedef struct adutil_buf_struct adutil_buf_type;
+struct adutil_buf_struct {
+    const char* buf;
+    size_t len;
+    size_t* pos;
+};
+
+
+/**
+ * Read one character from zone file.
+ *
+ */
+static int
+adutil_getc_frm_file(void* src, unsigned int* l)
+{
+    return ods_fgetc((FILE*) src, l);
+}
+
+
+/**
+ * Read one character from memory buffer.
+ *
+ */
+static int
+adutil_getc_frm_buf(void* src, unsigned int* l)
+{
+    adutil_buf_type* b = (adutil_buf_type*) src;
+    int c;
+    if (*b->pos >= b->len) {
+        return EOF;
+    }
+    c = (unsigned char) b->buf[(*b->pos)++];
+    if (c == '\n' && l) {
+        (*l)++;
+    }
+    return c;
+}
+
+
+/**
+ * Read one line from a source of characters.
+ *
+ */
+static int
+adutil_readline(adutil_getc_func next, void* src, char* line,
+    unsigned int* l, int keep_comments)
 {
     int i = 0;
     int li = 0;
@@ -56,10 +105,10 @@ adutil_readline_frm_file(FILE* fd, char* line, unsigned int* l,
     int lc = 0;
 
     for (i = 0; i < SE_ADFILE_MAXLINE; i++) {
-        c = ods_fgetc(fd, l);
+        c = next(src, l);
         if (comments) {
             while (c != EOF && (char)c != '\n') {
-                c = ods_fgetc(fd, l);
+                c = next(src, l);
             }
         }
 
@@ -146,6 +195,34 @@ adutil_readline_frm_file(FILE* fd, char* line, unsigned int* l,
 }
 
 
+/**
+ * Read one line from zone file.
+ *
+ */
+int
+adutil_readline_frm_file(FILE* fd, char* line, unsigned int* l,
+    int keep_comments)
+{
+    return adutil_readline(adutil_getc_frm_file, fd, line, l, keep_comments);
+}
+
+
+/**
+ * Read one line from memory buffer.
+ *
+ */
+int
+adutil_readline_frm_buf(const char* buf, size_t len, size_t* pos, char* line,
+    unsigned int* l, int keep_comments)
+{
+    adutil_buf_type b;
+    b.buf = buf;
+    b.len = len;
+    b.pos = pos;
+    return adutil_readline(adutil_getc_frm_buf, &b, line, l, keep_comments);
+}
+
+
 /*
  * Trim trailing whitespace.
  *
@@ -51,6 +51,20 @@
 int adutil_readline_frm_file(FILE* fd, char* line, unsigned int* l,
     int keep_comments);
 
+/**
+ * Read one line from memory buffer, e.g. a memory mapped zone file.
+ * \param[in] buf start of buffer
+ * \param[in] len length of buffer
+ * \param[in,out] pos current read offset in buffer
+ * \param[out] line the one line
+ * \param[out] l keeps track of line numbers
+ * \param[in] keep_comments if true, keep comments
+ * \return int number of characters read, -1 at end of buffer
+ *
+ */
+int adutil_readline_frm_buf(const char* buf, size_t len, size_t* pos,
+    char* line, unsigned int* l, int keep_comments);
+
 /*
  * Trim trailing whitespace.
  * \param[in] line line to be trimmed
@@ -45,24 +45,41 @@ static const char* dnsh_str = "dnshandler";
  *
  */
 dnshandler_type*
-dnshandler_create(listener_type* interfaces)
+dnshandler_create(listener_type* interfaces, int num_threads)
 {
     dnshandler_type* dnsh = NULL;
+    size_t i = 0;
+    size_t j = 0;
     if (!interfaces || interfaces->count <= 0) {
         return NULL;
     }
+#ifndef SO_REUSEPORT
+    if (num_threads > 1) {
+        ods_log_warning("[%s] SO_REUSEPORT not supported, using one "
+            "listener thread", dnsh_str);
+        num_threads = 1;
+    }
+#endif
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
     CHECKALLOC(dnsh = (dnshandler_type*) malloc(sizeof(dnshandler_type)));
     dnsh->need_to_exit = 0;
     dnsh->engine = NULL;
     dnsh->interfaces = interfaces;
-    dnsh->socklist = NULL;
-    dnsh->netio = NULL;
-    dnsh->query = NULL;
-    dnsh->tcp_accept_handlers = NULL;
+    dnsh->num_threads = (size_t) num_threads;
     /* setup */
-    CHECKALLOC(dnsh->socklist = (socklist_type*) malloc(sizeof(socklist_type)));
-    dnsh->netio = netio_create();
-    dnsh->query = query_create();
+    CHECKALLOC(dnsh->threads = (dnsthread_type*) calloc(dnsh->num_threads,
+        sizeof(dnsthread_type)));
+    for (i = 0; i < dnsh->num_threads; i++) {
+        dnsh->threads[i].dnshandler = dnsh;
+        CHECKALLOC(dnsh->threads[i].socklist = (socklist_type*) malloc(sizeof(socklist_type)));
+        dnsh->threads[i].netio = netio_create();
+        for (j = 0; j < SOCK_UDP_BATCH; j++) {
+            dnsh->threads[i].queries[j] = query_create();
+        }
+        dnsh->threads[i].tcp_accept_handlers = NULL;
+    }
     dnsh->xfrhandler.fd = -1;
     dnsh->xfrhandler.user_data = (void*) dnsh;
     dnsh->xfrhandler.timeout = 0;
@@ -78,40 +95,42 @@ ods_status
 dnshandler_listen(dnshandler_type* dnshandler)
 {
     ods_status status = ODS_STATUS_OK;
+    size_t i = 0;
     ods_log_assert(dnshandler);
-    status = sock_listen(dnshandler->socklist, dnshandler->interfaces);
-    if (status != ODS_STATUS_OK) {
-        ods_log_error("[%s] unable to start: sock_listen() "
-            "failed (%s)", dnsh_str, ods_status2str(status));
-        dnshandler->thread_id = 0;
+    for (i = 0; i < dnshandler->num_threads; i++) {
+        status = sock_listen(dnshandler->threads[i].socklist,
+            dnshandler->interfaces, dnshandler->num_threads > 1);
+        if (status != ODS_STATUS_OK) {
+            ods_log_error("[%s] unable to start: sock_listen() "
+                "failed (%s)", dnsh_str, ods_status2str(status));
+            dnshandler->thread_id = 0;
+            return status;
+        }
     }
     return status;
 }
 
 
 /**
- * Start dns handler.
+ * Serve the sockets of a dns handler thread.
  *
  */
-void
-dnshandler_start(dnshandler_type* dnshandler)
+static void
+dnshandler_serve(dnsthread_type* dnsthread)
 {
+    dnshandler_type* dnshandler = dnsthread->dnshandler;
     size_t i = 0;
 
-    ods_log_assert(dnshandler);
-    ods_log_assert(dnshandler->engine);
-    ods_log_debug("[%s] start", dnsh_str);
-
     /* udp */
     for (i=0; i < dnshandler->interfaces->count; i++) {
         struct udp_data* data = NULL;
         netio_handler_type* handler = NULL;
         CHECKALLOC(data = (struct udp_data*) malloc(sizeof(struct udp_data)));
-        data->query = dnshandler->query;
+        data->queries = dnsthread->queries;
         data->engine = dnshandler->engine;
-        data->socket = &dnshandler->socklist->udp[i];
+        data->socket = &dnsthread->socklist->udp[i];
         CHECKALLOC(handler = (netio_handler_type*) malloc(sizeof(netio_handler_type)));
-        handler->fd = dnshandler->socklist->udp[i].s;
+        handler->fd = dnsthread->socklist->udp[i].s;
         handler->timeout = NULL;
         handler->user_data = data;
         handler->event_types = NETIO_EVENT_READ;
@@ -119,20 +138,20 @@ dnshandler_start(dnshandler_type* dnshandler)
         handler->free_handler = 1;
         ods_log_debug("[%s] add udp network handler fd %u", dnsh_str,
             (unsigned) handler->fd);
-        netio_add_handler(dnshandler->netio, handler);
+        netio_add_handler(dnsthread->netio, handler);
     }
     /* tcp */
-    CHECKALLOC(dnshandler->tcp_accept_handlers = (netio_handler_type*) malloc(dnshandler->interfaces->count * sizeof(netio_handler_type)));
+    CHECKALLOC(dnsthread->tcp_accept_handlers = (netio_handler_type*) malloc(dnshandler->interfaces->count * sizeof(netio_handler_type)));
     for (i=0; i < dnshandler->interfaces->count; i++) {
         struct tcp_accept_data* data = NULL;
         netio_handler_type* handler = NULL;
         CHECKALLOC(data = (struct tcp_accept_data*) malloc(sizeof(struct tcp_accept_data)));
         data->engine = dnshandler->engine;
-        data->socket = &dnshandler->socklist->udp[i];
+        data->socket = &dnsthread->socklist->udp[i];
         data->tcp_accept_handler_count = dnshandler->interfaces->count;
-        data->tcp_accept_handlers = dnshandler->tcp_accept_handlers;
-        handler = &dnshandler->tcp_accept_handlers[i];
-        handler->fd = dnshandler->socklist->tcp[i].s;
+        data->tcp_accept_handlers = dnsthread->tcp_accept_handlers;
+        handler = &dnsthread->tcp_accept_handlers[i];
+        handler->fd = dnsthread->socklist->tcp[i].s;
         handler->timeout = NULL;
         handler->user_data = data;
         handler->event_types = NETIO_EVENT_READ;
@@ -140,12 +159,12 @@ dnshandler_start(dnshandler_type* dnshandler)
         handler->free_handler = 0;
         ods_log_debug("[%s] add tcp network handler fd %u", dnsh_str,
             (unsigned) handler->fd);
-        netio_add_handler(dnshandler->netio, handler);
+        netio_add_handler(dnsthread->netio, handler);
     }
     /* service */
     while (dnshandler->need_to_exit == 0) {
         ods_log_deeebug("[%s] netio dispatch", dnsh_str);
-        if (netio_dispatch(dnshandler->netio, NULL, NULL) == -1) {
+        if (netio_dispatch(dnsthread->netio, NULL, NULL) == -1) {
             if (errno != EINTR) {
                 ods_log_error("[%s] unable to dispatch netio: %s", dnsh_str,
                     strerror(errno));
@@ -153,8 +172,36 @@ dnshandler_start(dnshandler_type* dnshandler)
             }
         }
     }
+}
+
+
+/**
+ * Start dns handler.
+ *
+ */
+void
+dnshandler_start(dnshandler_type* dnshandler)
+{
+    size_t i = 0;
+
+    ods_log_assert(dnshandler);
+    ods_log_assert(dnshandler->engine);
+    ods_log_debug("[%s] start", dnsh_str);
+
+    /* the first thread is this one */
+    dnshandler->threads[0].thread_id = dnshandler->thread_id;
+    for (i = 1; i < dnshandler->num_threads; i++) {
+        janitor_thread_create(&dnshandler->threads[i].thread_id,
+            handlerthreadclass, (janitor_runfn_t) dnshandler_serve,
+            &dnshandler->threads[i]);
+    }
+    dnshandler_serve(&dnshandler->threads[0]);
     /* shutdown */
     ods_log_debug("[%s] shutdown", dnsh_str);
+    for (i = 1; i < dnshandler->num_threads; i++) {
+        janitor_thread_signal(dnshandler->threads[i].thread_id);
+        janitor_thread_join(dnshandler->threads[i].thread_id);
+    }
 }
 
 
@@ -199,27 +246,33 @@ void
 dnshandler_cleanup(dnshandler_type* dnshandler)
 {
     size_t i = 0;
+    size_t t = 0;
     if (!dnshandler) {
         return;
     }
-    netio_cleanup(dnshandler->netio);
-    query_cleanup(dnshandler->query);
-
+    for (t = 0; t < dnshandler->num_threads; t++) {
+        dnsthread_type* dnsthread = &dnshandler->threads[t];
+        netio_cleanup(dnsthread->netio);
+        for (i = 0; i < SOCK_UDP_BATCH; i++) {
+            query_cleanup(dnsthread->queries[i]);
+        }
 
-    for (i = 0; i < dnshandler->interfaces->count; i++) {
-        if (dnshandler->tcp_accept_handlers)
-            free(dnshandler->tcp_accept_handlers[i].user_data);
-        if (dnshandler->socklist->udp[i].s != -1) {
-            close(dnshandler->socklist->udp[i].s);
-            freeaddrinfo((void*)dnshandler->socklist->udp[i].addr);
+        for (i = 0; i < dnshandler->interfaces->count; i++) {
+            if (dnsthread->tcp_accept_handlers)
+                free(dnsthread->tcp_accept_handlers[i].user_data);
+            if (dnsthread->socklist->udp[i].s != -1) {
+                close(dnsthread->socklist->udp[i].s);
+                freeaddrinfo((void*)dnsthread->socklist->udp[i].addr);
+            }
+            if (dnsthread->socklist->tcp[i].s != -1) {
+                close(dnsthread->socklist->tcp[i].s);
+                freeaddrinfo((void*)dnsthread->socklist->tcp[i].addr);
+            }
         }
-        if (dnshandler->socklist->tcp[i].s != -1) {
-            close(dnshandler->socklist->tcp[i].s);
-            freeaddrinfo((void*)dnshandler->socklist->tcp[i].addr);
-        }  
+        free(dnsthread->tcp_accept_handlers);
+        free(dnsthread->socklist);
     }
-    free(dnshandler->tcp_accept_handlers);
-    free(dnshandler->socklist);
+    free(dnshandler->threads);
     listener_cleanup(dnshandler->interfaces);
     free(dnshandler);
 }
@@ -48,26 +48,40 @@ typedef struct dnshandler_struct dnshandler_type;
 #define ODS_SE_NOTIFY_CMD "NOTIFY"
 #define ODS_SE_MAX_HANDLERS 5
 
+typedef struct dnsthread_struct dnsthread_type;
+
+/**
+ * DNS handler thread. Each thread listens on its own sockets.
+ *
+ */
+struct dnsthread_struct {
+    janitor_thread_t thread_id;
+    dnshandler_type* dnshandler;
+    socklist_type* socklist;
+    netio_type* netio;
+    query_type* queries[SOCK_UDP_BATCH];
+    netio_handler_type *tcp_accept_handlers;
+};
+
 struct dnshandler_struct {
     janitor_thread_t thread_id;
     engine_type* engine;
     listener_type* interfaces;
-    socklist_type* socklist;
-    netio_type* netio;
-    query_type* query;
     netio_handler_type xfrhandler;
     unsigned need_to_exit;
-    netio_handler_type *tcp_accept_handlers;
+    size_t num_threads;
+    dnsthread_type* threads;
 };
 
 /**
  * Create dns handler.
- * \param[in] allocator memory allocator
  * \param[in] interfaces list of interfaces
+ * \param[in] num_threads number of threads serving the interfaces
  * \return dnshandler_type* created dns handler
  *
  */
-dnshandler_type* dnshandler_create(listener_type* interfaces);
+dnshandler_type* dnshandler_create(listener_type* interfaces,
+    int num_threads);
 
 /**
  * Start dns handler listener.
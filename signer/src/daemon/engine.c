@@ -30,6 +30,7 @@
  */
 
 #include "config.h"
+#include "adapter/adfile.h"
 #include "cfg.h"
 #include "daemon/engine.h"
 #include "duration.h"
@@ -78,6 +79,7 @@ engine_create(void)
     engine->cmdhandler = NULL;
     engine->dnshandler = NULL;
     engine->xfrhandler = NULL;
+    engine->notifyhandler = NULL;
     engine->taskq = NULL;
     engine->pid = -1;
     engine->uid = -1;
@@ -174,6 +176,39 @@ engine_stop_xfrhandler(engine_type* engine)
 }
 
 
+/**
+ * Start/stop notify nameserver handler.
+ *
+ */
+static void
+engine_start_notifyhandler(engine_type* engine)
+{
+    if (!engine || !engine->notifyhandler) {
+        return;
+    }
+    ods_log_debug("[%s] start notifyhandler", engine_str);
+    engine->notifyhandler->started = 1;
+    janitor_thread_create(&engine->notifyhandler->thread_id, handlerthreadclass, (janitor_runfn_t)notifyhandler_start, engine->notifyhandler);
+}
+static void
+engine_stop_notifyhandler(engine_type* engine)
+{
+    if (!engine || !engine->notifyhandler) {
+        return;
+    }
+    ods_log_debug("[%s] stop notifyhandler", engine_str);
+    pthread_mutex_lock(&engine->notifyhandler->handler_lock);
+    engine->notifyhandler->need_to_exit = 1;
+    pthread_mutex_unlock(&engine->notifyhandler->handler_lock);
+    notifyhandler_signal(engine->notifyhandler);
+    ods_log_debug("[%s] join notifyhandler", engine_str);
+    if (engine->notifyhandler->started) {
+        janitor_thread_join(engine->notifyhandler->thread_id);
+        engine->notifyhandler->started = 0;
+    }
+}
+
+
 /**
  * Drop privileges.
  *
@@ -350,11 +385,16 @@ engine_setup(void)
     if (!engine->cmdhandler) {
         return ODS_STATUS_CMDHANDLER_ERR;
     }
-    engine->dnshandler = dnshandler_create(create_listener(engine->config->interfaces));
-    engine->xfrhandler = xfrhandler_create();
+    engine->dnshandler = dnshandler_create(create_listener(engine->config->interfaces),
+        engine->config->num_listener_threads);
+    engine->xfrhandler = xfrhandler_create(
+        engine->config->num_transfer_connections,
+        engine->config->num_transfer_connections_master);
     if (!engine->xfrhandler) {
         return ODS_STATUS_XFRHANDLER_ERR;
     }
+    engine->notifyhandler =
+        notifyhandler_create(engine->config->notify_command);
     if (engine->dnshandler) {
         if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sockets) == -1) {
             return ODS_STATUS_XFRHANDLER_ERR;
@@ -479,10 +519,16 @@ engine_setup(void)
     sigaction(SIGPIPE, &action, NULL);
     /* create workers/drudgers */
     engine_create_workers(engine);
+    /* large zone files are parsed by as many threads as we sign with */
+    adfile_set_threads(engine->config->num_signer_threads);
+    /* signatures beyond the configured memory go to a store on disk */
+    rrset_store_set_budget(engine->config->signature_memory < 0 ? -1 :
+        engine->config->signature_memory * 1024 * 1024);
     /* start cmd/dns/xfr handlers */
     engine_start_cmdhandler(engine);
     engine_start_dnshandler(engine);
     engine_start_xfrhandler(engine);
+    engine_start_notifyhandler(engine);
     tsig_handler_init();
 
     if (engine->daemonize) {
@@ -764,6 +810,8 @@ engine_recover(engine_type* engine)
             } else {
                 ods_log_debug("[%s] recovered zone %s", engine_str,
                     zone->name);
+                /* serve the signed zone from the backup until the next output */
+                zone_publish(zone);
                 /* recovery done */
                 zone->zl_status = ZONE_ZL_OK;
             }
@@ -879,6 +927,7 @@ engine_start(const char* cfgfile, int cmdline_verbosity, int daemonize, int info
     cmdhandler_stop(engine->cmdhandler);
     engine_stop_xfrhandler(engine);
     engine_stop_dnshandler(engine);
+    engine_stop_notifyhandler(engine);
 
 earlyexit:
     if (engine && engine->config) {
@@ -923,6 +972,7 @@ engine_cleanup(engine_type* engine)
         cmdhandler_cleanup(engine->cmdhandler);
         dnshandler_cleanup(engine->dnshandler);
         xfrhandler_cleanup(engine->xfrhandler);
+        notifyhandler_cleanup(engine->notifyhandler);
         engine_config_cleanup(engine->config);
         pthread_mutex_destroy(&engine->signal_lock);
         pthread_cond_destroy(&engine->signal_cond);
@@ -40,6 +40,7 @@ typedef struct engine_struct engine_type;
 #include "cfg.h"
 #include "cmdhandler.h"
 #include "daemon/dnshandler.h"
+#include "daemon/notifyhandler.h"
 #include "daemon/xfrhandler.h"
 #include "scheduler/worker.h"
 #include "scheduler/schedule.h"
@@ -69,6 +70,7 @@ struct engine_struct {
     zonelist_type* zonelist;
     dnshandler_type* dnshandler;
     xfrhandler_type* xfrhandler;
+    notifyhandler_type* notifyhandler;
     edns_data_type edns;
 };
 
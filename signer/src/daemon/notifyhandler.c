@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Notify nameserver handler.
+ *
+ */
+
+#include "config.h"
+#include "daemon/notifyhandler.h"
+#include "file.h"
+#include "log.h"
+#include "status.h"
+#include "str.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+#include <spawn.h>
+extern char** environ;
+#endif
+
+static const char* notifyh_str = "notifyhandler";
+
+
+/**
+ * Copy command and arguments.
+ *
+ */
+static char**
+notifyhandler_copy_args(char** args)
+{
+    char** copy = NULL;
+    size_t count = 0;
+    size_t i = 0;
+    if (!args) {
+        return NULL;
+    }
+    while (args[count]) {
+        count++;
+    }
+    CHECKALLOC(copy = (char**) calloc(count + 1, sizeof(char*)));
+    for (i = 0; i < count; i++) {
+        CHECKALLOC(copy[i] = strdup(args[i]));
+    }
+    return copy;
+}
+
+
+/**
+ * Free command and arguments.
+ *
+ */
+static void
+notifyhandler_free_args(char** args)
+{
+    size_t i = 0;
+    if (!args) {
+        return;
+    }
+    for (i = 0; args[i]; i++) {
+        free(args[i]);
+    }
+    free(args);
+}
+
+
+/**
+ * Clean up notify job.
+ *
+ */
+static void
+notifyjob_cleanup(notifyjob_type* job)
+{
+    size_t i = 0;
+    if (!job) {
+        return;
+    }
+    for (i = 0; i < job->num_zones; i++) {
+        free(job->zones[i]);
+    }
+    free(job->zones);
+    notifyhandler_free_args(job->args);
+    free(job);
+}
+
+
+/**
+ * Zone name for logging.
+ *
+ */
+static const char*
+notifyjob_name(notifyjob_type* job)
+{
+    return job->num_zones == 1 ? job->zones[0] : "multiple zones";
+}
+
+
+/**
+ * Create notify nameserver handler.
+ *
+ */
+notifyhandler_type*
+notifyhandler_create(const char* command)
+{
+    notifyhandler_type* notifyh = NULL;
+    char* str = NULL;
+    char* token = NULL;
+    char* tmp = NULL;
+    CHECKALLOC(notifyh = (notifyhandler_type*) malloc(sizeof(notifyhandler_type)));
+    notifyh->thread_id = 0;
+    notifyh->batch_args = NULL;
+    notifyh->pending_first = NULL;
+    notifyh->pending_last = NULL;
+    notifyh->running = NULL;
+    notifyh->num_running = 0;
+    notifyh->need_to_exit = 0;
+    notifyh->started = 0;
+    pthread_mutex_init(&notifyh->handler_lock, NULL);
+    pthread_cond_init(&notifyh->handler_cond, NULL);
+    if (command && strstr(command, "%zones")) {
+        /* batch mode: %zones expands to all zones in the invocation */
+        CHECKALLOC(str = strdup(command));
+        ods_str_trim(str, 1);
+        tmp = str;
+        while ((token = strtok(tmp, " "))) {
+            if (*token) {
+                CHECKALLOC(token = strdup(token));
+                ods_str_list_add(&notifyh->batch_args, token);
+            }
+            tmp = NULL;
+        }
+        free(str);
+        ods_log_debug("[%s] notify nameserver in batch mode: %s", notifyh_str,
+            notifyh->batch_args ? notifyh->batch_args[0] : "(null)");
+    }
+    return notifyh;
+}
+
+
+/**
+ * Run a command, with all file descriptors closed and no signals blocked.
+ *
+ */
+static pid_t
+notifyhandler_spawn(char** args)
+{
+    pid_t pid = -1;
+    sigset_t sigset;
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int error = 0;
+
+    sigemptyset(&sigset);
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        return -1;
+    }
+    if (posix_spawnattr_init(&attr) != 0) {
+        posix_spawn_file_actions_destroy(&actions);
+        return -1;
+    }
+    (void) posix_spawn_file_actions_addclosefrom_np(&actions, 0);
+    (void) posix_spawnattr_setsigmask(&attr, &sigset);
+    (void) posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    error = posix_spawnp(&pid, args[0], &actions, &attr, args, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+#else
+    int fd = 0;
+    int fdlimit = 0;
+
+    switch ((pid = fork())) {
+        case -1: /* error */
+            return -1;
+        case 0: /* child */
+            fdlimit = sysconf(_SC_OPEN_MAX);
+            for (fd = 0; fd < fdlimit; fd++) {
+                close(fd);
+            }
+            sigemptyset(&sigset);
+            sigprocmask(SIG_SETMASK, &sigset, NULL);
+            execvp(args[0], args);
+            _exit(1);
+            break;
+        default: /* parent */
+            break;
+    }
+#endif
+    return pid;
+}
+
+
+/**
+ * Start a notify command.
+ *
+ */
+static void
+notifyhandler_run(notifyhandler_type* notifyhandler, notifyjob_type* job)
+{
+    if (!job->args || !job->args[0]) {
+        ods_log_error("[%s] notify nameserver failed for %s: no command",
+            notifyh_str, notifyjob_name(job));
+        notifyjob_cleanup(job);
+        return;
+    }
+    ods_log_verbose("[%s] notify nameserver for %s: %s", notifyh_str,
+        notifyjob_name(job), job->args[0]);
+    job->pid = notifyhandler_spawn(job->args);
+    if (job->pid == -1) {
+        ods_log_error("[%s] notify nameserver failed for %s: unable to "
+            "start %s (%s)", notifyh_str, notifyjob_name(job), job->args[0],
+            strerror(errno));
+        notifyjob_cleanup(job);
+        return;
+    }
+    job->started = time(NULL);
+    job->killed = 0;
+    job->next = notifyhandler->running;
+    notifyhandler->running = job;
+    notifyhandler->num_running++;
+}
+
+
+/**
+ * Is a notify command for this zone running?
+ *
+ */
+static int
+notifyhandler_is_running(notifyhandler_type* notifyhandler, const char* zone)
+{
+    notifyjob_type* job = notifyhandler->running;
+    size_t i = 0;
+    while (job) {
+        for (i = 0; i < job->num_zones; i++) {
+            if (ods_strcmp(job->zones[i], zone) == 0) {
+                return 1;
+            }
+        }
+        job = job->next;
+    }
+    return 0;
+}
+
+
+/**
+ * Combine pending zones into one batch invocation.
+ *
+ */
+static notifyjob_type*
+notifyhandler_batch(notifyhandler_type* notifyhandler)
+{
+    notifyjob_type* batch = NULL;
+    notifyjob_type* job = NULL;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    CHECKALLOC(batch = (notifyjob_type*) calloc(1, sizeof(notifyjob_type)));
+    CHECKALLOC(batch->zones = (char**) calloc(NOTIFYH_MAX_BATCH,
+        sizeof(char*)));
+    while (notifyhandler->pending_first &&
+        batch->num_zones < NOTIFYH_MAX_BATCH) {
+        job = notifyhandler->pending_first;
+        notifyhandler->pending_first = job->next;
+        batch->zones[batch->num_zones++] = job->zones[0];
+        job->num_zones = 0;
+        notifyjob_cleanup(job);
+    }
+    if (!notifyhandler->pending_first) {
+        notifyhandler->pending_last = NULL;
+    }
+    for (count = 0; notifyhandler->batch_args[count]; count++) {
+        ;
+    }
+    CHECKALLOC(batch->args = (char**) calloc(count + batch->num_zones + 1,
+        sizeof(char*)));
+    for (i = 0; i < count; i++) {
+        if (ods_strcmp(notifyhandler->batch_args[i], "%zones") == 0) {
+            for (k = 0; k < batch->num_zones; k++) {
+                CHECKALLOC(batch->args[j++] = strdup(batch->zones[k]));
+            }
+        } else {
+            CHECKALLOC(batch->args[j++] = strdup(notifyhandler->batch_args[i]));
+        }
+    }
+    return batch;
+}
+
+
+/**
+ * Start pending notify commands, within the concurrency limit.
+ *
+ */
+static void
+notifyhandler_launch(notifyhandler_type* notifyhandler)
+{
+    notifyjob_type* job = NULL;
+    notifyjob_type* prev = NULL;
+    notifyjob_type* next = NULL;
+
+    if (notifyhandler->batch_args) {
+        /* one invocation at a time, with everything that is pending */
+        if (!notifyhandler->running && notifyhandler->pending_first) {
+            notifyhandler_run(notifyhandler,
+                notifyhandler_batch(notifyhandler));
+        }
+        return;
+    }
+    job = notifyhandler->pending_first;
+    while (job && notifyhandler->num_running < NOTIFYH_MAX_RUNNING) {
+        next = job->next;
+        /* wait for the previous notify for this zone to finish */
+        if (notifyhandler_is_running(notifyhandler, job->zones[0])) {
+            prev = job;
+            job = next;
+            continue;
+        }
+        if (prev) {
+            prev->next = next;
+        } else {
+            notifyhandler->pending_first = next;
+        }
+        if (notifyhandler->pending_last == job) {
+            notifyhandler->pending_last = prev;
+        }
+        job->next = NULL;
+        notifyhandler_run(notifyhandler, job);
+        job = next;
+    }
+}
+
+
+/**
+ * Collect finished notify commands, kill the ones that take too long.
+ *
+ */
+static void
+notifyhandler_reap(notifyhandler_type* notifyhandler)
+{
+    notifyjob_type** p = &notifyhandler->running;
+    notifyjob_type* job = NULL;
+    time_t now = time(NULL);
+    pid_t wpid = 0;
+    int pid_status = 0;
+
+    while (*p) {
+        job = *p;
+        wpid = waitpid(job->pid, &pid_status, WNOHANG);
+        if (wpid == 0 || (wpid == -1 && errno == EINTR)) {
+            /* still running */
+            if (now - job->started >=
+                (job->killed ? NOTIFYH_GRACE : NOTIFYH_TIMEOUT)) {
+                ods_log_warning("[%s] notify nameserver for %s timed out, "
+                    "sending %s to pid %lu", notifyh_str, notifyjob_name(job),
+                    job->killed ? "SIGKILL" : "SIGTERM",
+                    (unsigned long) job->pid);
+                (void) kill(job->pid, job->killed ? SIGKILL : SIGTERM);
+                job->killed = 1;
+                job->started = now;
+            }
+            p = &job->next;
+            continue;
+        }
+        if (wpid == -1) {
+            ods_log_error("[%s] notify nameserver failed for %s: waitpid() "
+                "failed (%s)", notifyh_str, notifyjob_name(job),
+                strerror(errno));
+        } else if (!WIFEXITED(pid_status)) {
+            ods_log_error("[%s] notify nameserver failed for %s: notify "
+                "command did not terminate normally", notifyh_str,
+                notifyjob_name(job));
+        } else if (WEXITSTATUS(pid_status) != 0) {
+            ods_log_error("[%s] notify nameserver failed for %s: notify "
+                "command exited with status %d", notifyh_str,
+                notifyjob_name(job), WEXITSTATUS(pid_status));
+        } else {
+            ods_log_verbose("[%s] notify nameserver ok for %s", notifyh_str,
+                notifyjob_name(job));
+        }
+        *p = job->next;
+        notifyhandler->num_running--;
+        notifyjob_cleanup(job);
+    }
+}
+
+
+/**
+ * Start notify nameserver handler.
+ *
+ */
+void
+notifyhandler_start(notifyhandler_type* notifyhandler)
+{
+    notifyjob_type* job = NULL;
+    ods_log_assert(notifyhandler);
+    ods_log_debug("[%s] start", notifyh_str);
+    pthread_mutex_lock(&notifyhandler->handler_lock);
+    while (!notifyhandler->need_to_exit || notifyhandler->running) {
+        notifyhandler_reap(notifyhandler);
+        if (!notifyhandler->need_to_exit) {
+            notifyhandler_launch(notifyhandler);
+        }
+        if (notifyhandler->running) {
+            /* poll for children */
+            ods_thread_wait(&notifyhandler->handler_cond,
+                &notifyhandler->handler_lock, 1);
+        } else if (!notifyhandler->need_to_exit) {
+            ods_thread_wait(&notifyhandler->handler_cond,
+                &notifyhandler->handler_lock, 0);
+        }
+    }
+    while ((job = notifyhandler->pending_first)) {
+        ods_log_warning("[%s] drop notify nameserver for %s: shutting down",
+            notifyh_str, notifyjob_name(job));
+        notifyhandler->pending_first = job->next;
+        notifyjob_cleanup(job);
+    }
+    notifyhandler->pending_last = NULL;
+    pthread_mutex_unlock(&notifyhandler->handler_lock);
+    ods_log_debug("[%s] shutdown", notifyh_str);
+}
+
+
+/**
+ * Queue notify command for zone.
+ *
+ */
+void
+notifyhandler_queue(notifyhandler_type* notifyhandler, const char* zone,
+    char** args)
+{
+    notifyjob_type* job = NULL;
+    if (!notifyhandler || !zone) {
+        return;
+    }
+    pthread_mutex_lock(&notifyhandler->handler_lock);
+    for (job = notifyhandler->pending_first; job; job = job->next) {
+        if (ods_strcmp(job->zones[0], zone) == 0) {
+            ods_log_debug("[%s] notify nameserver for zone %s already "
+                "pending", notifyh_str, zone);
+            pthread_mutex_unlock(&notifyhandler->handler_lock);
+            return;
+        }
+    }
+    CHECKALLOC(job = (notifyjob_type*) calloc(1, sizeof(notifyjob_type)));
+    CHECKALLOC(job->zones = (char**) calloc(1, sizeof(char*)));
+    CHECKALLOC(job->zones[0] = strdup(zone));
+    job->num_zones = 1;
+    job->pid = -1;
+    if (!notifyhandler->batch_args) {
+        job->args = notifyhandler_copy_args(args);
+    }
+    if (notifyhandler->pending_last) {
+        notifyhandler->pending_last->next = job;
+    } else {
+        notifyhandler->pending_first = job;
+    }
+    notifyhandler->pending_last = job;
+    pthread_cond_signal(&notifyhandler->handler_cond);
+    pthread_mutex_unlock(&notifyhandler->handler_lock);
+}
+
+
+/**
+ * Signal notify nameserver handler.
+ *
+ */
+void
+notifyhandler_signal(notifyhandler_type* notifyhandler)
+{
+    if (!notifyhandler) {
+        return;
+    }
+    pthread_mutex_lock(&notifyhandler->handler_lock);
+    pthread_cond_signal(&notifyhandler->handler_cond);
+    pthread_mutex_unlock(&notifyhandler->handler_lock);
+}
+
+
+/**
+ * Cleanup notify nameserver handler.
+ *
+ */
+void
+notifyhandler_cleanup(notifyhandler_type* notifyhandler)
+{
+    notifyjob_type* job = NULL;
+    if (!notifyhandler) {
+        return;
+    }
+    while ((job = notifyhandler->pending_first)) {
+        notifyhandler->pending_first = job->next;
+        notifyjob_cleanup(job);
+    }
+    while ((job = notifyhandler->running)) {
+        notifyhandler->running = job->next;
+        notifyjob_cleanup(job);
+    }
+    notifyhandler_free_args(notifyhandler->batch_args);
+    pthread_mutex_destroy(&notifyhandler->handler_lock);
+    pthread_cond_destroy(&notifyhandler->handler_cond);
+    free(notifyhandler);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2009 NLNet Labs. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/**
+ * Notify nameserver handler.
+ *
+ */
+
+#ifndef DAEMON_NOTIFYHANDLER_H
+#define DAEMON_NOTIFYHANDLER_H
+
+#include "config.h"
+#include <sys/types.h>
+#include <time.h>
+
+#include "locks.h"
+
+#define NOTIFYH_MAX_RUNNING 4 /* max number of notify commands at a time */
+#define NOTIFYH_MAX_BATCH 64 /* max number of zones per batch invocation */
+#define NOTIFYH_TIMEOUT 300 /* seconds, before a notify command is killed */
+#define NOTIFYH_GRACE 10 /* seconds, after SIGTERM before SIGKILL */
+
+typedef struct notifyjob_struct notifyjob_type;
+typedef struct notifyhandler_struct notifyhandler_type;
+
+/**
+ * Notify command, queued or running.
+ *
+ */
+struct notifyjob_struct {
+    notifyjob_type* next;
+    char** zones; /* zone names */
+    size_t num_zones;
+    char** args; /* command and arguments */
+    pid_t pid;
+    time_t started;
+    unsigned killed : 1;
+};
+
+/**
+ * Notify nameserver handler. Runs the notify commands of zones that
+ * have been written, without blocking the workers. Notifies for a zone
+ * that is already queued are coalesced. If the notify command contains
+ * %zones, pending zones are passed to a single invocation.
+ *
+ */
+struct notifyhandler_struct {
+    janitor_thread_t thread_id;
+    pthread_mutex_t handler_lock;
+    pthread_cond_t handler_cond;
+    char** batch_args; /* command template in batch mode */
+    notifyjob_type* pending_first;
+    notifyjob_type* pending_last;
+    notifyjob_type* running;
+    size_t num_running;
+    unsigned need_to_exit : 1;
+    unsigned started : 1;
+};
+
+/**
+ * Create notify nameserver handler.
+ * \param[in] command configured notify command
+ * \return notifyhandler_type* created notify nameserver handler
+ *
+ */
+notifyhandler_type* notifyhandler_create(const char* command);
+
+/**
+ * Start notify nameserver handler.
+ * \param[in] notifyhandler notify nameserver handler
+ *
+ */
+void notifyhandler_start(notifyhandler_type* notifyhandler);
+
+/**
+ * Queue notify command for zone.
+ * \param[in] notifyhandler notify nameserver handler
+ * \param[in] zone zone name
+ * \param[in] args notify command and arguments for this zone
+ *
+ */
+void notifyhandler_queue(notifyhandler_type* notifyhandler, const char* zone,
+    char** args);
+
+/**
+ * Signal notify nameserver handler.
+ * \param[in] notifyhandler notify nameserver handler
+ *
+ */
+void notifyhandler_signal(notifyhandler_type* notifyhandler);
+
+/**
+ * Cleanup notify nameserver handler.
+ * \param[in] notifyhandler notify nameserver handler
+ *
+ */
+void notifyhandler_cleanup(notifyhandler_type* notifyhandler);
+
+#endif /* DAEMON_NOTIFYHANDLER_H */
@@ -438,6 +438,29 @@ cmdhandler_handle_cmd_clear(int sockfd, cmdhandler_ctx_type* context, char *cmd)
 }
 
 
+/**
+ * Print outstanding notifies.
+ *
+ */
+static void
+cmdhandler_print_notify(int sockfd, engine_type* engine)
+{
+    xfrhandler_type* xfrhandler = engine->xfrhandler;
+    char buf[ODS_SE_MAXLINE];
+    if (!xfrhandler) {
+        return;
+    }
+    pthread_mutex_lock(&xfrhandler->notify_lock);
+    (void)snprintf(buf, ODS_SE_MAXLINE, "Notify: %lu pending, %lu "
+        "acknowledged, %lu timed out.\n",
+        (unsigned long) xfrhandler->notify_pending,
+        (unsigned long) xfrhandler->notify_acked,
+        (unsigned long) xfrhandler->notify_timedout);
+    pthread_mutex_unlock(&xfrhandler->notify_lock);
+    client_printf(sockfd, buf);
+}
+
+
 /**
  * Handle the 'queue' command.
  *
@@ -458,6 +481,7 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_ctx_type* context, char *cmd)
     if (!engine->taskq || !engine->taskq->tasks) {
         (void)snprintf(buf, ODS_SE_MAXLINE, "There are no tasks scheduled.\n");
         client_printf(sockfd, buf);
+        cmdhandler_print_notify(sockfd, engine);
         return 0;
     }
     /* current time */
@@ -485,6 +509,7 @@ cmdhandler_handle_cmd_queue(int sockfd, cmdhandler_ctx_type* context, char *cmd)
         node = ldns_rbtree_next(node);
     }
     pthread_mutex_unlock(&engine->taskq->schedule_lock);
+    cmdhandler_print_notify(sockfd, engine);
     return 0;
 }
 
@@ -622,18 +647,18 @@ cmdhandler_handle_cmd_unknown(int sockfd, cmdhandler_ctx_type* context, char* st
 }
 
 
-struct cmd_func_block helpCmdDef = { "help", NULL, NULL, NULL, &cmdhandler_handle_cmd_help };
-struct cmd_func_block zonesCmdDef = { "zones", NULL, NULL, NULL, &cmdhandler_handle_cmd_zones };
+struct cmd_func_block helpCmdDef = { "help", NULL, NULL, NULL, &cmdhandler_handle_cmd_help, 1 };
+struct cmd_func_block zonesCmdDef = { "zones", NULL, NULL, NULL, &cmdhandler_handle_cmd_zones, 1 };
 struct cmd_func_block signCmdDef = { "sign", NULL, NULL, NULL, &cmdhandler_handle_cmd_sign };
 struct cmd_func_block clearCmdDef = { "clear", NULL, NULL, NULL, &cmdhandler_handle_cmd_clear };
-struct cmd_func_block queueCmdDef = { "queue", NULL, NULL, NULL, &cmdhandler_handle_cmd_queue };
+struct cmd_func_block queueCmdDef = { "queue", NULL, NULL, NULL, &cmdhandler_handle_cmd_queue, 1 };
 struct cmd_func_block flushCmdDef = { "flush", NULL, NULL, NULL, &cmdhandler_handle_cmd_flush };
 struct cmd_func_block updateCmdDef = { "update", NULL, NULL, NULL, &cmdhandler_handle_cmd_update };
 struct cmd_func_block stopCmdDef = { "stop", NULL, NULL, NULL, &cmdhandler_handle_cmd_stop };
 struct cmd_func_block startCmdDef = { "start", NULL, NULL, NULL, &cmdhandler_handle_cmd_start };
 struct cmd_func_block reloadCmdDef = { "reload", NULL, NULL, NULL, &cmdhandler_handle_cmd_reload };
 struct cmd_func_block retransferCmdDef = { "retransfer", NULL, NULL, NULL, &cmdhandler_handle_cmd_retransfer };
-struct cmd_func_block runningCmdDef = { "running", NULL, NULL, NULL, &cmdhandler_handle_cmd_running };
+struct cmd_func_block runningCmdDef = { "running", NULL, NULL, NULL, &cmdhandler_handle_cmd_running, 1 };
 struct cmd_func_block verbosityCmdDef = { "verbosity", NULL, NULL, NULL, &cmdhandler_handle_cmd_verbosity };
 
 struct cmd_func_block* signcommands[] = {
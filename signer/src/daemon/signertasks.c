@@ -212,7 +212,7 @@ do_readsignconf(task_type* task, const char* zonename, void* zonearg, void *cont
     engine_type* engine = context->engine;
     zone_type* zone = zonearg;
     ods_status status;
-    status = tools_signconf(zone);
+    status = tools_signconf(zone, engine);
     if (status == ODS_STATUS_UNCHANGED && !zone->signconf->last_modified) {
         ods_log_debug("No signconf.xml for zone %s yet", task->owner);
         status = ODS_STATUS_ERR;
@@ -243,7 +243,7 @@ do_forcereadsignconf(task_type* task, const char* zonename, void* zonearg, void
     zone_type* zone = zonearg;
     ods_status status;
     /* perform 'load signconf' task */
-    status = tools_signconf(zone);
+    status = tools_signconf(zone, engine);
     if (status == ODS_STATUS_UNCHANGED) {
         schedule_unscheduletask(engine->taskq, TASK_SIGNCONF, zone->name);
         if(!zone->zoneconfigvalid) {
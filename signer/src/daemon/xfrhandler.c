@@ -49,7 +49,7 @@ static void xfrhandler_handle_dns(netio_type* netio,
  *
  */
 xfrhandler_type*
-xfrhandler_create()
+xfrhandler_create(int num_tcp, int num_tcp_master)
 {
     xfrhandler_type* xfrh = NULL;
     CHECKALLOC(xfrh = (xfrhandler_type*) malloc(sizeof(xfrhandler_type)));
@@ -67,19 +67,33 @@ xfrhandler_create()
     xfrh->need_to_exit = 0;
     xfrh->started = 0;
     /* notify */
-    xfrh->notify_waiting_first = NULL;
-    xfrh->notify_waiting_last = NULL;
-    xfrh->notify_udp_num = 0;
+    CHECKALLOC(xfrh->notify_ids = (notify_target_type**) calloc(65536,
+        sizeof(notify_target_type*)));
+    xfrh->notify_rates = NULL;
+    xfrh->notify_pending = 0;
+    xfrh->notify_acked = 0;
+    xfrh->notify_timedout = 0;
+    pthread_mutex_init(&xfrh->notify_lock, NULL);
+    xfrh->notify4.fd = -1;
+    xfrh->notify4.user_data = (void*) xfrh;
+    xfrh->notify4.timeout = NULL;
+    xfrh->notify4.event_types = NETIO_EVENT_READ;
+    xfrh->notify4.event_handler = notify_handle_udp;
+    xfrh->notify4.free_handler = 0;
+    xfrh->notify4.list = NULL;
+    xfrh->notify6 = xfrh->notify4;
     /* setup */
     xfrh->netio = netio_create();
     xfrh->packet = buffer_create(PACKET_BUFFER_SIZE);
-    xfrh->tcp_set = tcp_set_create();
+    xfrh->tcp_set = tcp_set_create(xfrh->netio, num_tcp > 0 ? num_tcp : 0,
+        num_tcp_master > 0 ? num_tcp_master : 0);
     xfrh->dnshandler.fd = -1;
     xfrh->dnshandler.user_data = (void*) xfrh;
     xfrh->dnshandler.timeout = 0;
     xfrh->dnshandler.event_types = NETIO_EVENT_READ;
     xfrh->dnshandler.event_handler = xfrhandler_handle_dns;
     xfrh->dnshandler.free_handler = 0;
+    xfrh->dnshandler.list = NULL;
     return xfrh;
 }
 
@@ -98,6 +112,8 @@ xfrhandler_start(xfrhandler_type* xfrhandler)
     xfrhandler->start_time = time_now();
     /* handlers */
     netio_add_handler(xfrhandler->netio, &xfrhandler->dnshandler);
+    netio_add_handler(xfrhandler->netio, &xfrhandler->notify4);
+    netio_add_handler(xfrhandler->netio, &xfrhandler->notify6);
     /* service */
     while (xfrhandler->need_to_exit == 0) {
         /* dispatch may block for a longer period, so current is gone */
@@ -185,5 +201,7 @@ xfrhandler_cleanup(xfrhandler_type* xfrhandler)
     netio_cleanup_shallow(xfrhandler->netio);
     buffer_cleanup(xfrhandler->packet);
     tcp_set_cleanup(xfrhandler->tcp_set);
+    notify_cleanup_shared(xfrhandler);
+    pthread_mutex_destroy(&xfrhandler->notify_lock);
     free(xfrhandler);
 }
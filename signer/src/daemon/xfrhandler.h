@@ -64,9 +64,16 @@ struct xfrhandler_struct {
     xfrd_type* udp_waiting_first;
     xfrd_type* udp_waiting_last;
     size_t udp_use_num;
-    notify_type* notify_waiting_first;
-    notify_type* notify_waiting_last;
-    int notify_udp_num;
+    /* Notify sockets, shared by all zones */
+    netio_handler_type notify4;
+    netio_handler_type notify6;
+    /* Notifies waiting for a reply, by query id */
+    notify_target_type** notify_ids;
+    ldns_rbtree_t* notify_rates;
+    pthread_mutex_t notify_lock;
+    size_t notify_pending;
+    size_t notify_acked;
+    size_t notify_timedout;
     netio_handler_type dnshandler;
     unsigned got_time : 1;
     unsigned need_to_exit : 1;
@@ -75,11 +82,13 @@ struct xfrhandler_struct {
 
 /**
  * Create zone transfer handler.
- * \param[in] allocator memory allocator
+ * \param[in] num_tcp max number of tcp connections
+ * \param[in] num_tcp_master max number of tcp connections in use to one
+ *            master, 0 for no limit
  * \return xfrhandler_type* created zoned transfer handler
  *
  */
-xfrhandler_type* xfrhandler_create(void);
+xfrhandler_type* xfrhandler_create(int num_tcp, int num_tcp_master);
 
 /**
  * Start zone transfer handler.
@@ -29,525 +29,278 @@
  *
  */
 
-#include "confparser.h"
 #include "parser/signconfparser.h"
 #include "duration.h"
 #include "log.h"
 
-#include <libxml/parser.h>
-#include <libxml/xpath.h>
-#include <libxml/xpathInternals.h>
 #include <libxml/xmlreader.h>
 #include <stdlib.h>
+#include <string.h>
 
 static const char* parser_str = "parser";
 
+/* Maximum depth of the elements parse_sc() looks at */
+#define PARSE_SC_DEPTH 8
+/* Path of the element with the zone settings */
+#define PARSE_SC_ZONE "/SignerConfiguration/Zone"
 
-/**
- * Parse keys from the signer configuration file.
- *
- */
-keylist_type*
-parse_sc_keys(void* sc, const char* cfgfile)
-{
-    xmlDocPtr doc = NULL;
-    xmlXPathContextPtr xpathCtx = NULL;
-    xmlXPathObjectPtr xpathObj = NULL;
-    xmlNode* curNode = NULL;
-    xmlChar* xexpr = NULL;
-    key_type* new_key = NULL;
-    keylist_type* kl = NULL;
-    char* resourcerecord;
+/* <Key> element being read */
+typedef struct parse_sc_key_struct parse_sc_key_type;
+struct parse_sc_key_struct {
+    int open;
     char* locator;
+    char* resourcerecord;
     char* flags;
     char* algorithm;
-    int configerr;
-    int ksk, zsk, publish, i;
-
-    if (!cfgfile || !sc) {
-        return NULL;
-    }
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlParseFile() failed", parser_str);
-        return NULL;
-    }
-    /* Create xpath evaluation context */
-    xpathCtx = xmlXPathNewContext(doc);
-    if(xpathCtx == NULL) {
-        xmlFreeDoc(doc);
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlXPathNewContext() failed", parser_str);
-        return NULL;
-    }
-    /* Evaluate xpath expression */
-    xexpr = (xmlChar*) "//SignerConfiguration/Zone/Keys/Key";
-    xpathObj = xmlXPathEvalExpression(xexpr, xpathCtx);
-    if(xpathObj == NULL) {
-        xmlXPathFreeContext(xpathCtx);
-        xmlFreeDoc(doc);
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlXPathEvalExpression() failed", parser_str);
-        return NULL;
-    }
-    /* Parse keys */
-    kl = keylist_create(sc);
-    ods_log_assert(kl);
-    if (xpathObj->nodesetval && xpathObj->nodesetval->nodeNr > 0) {
-        for (i = 0; i < xpathObj->nodesetval->nodeNr; i++) {
-            resourcerecord = NULL;
-            locator = NULL;
-            flags = NULL;
-            algorithm = NULL;
-            ksk = 0;
-            zsk = 0;
-            publish = 0;
-            configerr = 0;
-
-            curNode = xpathObj->nodesetval->nodeTab[i]->xmlChildrenNode;
-            while (curNode) {
-                if (xmlStrEqual(curNode->name, (const xmlChar *)"Locator")) {
-                    locator = (char *) xmlNodeGetContent(curNode);
-                } else if (xmlStrEqual(curNode->name, (const xmlChar *)"Algorithm")) {
-                    algorithm = (char *) xmlNodeGetContent(curNode);
-                } else if (xmlStrEqual(curNode->name, (const xmlChar *)"Flags")) {
-                    flags = (char *) xmlNodeGetContent(curNode);
-                } else if (xmlStrEqual(curNode->name, (const xmlChar *)"KSK")) {
-                    ksk = 1;
-                } else if (xmlStrEqual(curNode->name, (const xmlChar *)"ZSK")) {
-                    zsk = 1;
-                } else if (xmlStrEqual(curNode->name, (const xmlChar *)"Publish")) {
-                    publish = 1;
-                } else if (xmlStrEqual(curNode->name, (const xmlChar *)"ResourceRecord")) {
-                    resourcerecord = (char *) xmlNodeGetContent(curNode);
-                }
-                curNode = curNode->next;
-            }
-            if (!algorithm)
-                configerr = 1;
-            if (!flags)
-                configerr = 1;
-            if (!locator && !resourcerecord)
-                configerr = 1;
-            if (!configerr) {
-                /* search for duplicates */
-                new_key = keylist_lookup_by_locator(kl, locator);
-                if (new_key &&
-                    new_key->algorithm == (uint8_t) atoi(algorithm) &&
-                    new_key->flags == (uint32_t) atoi(flags) &&
-                    new_key->publish == publish &&
-                    new_key->ksk == ksk &&
-                    new_key->zsk == zsk) {
-                    /* duplicate */
-                    ods_log_warning("[%s] unable to push duplicate key %s "
-                        "to keylist, skipping", parser_str, locator);
-                } else {
-                    (void) keylist_push(kl, locator, resourcerecord,
-                        (uint8_t) atoi(algorithm), (uint32_t) atoi(flags),
-                        publish, ksk, zsk);
-                }
-            } else {
-                ods_log_error("[%s] unable to push key to keylist: <Key> "
-                    "is missing required elements, skipping",
-                    parser_str);
-            }
-            free((void*)algorithm);
-            free((void*)flags);
-        }
-    }
-    xmlXPathFreeObject(xpathObj);
-    xmlXPathFreeContext(xpathCtx);
-    if (doc) {
-        xmlFreeDoc(doc);
-    }
-    return kl;
-}
+    int ksk;
+    int zsk;
+    int publish;
+};
 
 
 /**
- * Parse elements from the configuration file.
+ * Push the <Key> element read so far to the key list.
  *
  */
-duration_type*
-parse_sc_sig_resign_interval(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/Resign",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_sig_refresh_interval(const char* cfgfile)
+static void
+parse_sc_key_push(keylist_type* kl, parse_sc_key_type* key)
 {
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/Refresh",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_sig_validity_default(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/Validity/Default",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_sig_validity_denial(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/Validity/Denial",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_sig_validity_keyset(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/Validity/Keyset",
-        0);
-    /* Even if the value is 0 or NULL we want to write it in duration format. 
-       The value is written in backup file and read during startup*/
-    /*if (!str || *str == 0 || *str == '0') {
-        return NULL;
-    }*/
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_sig_jitter(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/Jitter",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_sig_inception_offset(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/InceptionOffset",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-duration_type*
-parse_sc_dnskey_ttl(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Keys/TTL",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
-
-
-const char**
-parse_sc_dnskey_sigrrs(const char* cfgfile)
-{
-    xmlDocPtr doc = NULL;
-    xmlXPathContextPtr xpathCtx = NULL;
-    xmlXPathObjectPtr xpathObj = NULL;
-    xmlNode* curNode = NULL;
-    xmlChar* xexpr = NULL;
-    const char **signatureresourcerecords;
-    int i;
+    key_type* new_key = NULL;
 
-    if (!cfgfile) {
-        return NULL;
-    }
-    /* Load XML document */
-    doc = xmlParseFile(cfgfile);
-    if (doc == NULL) {
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlParseFile() failed", parser_str);
-        return NULL;
-    }
-    /* Create xpath evaluation context */
-    xpathCtx = xmlXPathNewContext(doc);
-    if(xpathCtx == NULL) {
-        xmlFreeDoc(doc);
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlXPathNewContext() failed", parser_str);
-        return NULL;
+    if (!key->open) {
+        return;
     }
-    /* Evaluate xpath expression */
-    xexpr = (xmlChar*) "//SignerConfiguration/Zone/Keys/SignatureResourceRecord";
-    xpathObj = xmlXPathEvalExpression(xexpr, xpathCtx);
-    if(xpathObj == NULL) {
-        xmlXPathFreeContext(xpathCtx);
-        xmlFreeDoc(doc);
-        ods_log_error("[%s] unable to parse <Keys>: "
-            "xmlXPathEvalExpression() failed", parser_str);
-        return NULL;
-    }
-    /* Parse keys */
-    if (xpathObj->nodesetval && xpathObj->nodesetval->nodeNr > 0) {
-        signatureresourcerecords = malloc(sizeof(char*) * (xpathObj->nodesetval->nodeNr + 1));
-        for (i = 0; i < xpathObj->nodesetval->nodeNr; i++) {
-            curNode = xpathObj->nodesetval->nodeTab[i];
-            signatureresourcerecords[i] = (char *) xmlNodeGetContent(curNode);
-        }
-        signatureresourcerecords[i] = NULL;
+    if (!key->algorithm || !key->flags ||
+        (!key->locator && !key->resourcerecord)) {
+        ods_log_error("[%s] unable to push key to keylist: <Key> "
+            "is missing required elements, skipping", parser_str);
+        free(key->locator);
+        free(key->resourcerecord);
     } else {
-        signatureresourcerecords = NULL;
-    }
-    xmlXPathFreeObject(xpathObj);
-    xmlXPathFreeContext(xpathCtx);
-    if (doc) {
-        xmlFreeDoc(doc);
-    }
-    return signatureresourcerecords;
-}
-
-
-
-duration_type*
-parse_sc_nsec3param_ttl(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/TTL",
-        0);
-    if (!str) {
-        return NULL;
+        /* search for duplicates */
+        new_key = keylist_lookup_by_locator(kl, key->locator);
+        if (new_key &&
+            new_key->algorithm == (uint8_t) atoi(key->algorithm) &&
+            new_key->flags == (uint32_t) atoi(key->flags) &&
+            new_key->publish == key->publish &&
+            new_key->ksk == key->ksk &&
+            new_key->zsk == key->zsk) {
+            /* duplicate */
+            ods_log_warning("[%s] unable to push duplicate key %s "
+                "to keylist, skipping", parser_str, key->locator);
+            free(key->locator);
+            free(key->resourcerecord);
+        } else {
+            (void) keylist_push(kl, key->locator, key->resourcerecord,
+                (uint8_t) atoi(key->algorithm), (uint32_t) atoi(key->flags),
+                key->publish, key->ksk, key->zsk);
+        }
     }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
+    free(key->algorithm);
+    free(key->flags);
+    memset(key, 0, sizeof(*key));
 }
 
 
-duration_type*
-parse_sc_soa_ttl(const char* cfgfile)
+/**
+ * Get the text content of the current element.
+ *
+ */
+static char*
+parse_sc_text(xmlTextReaderPtr reader)
 {
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/SOA/TTL",
-        1);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
-}
+    xmlNodePtr node = xmlTextReaderExpand(reader);
 
-
-duration_type*
-parse_sc_soa_min(const char* cfgfile)
-{
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/SOA/Minimum",
-        1);
-    if (!str) {
+    if (!node) {
         return NULL;
     }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
+    return (char*) xmlNodeGetContent(node);
 }
 
 
-duration_type*
-parse_sc_max_zone_ttl(const char* cfgfile)
+/**
+ * Replace a string with the content of the current element.
+ *
+ */
+static void
+parse_sc_string(xmlTextReaderPtr reader, const char** str)
 {
-    duration_type* duration = NULL;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Signatures/MaxZoneTTL",
-        0);
-    if (!str) {
-        return NULL;
-    }
-    duration = duration_create_from_string(str);
-    free((void*)str);
-    return duration;
+    free((void*)*str);
+    *str = parse_sc_text(reader);
 }
 
 
 /**
- * Parse elements from the configuration file.
+ * Replace a duration with the content of the current element.
  *
  */
-ldns_rr_type
-parse_sc_nsec_type(const char* cfgfile)
+static void
+parse_sc_duration(xmlTextReaderPtr reader, duration_type** duration)
 {
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3",
-        0);
-    if (str) {
-        free((void*)str);
-        return LDNS_RR_TYPE_NSEC3;
-    }
-    str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC",
-        0);
-    if (str) {
-        free((void*)str);
-        return LDNS_RR_TYPE_NSEC;
-    }
-    return LDNS_RR_TYPE_FIRST;
+    char* str = parse_sc_text(reader);
+
+    duration_cleanup(*duration);
+    *duration = str ? duration_create_from_string(str) : NULL;
+    free(str);
 }
 
 
 /**
- * Parse elements from the configuration file.
+ * Parse an integer from the content of the current element.
  *
  */
-uint32_t
-parse_sc_nsec3_algorithm(const char* cfgfile)
+static uint32_t
+parse_sc_uint32(xmlTextReaderPtr reader)
 {
-    int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Algorithm",
-        1);
-    if (str) {
-        if (strlen(str) > 0) {
-            ret = atoi(str);
-        }
-        free((void*)str);
-    }
-    return ret;
-}
+    uint32_t ret = 0;
+    char* str = parse_sc_text(reader);
 
-
-uint32_t
-parse_sc_nsec3_iterations(const char* cfgfile)
-{
-    int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Iterations",
-        1);
     if (str) {
-        if (strlen(str) > 0) {
-            ret = atoi(str);
-        }
-        free((void*)str);
+        ret = (uint32_t) atoi(str);
+        free(str);
     }
     return ret;
 }
 
 
-int
-parse_sc_nsec3_optout(const char* cfgfile)
+/**
+ * Handle one element of the signer configuration, by its path below
+ * the <Zone> element.
+ *
+ */
+static void
+parse_sc_element(signconf_type* sc, xmlTextReaderPtr reader,
+    const char* path, parse_sc_key_type* key, size_t* sigcount)
 {
-    int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/OptOut",
-        0);
-    if (str) {
-        ret = 1;
-        free((void*)str);
+    if (!strcmp(path, "/Passthrough")) {
+        sc->passthrough = 1;
+    } else if (!strcmp(path, "/Signatures/Resign")) {
+        parse_sc_duration(reader, &sc->sig_resign_interval);
+    } else if (!strcmp(path, "/Signatures/Refresh")) {
+        parse_sc_duration(reader, &sc->sig_refresh_interval);
+    } else if (!strcmp(path, "/Signatures/Validity/Default")) {
+        parse_sc_duration(reader, &sc->sig_validity_default);
+    } else if (!strcmp(path, "/Signatures/Validity/Denial")) {
+        parse_sc_duration(reader, &sc->sig_validity_denial);
+    } else if (!strcmp(path, "/Signatures/Validity/Keyset")) {
+        parse_sc_duration(reader, &sc->sig_validity_keyset);
+    } else if (!strcmp(path, "/Signatures/Jitter")) {
+        parse_sc_duration(reader, &sc->sig_jitter);
+    } else if (!strcmp(path, "/Signatures/InceptionOffset")) {
+        parse_sc_duration(reader, &sc->sig_inception_offset);
+    } else if (!strcmp(path, "/Signatures/MaxZoneTTL")) {
+        parse_sc_duration(reader, &sc->max_zone_ttl);
+    } else if (!strcmp(path, "/Denial/NSEC")) {
+        if (sc->nsec_type != LDNS_RR_TYPE_NSEC3) {
+            sc->nsec_type = LDNS_RR_TYPE_NSEC;
+        }
+    } else if (!strcmp(path, "/Denial/NSEC3")) {
+        sc->nsec_type = LDNS_RR_TYPE_NSEC3;
+    } else if (!strcmp(path, "/Denial/NSEC3/TTL")) {
+        parse_sc_duration(reader, &sc->nsec3param_ttl);
+    } else if (!strcmp(path, "/Denial/NSEC3/OptOut")) {
+        sc->nsec3_optout = 1;
+    } else if (!strcmp(path, "/Denial/NSEC3/Hash/Algorithm")) {
+        sc->nsec3_algo = parse_sc_uint32(reader);
+    } else if (!strcmp(path, "/Denial/NSEC3/Hash/Iterations")) {
+        sc->nsec3_iterations = parse_sc_uint32(reader);
+    } else if (!strcmp(path, "/Denial/NSEC3/Hash/Salt")) {
+        parse_sc_string(reader, &sc->nsec3_salt);
+    } else if (!strcmp(path, "/Keys/TTL")) {
+        parse_sc_duration(reader, &sc->dnskey_ttl);
+    } else if (!strcmp(path, "/Keys/SignatureResourceRecord")) {
+        CHECKALLOC(sc->dnskey_signature = (const char**) realloc(
+            (void*)sc->dnskey_signature, sizeof(char*) * (*sigcount + 2)));
+        sc->dnskey_signature[*sigcount] =
+            parse_sc_text(reader);
+        if (sc->dnskey_signature[*sigcount]) {
+            (*sigcount)++;
+        }
+        sc->dnskey_signature[*sigcount] = NULL;
+    } else if (!strcmp(path, "/Keys/Key")) {
+        parse_sc_key_push(sc->keys, key);
+        key->open = 1;
+    } else if (!strcmp(path, "/Keys/Key/Locator")) {
+        parse_sc_string(reader, (const char**) &key->locator);
+    } else if (!strcmp(path, "/Keys/Key/ResourceRecord")) {
+        parse_sc_string(reader, (const char**) &key->resourcerecord);
+    } else if (!strcmp(path, "/Keys/Key/Flags")) {
+        parse_sc_string(reader, (const char**) &key->flags);
+    } else if (!strcmp(path, "/Keys/Key/Algorithm")) {
+        parse_sc_string(reader, (const char**) &key->algorithm);
+    } else if (!strcmp(path, "/Keys/Key/KSK")) {
+        key->ksk = 1;
+    } else if (!strcmp(path, "/Keys/Key/ZSK")) {
+        key->zsk = 1;
+    } else if (!strcmp(path, "/Keys/Key/Publish")) {
+        key->publish = 1;
+    } else if (!strcmp(path, "/SOA/TTL")) {
+        parse_sc_duration(reader, &sc->soa_ttl);
+    } else if (!strcmp(path, "/SOA/Minimum")) {
+        parse_sc_duration(reader, &sc->soa_min);
+    } else if (!strcmp(path, "/SOA/Serial")) {
+        parse_sc_string(reader, &sc->soa_serial);
     }
-    return ret;
 }
 
-int
-parse_sc_passthrough(const char* cfgfile)
-{
-    int ret = 0;
-    const char* str = parse_conf_string(cfgfile,
-        "//SignerConfiguration/Zone/Passthrough",
-        0);
-    if (str) {
-        ret = 1;
-        free((void*)str);
-    }
-    return ret;
-}
 
 /**
- * Parse elements from the configuration file.
+ * Parse the signer configuration file in a single pass.
  *
  */
-const char*
-parse_sc_soa_serial(const char* cfgfile)
+ods_status
+parse_sc(signconf_type* sc, const char* cfgfile)
 {
-    const char* dup = NULL;
-    const char* str = parse_conf_string(
-        cfgfile,
-        "//SignerConfiguration/Zone/SOA/Serial",
-        1);
-
-    if (str) {
-        dup = strdup(str);
-        free((void*)str);
+    xmlTextReaderPtr reader = NULL;
+    parse_sc_key_type key;
+    char path[256];
+    size_t pathlen[PARSE_SC_DEPTH];
+    size_t sigcount = 0;
+    size_t zonelen = strlen(PARSE_SC_ZONE);
+    const char* name;
+    int depth, ret;
+
+    if (!sc || !cfgfile) {
+        return ODS_STATUS_ASSERT_ERR;
     }
-    return dup;
-}
-
-
-const char*
-parse_sc_nsec3_salt(const char* cfgfile)
-{
-    const char* dup = NULL;
-    const char* str = parse_conf_string(
-        cfgfile,
-        "//SignerConfiguration/Zone/Denial/NSEC3/Hash/Salt",
-        1);
-
-    if (str) {
-        dup = strdup(str);
-        free((void*)str);
+    reader = xmlReaderForFile(cfgfile, NULL, 0);
+    if (!reader) {
+        ods_log_error("[%s] unable to parse signconf %s: "
+            "xmlReaderForFile() failed", parser_str, cfgfile);
+        return ODS_STATUS_XML_ERR;
+    }
+    memset(&key, 0, sizeof(key));
+    sc->keys = keylist_create(sc);
+    ods_log_assert(sc->keys);
+    while ((ret = xmlTextReaderRead(reader)) == 1) {
+        if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+            continue;
+        }
+        depth = xmlTextReaderDepth(reader);
+        name = (const char*) xmlTextReaderConstLocalName(reader);
+        if (depth < 0 || depth >= PARSE_SC_DEPTH || !name) {
+            continue;
+        }
+        pathlen[depth] = depth ? pathlen[depth-1] : 0;
+        ret = snprintf(path + pathlen[depth], sizeof(path) - pathlen[depth],
+            "/%s", name);
+        if (ret < 0 || pathlen[depth] + ret >= sizeof(path)) {
+            /* too long, skip it and the elements below it */
+            pathlen[depth] = sizeof(path) - 1;
+            continue;
+        }
+        pathlen[depth] += ret;
+        if (pathlen[depth] > zonelen &&
+            !strncmp(path, PARSE_SC_ZONE "/", zonelen + 1)) {
+            parse_sc_element(sc, reader, path + zonelen, &key, &sigcount);
+        }
+    }
+    parse_sc_key_push(sc->keys, &key);
+    xmlFreeTextReader(reader);
+    if (ret != 0) {
+        ods_log_error("[%s] unable to parse signconf %s", parser_str,
+            cfgfile);
+        return ODS_STATUS_XML_ERR;
     }
-    return dup;
+    return ODS_STATUS_OK;
 }
@@ -32,7 +32,6 @@
 #ifndef PARSER_SIGNCONFPARSER_H
 #define PARSER_SIGNCONFPARSER_H
 
-#include "confparser.h"
 #include "status.h"
 #include "duration.h"
 #include "signer/keys.h"
@@ -41,73 +40,12 @@
 #include <ldns/ldns.h>
 
 /**
- * Parse keys from the signer configuration file.
- * \param[in] sc signer configuration reference
+ * Parse the signer configuration file in a single pass.
+ * \param[in] sc signer configuration to fill in
  * \param[in] cfgfile the configuration file name.
- * \return keylist_type* key list
+ * \return ods_status status
  *
  */
-keylist_type* parse_sc_keys(void* sc, const char* cfgfile);
-
-/**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
- * \return duration_type* duration
- *
- */
-duration_type* parse_sc_sig_resign_interval(const char* cfgfile);
-duration_type* parse_sc_sig_refresh_interval(const char* cfgfile);
-duration_type* parse_sc_sig_validity_default(const char* cfgfile);
-duration_type* parse_sc_sig_validity_denial(const char* cfgfile);
-duration_type* parse_sc_sig_validity_keyset(const char* cfgfile);
-duration_type* parse_sc_sig_jitter(const char* cfgfile);
-duration_type* parse_sc_sig_inception_offset(const char* cfgfile);
-duration_type* parse_sc_dnskey_ttl(const char* cfgfile);
-const char** parse_sc_dnskey_sigrrs(const char* cfgfile);
-duration_type* parse_sc_nsec3param_ttl(const char* cfgfile);
-duration_type* parse_sc_soa_ttl(const char* cfgfile);
-duration_type* parse_sc_soa_min(const char* cfgfile);
-duration_type* parse_sc_max_zone_ttl(const char* cfgfile);
-
-/**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
- * \return ldns_rr_type rr type
- *
- */
-ldns_rr_type parse_sc_nsec_type(const char* cfgfile);
-
-/**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
- * \return uint32_t integer
- *
- */
-uint32_t parse_sc_nsec3_algorithm(const char* cfgfile);
-uint32_t parse_sc_nsec3_iterations(const char* cfgfile);
-
-/**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
- * \return int integer
- *
- */
-int parse_sc_nsec3_optout(const char* cfgfile);
-
-/**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
- * \return boolean
- */
-int parse_sc_passthrough(const char* cfgfile);
-
-/**
- * Parse elements from the configuration file.
- * \param[in] cfgfile the configuration file name.
- * \return const char* string
- *
- */
-const char* parse_sc_soa_serial(const char* cfgfile);
-const char* parse_sc_nsec3_salt(const char* cfgfile);
+ods_status parse_sc(signconf_type* sc, const char* cfgfile);
 
 #endif /* PARSER_SIGNCONFPARSER_H */
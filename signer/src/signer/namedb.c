@@ -34,6 +34,7 @@
 #include "file.h"
 #include "log.h"
 #include "util.h"
+#include "locks.h"
 #include "signer/backup.h"
 #include "signer/namedb.h"
 #include "signer/zone.h"
@@ -994,9 +995,74 @@ namedb_wipe_denial(namedb_type* db)
  */
 void
 namedb_export(FILE* fd, namedb_type* db, ods_status* status)
+{
+    namedb_export_parallel(fd, db, 1, status);
+}
+
+
+/**
+ * Range of domains formatted by one export thread.
+ *
+ */
+typedef struct namedb_range_struct namedb_range_type;
+struct namedb_range_struct {
+    ldns_rbnode_t* first;
+    size_t count;
+    char* buf;
+    size_t len;
+    ods_status status;
+};
+
+
+/**
+ * Format a range of domains into an in-memory stream.
+ *
+ */
+static void
+namedb_export_range(void* arg)
+{
+    namedb_range_type* range = (namedb_range_type*) arg;
+    ldns_rbnode_t* node = range->first;
+    FILE* fd = NULL;
+    size_t i = 0;
+
+    range->status = ODS_STATUS_OK;
+#ifdef HAVE_OPEN_MEMSTREAM
+    fd = open_memstream(&range->buf, &range->len);
+#endif
+    if (!fd) {
+        range->status = ODS_STATUS_MALLOC_ERR;
+        return;
+    }
+    for (i = 0; i < range->count && node && node != LDNS_RBTREE_NULL; i++) {
+        if (node->data) {
+            domain_print(fd, (domain_type*) node->data, &range->status);
+        }
+        node = ldns_rbtree_next(node);
+    }
+    if (fclose(fd) != 0 && range->status == ODS_STATUS_OK) {
+        range->status = ODS_STATUS_MALLOC_ERR;
+    }
+}
+
+
+/**
+ * Export db to file, formatting domain ranges in parallel.
+ *
+ */
+void
+namedb_export_parallel(FILE* fd, namedb_type* db, int threads,
+    ods_status* status)
 {
     ldns_rbnode_t* node = LDNS_RBTREE_NULL;
     domain_type* domain = NULL;
+    janitor_thread_t* workers = NULL;
+    namedb_range_type* ranges = NULL;
+    ods_status result = ODS_STATUS_OK;
+    size_t i = 0;
+    size_t n = 0;
+    int t = 0;
+
     if (!fd || !db || !db->domains) {
         if (status) {
             ods_log_error("[%s] unable to export namedb: file descriptor "
@@ -1013,6 +1079,56 @@ namedb_export(FILE* fd, namedb_type* db, ods_status* status)
         }
         return;
     }
+#ifdef HAVE_OPEN_MEMSTREAM
+    if (threads > 1 && db->domains->count >= NAMEDB_EXPORT_MINSIZE) {
+        /**
+         * Domains are handed out in rounds of one range per thread, so
+         * that at most threads * NAMEDB_EXPORT_RANGE domains are held
+         * as text at any time. Ranges are written in tree order.
+         */
+        CHECKALLOC(workers = (janitor_thread_t*) calloc(threads,
+            sizeof(janitor_thread_t)));
+        CHECKALLOC(ranges = (namedb_range_type*) calloc(threads,
+            sizeof(namedb_range_type)));
+        while (node && node != LDNS_RBTREE_NULL) {
+            for (t = 0; t < threads && node && node != LDNS_RBTREE_NULL;
+                t++) {
+                ranges[t].first = node;
+                ranges[t].buf = NULL;
+                ranges[t].len = 0;
+                for (n = 0; n < NAMEDB_EXPORT_RANGE &&
+                    node && node != LDNS_RBTREE_NULL; n++) {
+                    node = ldns_rbtree_next(node);
+                }
+                ranges[t].count = n;
+                janitor_thread_create(&workers[t], workerthreadclass,
+                    (janitor_runfn_t)namedb_export_range, &ranges[t]);
+            }
+            for (i = 0; i < (size_t) t; i++) {
+                janitor_thread_join(workers[i]);
+                if (ranges[i].status != ODS_STATUS_OK &&
+                    result == ODS_STATUS_OK) {
+                    result = ranges[i].status;
+                }
+                if (ranges[i].buf && ranges[i].len > 0 &&
+                    fwrite(ranges[i].buf, 1, ranges[i].len, fd) !=
+                    ranges[i].len && result == ODS_STATUS_OK) {
+                    result = ODS_STATUS_FWRITE_ERR;
+                }
+                free(ranges[i].buf);
+                ranges[i].buf = NULL;
+            }
+        }
+        free(ranges);
+        free(workers);
+        if (status) {
+            *status = result;
+        }
+        return;
+    }
+#else
+    (void)threads;
+#endif
     while (node && node != LDNS_RBTREE_NULL) {
         domain = (domain_type*) node->data;
         if (domain) {
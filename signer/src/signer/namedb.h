@@ -35,6 +35,11 @@
 #include "config.h"
 #include <ldns/ldns.h>
 
+/* Zones with at least this many domains are exported with multiple threads */
+#define NAMEDB_EXPORT_MINSIZE 100000
+/* Number of domains that an export thread formats per round */
+#define NAMEDB_EXPORT_RANGE 10000
+
 typedef struct namedb_struct namedb_type;
 
 #include "signer/denial.h"
@@ -196,6 +201,18 @@ void namedb_nsecify(namedb_type* db, uint32_t* num_added);
  */
 void namedb_export(FILE* fd, namedb_type* db, ods_status* status);
 
+/**
+ * Export db to file, formatting ranges of domains in parallel.
+ * The output is identical to namedb_export().
+ * \param[in] fd file descriptor
+ * \param[in] namedb namedb
+ * \param[in] threads number of formatting threads
+ * \param[out] status status
+ *
+ */
+void namedb_export_parallel(FILE* fd, namedb_type* db, int threads,
+    ods_status* status);
+
 /**
  * Wipe out all NSEC(3) RRsets.
  * \param[in] db namedb
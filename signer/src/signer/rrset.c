@@ -214,10 +214,97 @@ rrset_create(zone_type* zone, ldns_rr_type type)
     return rrset;
 }
 
+/**
+ * Write RRSIG to the signature store.
+ *
+ */
+static int
+memberdispose(void* dummy, void* member, FILE* fd)
+{
+    rrsig_type* sig = (rrsig_type*) member;
+    uint8_t* wire = NULL;
+    size_t len = 0;
+    uint32_t hdr[3];
+    (void)dummy;
+    if (ldns_rr2wire(&wire, sig->rr, LDNS_SECTION_ANSWER, &len)
+        != LDNS_STATUS_OK) {
+        return 1;
+    }
+    hdr[0] = sig->key_flags;
+    hdr[1] = sig->key_locator ? strlen(sig->key_locator) + 1 : 0;
+    hdr[2] = (uint32_t) len;
+    if (fwrite(hdr, sizeof(hdr), 1, fd) != 1 ||
+        (hdr[1] && fwrite(sig->key_locator, hdr[1], 1, fd) != 1) ||
+        fwrite(wire, len, 1, fd) != 1) {
+        free(wire);
+        return 1;
+    }
+    free(wire);
+    return 0;
+}
+
+/**
+ * Read RRSIG from the signature store.
+ *
+ */
+static int
+memberrestore(void* dummy, void* member, FILE* fd)
+{
+    rrsig_type* sig = (rrsig_type*) member;
+    uint8_t* wire = NULL;
+    char* locator = NULL;
+    size_t pos = 0;
+    uint32_t hdr[3];
+    (void)dummy;
+    if (fread(hdr, sizeof(hdr), 1, fd) != 1) {
+        return 1;
+    }
+    if (hdr[1]) {
+        CHECKALLOC(locator = (char*) malloc(hdr[1]));
+        if (fread(locator, hdr[1], 1, fd) != 1) {
+            free(locator);
+            return 1;
+        }
+        locator[hdr[1] - 1] = '\0';
+    }
+    CHECKALLOC(wire = (uint8_t*) malloc(hdr[2] ? hdr[2] : 1));
+    if (fread(wire, hdr[2], 1, fd) != 1 ||
+        ldns_wire2rr(&sig->rr, wire, hdr[2], &pos, LDNS_SECTION_ANSWER)
+        != LDNS_STATUS_OK) {
+        free(wire);
+        free(locator);
+        return 1;
+    }
+    free(wire);
+    sig->key_locator = locator;
+    sig->key_flags = hdr[0];
+    return 0;
+}
+
+static long rrset_store_budget = -1;
+
+/**
+ * Set the memory budget for signatures.
+ *
+ */
+void
+rrset_store_set_budget(long budget)
+{
+    rrset_store_budget = budget;
+}
+
 collection_class
-rrset_store_initialize()
+rrset_store_initialize(const char* name)
 {
     collection_class klass;
+    char* fname = NULL;
+    if (rrset_store_budget >= 0 && name &&
+        (fname = ods_build_path(name, ".sigstore", 0, 1))) {
+        collection_class_backed(&klass, fname, (size_t) rrset_store_budget,
+            NULL, memberdestroy, memberdispose, memberrestore);
+        free(fname);
+        return klass;
+    }
     collection_class_allocated(&klass, NULL, memberdestroy);
     return klass;
 }
@@ -786,17 +873,17 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
             ldns_rr_list_free(rr_list_clone);
             return ODS_STATUS_HSM_ERR;
         }
-        /* Add signature */
-        locator = strdup(zone->signconf->keys->keys[i].locator);
-        rrset_add_rrsig(rrset, rrsig, locator,
-            zone->signconf->keys->keys[i].flags);
-        newsigs++;
-        /* ixfr +RRSIG */
+        /* ixfr +RRSIG, before the signature store may swap rrsig out */
         if (zone->db->is_initialized) {
             pthread_mutex_lock(&zone->ixfr->ixfr_lock);
             ixfr_add_rr(zone->ixfr, rrsig);
             pthread_mutex_unlock(&zone->ixfr->ixfr_lock);
         }
+        /* Add signature */
+        locator = strdup(zone->signconf->keys->keys[i].locator);
+        rrset_add_rrsig(rrset, rrsig, locator,
+            zone->signconf->keys->keys[i].flags);
+        newsigs++;
     }
     if(rrset->rrtype == LDNS_RR_TYPE_DNSKEY && zone->signconf->dnskey_signature) {
         for(i=0; zone->signconf->dnskey_signature[i]; i++) {
@@ -807,15 +894,15 @@ rrset_sign(hsm_ctx_t* ctx, rrset_type* rrset, time_t signtime)
                     ldns_rr_list_deep_free(rr_list_clone);
                     return status;
             }
-            /* Add signature */
-            rrset_add_rrsig(rrset, rrsig, NULL, 0);
-            newsigs++;
-            /* ixfr +RRSIG */
+            /* ixfr +RRSIG, before the signature store may swap rrsig out */
             if (zone->db->is_initialized) {
                 pthread_mutex_lock(&zone->ixfr->ixfr_lock);
                 ixfr_add_rr(zone->ixfr, rrsig);
                 pthread_mutex_unlock(&zone->ixfr->ixfr_lock);
             }
+            /* Add signature */
+            rrset_add_rrsig(rrset, rrsig, NULL, 0);
+            newsigs++;
         }
     }
     /* RRset signing completed */
@@ -857,6 +944,7 @@ rrset_print(FILE* fd, rrset_type* rrset, int skip_rrsigs,
 {
     rrsig_type* rrsig;
     uint16_t i = 0;
+    ldns_buffer* buffer = NULL;
     ods_status result = ODS_STATUS_OK;
 
     if (!rrset || !fd) {
@@ -865,10 +953,15 @@ rrset_print(FILE* fd, rrset_type* rrset, int skip_rrsigs,
         if (status) {
             *status = ODS_STATUS_ASSERT_ERR;
         }
+    } else if (!(buffer = ldns_buffer_new(LDNS_MIN_BUFLEN))) {
+        ods_log_crit("[%s] unable to print RRset: malloc failed", rrset_str);
+        if (status) {
+            *status = ODS_STATUS_MALLOC_ERR;
+        }
     } else {
         for (i=0; i < rrset->rr_count; i++) {
             if (rrset->rrs[i].exists) {
-                result = util_rr_print(fd, rrset->rrs[i].rr);
+                result = util_rr_print_buf(fd, buffer, rrset->rrs[i].rr);
                 if (rrset->rrtype == LDNS_RR_TYPE_CNAME ||
                     rrset->rrtype == LDNS_RR_TYPE_DNAME) {
                     /* singleton types */
@@ -887,7 +980,7 @@ rrset_print(FILE* fd, rrset_type* rrset, int skip_rrsigs,
             result = ODS_STATUS_OK;
             while((rrsig = collection_iterator(rrset->rrsigs))) {
                 if (result == ODS_STATUS_OK) {
-                    result = util_rr_print(fd, rrsig->rr);
+                    result = util_rr_print_buf(fd, buffer, rrsig->rr);
                     if (result != ODS_STATUS_OK) {
                         zone_type* zone = rrset->zone;
                         log_rrset(ldns_rr_owner(rrset->rrs[i].rr), rrset->rrtype,
@@ -897,6 +990,7 @@ rrset_print(FILE* fd, rrset_type* rrset, int skip_rrsigs,
                 }
             }
         }
+        ldns_buffer_free(buffer);
         if (status) {
             *status = result;
         }
@@ -217,6 +217,20 @@ void rrset_cleanup(rrset_type* rrset);
  */
 void rrset_backup2(FILE* fd, rrset_type* rrset);
 
-collection_class rrset_store_initialize(void);
+/**
+ * Set the memory budget for signatures of a zone.
+ * \param[in] budget bytes of signatures to keep in memory per zone,
+ *            -1 to keep all signatures in memory
+ *
+ */
+void rrset_store_set_budget(long budget);
+
+/**
+ * Create the signature store for a zone.
+ * \param[in] name zone name
+ * \return collection_class signature store
+ *
+ */
+collection_class rrset_store_initialize(const char* name);
 
 #endif /* SIGNER_RRSET_H */
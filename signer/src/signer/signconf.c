@@ -30,6 +30,7 @@
  */
 
 #include "parser/signconfparser.h"
+#include "confparser.h"
 #include "duration.h"
 #include "file.h"
 #include "log.h"
@@ -38,6 +39,23 @@
 
 static const char* sc_str = "signconf";
 
+/* Elements a signconf written by the enforcer always has */
+static const char* signconf_elements[] = {
+    "/SignerConfiguration/Zone/Signatures/Resign",
+    "/SignerConfiguration/Zone/Signatures/Refresh",
+    "/SignerConfiguration/Zone/Signatures/Validity/Default",
+    "/SignerConfiguration/Zone/Signatures/Validity/Denial",
+    "/SignerConfiguration/Zone/Signatures/Jitter",
+    "/SignerConfiguration/Zone/Signatures/InceptionOffset",
+    "/SignerConfiguration/Zone/Denial/NSEC | "
+        "/SignerConfiguration/Zone/Denial/NSEC3",
+    "/SignerConfiguration/Zone/Keys/TTL",
+    "/SignerConfiguration/Zone/SOA/TTL",
+    "/SignerConfiguration/Zone/SOA/Minimum",
+    "/SignerConfiguration/Zone/SOA/Serial",
+    NULL
+};
+
 
 /**
  * Create a new signer configuration with the 'empty' settings.
@@ -77,6 +95,7 @@ signconf_create(void)
     /* Other useful information */
     sc->max_zone_ttl = NULL;
     sc->last_modified = 0;
+    memset(sc->digest, 0, sizeof(sc->digest));
     return sc;
 }
 
@@ -86,7 +105,7 @@ signconf_create(void)
  *
  */
 static ods_status
-signconf_read(signconf_type* signconf, const char* scfile)
+signconf_read(signconf_type* signconf, const char* scfile, int trusted)
 {
     const char* rngfile = ODS_SE_RNGDIR "/signconf.rng";
     ods_status status = ODS_STATUS_OK;
@@ -96,7 +115,11 @@ signconf_read(signconf_type* signconf, const char* scfile)
         return ODS_STATUS_ASSERT_ERR;
     }
     ods_log_debug("[%s] read signconf file %s", sc_str, scfile);
-    status = parse_file_check(scfile, rngfile);
+    if (trusted) {
+        status = parse_file_check_structure(scfile, signconf_elements);
+    } else {
+        status = parse_file_check(scfile, rngfile);
+    }
     if (status != ODS_STATUS_OK) {
         ods_log_error("[%s] unable to read signconf: parse error in "
             "file %s (%s)", sc_str, scfile, ods_status2str(status));
@@ -105,21 +128,12 @@ signconf_read(signconf_type* signconf, const char* scfile)
     fd = ods_fopen(scfile, NULL, "r");
     if (fd) {
         signconf->filename = strdup(scfile);
-        signconf->passthrough = parse_sc_passthrough(scfile);
-        signconf->sig_resign_interval = parse_sc_sig_resign_interval(scfile);
-        signconf->sig_refresh_interval = parse_sc_sig_refresh_interval(scfile);
-        signconf->sig_validity_default = parse_sc_sig_validity_default(scfile);
-        signconf->sig_validity_denial = parse_sc_sig_validity_denial(scfile);
-        signconf->sig_validity_keyset = parse_sc_sig_validity_keyset(scfile);
-        signconf->sig_jitter = parse_sc_sig_jitter(scfile);
-        signconf->sig_inception_offset = parse_sc_sig_inception_offset(scfile);
-        signconf->nsec_type = parse_sc_nsec_type(scfile);
+        status = parse_sc(signconf, scfile);
+        if (status != ODS_STATUS_OK) {
+            ods_fclose(fd);
+            return status;
+        }
         if (signconf->nsec_type == LDNS_RR_TYPE_NSEC3) {
-            signconf->nsec3param_ttl = parse_sc_nsec3param_ttl(scfile);
-            signconf->nsec3_optout = parse_sc_nsec3_optout(scfile);
-            signconf->nsec3_algo = parse_sc_nsec3_algorithm(scfile);
-            signconf->nsec3_iterations = parse_sc_nsec3_iterations(scfile);
-            signconf->nsec3_salt = parse_sc_nsec3_salt(scfile);
             signconf->nsec3params = nsec3params_create((void*) signconf,
             (uint8_t) signconf->nsec3_algo, (uint8_t) signconf->nsec3_optout,
             (uint16_t)signconf->nsec3_iterations, signconf->nsec3_salt);
@@ -130,13 +144,6 @@ signconf_read(signconf_type* signconf, const char* scfile)
                 return ODS_STATUS_MALLOC_ERR;
             }
         }
-        signconf->keys = parse_sc_keys((void*) signconf, scfile);
-        signconf->dnskey_ttl = parse_sc_dnskey_ttl(scfile);
-        signconf->dnskey_signature = parse_sc_dnskey_sigrrs(scfile);
-        signconf->soa_ttl = parse_sc_soa_ttl(scfile);
-        signconf->soa_min = parse_sc_soa_min(scfile);
-        signconf->soa_serial = parse_sc_soa_serial(scfile);
-        signconf->max_zone_ttl = parse_sc_max_zone_ttl(scfile);
         ods_fclose(fd);
         return ODS_STATUS_OK;
     }
@@ -146,24 +153,72 @@ signconf_read(signconf_type* signconf, const char* scfile)
 }
 
 
+/**
+ * Compute the digest of the signer configuration file content.
+ *
+ */
+static ods_status
+signconf_digest(const char* scfile, unsigned char* digest)
+{
+    ods_status status = ODS_STATUS_OK;
+    FILE* fd = NULL;
+    char* buf = NULL;
+    long len;
+
+    fd = ods_fopen(scfile, NULL, "r");
+    if (!fd) {
+        return ODS_STATUS_FOPEN_ERR;
+    }
+    if (fseek(fd, 0, SEEK_END) != 0 || (len = ftell(fd)) < 0 ||
+        fseek(fd, 0, SEEK_SET) != 0) {
+        ods_fclose(fd);
+        return ODS_STATUS_FSEEK_ERR;
+    }
+    CHECKALLOC(buf = (char*) malloc(len + 1));
+    if (fread(buf, 1, len, fd) != (size_t) len) {
+        status = ODS_STATUS_FREAD_ERR;
+    } else {
+        (void) ldns_sha256((unsigned char*) buf, (unsigned int) len, digest);
+    }
+    free(buf);
+    ods_fclose(fd);
+    return status;
+}
+
+
 /**
  * Update signer configuration.
  *
  */
 ods_status
 signconf_update(signconf_type** signconf, const char* scfile,
-    time_t last_modified)
+    signconf_type* current, int trusted)
 {
     signconf_type* new_sc = NULL;
+    unsigned char digest[LDNS_SHA256_DIGEST_LENGTH];
     time_t st_mtime = 0;
     ods_status status = ODS_STATUS_OK;
 
-    if (!scfile || !signconf) {
+    if (!scfile || !signconf || !current) {
         return ODS_STATUS_UNCHANGED;
     }
     /* is the file updated? */
     st_mtime = ods_file_lastmodified(scfile);
-    if (st_mtime <= last_modified) {
+    if (st_mtime <= current->last_modified) {
+        return ODS_STATUS_UNCHANGED;
+    }
+    /* is the content updated? */
+    status = signconf_digest(scfile, digest);
+    if (status != ODS_STATUS_OK) {
+        ods_log_error("[%s] unable to update signconf: failed to read file "
+            "%s (%s)", sc_str, scfile, ods_status2str(status));
+        return status;
+    }
+    if (current->last_modified &&
+        memcmp(digest, current->digest, sizeof(digest)) == 0) {
+        ods_log_debug("[%s] signconf file %s rewritten without changes",
+            sc_str, scfile);
+        current->last_modified = st_mtime;
         return ODS_STATUS_UNCHANGED;
     }
     /* if so, read the new signer configuration */
@@ -173,9 +228,10 @@ signconf_update(signconf_type** signconf, const char* scfile,
             "failed", sc_str);
         return ODS_STATUS_ERR;
     }
-    status = signconf_read(new_sc, scfile);
+    status = signconf_read(new_sc, scfile, trusted);
     if (status == ODS_STATUS_OK) {
         new_sc->last_modified = st_mtime;
+        memcpy(new_sc->digest, digest, sizeof(digest));
         if (signconf_check(new_sc) != ODS_STATUS_OK) {
             ods_log_error("[%s] unable to update signconf: signconf %s has "
                 "errors", sc_str, scfile);
@@ -70,6 +70,7 @@ struct signconf_struct {
     duration_type* max_zone_ttl;
     const char* filename;
     time_t last_modified;
+    unsigned char digest[LDNS_SHA256_DIGEST_LENGTH]; /* of the file content */
 };
 
 /**
@@ -83,12 +84,14 @@ signconf_type* signconf_create(void);
  * Update signer configuration.
  * \param[out] signconf signer configuration
  * \param[in] scfile signer configuration file name
- * \param[in] last_modified last known modification
+ * \param[in] current current signer configuration, its modification time
+ *            is moved forward if the file was rewritten without changes
+ * \param[in] trusted only check the structure, not the schema
  * \return ods_status status
  *
  */
 ods_status signconf_update(signconf_type** signconf, const char* scfile,
-    time_t last_modified);
+    signconf_type* current, int trusted);
 
 /**
  * Backup signer configuration.
@@ -36,10 +36,6 @@
 #include "signer/tools.h"
 #include "signer/zone.h"
 
-#include <errno.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
 
 static const char* tools_str = "tools";
 
@@ -49,14 +45,17 @@ static const char* tools_str = "tools";
  *
  */
 ods_status
-tools_signconf(zone_type* zone)
+tools_signconf(zone_type* zone, engine_type* engine)
 {
     ods_status status = ODS_STATUS_OK;
     signconf_type* new_signconf = NULL;
 
     ods_log_assert(zone);
     ods_log_assert(zone->name);
-    status = zone_load_signconf(zone, &new_signconf);
+    ods_log_assert(engine);
+    ods_log_assert(engine->config);
+    status = zone_load_signconf(zone, &new_signconf,
+        engine->config->trusted_signconf);
     if (status == ODS_STATUS_OK) {
         ods_log_assert(new_signconf);
         /* Denial of Existence Rollover? */
@@ -159,20 +158,6 @@ tools_input(zone_type* zone)
 }
 
 
-/**
- * Close file descriptors.
- *
- */
-static void
-ods_closeall(int fd)
-{
-    int fdlimit = sysconf(_SC_OPEN_MAX);
-    while (fd < fdlimit) {
-        close(fd++);
-    }
-}
-
-
 /**
  * Write zone to output adapter.
  *
@@ -200,6 +185,9 @@ tools_output(zone_type* zone, engine_type* engine)
             pthread_mutex_unlock(&zone->stats->stats_lock);
             zone->db->intserial =
                 zone->db->outserial;
+            if (!zone->served) {
+                zone_publish(zone);
+            }
             return ODS_STATUS_OK;
         }
         pthread_mutex_unlock(&zone->stats->stats_lock);
@@ -214,51 +202,16 @@ tools_output(zone_type* zone, engine_type* engine)
     zone->db->outserial = zone->db->intserial;
     zone->db->is_initialized = 1;
     zone->db->have_serial = 1;
+    zone_publish(zone);
     pthread_mutex_lock(&zone->ixfr->ixfr_lock);
     ixfr_purge(zone->ixfr, zone->name);
     pthread_mutex_unlock(&zone->ixfr->ixfr_lock);
     /* kick the nameserver */
     if (zone->notify_ns) {
-	int pid_status;
-        pid_t pid, wpid;
         ods_log_verbose("[%s] notify nameserver: %s", tools_str,
             zone->notify_ns);
-	/** fork */
-        switch ((pid = fork())) {
-            case -1: /* error */
-                ods_log_error("[%s] notify nameserver failed: unable to fork "
-                    "(%s)", tools_str, strerror(errno));
-                return ODS_STATUS_FORK_ERR;
-            case 0: /* child */
-                /** close fds */
-		ods_closeall(0);
-                /** execv */
-                execvp(zone->notify_ns, zone->notify_args);
-                /** error */
-                ods_log_error("[%s] notify nameserver failed: execv() failed "
-                    "(%s)", tools_str, strerror(errno));
-                exit(1);
-                break;
-            default: /* parent */
-                ods_log_debug("[%s] notify nameserver process forked",
-                    tools_str);
-                /** wait for completion  */
-                while((wpid = waitpid(pid, &pid_status, 0)) <= 0) {
-                    if (errno != EINTR) {
-                        break;
-                    }
-                }
-                if (wpid == -1) {
-                    ods_log_error("[%s] notify nameserver failed: waitpid() "
-                        "failed (%s)", tools_str, strerror(errno));
-                } else if (!WIFEXITED(pid_status)) {
-                    ods_log_error("[%s] notify nameserver failed: notify "
-                        "command did not terminate normally", tools_str);
-                } else {
-                    ods_log_verbose("[%s] notify nameserver ok", tools_str);
-                }
-                break;
-        }
+        notifyhandler_queue(engine->notifyhandler, zone->name,
+            zone->notify_args);
     }
     /* log stats */
     if (zone->stats) {
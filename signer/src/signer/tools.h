@@ -35,10 +35,11 @@
 /**
  * Load zone signconf.
  * \param[in] zone zone
+ * \param[in] engine engine
  * \return ods_status status
  *
  */
-ods_status tools_signconf(zone_type* zone);
+ods_status tools_signconf(zone_type* zone, engine_type* engine);
 
 /**
  * Read zone from input adapter.
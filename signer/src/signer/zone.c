@@ -76,6 +76,12 @@ zone_create(char* name, ldns_rr_class klass)
         free(zone);
         return NULL;
     }
+    if (pthread_mutex_init(&zone->served_lock, NULL)) {
+        (void)pthread_mutex_destroy(&zone->xfr_lock);
+        (void)pthread_mutex_destroy(&zone->zone_lock);
+        free(zone);
+        return NULL;
+    }
 
     zone->name = strdup(name);
     if (!zone->name) {
@@ -121,7 +127,7 @@ zone_create(char* name, ldns_rr_class klass)
         return NULL;
     }
     zone->stats = stats_create();
-    zone->rrstore = rrset_store_initialize();
+    zone->rrstore = rrset_store_initialize(zone->name);
     return zone;
 }
 
@@ -130,7 +136,8 @@ zone_create(char* name, ldns_rr_class klass)
  *
  */
 ods_status
-zone_load_signconf(zone_type* zone, signconf_type** new_signconf)
+zone_load_signconf(zone_type* zone, signconf_type** new_signconf,
+    int trusted)
 {
     ods_status status = ODS_STATUS_OK;
     signconf_type* signconf = NULL;
@@ -145,7 +152,7 @@ zone_load_signconf(zone_type* zone, signconf_type** new_signconf)
         return ODS_STATUS_INSECURE;
     }
     status = signconf_update(&signconf, zone->signconf_filename,
-        zone->signconf->last_modified);
+        zone->signconf, trusted);
     if (status == ODS_STATUS_OK) {
         if (!signconf) {
             /* this is unexpected */
@@ -523,6 +530,139 @@ zone_lookup_rrset(zone_type* zone, ldns_rdf* owner, ldns_rr_type type)
 }
 
 
+/**
+ * Free served version of the zone.
+ *
+ */
+static void
+zone_served_free(zone_served_type* served)
+{
+    size_t i = 0;
+    for (i = 0; i < served->rrset_count; i++) {
+        ldns_rr_list_deep_free(served->rrsets[i].rrs);
+        ldns_rr_list_deep_free(served->rrsets[i].rrsigs);
+    }
+    free(served->rrsets);
+    free(served);
+}
+
+
+/**
+ * Publish served version of the zone.
+ *
+ */
+void
+zone_publish(zone_type* zone)
+{
+    zone_served_type* served = NULL;
+    zone_served_type* old = NULL;
+    zone_served_rrset_type* srrset = NULL;
+    domain_type* domain = NULL;
+    rrset_type* rrset = NULL;
+    rrsig_type* rrsig = NULL;
+    size_t i = 0;
+
+    ods_log_assert(zone);
+    domain = namedb_lookup_domain(zone->db, zone->apex);
+    if (!domain) {
+        return;
+    }
+    CHECKALLOC(served = (zone_served_type*) calloc(1,
+        sizeof(zone_served_type)));
+    for (rrset = domain->rrsets; rrset; rrset = rrset->next) {
+        served->rrset_count++;
+    }
+    if (served->rrset_count) {
+        CHECKALLOC(served->rrsets = (zone_served_rrset_type*) calloc(
+            served->rrset_count, sizeof(zone_served_rrset_type)));
+    }
+    for (rrset = domain->rrsets, srrset = served->rrsets; rrset;
+        rrset = rrset->next, srrset++) {
+        srrset->type = rrset->rrtype;
+        CHECKALLOC(srrset->rrs = ldns_rr_list_new());
+        CHECKALLOC(srrset->rrsigs = ldns_rr_list_new());
+        for (i = 0; i < rrset->rr_count; i++) {
+            ldns_rr_list_push_rr(srrset->rrs, ldns_rr_clone(rrset->rrs[i].rr));
+        }
+        while ((rrsig = collection_iterator(rrset->rrsigs))) {
+            ldns_rr_list_push_rr(srrset->rrsigs, ldns_rr_clone(rrsig->rr));
+        }
+        if (rrset->rrtype == LDNS_RR_TYPE_SOA && rrset->rr_count > 0) {
+            served->serial = ldns_rdf2native_int32(
+                ldns_rr_rdf(rrset->rrs[0].rr, SE_SOA_RDATA_SERIAL));
+        }
+    }
+    served->refcount = 1;
+    ods_log_debug("[%s] zone %s publish serial %u", zone_str, zone->name,
+        served->serial);
+    /* swap, the previous version lives on until its last reader is done */
+    pthread_mutex_lock(&zone->served_lock);
+    old = zone->served;
+    zone->served = served;
+    pthread_mutex_unlock(&zone->served_lock);
+    zone_served_release(zone, old);
+}
+
+
+/**
+ * Get served version of the zone.
+ *
+ */
+zone_served_type*
+zone_served_acquire(zone_type* zone)
+{
+    zone_served_type* served = NULL;
+    ods_log_assert(zone);
+    pthread_mutex_lock(&zone->served_lock);
+    served = zone->served;
+    if (served) {
+        served->refcount++;
+    }
+    pthread_mutex_unlock(&zone->served_lock);
+    return served;
+}
+
+
+/**
+ * Release served version of the zone.
+ *
+ */
+void
+zone_served_release(zone_type* zone, zone_served_type* served)
+{
+    size_t refcount = 0;
+    if (!served) {
+        return;
+    }
+    pthread_mutex_lock(&zone->served_lock);
+    refcount = --served->refcount;
+    pthread_mutex_unlock(&zone->served_lock);
+    if (refcount == 0) {
+        zone_served_free(served);
+    }
+}
+
+
+/**
+ * Lookup RRset in served version of the zone.
+ *
+ */
+zone_served_rrset_type*
+zone_served_lookup(zone_served_type* served, ldns_rr_type type)
+{
+    size_t i = 0;
+    if (!served) {
+        return NULL;
+    }
+    for (i = 0; i < served->rrset_count; i++) {
+        if (served->rrsets[i].type == type) {
+            return &served->rrsets[i];
+        }
+    }
+    return NULL;
+}
+
+
 /**
  * Add RR.
  *
@@ -780,6 +920,8 @@ pthread_mutex_unlock(&zone->zone_lock);
     free((void*)zone->signconf_filename);
     free((void*)zone->name);
     collection_class_destroy(&zone->rrstore);
+    zone_served_release(zone, zone->served);
+    pthread_mutex_destroy(&zone->served_lock);
     pthread_mutex_destroy(&zone->xfr_lock);
     pthread_mutex_destroy(&zone->zone_lock);
     free(zone);
@@ -40,6 +40,27 @@ typedef enum zone_zl_status_enum zone_zl_status;
 
 typedef struct zone_struct zone_type;
 
+/**
+ * Served version of a zone: the apex RRsets as of the last output. Once
+ * published it is never changed, so that the dns handler can answer from
+ * it without taking the zone lock.
+ *
+ */
+typedef struct zone_served_rrset_struct zone_served_rrset_type;
+struct zone_served_rrset_struct {
+    ldns_rr_type type;
+    ldns_rr_list* rrs;
+    ldns_rr_list* rrsigs;
+};
+
+typedef struct zone_served_struct zone_served_type;
+struct zone_served_struct {
+    zone_served_rrset_type* rrsets;
+    size_t rrset_count;
+    uint32_t serial;
+    size_t refcount; /* protected by the served lock of the zone */
+};
+
 #include "adapter/adapter.h"
 #include "scheduler/schedule.h"
 #include "locks.h"
@@ -85,6 +106,9 @@ struct zone_struct {
     stats_type* stats;
     pthread_mutex_t zone_lock;
     pthread_mutex_t xfr_lock;
+    /* served version, swapped under the served lock */
+    zone_served_type* served;
+    pthread_mutex_t served_lock;
     /* backing store for rrsigs (both domain as denial) */
     collection_class rrstore;
     int zoneconfigvalid; /* flag indicating whether the signconf has at least once been read */
@@ -104,13 +128,15 @@ zone_type* zone_create(char* name, ldns_rr_class klass);
  * Load signer configuration for zone.
  * \param[in] zone zone
  * \param[out] new_signconf new signer configuration
+ * \param[in] trusted only check the structure of the signconf file
  * \return ods_status status
  *         ODS_STATUS_OK: new signer configuration loaded
  *         ODS_STATUS_UNCHANGED: signer configuration has not changed
  *         other: signer configuration not loaded, error occurred
  *
  */
-ods_status zone_load_signconf(zone_type* zone, signconf_type** new_signconf);
+ods_status zone_load_signconf(zone_type* zone, signconf_type** new_signconf,
+    int trusted);
 
 /**
  * Reschedule task for zone.
@@ -180,6 +206,42 @@ ods_status zone_update_serial(zone_type* zone);
 rrset_type* zone_lookup_rrset(zone_type* zone, ldns_rdf* owner,
     ldns_rr_type type);
 
+/**
+ * Publish the apex RRsets as the served version of the zone. Must be
+ * called with the zone lock held. Queries that still use the previous
+ * version keep it until they release it.
+ * \param[in] zone zone
+ *
+ */
+void zone_publish(zone_type* zone);
+
+/**
+ * Get a reference to the served version of the zone, without taking the
+ * zone lock.
+ * \param[in] zone zone
+ * \return zone_served_type* served version, NULL if none published yet
+ *
+ */
+zone_served_type* zone_served_acquire(zone_type* zone);
+
+/**
+ * Release a reference to a served version of the zone.
+ * \param[in] zone zone
+ * \param[in] served served version
+ *
+ */
+void zone_served_release(zone_type* zone, zone_served_type* served);
+
+/**
+ * Lookup RRset in served version of the zone.
+ * \param[in] served served version
+ * \param[in] type RRtype
+ * \return zone_served_rrset_type* RRset, if found
+ *
+ */
+zone_served_rrset_type* zone_served_lookup(zone_served_type* served,
+    ldns_rr_type type);
+
 /**
  * Add RR.
  * \param[in] zone zone
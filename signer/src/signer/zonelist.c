@@ -39,11 +39,24 @@
 #include "signer/zone.h"
 #include "signer/zonelist.h"
 
+#include <ctype.h>
 #include <ldns/ldns.h>
 #include <stdlib.h>
 
 static const char* zl_str = "zonelist";
 
+#define ZONELIST_HASH_MIN 256 /* initial number of hash buckets */
+
+/**
+ * Zone in the zone hash.
+ *
+ */
+struct zonelist_entry_struct {
+    zonelist_entry_type* next;
+    uint32_t hash;
+    zone_type* zone;
+};
+
 
 /**
  * Compare two zones.
@@ -82,12 +95,122 @@ zonelist_create()
         free(zlist);
         return NULL;
     }
+    zlist->hash = NULL;
+    zlist->hash_size = 0;
+    zlist->hash_count = 0;
     zlist->last_modified = 0;
     pthread_mutex_init(&zlist->zl_lock, NULL);
     return zlist;
 }
 
 
+/**
+ * Hash a zone apex and class. Domain names are compared case
+ * insensitive, so is the hash.
+ *
+ */
+static uint32_t
+zonelist_hash(ldns_rdf* dname, ldns_rr_class klass)
+{
+    const uint8_t* data = ldns_rdf_data(dname);
+    size_t size = ldns_rdf_size(dname);
+    uint32_t hash = 2166136261U;
+    size_t i = 0;
+    for (i = 0; i < size; i++) {
+        hash ^= (uint32_t) tolower((int) data[i]);
+        hash *= 16777619U;
+    }
+    hash ^= (uint32_t) klass;
+    hash *= 16777619U;
+    return hash;
+}
+
+
+/**
+ * Add zone to the zone hash.
+ *
+ */
+static void
+zonelist_hash_add(zonelist_type* zl, zone_type* zone)
+{
+    zonelist_entry_type* entry = NULL;
+    zonelist_entry_type* next = NULL;
+    zonelist_entry_type** hash = NULL;
+    size_t size = 0;
+    size_t i = 0;
+    if (zl->hash_count >= zl->hash_size) {
+        /* grow, keep at most one zone per bucket on average */
+        size = zl->hash_size ? zl->hash_size * 2 : ZONELIST_HASH_MIN;
+        CHECKALLOC(hash = (zonelist_entry_type**) calloc(size,
+            sizeof(zonelist_entry_type*)));
+        for (i = 0; i < zl->hash_size; i++) {
+            for (entry = zl->hash[i]; entry; entry = next) {
+                next = entry->next;
+                entry->next = hash[entry->hash % size];
+                hash[entry->hash % size] = entry;
+            }
+        }
+        free(zl->hash);
+        zl->hash = hash;
+        zl->hash_size = size;
+    }
+    CHECKALLOC(entry = (zonelist_entry_type*) malloc(
+        sizeof(zonelist_entry_type)));
+    entry->hash = zonelist_hash(zone->apex, zone->klass);
+    entry->zone = zone;
+    entry->next = zl->hash[entry->hash % zl->hash_size];
+    zl->hash[entry->hash % zl->hash_size] = entry;
+    zl->hash_count++;
+}
+
+
+/**
+ * Delete zone from the zone hash.
+ *
+ */
+static void
+zonelist_hash_del(zonelist_type* zl, zone_type* zone)
+{
+    zonelist_entry_type** prev = NULL;
+    zonelist_entry_type* entry = NULL;
+    if (!zl->hash_size) {
+        return;
+    }
+    prev = &zl->hash[zonelist_hash(zone->apex, zone->klass) % zl->hash_size];
+    for (entry = *prev; entry; prev = &entry->next, entry = entry->next) {
+        if (entry->zone == zone) {
+            *prev = entry->next;
+            free(entry);
+            zl->hash_count--;
+            return;
+        }
+    }
+}
+
+
+/**
+ * Free the zone hash.
+ *
+ */
+static void
+zonelist_hash_free(zonelist_type* zl)
+{
+    zonelist_entry_type* entry = NULL;
+    zonelist_entry_type* next = NULL;
+    size_t i = 0;
+    for (i = 0; i < zl->hash_size; i++) {
+        for (entry = zl->hash[i]; entry; entry = next) {
+            next = entry->next;
+            free(entry);
+        }
+    }
+    free(zl->hash);
+    zl->hash = NULL;
+    zl->hash_size = 0;
+    zl->hash_count = 0;
+}
+
+
 /**
  * Read a zonelist file.
  *
@@ -171,14 +294,21 @@ zone_type*
 zonelist_lookup_zone_by_dname(zonelist_type* zonelist, ldns_rdf* dname,
     ldns_rr_class klass)
 {
-    char* name = NULL;
-    zone_type* result = NULL;
-    if (zonelist && zonelist->zones && dname && klass) {
-        name = ldns_rdf2str(dname);
-        result = zonelist_lookup_zone_by_name(zonelist, name, klass);
-        free((void*)name);
+    zonelist_entry_type* entry = NULL;
+    uint32_t hash = 0;
+    if (!zonelist || !zonelist->hash_size || !dname || !klass) {
+        return NULL;
     }
-    return result;
+    hash = zonelist_hash(dname, klass);
+    for (entry = zonelist->hash[hash % zonelist->hash_size]; entry;
+        entry = entry->next) {
+        if (entry->hash == hash && entry->zone->klass == klass &&
+            ldns_rdf_size(entry->zone->apex) == ldns_rdf_size(dname) &&
+            ldns_dname_compare(entry->zone->apex, dname) == 0) {
+            return entry->zone;
+        }
+    }
+    return NULL;
 }
 
 
@@ -213,6 +343,7 @@ zonelist_add_zone(zonelist_type* zlist, zone_type* zone)
         zone_cleanup(zone);
         return NULL;
     }
+    zonelist_hash_add(zlist, zone);
     zone->zl_status = ZONE_ZL_ADDED;
     zlist->just_added++;
     return zone;
@@ -236,6 +367,7 @@ zonelist_del_zone(zonelist_type* zlist, zone_type* zone)
         goto zone_not_present;
     }
     free((void*) old_node);
+    zonelist_hash_del(zlist, zone);
     return;
 
 zone_not_present:
@@ -424,6 +556,7 @@ zonelist_cleanup(zonelist_type* zl)
         ldns_rbtree_free(zl->zones);
         zl->zones = NULL;
     }
+    zonelist_hash_free(zl);
     pthread_mutex_destroy(&zl->zl_lock);
     free(zl);
 }
@@ -444,6 +577,7 @@ zonelist_free(zonelist_type* zl)
         ldns_rbtree_free(zl->zones);
         zl->zones = NULL;
     }
+    zonelist_hash_free(zl);
     pthread_mutex_destroy(&zl->zl_lock);
     free(zl);
 }
@@ -32,6 +32,7 @@
 #include <time.h>
 
 typedef struct zonelist_struct zonelist_type;
+typedef struct zonelist_entry_struct zonelist_entry_type;
 
 #include "status.h"
 #include "locks.h"
@@ -43,6 +44,10 @@ typedef struct zonelist_struct zonelist_type;
  */
 struct zonelist_struct {
     ldns_rbtree_t* zones;
+    /* the same zones, hashed on apex and class for the query path */
+    zonelist_entry_type** hash;
+    size_t hash_size;
+    size_t hash_count;
     time_t last_modified;
     int just_added;
     int just_updated;
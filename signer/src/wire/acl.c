@@ -37,6 +37,17 @@
 
 static const char* acl_str = "acl";
 
+/**
+ * Node in the ACL address trie.
+ *
+ */
+struct acl_node_struct {
+    acl_node_type* child[2];
+    /* positions of the entries whose prefix ends here */
+    size_t* entries;
+    size_t count;
+};
+
 
 /**
  * Returns range type.
@@ -133,6 +144,7 @@ acl_create(char* address, char* port,
     acl->address = NULL;
     acl->next = NULL;
     acl->tsig = NULL;
+    acl->tsig_algo = NULL;
     if (tsig_name) {
         acl->tsig = tsig_lookup_by_name(tsig, tsig_name);
         if (!acl->tsig) {
@@ -141,6 +153,7 @@ acl_create(char* address, char* port,
             acl_cleanup(acl);
             return NULL;
         }
+        acl->tsig_algo = tsig_lookup_algo(acl->tsig->algorithm);
     }
     acl->port = 0;
     if (port) {
@@ -395,11 +408,18 @@ acl_tsig_matches(acl_type* acl, tsig_rr_type* tsig)
         ods_log_debug("[%s] no match: no config", acl_str);
         return 0; /* missing TSIG config */
     }
-    if (ldns_dname_compare(tsig->key_name, acl->tsig->key->dname) != 0) {
+    if (tsig->key != acl->tsig->key &&
+        ldns_dname_compare(tsig->key_name, acl->tsig->key->dname) != 0) {
         ods_log_debug("[%s] no match: key names not the same", acl_str);
         return 0; /* wrong key name */
     }
-    if (ods_strlowercmp(tsig->algo->txt_name, acl->tsig->algorithm) != 0) {
+    if (acl->tsig_algo) {
+        if (tsig->algo != acl->tsig_algo) {
+            ods_log_debug("[%s] no match: algorithms not the same", acl_str);
+            return 0; /* wrong algorithm */
+        }
+    } else if (ods_strlowercmp(tsig->algo->txt_name,
+        acl->tsig->algorithm) != 0) {
         ods_log_debug("[%s] no match: algorithms not the same", acl_str);
         return 0; /* wrong algorithm name */
     }
@@ -448,6 +468,231 @@ acl_find(acl_type* acl, struct sockaddr_storage* addr, tsig_rr_type* trr)
 }
 
 
+/**
+ * Prefix length of an ACL entry, -1 if it does not cover a prefix.
+ *
+ */
+static int
+acl_prefix_len(acl_type* acl)
+{
+    const uint8_t* mask = (const uint8_t*) &acl->range_mask;
+    size_t size = acl->family == AF_INET6 ? sizeof(struct in6_addr) :
+        sizeof(struct in_addr);
+    size_t i = 0;
+    int len = 0;
+    uint8_t bits = 0;
+    switch (acl->range_type) {
+        case ACL_RANGE_SINGLE:
+            return (int) size * 8;
+        case ACL_RANGE_MASK:
+        case ACL_RANGE_SUBNET:
+            /* leading ones, followed by zeroes only */
+            for (i = 0; i < size && mask[i] == 0xff; i++) {
+                len += 8;
+            }
+            if (i < size) {
+                bits = mask[i++];
+                while (bits & 0x80) {
+                    len++;
+                    bits <<= 1;
+                }
+                if (bits) {
+                    return -1;
+                }
+            }
+            for (; i < size; i++) {
+                if (mask[i]) {
+                    return -1;
+                }
+            }
+            return len;
+        case ACL_RANGE_MINMAX:
+        default:
+            return -1;
+    }
+}
+
+
+/**
+ * Add entry to the ACL address trie.
+ *
+ */
+static void
+acl_node_add(acl_node_type** root, const uint8_t* addr, int len, size_t pos)
+{
+    acl_node_type* node = NULL;
+    int i = 0;
+    int bit = 0;
+    if (!*root) {
+        CHECKALLOC(*root = (acl_node_type*) calloc(1, sizeof(acl_node_type)));
+    }
+    node = *root;
+    for (i = 0; i < len; i++) {
+        bit = (addr[i/8] >> (7 - (i%8))) & 1;
+        if (!node->child[bit]) {
+            CHECKALLOC(node->child[bit] = (acl_node_type*) calloc(1,
+                sizeof(acl_node_type)));
+        }
+        node = node->child[bit];
+    }
+    CHECKALLOC(node->entries = (size_t*) realloc(node->entries,
+        (node->count + 1) * sizeof(size_t)));
+    node->entries[node->count++] = pos;
+}
+
+
+/**
+ * Compile ACL.
+ *
+ */
+acl_index_type*
+acl_index_create(acl_type* acl)
+{
+    acl_index_type* index = NULL;
+    acl_type* walk = NULL;
+    size_t pos = 0;
+    int len = 0;
+    if (!acl) {
+        return NULL;
+    }
+    CHECKALLOC(index = (acl_index_type*) calloc(1, sizeof(acl_index_type)));
+    for (walk = acl; walk; walk = walk->next) {
+        index->count++;
+    }
+    CHECKALLOC(index->acls = (acl_type**) malloc(index->count *
+        sizeof(acl_type*)));
+    CHECKALLOC(index->others = (size_t*) malloc(index->count *
+        sizeof(size_t)));
+    for (walk = acl, pos = 0; walk; walk = walk->next, pos++) {
+        index->acls[pos] = walk;
+        if (!walk->address) {
+            /* all addresses match */
+            acl_node_add(&index->root4, NULL, 0, pos);
+            acl_node_add(&index->root6, NULL, 0, pos);
+            continue;
+        }
+        len = acl_prefix_len(walk);
+        if (len < 0) {
+            index->others[index->num_others++] = pos;
+        } else if (walk->family == AF_INET6) {
+            acl_node_add(&index->root6, (const uint8_t*) &walk->addr.addr6,
+                len, pos);
+        } else {
+            acl_node_add(&index->root4, (const uint8_t*) &walk->addr.addr,
+                len, pos);
+        }
+    }
+    return index;
+}
+
+
+/**
+ * Find the first entry at a trie node that matches, if it comes before
+ * the best match so far.
+ *
+ */
+static size_t
+acl_node_find(acl_index_type* index, acl_node_type* node,
+    struct sockaddr_storage* addr, tsig_rr_type* trr, size_t best)
+{
+    size_t i = 0;
+    for (i = 0; i < node->count && node->entries[i] < best; i++) {
+        if (acl_addr_matches(index->acls[node->entries[i]], addr) &&
+            acl_tsig_matches(index->acls[node->entries[i]], trr)) {
+            return node->entries[i];
+        }
+    }
+    return best;
+}
+
+
+/**
+ * Find ACL in compiled ACL.
+ *
+ */
+acl_type*
+acl_index_find(acl_index_type* index, struct sockaddr_storage* addr,
+    tsig_rr_type* trr)
+{
+    acl_node_type* node = NULL;
+    const uint8_t* bytes = NULL;
+    size_t best = 0;
+    size_t i = 0;
+    int len = 0;
+    int bit = 0;
+    if (!index || !addr) {
+        return NULL;
+    }
+    best = index->count;
+    if (addr->ss_family == AF_INET6) {
+        node = index->root6;
+        bytes = (const uint8_t*) &((struct sockaddr_in6*) addr)->sin6_addr;
+        len = sizeof(struct in6_addr) * 8;
+    } else {
+        node = index->root4;
+        bytes = (const uint8_t*) &((struct sockaddr_in*) addr)->sin_addr;
+        len = sizeof(struct in_addr) * 8;
+    }
+    /* entries on the path to the address cover it */
+    for (i = 0; node; i++) {
+        best = acl_node_find(index, node, addr, trr, best);
+        if ((int) i == len) {
+            break;
+        }
+        bit = (bytes[i/8] >> (7 - (i%8))) & 1;
+        node = node->child[bit];
+    }
+    for (i = 0; i < index->num_others && index->others[i] < best; i++) {
+        if (acl_addr_matches(index->acls[index->others[i]], addr) &&
+            acl_tsig_matches(index->acls[index->others[i]], trr)) {
+            best = index->others[i];
+            break;
+        }
+    }
+    if (best == index->count) {
+        return NULL;
+    }
+    ods_log_debug("[%s] match %s", acl_str, index->acls[best]->address);
+    return index->acls[best];
+}
+
+
+/**
+ * Clean up ACL address trie.
+ *
+ */
+static void
+acl_node_cleanup(acl_node_type* node)
+{
+    if (!node) {
+        return;
+    }
+    acl_node_cleanup(node->child[0]);
+    acl_node_cleanup(node->child[1]);
+    free(node->entries);
+    free(node);
+}
+
+
+/**
+ * Clean up compiled ACL.
+ *
+ */
+void
+acl_index_cleanup(acl_index_type* index)
+{
+    if (!index) {
+        return;
+    }
+    acl_index_cleanup(index->next);
+    acl_node_cleanup(index->root4);
+    acl_node_cleanup(index->root6);
+    free(index->acls);
+    free(index->others);
+    free(index);
+}
+
+
 /**
  * Clean up ACL.
  *
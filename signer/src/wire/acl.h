@@ -67,10 +67,31 @@ struct acl_struct {
     /* tsig */
     const char* tsig_name;
     tsig_type* tsig;
+    tsig_algo_type* tsig_algo;
     /* cache */
     time_t ixfr_disabled;
 };
 
+/**
+ * ACL compiled for matching: entries that cover an address prefix are
+ * kept in a binary trie per address family, others in a list.
+ *
+ */
+typedef struct acl_node_struct acl_node_type;
+typedef struct acl_index_struct acl_index_type;
+struct acl_index_struct {
+    /* ACL entries, in list order */
+    acl_type** acls;
+    size_t count;
+    acl_node_type* root4;
+    acl_node_type* root6;
+    /* positions of entries that are not a prefix, like ranges */
+    size_t* others;
+    size_t num_others;
+    /* next in a list of indexes waiting to be cleaned up */
+    acl_index_type* next;
+};
+
 /**
  * Create ACL.
  * \param[in] allocator memory allocator
@@ -95,6 +116,26 @@ acl_type* acl_create(char* address,
 acl_type* acl_find(acl_type* acl, struct sockaddr_storage* addr,
     tsig_rr_type* tsig);
 
+/**
+ * Compile ACL.
+ * \param[in] acl ACL
+ * \return acl_index_type* compiled ACL, NULL if the ACL is empty
+ *
+ */
+acl_index_type* acl_index_create(acl_type* acl);
+
+/**
+ * Find ACL in compiled ACL. Returns the same match as acl_find() on the
+ * list it was compiled from.
+ * \param[in] index compiled ACL
+ * \param[in] addr remote address storage
+ * \param[in] tsig tsig credentials
+ * \return acl_type* ACL that matches
+ *
+ */
+acl_type* acl_index_find(acl_index_type* index,
+    struct sockaddr_storage* addr, tsig_rr_type* tsig);
+
 /**
  * Parse family from address.
  * \param[in] a address in string format
@@ -121,4 +162,11 @@ int addr2ip(struct sockaddr_storage addr, char* ip, size_t len);
  */
 void acl_cleanup(acl_type* acl);
 
+/**
+ * Clean up compiled ACL, and the indexes linked to it.
+ * \param[in] index compiled ACL
+ *
+ */
+void acl_index_cleanup(acl_index_type* index);
+
 #endif /* WIRE_ACL_H */
@@ -62,11 +62,22 @@ soa_request(query_type* q, engine_type* engine)
     char line[SE_ADFILE_MAXLINE];
     unsigned l = 0;
     FILE* fd = NULL;
+    zone_served_type* served = NULL;
+    zone_served_rrset_type* rrset = NULL;
     ods_log_assert(q);
     ods_log_assert(q->buffer);
     ods_log_assert(q->zone);
     ods_log_assert(q->zone->name);
     ods_log_assert(engine);
+    /* the served version has the soa of the last output */
+    served = zone_served_acquire(q->zone);
+    rrset = zone_served_lookup(served, LDNS_RR_TYPE_SOA);
+    if (rrset && ldns_rr_list_rr_count(rrset->rrs) > 0) {
+        rr = ldns_rr_clone(ldns_rr_list_rr(rrset->rrs, 0));
+        zone_served_release(q->zone, served);
+        goto soa_add;
+    }
+    zone_served_release(q->zone, served);
     xfrfile = ods_build_path(q->zone->name, ".axfr", 0, 1);
     if (xfrfile) {
         fd = ods_fopen(xfrfile, NULL, "r");
@@ -79,9 +90,6 @@ soa_request(query_type* q, engine_type* engine)
         return QUERY_PROCESSED;
     }
     free((void*)xfrfile);
-    if (q->tsig_rr->status == TSIG_OK) {
-        q->tsig_sign_it = 1; /* sign first packet in stream */
-    }
     /* compression? */
 
     /* add SOA RR */
@@ -103,6 +111,12 @@ soa_request(query_type* q, engine_type* engine)
         ods_fclose(fd);
         return QUERY_PROCESSED;
     }
+    ods_fclose(fd);
+
+soa_add:
+    if (q->tsig_rr->status == TSIG_OK) {
+        q->tsig_sign_it = 1; /* sign first packet in stream */
+    }
     /* zone not expired? */
     if (q->zone->xfrd) {
         expire = q->zone->xfrd->serial_xfr_acquired;
@@ -112,7 +126,6 @@ soa_request(query_type* q, engine_type* engine)
                 "not serving soa", axfr_str, q->zone->name, (long long)expire, (long long)time_now());
             ldns_rr_free(rr);
             buffer_pkt_set_rcode(q->buffer, LDNS_RCODE_SERVFAIL);
-            ods_fclose(fd);
             return QUERY_PROCESSED;
         }
     }
@@ -128,10 +141,8 @@ soa_request(query_type* q, engine_type* engine)
             axfr_str, q->zone->name);
         ldns_rr_free(rr);
         buffer_pkt_set_rcode(q->buffer, LDNS_RCODE_SERVFAIL);
-        ods_fclose(fd);
         return QUERY_PROCESSED;
     }
-    ods_fclose(fd);
     buffer_pkt_set_ancount(q->buffer, 1);
     buffer_pkt_set_nscount(q->buffer, 0);
     buffer_pkt_set_arcount(q->buffer, 0);
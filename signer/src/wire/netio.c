@@ -12,6 +12,7 @@
 #include <sys/time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "log.h"
 #include "wire/netio.h"
@@ -30,6 +31,13 @@ int pselect(int n, fd_set* readfds, fd_set* writefds, fd_set* exceptfds,
 static const char* netio_str = "netio";
 
 
+#ifdef NETIO_USE_EPOLL
+static void netio_sync_handler(netio_type* netio,
+    netio_handler_list_type* l, int force);
+static void netio_forget_handler(netio_type* netio,
+    netio_handler_list_type* l);
+#endif
+
 /*
  * Create a new netio instance.
  * \return netio_type* netio instance
@@ -41,7 +49,26 @@ netio_create()
     netio_type* netio = NULL;
     CHECKALLOC(netio = (netio_type*) malloc(sizeof(netio_type)));
     netio->handlers = NULL;
+    netio->have_current_time = 0;
     netio->dispatch_next = NULL;
+    pthread_mutex_init(&netio->netio_lock, NULL);
+    pthread_cond_init(&netio->netio_cond, NULL);
+    netio->dispatching = 0;
+    netio->dispatch_current = NULL;
+#ifdef NETIO_USE_EPOLL
+    netio->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (netio->epfd == -1) {
+        ods_fatal_exit("[%s] unable to create epoll instance: %s", netio_str,
+            strerror(errno));
+    }
+    netio->timers = NULL;
+    netio->timers_count = 0;
+    netio->timers_size = 0;
+    netio->fds = NULL;
+    netio->fds_size = 0;
+    netio->next_id = 0;
+    netio->round = 0;
+#endif
     return netio;
 }
 
@@ -58,9 +85,20 @@ netio_add_handler(netio_type* netio, netio_handler_type* handler)
     ods_log_assert(handler);
 
     CHECKALLOC(l = (netio_handler_list_type*) malloc(sizeof(netio_handler_list_type)));
+    pthread_mutex_lock(&netio->netio_lock);
     l->next = netio->handlers;
     l->handler = handler;
     netio->handlers = l;
+    handler->list = l;
+#ifdef NETIO_USE_EPOLL
+    l->id = ++netio->next_id;
+    l->fd = -1;
+    l->events = 0;
+    l->timer = -1;
+    l->round = 0;
+    netio_sync_handler(netio, l, 0);
+#endif
+    pthread_mutex_unlock(&netio->netio_lock);
     ods_log_debug("[%s] handler added", netio_str);
 }
 
@@ -75,22 +113,58 @@ netio_remove_handler(netio_type* netio, netio_handler_type* handler)
     if (!netio || !handler) {
         return;
     }
+    pthread_mutex_lock(&netio->netio_lock);
+    /* the caller may free the handler, let a running callback finish */
+    while (netio->dispatching && netio->dispatch_current &&
+        netio->dispatch_current->handler == handler &&
+        !pthread_equal(netio->dispatch_thread, pthread_self())) {
+        pthread_cond_wait(&netio->netio_cond, &netio->netio_lock);
+    }
     for (lptr = &netio->handlers; *lptr; lptr = &(*lptr)->next) {
         if ((*lptr)->handler == handler) {
             netio_handler_list_type* next = (*lptr)->next;
             if ((*lptr) == netio->dispatch_next) {
                 netio->dispatch_next = next;
             }
+            if ((*lptr) == netio->dispatch_current) {
+                netio->dispatch_current = NULL;
+            }
+#ifdef NETIO_USE_EPOLL
+            netio_forget_handler(netio, *lptr);
+#endif
+            handler->list = NULL;
             (*lptr)->handler = NULL;
 	    free(*lptr);
             *lptr = next;
             break;
         }
     }
+    pthread_mutex_unlock(&netio->netio_lock);
     ods_log_debug("[%s] handler removed", netio_str);
 }
 
 
+/*
+ * Tell netio that a handler changed outside of its own callback.
+ *
+ */
+void
+netio_update_handler(netio_type* netio, netio_handler_type* handler)
+{
+    if (!netio || !handler) {
+        return;
+    }
+#ifdef NETIO_USE_EPOLL
+    pthread_mutex_lock(&netio->netio_lock);
+    /* a running callback is followed by a sync anyway */
+    if (handler->list && handler->list != netio->dispatch_current) {
+        netio_sync_handler(netio, handler->list, 1);
+    }
+    pthread_mutex_unlock(&netio->netio_lock);
+#endif
+}
+
+
 /*
  * Convert timeval to timespec.
  *
@@ -155,6 +229,280 @@ timespec_subtract(struct timespec* left, const struct timespec* right)
 }
 
 
+#ifdef NETIO_USE_EPOLL
+/**
+ * Move timer up in the heap.
+ *
+ */
+static void
+netio_timer_up(netio_type* netio, size_t i)
+{
+    netio_handler_list_type* l = netio->timers[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (timespec_compare(&netio->timers[parent]->expire,
+            &l->expire) <= 0) {
+            break;
+        }
+        netio->timers[i] = netio->timers[parent];
+        netio->timers[i]->timer = (long) i;
+        i = parent;
+    }
+    netio->timers[i] = l;
+    l->timer = (long) i;
+}
+
+
+/**
+ * Move timer down in the heap.
+ *
+ */
+static void
+netio_timer_down(netio_type* netio, size_t i)
+{
+    netio_handler_list_type* l = netio->timers[i];
+    while (2 * i + 1 < netio->timers_count) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < netio->timers_count &&
+            timespec_compare(&netio->timers[child + 1]->expire,
+            &netio->timers[child]->expire) < 0) {
+            child++;
+        }
+        if (timespec_compare(&l->expire,
+            &netio->timers[child]->expire) <= 0) {
+            break;
+        }
+        netio->timers[i] = netio->timers[child];
+        netio->timers[i]->timer = (long) i;
+        i = child;
+    }
+    netio->timers[i] = l;
+    l->timer = (long) i;
+}
+
+
+/**
+ * Remove timer from the heap.
+ *
+ */
+static void
+netio_timer_remove(netio_type* netio, netio_handler_list_type* l)
+{
+    netio_handler_list_type* last = NULL;
+    size_t i;
+    if (l->timer < 0) {
+        return;
+    }
+    i = (size_t) l->timer;
+    l->timer = -1;
+    last = netio->timers[--netio->timers_count];
+    if (last != l) {
+        netio->timers[i] = last;
+        netio_timer_up(netio, i);
+        netio_timer_down(netio, (size_t) last->timer);
+    }
+}
+
+
+/**
+ * Set timer in the heap.
+ *
+ */
+static void
+netio_timer_set(netio_type* netio, netio_handler_list_type* l,
+    const struct timespec* expire)
+{
+    l->expire.tv_sec = expire->tv_sec;
+    l->expire.tv_nsec = expire->tv_nsec;
+    if (l->timer < 0) {
+        if (netio->timers_count == netio->timers_size) {
+            netio->timers_size = netio->timers_size ?
+                2 * netio->timers_size : 64;
+            CHECKALLOC(netio->timers = (netio_handler_list_type**) realloc(
+                netio->timers, netio->timers_size *
+                sizeof(netio_handler_list_type*)));
+        }
+        netio->timers[netio->timers_count] = l;
+        l->timer = (long) netio->timers_count++;
+    }
+    netio_timer_up(netio, (size_t) l->timer);
+    netio_timer_down(netio, (size_t) l->timer);
+}
+
+
+/**
+ * Stop watching the file descriptor of handler.
+ *
+ */
+static void
+netio_unwatch(netio_type* netio, netio_handler_list_type* l)
+{
+    struct epoll_event ev;
+    if (l->fd >= 0 && (size_t) l->fd < netio->fds_size &&
+        netio->fds[l->fd] == l) {
+        netio->fds[l->fd] = NULL;
+        /* fails if the descriptor was closed already, that is fine */
+        memset(&ev, 0, sizeof(ev));
+        (void) epoll_ctl(netio->epfd, EPOLL_CTL_DEL, l->fd, &ev);
+    }
+    l->fd = -1;
+    l->events = 0;
+}
+
+
+/**
+ * Watch file descriptor of handler for events.
+ *
+ */
+static void
+netio_watch(netio_type* netio, netio_handler_list_type* l, int fd,
+    uint32_t events)
+{
+    struct epoll_event ev;
+    netio_handler_list_type* owner = NULL;
+    int op, rc;
+    if ((size_t) fd >= netio->fds_size) {
+        size_t size = netio->fds_size ? netio->fds_size : 64;
+        while (size <= (size_t) fd) {
+            size *= 2;
+        }
+        CHECKALLOC(netio->fds = (netio_handler_list_type**) realloc(
+            netio->fds, size * sizeof(netio_handler_list_type*)));
+        memset(&netio->fds[netio->fds_size], 0,
+            (size - netio->fds_size) * sizeof(netio_handler_list_type*));
+        netio->fds_size = size;
+    }
+    owner = netio->fds[fd];
+    if (owner && owner != l) {
+        /* descriptor was closed and reused by another handler */
+        owner->fd = -1;
+        owner->events = 0;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = ((uint64_t) l->id << 32) | (uint32_t) fd;
+    op = owner ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    rc = epoll_ctl(netio->epfd, op, fd, &ev);
+    if (rc == -1 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+        /* descriptor was closed and reopened */
+        rc = epoll_ctl(netio->epfd, EPOLL_CTL_ADD, fd, &ev);
+    } else if (rc == -1 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+        rc = epoll_ctl(netio->epfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    if (rc == -1) {
+        ods_log_error("[%s] unable to watch fd %d: epoll_ctl() failed (%s)",
+            netio_str, fd, strerror(errno));
+        netio->fds[fd] = NULL;
+        l->fd = -1;
+        l->events = 0;
+        return;
+    }
+    netio->fds[fd] = l;
+    l->fd = fd;
+    l->events = events;
+}
+
+
+/**
+ * Bring epoll and the timer heap in line with handler. If force is
+ * set, the file descriptor is registered again even if it did not
+ * change, as it may have been closed and reopened.
+ *
+ */
+static void
+netio_sync_handler(netio_type* netio, netio_handler_list_type* l, int force)
+{
+    netio_handler_type* handler = l->handler;
+    uint32_t events = 0;
+    int fd = handler->fd;
+    if (handler->event_types & NETIO_EVENT_READ) {
+        events |= EPOLLIN;
+    }
+    if (handler->event_types & NETIO_EVENT_WRITE) {
+        events |= EPOLLOUT;
+    }
+    if (handler->event_types & NETIO_EVENT_EXCEPT) {
+        events |= EPOLLPRI;
+    }
+    if (fd < 0 || !events) {
+        fd = -1;
+        events = 0;
+    }
+    if (fd != l->fd) {
+        netio_unwatch(netio, l);
+    }
+    if (fd >= 0 && (force || fd != l->fd || events != l->events)) {
+        netio_watch(netio, l, fd, events);
+    }
+    if (handler->timeout && (handler->event_types & NETIO_EVENT_TIMEOUT)) {
+        if (l->timer < 0 ||
+            timespec_compare(&l->expire, handler->timeout) != 0) {
+            netio_timer_set(netio, l, handler->timeout);
+        }
+    } else {
+        netio_timer_remove(netio, l);
+    }
+}
+
+
+/**
+ * Forget about handler, it is being removed.
+ *
+ */
+static void
+netio_forget_handler(netio_type* netio, netio_handler_list_type* l)
+{
+    netio_unwatch(netio, l);
+    netio_timer_remove(netio, l);
+}
+
+
+/**
+ * Find the handler of an event returned by epoll_pwait(2). NULL if it
+ * was removed or registered again meanwhile.
+ *
+ */
+static netio_handler_list_type*
+netio_event_handler(netio_type* netio, const struct epoll_event* ev)
+{
+    int fd = (int) (ev->data.u64 & 0xffffffffU);
+    uint32_t id = (uint32_t) (ev->data.u64 >> 32);
+    netio_handler_list_type* l = NULL;
+    if (fd < 0 || (size_t) fd >= netio->fds_size) {
+        return NULL;
+    }
+    l = netio->fds[fd];
+    if (!l || l->id != id || l->handler->fd != fd) {
+        return NULL;
+    }
+    return l;
+}
+#endif /* NETIO_USE_EPOLL */
+
+
+/**
+ * Call the handler, without holding the lock.
+ *
+ */
+static void
+netio_callback(netio_type* netio, netio_handler_list_type* l,
+    netio_events_type event_types)
+{
+    netio_handler_type* handler = l->handler;
+    netio->dispatch_current = l;
+    pthread_mutex_unlock(&netio->netio_lock);
+    handler->event_handler(netio, handler, event_types);
+    pthread_mutex_lock(&netio->netio_lock);
+#ifdef NETIO_USE_EPOLL
+    if (netio->dispatch_current) {
+        netio_sync_handler(netio, l, 1);
+    }
+#endif
+    netio->dispatch_current = NULL;
+    pthread_cond_broadcast(&netio->netio_cond);
+}
+
+
 /*
  * Retrieve the current time (using gettimeofday(2)).
  *
@@ -179,6 +527,140 @@ netio_current_time(netio_type* netio)
 }
 
 
+#ifdef NETIO_USE_EPOLL
+/*
+ * Check for events and dispatch them to the handlers.
+ *
+ */
+int
+netio_dispatch(netio_type* netio, const struct timespec* timeout,
+    const sigset_t* sigmask)
+{
+    netio_handler_list_type* l = NULL;
+    netio_handler_type* handler = NULL;
+    const struct timespec* now = NULL;
+    struct timespec minimum_timeout;
+    int have_timeout = 0;
+    int msec = -1;
+    int rc = 0;
+    int i = 0;
+    int result = 0;
+
+    if (!netio) {
+        return 0;
+    }
+    pthread_mutex_lock(&netio->netio_lock);
+    if (!netio->handlers) {
+        pthread_mutex_unlock(&netio->netio_lock);
+        return 0;
+    }
+    netio->dispatch_thread = pthread_self();
+    netio->dispatching = 1;
+    /* Clear the cached current time */
+    netio->have_current_time = 0;
+    netio->round++;
+    /* Initialize the minimum timeout with the timeout parameter */
+    if (timeout) {
+        have_timeout = 1;
+        memcpy(&minimum_timeout, timeout, sizeof(struct timespec));
+    }
+    if (netio->timers_count > 0) {
+        struct timespec relative;
+        relative.tv_sec = netio->timers[0]->expire.tv_sec;
+        relative.tv_nsec = netio->timers[0]->expire.tv_nsec;
+        timespec_subtract(&relative, netio_current_time(netio));
+        if (!have_timeout ||
+            timespec_compare(&relative, &minimum_timeout) < 0) {
+            have_timeout = 1;
+            minimum_timeout.tv_sec = relative.tv_sec;
+            minimum_timeout.tv_nsec = relative.tv_nsec;
+        }
+    }
+    if (have_timeout) {
+        if (minimum_timeout.tv_sec < 0) {
+            msec = 0;
+        } else if (minimum_timeout.tv_sec > 86400) {
+            msec = 86400 * 1000;
+        } else {
+            msec = (int) minimum_timeout.tv_sec * 1000 +
+                (int) ((minimum_timeout.tv_nsec + 999999L) / 1000000L);
+        }
+    }
+    /* Check for events. */
+    pthread_mutex_unlock(&netio->netio_lock);
+    rc = epoll_pwait(netio->epfd, netio->events, NETIO_EPOLL_EVENTS, msec,
+        sigmask);
+    pthread_mutex_lock(&netio->netio_lock);
+    if (rc == -1) {
+        if (errno == EINVAL || errno == EBADF || errno == EFAULT) {
+            ods_fatal_exit("[%s] fatal error epoll_pwait: %s", netio_str,
+                strerror(errno));
+        }
+        netio->dispatching = 0;
+        pthread_mutex_unlock(&netio->netio_lock);
+        return -1;
+    }
+    /* Clear the cached current_time (epoll_pwait(2) may block for
+     * some time so the cached value is likely to be old).
+     */
+    netio->have_current_time = 0;
+    /*
+     * Dispatch the events to interested handlers. Note that a handler
+     * might deinstall or change itself or other handlers, after which
+     * their pending events no longer match.
+     */
+    ods_log_assert(netio->dispatch_current == NULL);
+    for (i = 0; i < rc; i++) {
+        uint32_t events = netio->events[i].events;
+        netio_events_type event_types = NETIO_EVENT_NONE;
+        l = netio_event_handler(netio, &netio->events[i]);
+        if (!l) {
+            continue;
+        }
+        handler = l->handler;
+        if (events & (EPOLLIN|EPOLLERR|EPOLLHUP)) {
+            event_types |= NETIO_EVENT_READ;
+        }
+        if (events & (EPOLLOUT|EPOLLERR|EPOLLHUP)) {
+            event_types |= NETIO_EVENT_WRITE;
+        }
+        if (events & EPOLLPRI) {
+            event_types |= NETIO_EVENT_EXCEPT;
+        }
+        if (event_types & handler->event_types) {
+            netio_callback(netio, l, event_types & handler->event_types);
+            ++result;
+        }
+    }
+    /*
+     * Dispatch the timeouts that expired. A handler is called at most
+     * once per dispatch, so that a handler that does not move its
+     * timeout forward does not keep us here.
+     */
+    now = netio_current_time(netio);
+    while (netio->timers_count > 0 &&
+        timespec_compare(&netio->timers[0]->expire, now) <= 0) {
+        l = netio->timers[0];
+        handler = l->handler;
+        if (l->round == netio->round) {
+            break;
+        }
+        if (!handler->timeout ||
+            !(handler->event_types & NETIO_EVENT_TIMEOUT) ||
+            timespec_compare(handler->timeout, now) > 0) {
+            /* changed by an earlier callback */
+            netio_sync_handler(netio, l, 0);
+            continue;
+        }
+        l->round = netio->round;
+        netio_timer_remove(netio, l);
+        netio_callback(netio, l, NETIO_EVENT_TIMEOUT);
+    }
+    netio->dispatching = 0;
+    pthread_mutex_unlock(&netio->netio_lock);
+    return result;
+}
+#else /* !NETIO_USE_EPOLL */
 /*
  * Check for events and dispatch them to the handlers.
  *
@@ -191,14 +673,21 @@ netio_dispatch(netio_type* netio, const struct timespec* timeout,
     int max_fd;
     int have_timeout = 0;
     struct timespec minimum_timeout;
-    netio_handler_type* timeout_handler = NULL;
+    netio_handler_list_type* timeout_handler = NULL;
     netio_handler_list_type* l = NULL;
     int rc = 0;
     int result = 0;
 
-    if (!netio || !netio->handlers) {
+    if (!netio) {
         return 0;
     }
+    pthread_mutex_lock(&netio->netio_lock);
+    if (!netio->handlers) {
+        pthread_mutex_unlock(&netio->netio_lock);
+        return 0;
+    }
+    netio->dispatch_thread = pthread_self();
+    netio->dispatching = 1;
     /* Clear the cached current time */
     netio->have_current_time = 0;
     /* Initialize the minimum timeout with the timeout parameter */
@@ -240,7 +729,7 @@ netio_dispatch(netio_type* netio, const struct timespec* timeout,
                 have_timeout = 1;
                 minimum_timeout.tv_sec = relative.tv_sec;
                 minimum_timeout.tv_nsec = relative.tv_nsec;
-                timeout_handler = handler;
+                timeout_handler = l;
             }
         }
     }
@@ -253,20 +742,25 @@ netio_dispatch(netio_type* netio, const struct timespec* timeout,
         ods_log_debug("[%s] dispatch timeout event without checking for "
             "other events", netio_str);
         if (timeout_handler &&
-            (timeout_handler->event_types & NETIO_EVENT_TIMEOUT)) {
-            timeout_handler->event_handler(netio, timeout_handler,
-                NETIO_EVENT_TIMEOUT);
+            (timeout_handler->handler->event_types & NETIO_EVENT_TIMEOUT)) {
+            netio_callback(netio, timeout_handler, NETIO_EVENT_TIMEOUT);
         }
+        netio->dispatching = 0;
+        pthread_mutex_unlock(&netio->netio_lock);
         return result;
     }
     /* Check for events. */
+    pthread_mutex_unlock(&netio->netio_lock);
     rc = pselect(max_fd + 1, &readfds, &writefds, &exceptfds,
         have_timeout ? &minimum_timeout : NULL, sigmask);
+    pthread_mutex_lock(&netio->netio_lock);
     if (rc == -1) {
         if(errno == EINVAL || errno == EACCES || errno == EBADF) {
             ods_fatal_exit("[%s] fatal error pselect: %s", netio_str,
                 strerror(errno));
         }
+        netio->dispatching = 0;
+        pthread_mutex_unlock(&netio->netio_lock);
         return -1;
     }
 
@@ -281,10 +775,11 @@ netio_dispatch(netio_type* netio, const struct timespec* timeout,
          * No events before the minimum timeout expired.
          * Dispatch to handler if interested.
          */
-        if (timeout_handler &&
-            (timeout_handler->event_types & NETIO_EVENT_TIMEOUT)) {
-            timeout_handler->event_handler(netio, timeout_handler,
-                NETIO_EVENT_TIMEOUT);
+        for (l = netio->handlers; l && l != timeout_handler; l = l->next) {
+            /* it may have been removed meanwhile */
+        }
+        if (l && (l->handler->event_types & NETIO_EVENT_TIMEOUT)) {
+            netio_callback(netio, l, NETIO_EVENT_TIMEOUT);
         }
     } else {
         /*
@@ -315,7 +810,7 @@ netio_dispatch(netio_type* netio, const struct timespec* timeout,
                     rc--;
                 }
                 if (event_types & handler->event_types) {
-                    handler->event_handler(netio, handler,
+                    netio_callback(netio, l,
                         event_types & handler->event_types);
                     ++result;
                 }
@@ -324,8 +819,11 @@ netio_dispatch(netio_type* netio, const struct timespec* timeout,
         }
         netio->dispatch_next = NULL;
     }
+    netio->dispatching = 0;
+    pthread_mutex_unlock(&netio->netio_lock);
     return result;
 }
+#endif /* NETIO_USE_EPOLL */
 
 
 /**
@@ -345,6 +843,13 @@ netio_cleanup(netio_type* netio)
         }
         free(handler);
     }
+#ifdef NETIO_USE_EPOLL
+    close(netio->epfd);
+    free(netio->timers);
+    free(netio->fds);
+#endif
+    pthread_cond_destroy(&netio->netio_cond);
+    pthread_mutex_destroy(&netio->netio_lock);
     free(netio);
 }
 
@@ -356,6 +861,13 @@ netio_cleanup_shallow(netio_type* netio)
 {
     ods_log_assert(netio);
     free(netio->handlers);
+#ifdef NETIO_USE_EPOLL
+    close(netio->epfd);
+    free(netio->timers);
+    free(netio->fds);
+#endif
+    pthread_cond_destroy(&netio->netio_cond);
+    pthread_mutex_destroy(&netio->netio_lock);
     free(netio);
 }
 
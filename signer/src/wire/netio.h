@@ -5,7 +5,7 @@
  *
  *
  * The netio module implements event based I/O handling using
- * pselect(2).  Multiple event handlers can wait for a certain event
+ * epoll(7) where available and pselect(2) otherwise.  Multiple event handlers can wait for a certain event
  * to occur simultaneously.  Each event handler is called when an
  * event occurs that the event handler has indicated that it is
  * willing to handle.
@@ -34,7 +34,21 @@
  * The main loop of the program must call netio_dispatch to check for
  * events and dispatch them to the handlers.  An additional timeout
  * can be specified as well as the signal mask to install while
- * blocked in pselect(2).
+ * blocked in epoll_pwait(2) or pselect(2).
+ *
+ * A handler is checked for changes after its own callback.  Changes
+ * made anywhere else, such as from the callback of another handler or
+ * from another thread, must be announced with netio_update_handler.
+ * With epoll(7) only changed handlers are passed to the kernel, and
+ * timeouts are kept in a heap so that all expired timeouts are
+ * dispatched in one call.
+ *
+ * Handlers may be added, updated and removed from other threads than
+ * the one that calls netio_dispatch.  The netio is locked except while
+ * blocked and while a callback runs, and removing a handler whose
+ * callback is running waits for the callback to return.  Such a thread
+ * should wake up the dispatching thread itself if the change affects
+ * how long it may block.
  */
 
 /**
@@ -49,11 +63,21 @@
 #include <sys/select.h>
 #endif
 
+#include <pthread.h>
 #include <signal.h>
 
 #include "config.h"
 #include "status.h"
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1) && \
+    defined(HAVE_EPOLL_PWAIT)
+#define NETIO_USE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
+/* Maximum number of events returned by one epoll_pwait(2) call */
+#define NETIO_EPOLL_EVENTS 64
+
 #ifndef PF_INET
 #define PF_INET AF_INET
 #endif
@@ -93,6 +117,28 @@ typedef void (*netio_event_handler_type)(netio_type *netio,
 struct netio_handler_list_struct {
     netio_handler_list_type* next;
     netio_handler_type* handler;
+#ifdef NETIO_USE_EPOLL
+    /*
+     * Identifies the registration in epoll events, together with fd.
+     */
+    uint32_t id;
+    /*
+     * The file descriptor and events as registered with epoll,
+     * -1 and 0 if not registered.
+     */
+    int fd;
+    uint32_t events;
+    /*
+     * The timeout as kept in the timer heap and the position in the
+     * heap, -1 if the handler has no timeout.
+     */
+    struct timespec expire;
+    long timer;
+    /*
+     * The dispatch in which the timeout was last dispatched.
+     */
+    unsigned long round;
+#endif
 };
 
 /**
@@ -130,6 +176,10 @@ struct netio_handler_struct {
      */
     netio_event_handler_type event_handler;
     int free_handler;
+    /*
+     * Set by netio_add_handler, NULL if the handler was not added.
+     */
+    netio_handler_list_type* list;
 };
 
 /**
@@ -154,6 +204,44 @@ struct netio_struct {
      * To make sure that deletes respect the state of the iterator.
      */
     netio_handler_list_type* dispatch_next;
+    /*
+     * Held except while netio_dispatch is blocked or in a callback.
+     * The condition is signalled when a callback returns.
+     */
+    pthread_mutex_t netio_lock;
+    pthread_cond_t netio_cond;
+    /*
+     * The thread in netio_dispatch, if dispatching is set.
+     */
+    pthread_t dispatch_thread;
+    int dispatching;
+    /*
+     * Handler whose callback is running.  Only valid during dispatch.
+     */
+    netio_handler_list_type* dispatch_current;
+#ifdef NETIO_USE_EPOLL
+    int epfd;
+    /*
+     * Handlers with a timeout, as a binary heap ordered on the
+     * absolute timeout.
+     */
+    netio_handler_list_type** timers;
+    size_t timers_count;
+    size_t timers_size;
+    /*
+     * Handler registered for each file descriptor, to notice file
+     * descriptors that were closed and reused.
+     */
+    netio_handler_list_type** fds;
+    size_t fds_size;
+    /*
+     * Events returned by epoll_pwait(2).  Events of handlers that were
+     * removed or changed meanwhile no longer match an id in fds.
+     */
+    struct epoll_event events[NETIO_EPOLL_EVENTS];
+    uint32_t next_id;
+    unsigned long round;
+#endif
 };
 
 /*
@@ -180,6 +268,17 @@ void netio_add_handler(netio_type* netio, netio_handler_type* handler);
  */
 void netio_remove_handler(netio_type* netio, netio_handler_type* handler);
 
+/*
+ * Tell netio that the fd, event types or timeout of a handler changed
+ * outside of its own callback.  Also needed when the fd was closed and
+ * reopened under the same number.  Does nothing if the handler was not
+ * added.
+ * \param[in] netio netio instance
+ * \param[in] handler handler
+ *
+ */
+void netio_update_handler(netio_type* netio, netio_handler_type* handler);
+
 /*
  * Retrieve the current time (using gettimeofday(2)).
  * \param[in] netio netio instance
@@ -193,7 +292,8 @@ const struct timespec* netio_current_time(netio_type* netio);
  * \param[in] netio netio instance
  * \param[in] timeout if specified, the maximum time to wait for an
  *                    event to arrive.
- * \param[in] sigmask is passed to the underlying pselect(2) call
+ * \param[in] sigmask is passed to the underlying epoll_pwait(2) or
+ *                    pselect(2) call
  * \return int the number of non-timeout events dispatched, 0 on timeout,
  *             and -1 on error (with errno set appropriately).
  *
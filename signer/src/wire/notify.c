@@ -37,6 +37,9 @@
 #include "wire/notify.h"
 #include "wire/xfrd.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
 #include <sys/socket.h>
 
 static const char* notify_str = "notify";
@@ -44,6 +47,18 @@ static const char* notify_str = "notify";
 static void notify_handle_zone(netio_type* netio,
     netio_handler_type* handler, netio_events_type event_types);
 
+/**
+ * Notifies sent to one secondary in the current second.
+ *
+ */
+typedef struct notify_rate_struct notify_rate_type;
+struct notify_rate_struct {
+    ldns_rbnode_t node;
+    char* address;
+    time_t second;
+    unsigned sent;
+};
+
 
 /**
  * Get time.
@@ -106,47 +121,51 @@ notify_create(xfrhandler_type* xfrhandler, zone_type* zone)
     CHECKALLOC(notify = (notify_type*) malloc(sizeof(notify_type)));
     notify->zone = zone;
     notify->xfrhandler = xfrhandler;
-    notify->waiting_next = NULL;
-    notify->secondary = NULL;
     notify->soa = NULL;
     notify->tsig_rr = tsig_rr_create();
-    notify->retry = 0;
-    notify->query_id = 0;
-    notify->is_waiting = 0;
+    notify->targets = NULL;
+    notify->num_targets = 0;
     notify->handler.fd = -1;
     notify->timeout.tv_sec = 0;
     notify->timeout.tv_nsec = 0;
     notify->handler.timeout = NULL;
     notify->handler.user_data = notify;
-    notify->handler.event_types =
-        NETIO_EVENT_READ|NETIO_EVENT_TIMEOUT;
+    notify->handler.event_types = NETIO_EVENT_TIMEOUT;
     notify->handler.event_handler = notify_handle_zone;
+    notify->handler.list = NULL;
     return notify;
 }
 
 
 /**
- * Setup notify.
+ * Release the query id of a notify.
  *
  */
 static void
-notify_setup(notify_type* notify)
+notify_release(notify_target_type* target)
 {
-    zone_type* zone = NULL;
-    dnsout_type* dnsout = NULL;
-    if (!notify) {
+    xfrhandler_type* xfrhandler = target->notify->xfrhandler;
+    if (target->has_id &&
+        xfrhandler->notify_ids[target->query_id] == target) {
+        xfrhandler->notify_ids[target->query_id] = NULL;
+    }
+    target->has_id = 0;
+}
+
+
+/**
+ * Stop notifying a secondary.
+ *
+ */
+static void
+notify_done(notify_target_type* target)
+{
+    if (!target->pending) {
         return;
     }
-    zone = (zone_type*) notify->zone;
-    ods_log_assert(zone);
-    ods_log_assert(zone->adoutbound);
-    ods_log_assert(zone->adoutbound->config);
-    ods_log_assert(zone->adoutbound->type == ADAPTER_DNS);
-    dnsout = (dnsout_type*) zone->adoutbound->config;
-    notify->retry = 0;
-    notify->secondary = dnsout->do_notify;
-    ods_log_debug("[%s] setup notify for zone %s", notify_str, zone->name);
-    notify_set_timer(notify, notify_time(notify));
+    notify_release(target);
+    target->pending = 0;
+    target->notify->xfrhandler->notify_pending--;
 }
 
 
@@ -157,119 +176,113 @@ notify_setup(notify_type* notify)
 static void
 notify_disable(notify_type* notify)
 {
-    xfrhandler_type* xfrhandler = NULL;
-    zone_type* zone = NULL;
+    size_t i = 0;
     if (!notify) {
         return;
     }
-    xfrhandler = (xfrhandler_type*) notify->xfrhandler;
-    ods_log_assert(xfrhandler);
-    zone = (zone_type*) notify->zone;
-    ods_log_assert(zone);
-    ods_log_assert(zone->name);
-    notify->secondary = NULL;
-    notify->handler.timeout = NULL;
-    if (notify->handler.fd != -1) {
-        close(notify->handler.fd);
-        notify->handler.fd = -1;
-    }
-    if (xfrhandler->notify_udp_num == NOTIFY_MAX_UDP) {
-        while (xfrhandler->notify_waiting_first) {
-            notify_type* wn = xfrhandler->notify_waiting_first;
-            ods_log_assert(wn->is_waiting);
-            wn->is_waiting = 0;
-            xfrhandler->notify_waiting_first = wn->waiting_next;
-            if (xfrhandler->notify_waiting_last == wn) {
-                xfrhandler->notify_waiting_last = NULL;
-            }
-            if (wn->secondary) {
-                ods_log_debug("[%s] zone %s notify off waiting list",
-                    notify_str, zone->name);
-                notify_setup(wn);
-                return;
-            }
-       }
+    for (i = 0; i < notify->num_targets; i++) {
+        notify_done(&notify->targets[i]);
     }
-    ods_log_debug("[%s] notify for zone %s disabled", notify_str, zone->name);
-    xfrhandler->notify_udp_num--;
+    free(notify->targets);
+    notify->targets = NULL;
+    notify->num_targets = 0;
+    notify->handler.timeout = NULL;
 }
 
 
 /**
- * Next secondary.
+ * Compare secondary addresses.
  *
  */
-static void
-notify_next(notify_type* notify)
+static int
+notify_rate_compare(const void* a, const void* b)
 {
-    if (!notify || !notify->secondary) {
-        return;
-    }
-    notify->secondary = notify->secondary->next;
-    notify->retry = 0;
-    if (!notify->secondary) {
-        zone_type* zone = (zone_type*) notify->zone;
-        ods_log_assert(zone);
-        ods_log_assert(zone->name);
-        ods_log_debug("[%s] zone %s no more secondaries, disable notify",
-            notify_str, zone->name);
-        notify_disable(notify);
-    }
+    return strcmp((const char*) a, (const char*) b);
 }
 
 
 /**
- * Read packet from udp.
+ * Take a notify from the budget of a secondary for this second.
+ * Returns 0 if the budget is used up.
  *
  */
 static int
-notify_udp_read_packet(notify_type* notify)
+notify_rate_take(xfrhandler_type* xfrhandler, acl_type* secondary,
+    time_t now)
 {
-    xfrhandler_type* xfrhandler = NULL;
-    ssize_t received = 0;
-    ods_log_assert(notify);
-    xfrhandler = (xfrhandler_type*) notify->xfrhandler;
-    ods_log_assert(xfrhandler);
-    buffer_clear(xfrhandler->packet);
-    received = recvfrom(notify->handler.fd, buffer_begin(xfrhandler->packet),
-        buffer_remaining(xfrhandler->packet), 0, NULL, NULL);
-    if (received == -1) {
-        ods_log_error("[%s] unable to read packet: recvfrom() failed fd %d "
-            "(%s)", notify_str, notify->handler.fd, strerror(errno));
+    ldns_rbnode_t* node = LDNS_RBTREE_NULL;
+    notify_rate_type* rate = NULL;
+    if (!xfrhandler->notify_rates) {
+        xfrhandler->notify_rates = ldns_rbtree_create(notify_rate_compare);
+        if (!xfrhandler->notify_rates) {
+            return 1;
+        }
+    }
+    node = ldns_rbtree_search(xfrhandler->notify_rates, secondary->address);
+    if (node && node != LDNS_RBTREE_NULL) {
+        rate = (notify_rate_type*) node->data;
+    } else {
+        CHECKALLOC(rate = (notify_rate_type*) calloc(1,
+            sizeof(notify_rate_type)));
+        CHECKALLOC(rate->address = strdup(secondary->address));
+        rate->node.key = rate->address;
+        rate->node.data = rate;
+        ldns_rbtree_insert(xfrhandler->notify_rates, &rate->node);
+    }
+    if (rate->second != now) {
+        rate->second = now;
+        rate->sent = 0;
+    }
+    if (rate->sent >= NOTIFY_MAX_RATE) {
         return 0;
     }
-    buffer_set_limit(xfrhandler->packet, received);
+    rate->sent++;
     return 1;
 }
 
 
+/**
+ * Check that a reply came from the secondary it was sent to.
+ *
+ */
+static int
+notify_from_secondary(acl_type* secondary, struct sockaddr_storage* from)
+{
+    if (secondary->family == AF_INET6) {
+        struct sockaddr_in6* addr6 = (struct sockaddr_in6*) from;
+        return from->ss_family == AF_INET6 &&
+            memcmp(&addr6->sin6_addr, &secondary->addr.addr6,
+            sizeof(struct in6_addr)) == 0;
+    } else {
+        struct sockaddr_in* addr = (struct sockaddr_in*) from;
+        return from->ss_family == AF_INET &&
+            memcmp(&addr->sin_addr, &secondary->addr.addr,
+            sizeof(struct in_addr)) == 0;
+    }
+}
+
+
 /**
  * Handle notify reply.
  *
  */
 static int
-notify_handle_reply(notify_type* notify)
+notify_handle_reply(notify_target_type* target)
 {
     xfrhandler_type* xfrhandler = NULL;
     zone_type* zone = NULL;
-    ods_log_assert(notify);
-    ods_log_assert(notify->secondary);
-    ods_log_assert(notify->secondary->address);
-    xfrhandler = (xfrhandler_type*) notify->xfrhandler;
-    zone = (zone_type*) notify->zone;
+    ods_log_assert(target);
+    ods_log_assert(target->secondary);
+    ods_log_assert(target->secondary->address);
+    xfrhandler = (xfrhandler_type*) target->notify->xfrhandler;
+    zone = (zone_type*) target->notify->zone;
     ods_log_assert(xfrhandler);
     ods_log_assert(zone);
     ods_log_assert(zone->name);
-    if (xfrhandler->packet->limit < 3 ||
-        (buffer_pkt_opcode(xfrhandler->packet) != LDNS_PACKET_NOTIFY) ||
+    if ((buffer_pkt_opcode(xfrhandler->packet) != LDNS_PACKET_NOTIFY) ||
         (buffer_pkt_qr(xfrhandler->packet) == 0)) {
         ods_log_error("[%s] zone %s received bad notify reply opcode/qr from %s",
-            notify_str, zone->name, notify->secondary->address);
-        return 0;
-    }
-    if (buffer_pkt_id(xfrhandler->packet) != notify->query_id) {
-        ods_log_error("[%s] zone %s received bad notify reply id from %s",
-            notify_str, zone->name, notify->secondary->address);
+            notify_str, zone->name, target->secondary->address);
         return 0;
     }
     /* could check tsig */
@@ -277,50 +290,43 @@ notify_handle_reply(notify_type* notify)
         const char* str = buffer_rcode2str(buffer_pkt_rcode(xfrhandler->packet));
         ods_log_error("[%s] zone %s received bad notify rcode %s from %s",
             notify_str, zone->name, str?str:"UNKNOWN",
-            notify->secondary->address);
+            target->secondary->address);
         if (buffer_pkt_rcode(xfrhandler->packet) != LDNS_RCODE_NOTIMPL) {
             return 1;
         }
         return 0;
     }
     ods_log_debug("[%s] zone %s secondary %s notify reply ok", notify_str,
-        zone->name, notify->secondary->address);
+        zone->name, target->secondary->address);
     return 1;
 }
 
 
 /**
- * Send notify over udp.
+ * Get the notify socket for an address family.
  *
  */
 static int
-notify_send_udp(notify_type* notify, buffer_type* buffer)
+notify_socket(xfrhandler_type* xfrhandler, int family)
 {
-    struct sockaddr_storage to;
-    socklen_t to_len = 0;
+    netio_handler_type* handler = &xfrhandler->notify4;
     int fd = -1;
-    int family = PF_INET;
-    ssize_t nb = 0;
-    ods_log_assert(buffer);
-    ods_log_assert(notify);
-    ods_log_assert(notify->secondary);
-    ods_log_assert(notify->secondary->address);
-    /* this will set the remote port to acl->port or TCP_PORT */
-    to_len = xfrd_acl_sockaddr_to(notify->secondary, &to);
-    /* get the address family of the remote host */
-    if (notify->secondary->family == AF_INET6) {
-        family = PF_INET6;
+    if (family == AF_INET6) {
+        handler = &xfrhandler->notify6;
+    }
+    if (handler->fd != -1) {
+        return handler->fd;
     }
     /* create socket */
-    fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    fd = socket(family == AF_INET6 ? PF_INET6 : PF_INET, SOCK_DGRAM,
+        IPPROTO_UDP);
     if (fd == -1) {
-        ods_log_error("[%s] unable to send data over udp to %s: "
-            "socket() failed (%s)", notify_str, notify->secondary->address,
-            strerror(errno));
+        ods_log_error("[%s] unable to create notify socket: "
+            "socket() failed (%s)", notify_str, strerror(errno));
         return -1;
     }
     /* bind it */
-    interface_type interface = notify->xfrhandler->engine->dnshandler->interfaces->interfaces[0];
+    interface_type interface = xfrhandler->engine->dnshandler->interfaces->interfaces[0];
     if (!interface.address) {
         ods_log_error("[%s] unable to get the address of interface", notify_str);
         close(fd);
@@ -348,19 +354,14 @@ notify_send_udp(notify_type* notify, buffer_type* buffer)
             return -1;
         }
     }
-
-    /* send it (udp) */
-    ods_log_deeebug("[%s] send %ld bytes over udp to %s", notify_str,
-        (unsigned long)buffer_remaining(buffer), notify->secondary->address);
-    nb = sendto(fd, buffer_current(buffer), buffer_remaining(buffer), 0,
-        (struct sockaddr*)&to, to_len);
-    if (nb == -1) {
-        ods_log_error("[%s] unable to send data over udp to %s: "
-            "sendto() failed (%s)", notify_str, notify->secondary->address,
-            strerror(errno));
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+        ods_log_error("[%s] unable to set notify socket to non-blocking: "
+            "fcntl() failed (%s)", notify_str, strerror(errno));
         close(fd);
         return -1;
     }
+    handler->fd = fd;
+    netio_update_handler(xfrhandler->netio, handler);
     return fd;
 }
 
@@ -370,22 +371,23 @@ notify_send_udp(notify_type* notify, buffer_type* buffer)
  *
  */
 static void
-notify_tsig_sign(notify_type* notify, buffer_type* buffer)
+notify_tsig_sign(notify_type* notify, acl_type* secondary,
+    buffer_type* buffer)
 {
     tsig_algo_type* algo = NULL;
-    if (!notify || !notify->tsig_rr || !notify->secondary ||
-        !notify->secondary->tsig || !notify->secondary->tsig->key ||
+    if (!notify || !notify->tsig_rr || !secondary ||
+        !secondary->tsig || !secondary->tsig->key ||
         !buffer) {
         return; /* no tsig configured */
     }
-    algo = tsig_lookup_algo(notify->secondary->tsig->algorithm);
+    algo = tsig_lookup_algo(secondary->tsig->algorithm);
     if (!algo) {
         ods_log_error("[%s] unable to sign notify: tsig unknown algorithm "
-            "%s", notify_str, notify->secondary->tsig->algorithm);
+            "%s", notify_str, secondary->tsig->algorithm);
         return;
     }
     ods_log_assert(algo);
-    tsig_rr_reset(notify->tsig_rr, algo, notify->secondary->tsig->key);
+    tsig_rr_reset(notify->tsig_rr, algo, secondary->tsig->key);
     notify->tsig_rr->original_query_id = buffer_pkt_id(buffer);
     notify->tsig_rr->algo_name =
         ldns_rdf_clone(notify->tsig_rr->algo->wf_name);
@@ -406,29 +408,46 @@ notify_tsig_sign(notify_type* notify, buffer_type* buffer)
 
 
 /**
- * Send notify.
+ * Send notify to a secondary.
  *
  */
-void
-notify_send(notify_type* notify)
+static int
+notify_send(notify_target_type* target)
 {
     xfrhandler_type* xfrhandler = NULL;
+    notify_type* notify = NULL;
     zone_type* zone = NULL;
-    ods_log_assert(notify);
-    ods_log_assert(notify->secondary);
-    ods_log_assert(notify->secondary->address);
+    struct sockaddr_storage to;
+    socklen_t to_len = 0;
+    int fd = -1;
+    int tries = 0;
+    ssize_t nb = 0;
+    ods_log_assert(target);
+    ods_log_assert(target->secondary);
+    ods_log_assert(target->secondary->address);
+    notify = target->notify;
     xfrhandler = (xfrhandler_type*) notify->xfrhandler;
     zone = (zone_type*) notify->zone;
     ods_log_assert(xfrhandler);
     ods_log_assert(zone);
     ods_log_assert(zone->name);
-    if (notify->handler.fd != -1) {
-        close(notify->handler.fd);
+    notify_release(target);
+    fd = notify_socket(xfrhandler, target->secondary->family);
+    if (fd == -1) {
+        return 0;
     }
-    notify->handler.fd = -1;
-    notify->timeout.tv_sec = notify_time(notify) + NOTIFY_RETRY_TIMEOUT;
     buffer_pkt_notify(xfrhandler->packet, zone->apex, LDNS_RR_CLASS_IN);
-    notify->query_id = buffer_pkt_id(xfrhandler->packet);
+    /* replies are matched on query id */
+    while (xfrhandler->notify_ids[buffer_pkt_id(xfrhandler->packet)]) {
+        if (++tries > NOTIFY_ID_TRIES) {
+            ods_log_error("[%s] unable to send notify for zone %s to %s: "
+                "no free query id", notify_str, zone->name,
+                target->secondary->address);
+            return 0;
+        }
+        buffer_pkt_set_random_id(xfrhandler->packet);
+    }
+    target->query_id = buffer_pkt_id(xfrhandler->packet);
     buffer_pkt_set_aa(xfrhandler->packet);
     /* add current SOA to answer section */
     if (notify->soa) {
@@ -436,24 +455,33 @@ notify_send(notify_type* notify)
             buffer_pkt_set_ancount(xfrhandler->packet, 1);
         }
     }
-    if (notify->secondary->tsig) {
-        notify_tsig_sign(notify, xfrhandler->packet);
+    if (target->secondary->tsig) {
+        notify_tsig_sign(notify, target->secondary, xfrhandler->packet);
     }
     buffer_flip(xfrhandler->packet);
-    notify->handler.fd = notify_send_udp(notify, xfrhandler->packet);
-    if (notify->handler.fd == -1) {
-        ods_log_error("[%s] unable to send notify retry %u for zone %s to "
-            "%s: notify_send_udp() failed", notify_str, notify->retry,
-            zone->name, notify->secondary->address);
-        return;
+    /* this will set the remote port to acl->port or TCP_PORT */
+    to_len = xfrd_acl_sockaddr_to(target->secondary, &to);
+    ods_log_deeebug("[%s] send %ld bytes over udp to %s", notify_str,
+        (unsigned long)buffer_remaining(xfrhandler->packet),
+        target->secondary->address);
+    nb = sendto(fd, buffer_current(xfrhandler->packet),
+        buffer_remaining(xfrhandler->packet), 0, (struct sockaddr*)&to,
+        to_len);
+    if (nb == -1) {
+        ods_log_error("[%s] unable to send data over udp to %s: "
+            "sendto() failed (%s)", notify_str, target->secondary->address,
+            strerror(errno));
+        return 0;
     }
-    ods_log_verbose("[%s] notify retry %u for zone %s sent to %s", notify_str,
-        notify->retry, zone->name, notify->secondary->address);
+    xfrhandler->notify_ids[target->query_id] = target;
+    target->has_id = 1;
+    return 1;
 }
 
 
 /**
- * Handle notify.
+ * Handle notify. Send to all secondaries that are due, as far as their
+ * rate limits allow.
  *
  */
 static void
@@ -463,6 +491,10 @@ notify_handle_zone(netio_type* ATTR_UNUSED(netio),
     notify_type* notify = NULL;
     xfrhandler_type* xfrhandler = NULL;
     zone_type* zone = NULL;
+    notify_target_type* target = NULL;
+    time_t now = 0;
+    time_t next = 0;
+    size_t i = 0;
     if (!handler) {
         return;
     }
@@ -473,40 +505,116 @@ notify_handle_zone(netio_type* ATTR_UNUSED(netio),
     ods_log_assert(xfrhandler);
     ods_log_assert(zone);
     ods_log_assert(zone->name);
+    ods_log_assert(event_types & NETIO_EVENT_TIMEOUT);
     ods_log_debug("[%s] handle notify for zone %s", notify_str, zone->name);
 
-    if (notify->is_waiting) {
-        ods_log_debug("[%s] already waiting, skipping notify for zone %s",
+    pthread_mutex_lock(&xfrhandler->notify_lock);
+    now = notify_time(notify);
+    for (i = 0; i < notify->num_targets; i++) {
+        target = &notify->targets[i];
+        if (!target->pending) {
+            continue;
+        }
+        if (target->timeout <= now) {
+            if (target->retry >= NOTIFY_MAX_RETRY) {
+                ods_log_verbose("[%s] notify max retry for zone %s, %s "
+                    "unreachable", notify_str, zone->name,
+                    target->secondary->address);
+                xfrhandler->notify_timedout++;
+                notify_done(target);
+                continue;
+            }
+            if (!notify_rate_take(xfrhandler, target->secondary, now)) {
+                /* try again in the next second */
+                target->timeout = now + 1;
+            } else {
+                target->retry++;
+                target->timeout = now + NOTIFY_RETRY_TIMEOUT;
+                if (notify_send(target)) {
+                    ods_log_verbose("[%s] notify retry %u for zone %s sent "
+                        "to %s", notify_str, target->retry, zone->name,
+                        target->secondary->address);
+                } else {
+                    ods_log_error("[%s] unable to send notify retry %u for "
+                        "zone %s to %s", notify_str, target->retry,
+                        zone->name, target->secondary->address);
+                }
+            }
+        }
+        if (!next || target->timeout < next) {
+            next = target->timeout;
+        }
+    }
+    if (next) {
+        notify->handler.timeout = &notify->timeout;
+        notify->timeout.tv_sec = next;
+        notify->timeout.tv_nsec = 0;
+    } else {
+        ods_log_debug("[%s] zone %s no more secondaries, disable notify",
             notify_str, zone->name);
-        ods_log_assert(notify->handler.fd == -1);
+        notify_disable(notify);
+    }
+    pthread_mutex_unlock(&xfrhandler->notify_lock);
+}
+
+
+/**
+ * Handle notify replies.
+ *
+ */
+void
+notify_handle_udp(netio_type* ATTR_UNUSED(netio),
+    netio_handler_type* handler, netio_events_type event_types)
+{
+    xfrhandler_type* xfrhandler = NULL;
+    notify_target_type* target = NULL;
+    notify_type* notify = NULL;
+    struct sockaddr_storage from;
+    socklen_t fromlen = sizeof(from);
+    ssize_t received = 0;
+    if (!handler || !(event_types & NETIO_EVENT_READ)) {
         return;
     }
-    if (event_types & NETIO_EVENT_READ) {
-        ods_log_debug("[%s] read notify ok for zone %s", notify_str,
-            zone->name);
-        ods_log_assert(notify->handler.fd != -1);
-        if (notify_udp_read_packet(notify)) {
-            if (notify_handle_reply(notify)) {
-                notify_next(notify);
-            }
-        }
-    } else if(event_types & NETIO_EVENT_TIMEOUT) {
-        ods_log_debug("[%s] notify timeout for zone %s", notify_str,
-            zone->name);
-        /* timeout, try again */
-    }
-    /* see if notify is still enabled */
-    if (notify->secondary) {
-        ods_log_assert(notify->secondary->address);
-        notify->retry++;
-        if (notify->retry > NOTIFY_MAX_RETRY) {
-            ods_log_verbose("[%s] notify max retry for zone %s, %s unreachable",
-                notify_str, zone->name, notify->secondary->address);
-            notify_next(notify);
-        } else {
-            notify_send(notify);
+    xfrhandler = (xfrhandler_type*) handler->user_data;
+    ods_log_assert(xfrhandler);
+    buffer_clear(xfrhandler->packet);
+    received = recvfrom(handler->fd, buffer_begin(xfrhandler->packet),
+        buffer_remaining(xfrhandler->packet), 0,
+        (struct sockaddr*) &from, &fromlen);
+    if (received == -1) {
+        if (errno != EAGAIN && errno != EINTR) {
+            ods_log_error("[%s] unable to read packet: recvfrom() failed "
+                "fd %d (%s)", notify_str, handler->fd, strerror(errno));
         }
+        return;
     }
+    buffer_set_limit(xfrhandler->packet, received);
+    if (xfrhandler->packet->limit < 3) {
+        ods_log_error("[%s] received bad notify reply", notify_str);
+        return;
+    }
+    pthread_mutex_lock(&xfrhandler->notify_lock);
+    target = xfrhandler->notify_ids[buffer_pkt_id(xfrhandler->packet)];
+    if (!target || !notify_from_secondary(target->secondary, &from)) {
+        ods_log_error("[%s] received notify reply with unknown id %u",
+            notify_str, buffer_pkt_id(xfrhandler->packet));
+        pthread_mutex_unlock(&xfrhandler->notify_lock);
+        return;
+    }
+    notify = target->notify;
+    if (notify_handle_reply(target)) {
+        xfrhandler->notify_acked++;
+        notify_done(target);
+    } else {
+        /* try again right away */
+        notify_release(target);
+        target->timeout = notify_time(notify);
+        notify->handler.timeout = &notify->timeout;
+        notify->timeout.tv_sec = target->timeout;
+        notify->timeout.tv_nsec = 0;
+        netio_update_handler(xfrhandler->netio, &notify->handler);
+    }
+    pthread_mutex_unlock(&xfrhandler->notify_lock);
 }
 
 
@@ -537,6 +645,8 @@ notify_enable(notify_type* notify, ldns_rr* soa)
     xfrhandler_type* xfrhandler = NULL;
     zone_type* zone = NULL;
     dnsout_type* dnsout = NULL;
+    acl_type* acl = NULL;
+    size_t i = 0;
     if (!notify) {
         return;
     }
@@ -554,32 +664,25 @@ notify_enable(notify_type* notify, ldns_rr* soa)
             zone->name);
         return; /* nothing to do */
     }
-    if (notify->is_waiting || notify->handler.fd != -1) {
-        ods_log_debug("[%s] zone %s already on waiting list", notify_str,
-            zone->name);
-       return;
-    }
+    pthread_mutex_lock(&xfrhandler->notify_lock);
+    /* notifies for an older serial are no longer needed */
+    notify_disable(notify);
     notify_update_soa(notify, soa);
-    if (xfrhandler->notify_udp_num < NOTIFY_MAX_UDP) {
-        notify_setup(notify);
-        xfrhandler->notify_udp_num++;
-        ods_log_debug("[%s] zone %s notify enabled", notify_str,
-            zone->name);
-        return;
+    for (acl = dnsout->do_notify; acl; acl = acl->next) {
+        notify->num_targets++;
     }
-    /* put it in waiting list */
-    notify->secondary = dnsout->do_notify;
-    notify->is_waiting = 1;
-    notify->waiting_next = NULL;
-    if (xfrhandler->notify_waiting_last) {
-        xfrhandler->notify_waiting_last->waiting_next = notify;
-    } else {
-        xfrhandler->notify_waiting_first = notify;
+    CHECKALLOC(notify->targets = (notify_target_type*) calloc(
+        notify->num_targets, sizeof(notify_target_type)));
+    for (acl = dnsout->do_notify, i = 0; acl; acl = acl->next, i++) {
+        notify->targets[i].notify = notify;
+        notify->targets[i].secondary = acl;
+        notify->targets[i].pending = 1;
+        xfrhandler->notify_pending++;
     }
-    xfrhandler->notify_waiting_last = notify;
-    notify->handler.timeout = NULL;
-    ods_log_debug("[%s] zone %s notify on waiting list", notify_str,
-        zone->name);
+    notify_set_timer(notify, notify_time(notify));
+    netio_update_handler(xfrhandler->netio, &notify->handler);
+    pthread_mutex_unlock(&xfrhandler->notify_lock);
+    ods_log_debug("[%s] zone %s notify enabled", notify_str, zone->name);
 }
 
 
@@ -590,16 +693,59 @@ notify_enable(notify_type* notify, ldns_rr* soa)
 void
 notify_cleanup(notify_type* notify)
 {
+    xfrhandler_type* xfrhandler = NULL;
     if (!notify) {
         return;
     }
-    if (notify->handler.fd != -1) {
-        close(notify->handler.fd);
-        notify->handler.fd = -1;
-    }
+    xfrhandler = (xfrhandler_type*) notify->xfrhandler;
+    pthread_mutex_lock(&xfrhandler->notify_lock);
+    notify_disable(notify);
+    pthread_mutex_unlock(&xfrhandler->notify_lock);
     if (notify->soa) {
         ldns_rr_free(notify->soa);
     }
     tsig_rr_cleanup(notify->tsig_rr);
     free(notify);
 }
+
+
+/**
+ * Free notify rate.
+ *
+ */
+static void
+notify_rate_free(ldns_rbnode_t* node, void* ATTR_UNUSED(arg))
+{
+    notify_rate_type* rate = (notify_rate_type*) node->data;
+    free(rate->address);
+    free(rate);
+}
+
+
+/**
+ * Cleanup the notify sockets and rate limits of the zone transfer handler.
+ *
+ */
+void
+notify_cleanup_shared(xfrhandler_type* xfrhandler)
+{
+    if (!xfrhandler) {
+        return;
+    }
+    if (xfrhandler->notify4.fd != -1) {
+        close(xfrhandler->notify4.fd);
+        xfrhandler->notify4.fd = -1;
+    }
+    if (xfrhandler->notify6.fd != -1) {
+        close(xfrhandler->notify6.fd);
+        xfrhandler->notify6.fd = -1;
+    }
+    if (xfrhandler->notify_rates) {
+        ldns_traverse_postorder(xfrhandler->notify_rates, notify_rate_free,
+            NULL);
+        ldns_rbtree_free(xfrhandler->notify_rates);
+        xfrhandler->notify_rates = NULL;
+    }
+    free(xfrhandler->notify_ids);
+    xfrhandler->notify_ids = NULL;
+}
@@ -36,6 +36,7 @@
 #include <ldns/ldns.h>
 
 typedef struct notify_struct notify_type;
+typedef struct notify_target_struct notify_target_type;
 
 #include "status.h"
 #include "wire/acl.h"
@@ -45,26 +46,40 @@ typedef struct notify_struct notify_type;
 #include "daemon/xfrhandler.h"
 #include "signer/zone.h"
 
-#define NOTIFY_MAX_UDP 50
 #define NOTIFY_MAX_RETRY 5
 #define NOTIFY_RETRY_TIMEOUT 15
+/* Maximum number of notifies sent to one secondary per second */
+#define NOTIFY_MAX_RATE 100
+/* Number of random query ids tried before giving up */
+#define NOTIFY_ID_TRIES 16
 
 /**
- * Notify.
+ * Notify to one secondary.
+ *
+ */
+struct notify_target_struct {
+    notify_type* notify;
+    acl_type* secondary;
+    time_t timeout;
+    uint16_t query_id;
+    uint8_t retry;
+    unsigned pending : 1;
+    unsigned has_id : 1;
+};
+
+/**
+ * Notify. All secondaries of a zone are notified at the same time.
  *
  */
 struct notify_struct {
-    notify_type* waiting_next;
     ldns_rr* soa;
     tsig_rr_type* tsig_rr;
-    acl_type* secondary;
+    notify_target_type* targets;
+    size_t num_targets;
     zone_type* zone;
     xfrhandler_type* xfrhandler;
     netio_handler_type handler;
     struct timespec timeout;
-    uint16_t query_id;
-    uint8_t retry;
-    unsigned is_waiting : 1;
 };
 
 /**
@@ -85,11 +100,22 @@ notify_type* notify_create(xfrhandler_type* xfrhandler, zone_type* zone);
 void notify_enable(notify_type* notify, ldns_rr* soa);
 
 /**
- * Send notify.
- * \param[in] notify notify structure
+ * Handle notify replies. Replies for all zones arrive on the notify
+ * sockets of the zone transfer handler.
+ * \param[in] netio network I/O event handler
+ * \param[in] handler event handler
+ * \param[in] event_types the types of events that should be checked for
+ *
+ */
+void notify_handle_udp(netio_type* netio, netio_handler_type* handler,
+    netio_events_type event_types);
+
+/**
+ * Cleanup the notify sockets and rate limits of the zone transfer handler.
+ * \param[in] xfrhandler zone transfer handler
  *
  */
-void notify_send(notify_type* notify);
+void notify_cleanup_shared(xfrhandler_type* xfrhandler);
 
 /**
  * Cleanup notify structure.
@@ -37,6 +37,8 @@
 #include "wire/axfr.h"
 #include "wire/query.h"
 
+#include <ctype.h>
+
 const char* query_str = "query";
 
 
@@ -52,6 +54,8 @@ query_create(void)
     q->buffer = NULL;
     q->tsig_rr = NULL;
     q->axfr_fd = NULL;
+    memset(q->compress, 0, sizeof(q->compress));
+    q->compress_gen = 0;
     q->buffer = buffer_create(PACKET_BUFFER_SIZE);
     if (!q->buffer) {
         query_cleanup(q);
@@ -72,6 +76,206 @@ query_create(void)
 }
 
 
+/**
+ * Forget the names in the compression table.
+ *
+ */
+static void
+query_compress_reset(query_type* q)
+{
+    q->compress_gen++;
+    if (q->compress_gen == 0) {
+        memset(q->compress, 0, sizeof(q->compress));
+        q->compress_gen = 1;
+    }
+}
+
+
+/**
+ * Find the labels of an uncompressed domain name and hash its suffixes,
+ * case insensitive. Returns the number of labels, or -1 if malformed.
+ *
+ */
+static int
+query_compress_hash(const uint8_t* name, size_t size, size_t* labels,
+    uint32_t* hashes)
+{
+    uint32_t h = 2166136261U;
+    size_t pos = 0, j = 0;
+    int count = 0, i = 0;
+    while (pos < size && name[pos] != 0) {
+        if ((name[pos] & 0xc0) || count >= (MAXDOMAINLEN+1)/2) {
+            return -1;
+        }
+        labels[count++] = pos;
+        pos += name[pos] + 1;
+    }
+    if (pos >= size) {
+        return -1;
+    }
+    /* shortest suffix first, so that each extends the previous hash */
+    for (i = count; i > 0; i--) {
+        pos = labels[i-1];
+        for (j = pos; j <= pos + name[pos]; j++) {
+            h ^= (uint32_t) tolower((unsigned char) name[j]);
+            h *= 16777619U;
+        }
+        hashes[i-1] = h;
+    }
+    return count;
+}
+
+
+/**
+ * Remember the suffixes of a name written at offset start.
+ *
+ */
+static void
+query_compress_add(query_type* q, size_t start, size_t* labels,
+    uint32_t* hashes, int count)
+{
+    int i = 0;
+    for (i = 0; i < count; i++) {
+        if (start + labels[i] >= QUERY_COMPRESS_MAX_OFFSET) {
+            return;
+        }
+        q->compress[hashes[i] & (QUERY_COMPRESS_SIZE-1)] =
+            ((uint32_t) q->compress_gen << 16) | (start + labels[i]);
+    }
+}
+
+
+/**
+ * Does the name at offset pos in the message equal the uncompressed name?
+ * Only the part of the message that has been written is looked at, and
+ * only backward pointers are followed.
+ *
+ */
+static int
+query_compress_match(query_type* q, size_t pos, const uint8_t* name)
+{
+    const uint8_t* wire = buffer_begin(q->buffer);
+    size_t limit = buffer_position(q->buffer);
+    size_t ptr = 0, i = 0;
+    uint8_t len = 0;
+    while (pos < limit) {
+        len = wire[pos];
+        if ((len & 0xc0) == 0xc0) {
+            if (pos + 1 >= limit) {
+                return 0;
+            }
+            ptr = ((size_t) (len & 0x3f) << 8) | wire[pos+1];
+            if (ptr >= pos) {
+                return 0;
+            }
+            pos = ptr;
+            continue;
+        }
+        if (len != name[0]) {
+            return 0;
+        } else if (len == 0) {
+            return 1;
+        } else if (pos + 1 + len > limit) {
+            return 0;
+        }
+        for (i = 1; i <= len; i++) {
+            if (tolower(wire[pos+i]) != tolower(name[i])) {
+                return 0;
+            }
+        }
+        pos += len + 1;
+        name += len + 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Write domain name, compressed against the names earlier in the message.
+ *
+ */
+static void
+query_write_dname(query_type* q, ldns_rdf* dname)
+{
+    const uint8_t* name = ldns_rdf_data(dname);
+    size_t labels[(MAXDOMAINLEN+1)/2];
+    uint32_t hashes[(MAXDOMAINLEN+1)/2];
+    size_t start = buffer_position(q->buffer);
+    uint32_t entry = 0;
+    int count = 0, i = 0;
+
+    count = query_compress_hash(name, ldns_rdf_size(dname), labels, hashes);
+    if (count < 0) {
+        buffer_write_rdf(q->buffer, dname);
+        return;
+    }
+    /* longest suffix that is already in the message */
+    for (i = 0; i < count; i++) {
+        entry = q->compress[hashes[i] & (QUERY_COMPRESS_SIZE-1)];
+        if ((entry >> 16) == q->compress_gen &&
+            query_compress_match(q, entry & 0xffff, name + labels[i])) {
+            break;
+        }
+    }
+    query_compress_add(q, start, labels, hashes, i);
+    if (i < count) {
+        buffer_write(q->buffer, name, labels[i]);
+        buffer_write_u16(q->buffer, 0xc000 | (entry & 0x3fff));
+    } else {
+        buffer_write_rdf(q->buffer, dname);
+    }
+}
+
+
+/**
+ * Remember the question name, so that answers can point to it.
+ *
+ */
+static void
+query_compress_qname(query_type* q)
+{
+    size_t labels[(MAXDOMAINLEN+1)/2];
+    uint32_t hashes[(MAXDOMAINLEN+1)/2];
+    int count = 0;
+    if (buffer_pkt_qdcount(q->buffer) == 0 ||
+        buffer_position(q->buffer) <= BUFFER_PKT_HEADER_SIZE) {
+        return;
+    }
+    count = query_compress_hash(buffer_at(q->buffer, BUFFER_PKT_HEADER_SIZE),
+        buffer_position(q->buffer) - BUFFER_PKT_HEADER_SIZE, labels, hashes);
+    if (count > 0) {
+        query_compress_add(q, BUFFER_PKT_HEADER_SIZE, labels, hashes, count);
+    }
+}
+
+
+/**
+ * May names in the rdata of this type be compressed (RFC 3597)?
+ *
+ */
+static int
+query_compress_rdata(ldns_rr_type type)
+{
+    switch (type) {
+        case LDNS_RR_TYPE_NS:
+        case LDNS_RR_TYPE_MD:
+        case LDNS_RR_TYPE_MF:
+        case LDNS_RR_TYPE_CNAME:
+        case LDNS_RR_TYPE_SOA:
+        case LDNS_RR_TYPE_MB:
+        case LDNS_RR_TYPE_MG:
+        case LDNS_RR_TYPE_MR:
+        case LDNS_RR_TYPE_PTR:
+        case LDNS_RR_TYPE_MINFO:
+        case LDNS_RR_TYPE_MX:
+            return 1;
+        default:
+            break;
+    }
+    return 0;
+}
+
+
 /**
  * Reset query.
  *
@@ -95,6 +299,7 @@ query_reset(query_type* q, size_t maxlen, int is_tcp)
     /* qname, qtype, qclass */
     q->zone = NULL;
     /* domain, opcode, cname count, delegation, compression, temp */
+    query_compress_reset(q);
     q->axfr_is_done = 0;
     if (q->axfr_fd) {
         ods_fclose(q->axfr_fd);
@@ -297,7 +502,7 @@ query_process_notify(query_type* q, ldns_rr_type qtype, engine_type* engine)
     }
     ods_log_assert(q->zone->adinbound->config);
     dnsin = (dnsin_type*) q->zone->adinbound->config;
-    if (!acl_find(dnsin->allow_notify, &q->addr, q->tsig_rr)) {
+    if (!acl_index_find(dnsin->allow_notify_index, &q->addr, q->tsig_rr)) {
         if (addr2ip(q->addr, address, sizeof(address))) {
             ods_log_info("[%s] unauthorized notify for zone %s from %s: "
                 "no acl matches", query_str, q->zone->name, address);
@@ -458,7 +663,7 @@ query_process_ixfr(query_type* q)
  *
  */
 static int
-response_add_rrset(response_type* r, rrset_type* rrset,
+response_add_rrset(response_type* r, zone_served_rrset_type* rrset,
     ldns_pkt_section section)
 {
     if (!r || !rrset || !section) {
@@ -502,21 +707,23 @@ response_encode_rr(query_type* q, ldns_rr* rr, ldns_pkt_section section)
  *
  */
 static uint16_t
-response_encode_rrset(query_type* q, rrset_type* rrset, ldns_pkt_section section)
+response_encode_rrset(query_type* q, zone_served_rrset_type* rrset,
+    ldns_pkt_section section)
 {
-    rrsig_type* rrsig;
-    uint16_t i = 0;
+    size_t i = 0;
     uint16_t added = 0;
     ods_log_assert(q);
     ods_log_assert(rrset);
     ods_log_assert(section);
 
-    for (i = 0; i < rrset->rr_count; i++) {
-        added += response_encode_rr(q, rrset->rrs[i].rr, section);
+    for (i = 0; i < ldns_rr_list_rr_count(rrset->rrs); i++) {
+        added += response_encode_rr(q, ldns_rr_list_rr(rrset->rrs, i),
+            section);
     }
     if (q->edns_rr && q->edns_rr->dnssec_ok) {
-        while((rrsig = collection_iterator(rrset->rrsigs))) {
-            added += response_encode_rr(q, rrsig->rr, section);
+        for (i = 0; i < ldns_rr_list_rr_count(rrset->rrsigs); i++) {
+            added += response_encode_rr(q, ldns_rr_list_rr(rrset->rrsigs, i),
+                section);
         }
     }
     /* truncation? */
@@ -561,44 +768,49 @@ response_encode(query_type* q, response_type* r)
 static query_state
 query_response(query_type* q, ldns_rr_type qtype)
 {
-    rrset_type* rrset = NULL;
+    zone_served_type* served = NULL;
+    zone_served_rrset_type* rrset = NULL;
     response_type r;
     if (!q || !q->zone) {
         return QUERY_DISCARDED;
     }
     r.rrset_count = 0;
-    pthread_mutex_lock(&q->zone->zone_lock);
-    rrset = zone_lookup_rrset(q->zone, q->zone->apex, qtype);
+    /* answer from the served version, signing may go on meanwhile */
+    served = zone_served_acquire(q->zone);
+    if (!served) {
+        /* not signed and written yet, the zone lock is not ours to take */
+        return query_servfail(q);
+    }
+    rrset = zone_served_lookup(served, qtype);
     if (rrset) {
         if (!response_add_rrset(&r, rrset, LDNS_SECTION_ANSWER)) {
-            pthread_mutex_unlock(&q->zone->zone_lock);
+            zone_served_release(q->zone, served);
             return query_servfail(q);
         }
         /* NS RRset goes into Authority Section */
-        rrset = zone_lookup_rrset(q->zone, q->zone->apex, LDNS_RR_TYPE_NS);
+        rrset = zone_served_lookup(served, LDNS_RR_TYPE_NS);
         if (rrset) {
             if (!response_add_rrset(&r, rrset, LDNS_SECTION_AUTHORITY)) {
-                pthread_mutex_unlock(&q->zone->zone_lock);
+                zone_served_release(q->zone, served);
                 return query_servfail(q);
             }
         } /* else: not having NS RRs is not fatal  */
     } else if (qtype != LDNS_RR_TYPE_SOA) {
-        rrset = zone_lookup_rrset(q->zone, q->zone->apex, LDNS_RR_TYPE_SOA);
+        rrset = zone_served_lookup(served, LDNS_RR_TYPE_SOA);
         if (!rrset) {
-            pthread_mutex_unlock(&q->zone->zone_lock);
+            zone_served_release(q->zone, served);
             return query_servfail(q);
         }
         if (!response_add_rrset(&r, rrset, LDNS_SECTION_AUTHORITY)) {
-            pthread_mutex_unlock(&q->zone->zone_lock);
+            zone_served_release(q->zone, served);
             return query_servfail(q);
         }
     } else {
-        pthread_mutex_unlock(&q->zone->zone_lock);
+        zone_served_release(q->zone, served);
         return query_servfail(q);
     }
-    pthread_mutex_unlock(&q->zone->zone_lock);
-
     response_encode(q, &r);
+    zone_served_release(q->zone, served);
     /* compression */
     return QUERY_PROCESSED;
 }
@@ -625,6 +837,9 @@ query_prepare(query_type* q)
     buffer_set_limit(q->buffer, buffer_capacity(q->buffer));
     q->reserved_space = edns_rr_reserved_space(q->edns_rr);
     q->reserved_space += tsig_rr_reserved_space(q->tsig_rr);
+    /* new message, new compression table */
+    query_compress_reset(q);
+    query_compress_qname(q);
 }
 
 
@@ -661,7 +876,7 @@ query_process_query(query_type* q, ldns_rr_type qtype, engine_type* engine)
     ods_log_assert(q->zone->adoutbound->config);
     dnsout = (dnsout_type*) q->zone->adoutbound->config;
     /* acl also in use for soa and other queries */
-    if (!acl_find(dnsout->provide_xfr, &q->addr, q->tsig_rr)) {
+    if (!acl_index_find(dnsout->provide_xfr_index, &q->addr, q->tsig_rr)) {
         ods_log_debug("[%s] zone %s acl query refused", query_str,
             q->zone->name);
         return query_refused(q);
@@ -1038,10 +1253,12 @@ query_add_rr(query_type* q, ldns_rr* rr)
     size_t tc_mark = 0;
     size_t rdlength_pos = 0;
     uint16_t rdlength = 0;
+    int compress = 0;
 
     ods_log_assert(q);
     ods_log_assert(q->buffer);
     ods_log_assert(rr);
+    compress = query_compress_rdata(ldns_rr_get_type(rr));
 
     /* set truncation mark, in case rr does not fit */
     tc_mark = buffer_position(q->buffer);
@@ -1049,7 +1266,7 @@ query_add_rr(query_type* q, ldns_rr* rr)
     if (!buffer_available(q->buffer, ldns_rdf_size(ldns_rr_owner(rr)))) {
         goto query_add_rr_tc;
     }
-    buffer_write_rdf(q->buffer, ldns_rr_owner(rr));
+    query_write_dname(q, ldns_rr_owner(rr));
     if (!buffer_available(q->buffer, sizeof(uint16_t) + sizeof(uint16_t) +
         sizeof(uint32_t) + sizeof(rdlength))) {
         goto query_add_rr_tc;
@@ -1065,7 +1282,12 @@ query_add_rr(query_type* q, ldns_rr* rr)
         if (!buffer_available(q->buffer, ldns_rdf_size(ldns_rr_rdf(rr, i)))) {
             goto query_add_rr_tc;
         }
-        buffer_write_rdf(q->buffer, ldns_rr_rdf(rr, i));
+        if (compress &&
+            ldns_rdf_get_type(ldns_rr_rdf(rr, i)) == LDNS_RDF_TYPE_DNAME) {
+            query_write_dname(q, ldns_rr_rdf(rr, i));
+        } else {
+            buffer_write_rdf(q->buffer, ldns_rr_rdf(rr, i));
+        }
     }
 
     if (!query_overflow(q)) {
@@ -42,6 +42,8 @@
 #define UDP_MAX_MESSAGE_LEN 512
 #define TCP_MAX_MESSAGE_LEN 65535
 #define QUERY_RESPONSE_MAX_RRSET 10 /* should be enough */
+#define QUERY_COMPRESS_SIZE 4096 /* slots in the name compression table */
+#define QUERY_COMPRESS_MAX_OFFSET 0x4000 /* max offset of a name pointer */
 
 enum query_enum {
         QUERY_PROCESSED = 0,
@@ -75,8 +77,10 @@ struct query_struct {
 
     /* Zone */
     zone_type* zone;
-    /* Compression */
-
+    /* Compression: name suffix hash to offset in the current message,
+       with the generation in the upper bits */
+    uint32_t compress[QUERY_COMPRESS_SIZE];
+    uint16_t compress_gen;
     /* AXFR IXFR */
     FILE* axfr_fd;
     uint32_t serial;
@@ -96,7 +100,7 @@ typedef struct response_struct response_type;
 struct response_struct {
     size_t rrset_count;
     ldns_pkt_section sections[QUERY_RESPONSE_MAX_RRSET];
-    rrset_type* rrsets[QUERY_RESPONSE_MAX_RRSET];
+    zone_served_rrset_type* rrsets[QUERY_RESPONSE_MAX_RRSET];
 };
 
 /**
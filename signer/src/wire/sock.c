@@ -41,6 +41,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <ldns/ldns.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #define SOCK_TCP_BACKLOG 5
@@ -125,6 +126,33 @@ sock_tcp_reuseaddr(sock_type* sock, const char* node, const char* port,
 }
 
 
+/**
+ * Allow other sockets to bind to the same address, for listener threads.
+ *
+ */
+static void
+sock_reuseport(sock_type* sock, const char* node, const char* port,
+    const char* stype)
+{
+#ifdef SO_REUSEPORT
+    int on = 1;
+    ods_log_assert(sock);
+    ods_log_assert(port);
+    ods_log_assert(stype);
+    if (setsockopt(sock->s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        ods_log_error("[%s] unable to set %s socket '%s:%s' to "
+            "reuse-port: setsockopt() failed (%s)", sock_str, stype,
+            node?node:"localhost", port, strerror(errno));
+    }
+#else
+    (void)sock;
+    (void)node;
+    (void)port;
+    (void)stype;
+#endif
+}
+
+
 /**
  * Listen on tcp socket.
  *
@@ -152,7 +180,7 @@ sock_tcp_listen(sock_type* sock, const char* node, const char* port,
  */
 static ods_status
 sock_server_udp(sock_type* sock, const char* node, const char* port,
-    unsigned* ip6_support)
+    unsigned* ip6_support, int reuseport)
 {
     int on = 0;
     ods_status status = ODS_STATUS_OK;
@@ -174,6 +202,9 @@ sock_server_udp(sock_type* sock, const char* node, const char* port,
         }
         return ODS_STATUS_SOCK_SOCKET_UDP;
     }
+    if (reuseport) {
+        sock_reuseport(sock, node, port, "udp");
+    }
     /* ipv4 */
     if (sock->addr->ai_family == AF_INET) {
         status = sock_fcntl_and_bind(sock, node, port, "udp", "ipv4");
@@ -196,7 +227,7 @@ sock_server_udp(sock_type* sock, const char* node, const char* port,
  */
 static ods_status
 sock_server_tcp(sock_type* sock, const char* node, const char* port,
-    unsigned* ip6_support)
+    unsigned* ip6_support, int reuseport)
 {
     int on = 0;
     ods_status status = ODS_STATUS_OK;
@@ -218,6 +249,9 @@ sock_server_tcp(sock_type* sock, const char* node, const char* port,
         }
         return ODS_STATUS_SOCK_SOCKET_TCP;
     }
+    if (reuseport) {
+        sock_reuseport(sock, node, port, "tcp");
+    }
     /* ipv4 */
     if (sock->addr->ai_family == AF_INET) {
         sock_tcp_reuseaddr(sock, node, port, on, "ipv4");
@@ -248,7 +282,7 @@ sock_server_tcp(sock_type* sock, const char* node, const char* port,
  */
 static ods_status
 socket_listen(sock_type* sock, struct addrinfo hints, int socktype,
-    const char* node, const char* port, unsigned* ip6_support)
+    const char* node, const char* port, unsigned* ip6_support, int reuseport)
 {
     ods_status status = ODS_STATUS_OK;
     int r = 0;
@@ -274,9 +308,9 @@ socket_listen(sock_type* sock, struct addrinfo hints, int socktype,
     }
     /* socket */
     if (socktype == SOCK_DGRAM) {
-        status = sock_server_udp(sock, node, port, ip6_support);
+        status = sock_server_udp(sock, node, port, ip6_support, reuseport);
     } else if (socktype == SOCK_STREAM) {
-        status = sock_server_tcp(sock, node, port, ip6_support);
+        status = sock_server_tcp(sock, node, port, ip6_support, reuseport);
     }
     ods_log_debug("[%s] socket listening to %s:%s", sock_str,
         node?node:"localhost", port);
@@ -289,7 +323,7 @@ socket_listen(sock_type* sock, struct addrinfo hints, int socktype,
  *
  */
 ods_status
-sock_listen(socklist_type* sockets, listener_type* listener)
+sock_listen(socklist_type* sockets, listener_type* listener, int reuseport)
 {
     ods_status status = ODS_STATUS_OK;
     struct addrinfo hints[MAX_INTERFACES];
@@ -326,7 +360,7 @@ sock_listen(socklist_type* sockets, listener_type* listener)
         }
         /* udp */
         status = socket_listen(&sockets->udp[i], hints[i], SOCK_DGRAM,
-            node, port, &ip6_support);
+            node, port, &ip6_support, reuseport);
         if (status != ODS_STATUS_OK) {
             if (!ip6_support) {
                 ods_log_warning("[%s] fallback to udp/ipv4, no udp/ipv6: "
@@ -338,7 +372,7 @@ sock_listen(socklist_type* sockets, listener_type* listener)
         }
         /* tcp */
         status = socket_listen(&sockets->tcp[i], hints[i], SOCK_STREAM,
-            node, port, &ip6_support);
+            node, port, &ip6_support, reuseport);
         if (status != ODS_STATUS_OK) {
             if (!ip6_support) {
                 ods_log_warning("[%s] fallback to udp/ipv4, no udp/ipv6: "
@@ -355,6 +389,112 @@ sock_listen(socklist_type* sockets, listener_type* listener)
 }
 
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+/**
+ * Send responses over udp.
+ *
+ */
+static void
+send_udp_batch(struct udp_data* data, struct mmsghdr* msgs, int count)
+{
+    int sent = 0;
+    int i = 0;
+    ods_log_deeebug("[%s] sending %d messages over udp", sock_str, count);
+    while (sent < count) {
+        int nb = sendmmsg(data->socket->s, &msgs[sent], count - sent, 0);
+        if (nb == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* the first message could not be sent, try the others */
+            ods_log_error("[%s] unable to send data over udp: sendmmsg() "
+                "failed (%s)", sock_str, strerror(errno));
+            sent++;
+            continue;
+        }
+        for (i = sent; i < sent + nb; i++) {
+            if (msgs[i].msg_len != msgs[i].msg_hdr.msg_iov->iov_len) {
+                ods_log_error("[%s] unable to send data over udp: only sent "
+                    "%d of %d octets", sock_str, (int) msgs[i].msg_len,
+                    (int) msgs[i].msg_hdr.msg_iov->iov_len);
+            }
+        }
+        sent += nb;
+    }
+}
+
+
+/**
+ * Handle incoming udp queries. Up to SOCK_UDP_BATCH queries are received
+ * at once, and their responses are sent at once.
+ *
+ */
+void
+sock_handle_udp(netio_type* ATTR_UNUSED(netio), netio_handler_type* handler,
+    netio_events_type event_types)
+{
+    struct udp_data* data = (struct udp_data*) handler->user_data;
+    struct mmsghdr msgs[SOCK_UDP_BATCH];
+    struct iovec iovecs[SOCK_UDP_BATCH];
+    int received = 0;
+    int count = 0;
+    int i = 0;
+    query_type* q = NULL;
+    query_state qstate = QUERY_PROCESSED;
+
+    if (!(event_types & NETIO_EVENT_READ)) {
+        return;
+    }
+    ods_log_debug("[%s] incoming udp message", sock_str);
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < SOCK_UDP_BATCH; i++) {
+        q = data->queries[i];
+        query_reset(q, UDP_MAX_MESSAGE_LEN, 0);
+        iovecs[i].iov_base = buffer_begin(q->buffer);
+        iovecs[i].iov_len = buffer_remaining(q->buffer);
+        msgs[i].msg_hdr.msg_name = &q->addr;
+        msgs[i].msg_hdr.msg_namelen = q->addrlen;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    received = recvmmsg(handler->fd, msgs, SOCK_UDP_BATCH, 0, NULL);
+    if (received < 1) {
+        if (errno != EAGAIN && errno != EINTR) {
+            ods_log_error("[%s] recvmmsg() failed: %s", sock_str,
+                strerror(errno));
+        }
+        return;
+    }
+    /* responses take the place of the queries that were processed */
+    for (i = 0; i < received; i++) {
+        q = data->queries[i];
+        q->addrlen = msgs[i].msg_hdr.msg_namelen;
+        if (msgs[i].msg_len < 1) {
+            continue;
+        }
+        buffer_skip(q->buffer, msgs[i].msg_len);
+        buffer_flip(q->buffer);
+        qstate = query_process(q, data->engine);
+        if (qstate == QUERY_DISCARDED) {
+            continue;
+        }
+        ods_log_debug("[%s] query processed qstate=%d", sock_str, qstate);
+        query_add_optional(q, data->engine);
+        buffer_flip(q->buffer);
+        iovecs[count].iov_base = buffer_begin(q->buffer);
+        iovecs[count].iov_len = buffer_remaining(q->buffer);
+        msgs[count].msg_hdr.msg_name = &q->addr;
+        msgs[count].msg_hdr.msg_namelen = q->addrlen;
+        msgs[count].msg_hdr.msg_iov = &iovecs[count];
+        msgs[count].msg_hdr.msg_iovlen = 1;
+        msgs[count].msg_len = 0;
+        count++;
+    }
+    if (count > 0) {
+        send_udp_batch(data, msgs, count);
+    }
+}
+#else /* !HAVE_RECVMMSG || !HAVE_SENDMMSG */
 /**
  * Send data over udp.
  *
@@ -390,7 +530,7 @@ sock_handle_udp(netio_type* ATTR_UNUSED(netio), netio_handler_type* handler,
 {
     struct udp_data* data = (struct udp_data*) handler->user_data;
     int received = 0;
-    query_type* q = data->query;
+    query_type* q = data->queries[0];
     query_state qstate = QUERY_PROCESSED;
 
     if (!(event_types & NETIO_EVENT_READ)) {
@@ -418,6 +558,7 @@ sock_handle_udp(netio_type* ATTR_UNUSED(netio), netio_handler_type* handler,
         send_udp(data, q);
     }
 }
+#endif /* HAVE_RECVMMSG && HAVE_SENDMMSG */
 
 
 /**
@@ -428,15 +569,64 @@ static void
 cleanup_tcp_handler(netio_type* netio, netio_handler_type* handler)
 {
     struct tcp_data* data = (struct tcp_data*) handler->user_data;
+    size_t i = 0;
     netio_remove_handler(netio, handler);
     close(handler->fd);
     free(handler->timeout);
     free(handler);
+    for (i = 0; i < data->out_size; i++) {
+        buffer_cleanup(data->out[i]);
+    }
+    free(data->out);
+    free(data->out_len);
     query_cleanup(data->query);
     free(data);
 }
 
 
+/**
+ * Queue the response in the query buffer for writing. The query keeps
+ * building into a spare buffer, that gets the header of the queued
+ * response: subsequent transfer messages reuse it.
+ *
+ */
+static void
+sock_tcp_queue(struct tcp_data* data)
+{
+    query_type* q = data->query;
+    buffer_type* spare = NULL;
+    size_t slot = 0;
+    int window = 0;
+
+    if (!data->out) {
+        window = data->engine->config->transfer_window;
+        if (window < 1) {
+            window = 1;
+        } else if (window > SOCK_TCP_WINDOW_MAX) {
+            window = SOCK_TCP_WINDOW_MAX;
+        }
+        data->out_size = (size_t) window;
+        CHECKALLOC(data->out = (buffer_type**) calloc(data->out_size,
+            sizeof(buffer_type*)));
+        CHECKALLOC(data->out_len = (uint16_t*) calloc(data->out_size,
+            sizeof(uint16_t)));
+    }
+    ods_log_assert(data->out_count < data->out_size);
+    slot = (data->out_first + data->out_count) % data->out_size;
+    spare = data->out[slot];
+    if (!spare) {
+        spare = buffer_create(PACKET_BUFFER_SIZE);
+        ods_log_assert(spare);
+    }
+    memcpy(buffer_begin(spare), buffer_begin(q->buffer),
+        BUFFER_PKT_HEADER_SIZE);
+    data->out[slot] = q->buffer;
+    data->out_len[slot] = htons(q->tcplen);
+    data->out_count++;
+    q->buffer = spare;
+}
+
+
 /**
  * Handle incoming tcp connections.
  *
@@ -480,6 +670,11 @@ sock_handle_tcp_accept(netio_type* netio, netio_handler_type* handler,
     tcp_data->tcp_accept_handlers = accept_data->tcp_accept_handlers;
     tcp_data->qstate = QUERY_PROCESSED;
     tcp_data->bytes_transmitted = 0;
+    tcp_data->out = NULL;
+    tcp_data->out_len = NULL;
+    tcp_data->out_first = 0;
+    tcp_data->out_count = 0;
+    tcp_data->out_size = 0;
     memcpy(&tcp_data->query->addr, &addr, addrlen);
     tcp_data->query->addrlen = addrlen;
     CHECKALLOC(tcp_handler = (netio_handler_type*) malloc(sizeof(netio_handler_type)));
@@ -611,6 +806,7 @@ sock_handle_tcp_read(netio_type* netio, netio_handler_type* handler,
     data->query->tcplen = buffer_remaining(data->query->buffer);
     ods_log_debug("[%s] TCP_READ: new tcplen %u", sock_str,
         data->query->tcplen);
+    sock_tcp_queue(data);
     data->bytes_transmitted = 0;
     handler->timeout->tv_sec = XFRD_TCP_TIMEOUT;
     handler->timeout->tv_nsec = 0L;
@@ -629,7 +825,9 @@ sock_handle_tcp_write(netio_type* netio, netio_handler_type* handler,
     netio_events_type event_types)
 {
     struct tcp_data* data = (struct tcp_data *) handler->user_data;
+    struct iovec iov[SOCK_TCP_WINDOW_MAX*2];
     ssize_t sent = 0;
+    size_t i = 0, n = 0, slot = 0, skip = 0, len = 0;
     query_type* q = data->query;
 
     if (event_types & NETIO_EVENT_TIMEOUT) {
@@ -638,97 +836,85 @@ sock_handle_tcp_write(netio_type* netio, netio_handler_type* handler,
     }
     ods_log_assert(event_types & NETIO_EVENT_WRITE);
 
-    if (data->bytes_transmitted < sizeof(q->tcplen)) {
-        uint16_t n_tcplen = htons(q->tcplen);
-        sent = write(handler->fd,
-            (const char*) &n_tcplen + data->bytes_transmitted,
-            sizeof(n_tcplen) - data->bytes_transmitted);
-        if (sent == -1) {
-             if (errno == EAGAIN || errno == EINTR) {
-                 /* write would block, wait until socket becomes writeable. */
-                 return;
-             } else {
-                 ods_log_error("[%s] unable to handle outgoing tcp response: "
-                     "write() failed (%s)", sock_str, strerror(errno));
-                 cleanup_tcp_handler(netio, handler);
-                 return;
-             }
-         } else if (sent == 0) {
-             cleanup_tcp_handler(netio, handler);
-             return;
-         }
-         data->bytes_transmitted += sent;
-         ods_log_debug("[%s] TCP_WRITE: bytes transmitted %lu (sent %ld)",
-                sock_str, (unsigned long)data->bytes_transmitted, (long)sent);
-         if (data->bytes_transmitted < sizeof(q->tcplen)) {
-             /* writing not complete, wait until socket becomes writable. */
-             ods_log_debug("[%s] TCP_WRITE: bytes transmitted %lu, while "
-                "sizeof tcplen %lu", sock_str, (unsigned long)data->bytes_transmitted,
-                (unsigned long)sizeof(q->tcplen));
-             return;
-         }
-         ods_log_assert(data->bytes_transmitted == sizeof(q->tcplen));
-    }
-    ods_log_assert(data->bytes_transmitted < q->tcplen + sizeof(q->tcplen));
-
-    sent = write(handler->fd, buffer_current(q->buffer),
-        buffer_remaining(q->buffer));
-    if (sent == -1) {
-        if (errno == EAGAIN || errno == EINTR) {
-            /* write would block, wait until socket becomes writeable. */
-            return;
-        } else {
-            ods_log_error("[%s] unable to handle outgoing tcp response: "
-                 "write() failed (%s)", sock_str, strerror(errno));
-            cleanup_tcp_handler(netio, handler);
-            return;
-        }
-    } else if (sent == 0) {
-        cleanup_tcp_handler(netio, handler);
-        return;
-    }
-
-    buffer_skip(q->buffer, sent);
-    data->bytes_transmitted += sent;
-    if (data->bytes_transmitted < q->tcplen + sizeof(q->tcplen)) {
-        /* still more data to write when socket becomes writable. */
-        ods_log_debug("[%s] TCP_WRITE: bytes transmitted %lu, while tcplen "
-           "%u and sizeof tcplen %lu", sock_str, (unsigned long) data->bytes_transmitted,
-           q->tcplen, (unsigned long)sizeof(q->tcplen));
-        return;
-    }
-
-    ods_log_debug("[%s] TCP_WRITE: bytes transmitted %lu",
-        sock_str, (unsigned long)data->bytes_transmitted);
-    ods_log_debug("[%s] TCP_WRITE: tcplen %u", sock_str, q->tcplen);
-    ods_log_debug("[%s] TCP_WRITE: sizeof tcplen %lu", sock_str,
-        (unsigned long)sizeof(q->tcplen));
-    ods_log_assert(data->bytes_transmitted == q->tcplen + sizeof(q->tcplen));
-    if (data->qstate == QUERY_AXFR || data->qstate == QUERY_IXFR) {
-        /* continue processing AXFR and writing back results.  */
+    /* prepare the next messages of a zone transfer ahead. */
+    while ((data->qstate == QUERY_AXFR || data->qstate == QUERY_IXFR) &&
+        data->out_count < data->out_size) {
         buffer_clear(q->buffer);
         if (data->qstate == QUERY_IXFR) {
             data->qstate = ixfr(q, data->engine);
         } else {
             data->qstate = axfr(q, data->engine, 0);
         }
-        if (data->qstate != QUERY_PROCESSED) {
-            /* edns, tsig */
-            query_add_optional(q, data->engine);
-            buffer_flip(q->buffer);
-            q->tcplen = buffer_remaining(q->buffer);
-            data->bytes_transmitted = 0;
-            handler->timeout->tv_sec = XFRD_TCP_TIMEOUT;
-            handler->timeout->tv_nsec = 0L;
-            timespec_add(handler->timeout, netio_current_time(netio));
+        if (data->qstate == QUERY_PROCESSED) {
+            break;
+        }
+        /* edns, tsig */
+        query_add_optional(q, data->engine);
+        buffer_flip(q->buffer);
+        q->tcplen = buffer_remaining(q->buffer);
+        sock_tcp_queue(data);
+    }
+
+    if (data->out_count > 0) {
+        /* write all queued messages, length prefixes included, at once. */
+        skip = data->bytes_transmitted;
+        for (i = 0; i < data->out_count; i++) {
+            slot = (data->out_first + i) % data->out_size;
+            if (skip < sizeof(uint16_t)) {
+                iov[n].iov_base = (uint8_t*) &data->out_len[slot] + skip;
+                iov[n].iov_len = sizeof(uint16_t) - skip;
+                n++;
+            } else {
+                skip -= sizeof(uint16_t);
+            }
+            iov[n].iov_base = buffer_begin(data->out[slot]) + skip;
+            iov[n].iov_len = buffer_limit(data->out[slot]) - skip;
+            n++;
+            skip = 0;
+        }
+        sent = writev(handler->fd, iov, (int) n);
+        if (sent == -1) {
+            if (errno == EAGAIN || errno == EINTR) {
+                /* write would block, wait until socket becomes writeable. */
+                return;
+            } else {
+                ods_log_error("[%s] unable to handle outgoing tcp response: "
+                     "writev() failed (%s)", sock_str, strerror(errno));
+                cleanup_tcp_handler(netio, handler);
+                return;
+            }
+        } else if (sent == 0) {
+            cleanup_tcp_handler(netio, handler);
             return;
         }
+        ods_log_debug("[%s] TCP_WRITE: sent %ld bytes of %lu messages",
+            sock_str, (long)sent, (unsigned long)data->out_count);
+        /* release the messages that are written completely. */
+        while (sent > 0) {
+            slot = data->out_first;
+            len = sizeof(uint16_t) + buffer_limit(data->out[slot]) -
+                data->bytes_transmitted;
+            if ((size_t) sent < len) {
+                data->bytes_transmitted += sent;
+                break;
+            }
+            sent -= len;
+            data->bytes_transmitted = 0;
+            data->out_first = (data->out_first + 1) % data->out_size;
+            data->out_count--;
+        }
     }
-    /* done sending, wait for the next request. */
-    data->bytes_transmitted = 0;
+
     handler->timeout->tv_sec = XFRD_TCP_TIMEOUT;
     handler->timeout->tv_nsec = 0L;
     timespec_add(handler->timeout, netio_current_time(netio));
+    if (data->out_count > 0 || data->qstate == QUERY_AXFR ||
+        data->qstate == QUERY_IXFR) {
+        /* still more data to write when socket becomes writable. */
+        return;
+    }
+    /* done sending, wait for the next request. */
+    data->bytes_transmitted = 0;
     handler->event_types = NETIO_EVENT_READ | NETIO_EVENT_TIMEOUT;
     handler->event_handler = sock_handle_tcp_read;
 }
@@ -38,6 +38,16 @@
 #include "wire/netio.h"
 #include "wire/query.h"
 
+/* Number of udp messages received and sent with one system call */
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define SOCK_UDP_BATCH 32
+#else
+#define SOCK_UDP_BATCH 1
+#endif
+
+/* Max number of transfer messages queued for writing on a tcp connection */
+#define SOCK_TCP_WINDOW_MAX 64
+
 /**
  * Socket.
  *
@@ -65,7 +75,7 @@ struct socklist_struct {
 struct udp_data {
     engine_type* engine;
     sock_type* socket;
-    query_type* query;
+    query_type** queries; /* SOCK_UDP_BATCH queries */
 };
 
 /**
@@ -90,16 +100,25 @@ struct tcp_data {
     netio_handler_type* tcp_accept_handlers;
     query_state qstate;
     size_t bytes_transmitted;
+    /* responses waiting to be written, with their length prefix */
+    buffer_type** out;
+    uint16_t* out_len;
+    size_t out_first;
+    size_t out_count;
+    size_t out_size;
 };
 
 /**
  * Create sockets and listen.
  * \param[out] sockets sockets
  * \param[in] listener interfaces
+ * \param[in] reuseport set SO_REUSEPORT, so that other threads can listen
+ *            on the same interfaces
  * \return ods_status status
  *
  */
-ods_status sock_listen(socklist_type* sockets, listener_type* listener);
+ods_status sock_listen(socklist_type* sockets, listener_type* listener,
+    int reuseport);
 
 /**
  * Handle incoming udp queries.
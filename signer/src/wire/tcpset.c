@@ -36,6 +36,9 @@
 
 static const char* tcp_str = "tcp";
 
+static void tcp_set_handle_idle(netio_type* netio,
+    netio_handler_type* handler, netio_events_type event_types);
+
 
 /**
  * Create a tcp connection.
@@ -55,6 +58,13 @@ tcp_conn_create()
     tcp_conn->msglen = 0;
     tcp_conn->total_bytes = 0;
     tcp_conn->fd = -1;
+    tcp_conn->idle_handler.fd = -1;
+    tcp_conn->idle_handler.user_data = NULL;
+    tcp_conn->idle_handler.timeout = NULL;
+    tcp_conn->idle_handler.event_types = NETIO_EVENT_READ|NETIO_EVENT_TIMEOUT;
+    tcp_conn->idle_handler.event_handler = tcp_set_handle_idle;
+    tcp_conn->idle_handler.free_handler = 0;
+    tcp_conn->idle_handler.list = NULL;
     return tcp_conn;
 }
 
@@ -64,22 +74,203 @@ tcp_conn_create()
  *
  */
 tcp_set_type*
-tcp_set_create()
+tcp_set_create(netio_type* netio, size_t max, size_t max_remote)
 {
     size_t i = 0;
     tcp_set_type* tcp_set = NULL;
     CHECKALLOC(tcp_set = (tcp_set_type*) malloc(sizeof(tcp_set_type)));
     memset(tcp_set, 0, sizeof(tcp_set_type));
+    if (max == 0) {
+        max = TCPSET_MAX;
+    }
+    CHECKALLOC(tcp_set->tcp_conn = (tcp_conn_type**) calloc(max,
+        sizeof(tcp_conn_type*)));
+    tcp_set->tcp_max = max;
+    tcp_set->tcp_max_remote = max_remote;
     tcp_set->tcp_count = 0;
-    for (i=0; i < TCPSET_MAX; i++) {
+    tcp_set->netio = netio;
+    for (i=0; i < max; i++) {
         tcp_set->tcp_conn[i] = tcp_conn_create();
+        tcp_set->tcp_conn[i]->idle_handler.user_data = (void*) tcp_set;
     }
-    tcp_set->tcp_waiting_first = NULL;
-    tcp_set->tcp_waiting_last = NULL;
     return tcp_set;
 }
 
 
+/**
+ * Count the connections that are in use to a remote.
+ *
+ */
+size_t
+tcp_set_count_remote(tcp_set_type* set, struct sockaddr_storage* to,
+    socklen_t to_len)
+{
+    size_t i = 0;
+    size_t count = 0;
+    ods_log_assert(set);
+    for (i=0; i < set->tcp_max; i++) {
+        if (set->tcp_conn[i]->fd != -1 && !set->tcp_conn[i]->is_idle &&
+            set->tcp_conn[i]->to_len == to_len &&
+            memcmp(&set->tcp_conn[i]->to, to, to_len) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * Keep a connection open after a completed transfer.
+ *
+ */
+void
+tcp_set_keep_idle(tcp_set_type* set, int i, time_t now)
+{
+    tcp_conn_type* tcp = NULL;
+    ods_log_assert(set);
+    ods_log_assert(i >= 0 && (size_t) i < set->tcp_max);
+    tcp = set->tcp_conn[i];
+    ods_log_assert(tcp->fd != -1);
+    tcp->is_idle = 1;
+    tcp->idle_since = now;
+    if (!set->netio) {
+        return;
+    }
+    /* no more data is expected, readable means the remote closed it */
+    tcp->idle_timeout.tv_sec = now + TCPSET_IDLE_TIMEOUT;
+    tcp->idle_timeout.tv_nsec = 0;
+    tcp->idle_handler.fd = tcp->fd;
+    tcp->idle_handler.timeout = &tcp->idle_timeout;
+    netio_add_handler(set->netio, &tcp->idle_handler);
+}
+
+
+/**
+ * Close an idle connection when the remote end closed it or when it
+ * has been unused for too long.
+ *
+ */
+static void
+tcp_set_handle_idle(netio_type* ATTR_UNUSED(netio),
+    netio_handler_type* handler, netio_events_type event_types)
+{
+    tcp_set_type* set = NULL;
+    size_t i = 0;
+    ods_log_assert(handler);
+    set = (tcp_set_type*) handler->user_data;
+    ods_log_assert(set);
+    for (i=0; i < set->tcp_max; i++) {
+        if (&set->tcp_conn[i]->idle_handler == handler) {
+            break;
+        }
+    }
+    if (i == set->tcp_max || !set->tcp_conn[i]->is_idle) {
+        return;
+    }
+    if (event_types & NETIO_EVENT_TIMEOUT) {
+        ods_log_debug("[%s] close idle connection", tcp_str);
+    } else {
+        ods_log_debug("[%s] idle connection closed by remote", tcp_str);
+    }
+    tcp_set_close(set, i);
+}
+
+
+/**
+ * Take an idle connection to a remote.
+ *
+ */
+int
+tcp_set_take_idle(tcp_set_type* set, struct sockaddr_storage* to,
+    socklen_t to_len, time_t now)
+{
+    size_t i = 0;
+    int found = -1;
+    tcp_conn_type* tcp = NULL;
+    ods_log_assert(set);
+    for (i=0; i < set->tcp_max; i++) {
+        tcp = set->tcp_conn[i];
+        if (tcp->fd == -1 || !tcp->is_idle) {
+            continue;
+        }
+        if (now - tcp->idle_since >= TCPSET_IDLE_TIMEOUT) {
+            ods_log_debug("[%s] close idle connection", tcp_str);
+            tcp_set_close(set, i);
+            continue;
+        }
+        if (found == -1 && tcp->to_len == to_len &&
+            memcmp(&tcp->to, to, to_len) == 0) {
+            found = i;
+        }
+    }
+    if (found != -1) {
+        tcp = set->tcp_conn[found];
+        if (set->netio) {
+            netio_remove_handler(set->netio, &tcp->idle_handler);
+        }
+        tcp->idle_handler.fd = -1;
+        tcp->is_idle = 0;
+        tcp->is_reused = 1;
+        tcp->is_reading = 0;
+        tcp->total_bytes = 0;
+        tcp->msglen = 0;
+    }
+    return found;
+}
+
+
+/**
+ * Find a free connection slot.
+ *
+ */
+int
+tcp_set_free_slot(tcp_set_type* set)
+{
+    size_t i = 0;
+    int oldest = -1;
+    ods_log_assert(set);
+    for (i=0; i < set->tcp_max; i++) {
+        if (set->tcp_conn[i]->fd == -1) {
+            return i;
+        }
+        if (set->tcp_conn[i]->is_idle && (oldest == -1 ||
+            set->tcp_conn[i]->idle_since <
+            set->tcp_conn[oldest]->idle_since)) {
+            oldest = i;
+        }
+    }
+    if (oldest != -1) {
+        tcp_set_close(set, oldest);
+    }
+    return oldest;
+}
+
+
+/**
+ * Close a connection and free its slot.
+ *
+ */
+void
+tcp_set_close(tcp_set_type* set, int i)
+{
+    tcp_conn_type* tcp = NULL;
+    ods_log_assert(set);
+    ods_log_assert(i >= 0 && (size_t) i < set->tcp_max);
+    tcp = set->tcp_conn[i];
+    if (tcp->is_idle && set->netio) {
+        netio_remove_handler(set->netio, &tcp->idle_handler);
+    }
+    tcp->idle_handler.fd = -1;
+    if (tcp->fd != -1) {
+        close(tcp->fd);
+    }
+    tcp->fd = -1;
+    tcp->is_idle = 0;
+    tcp->is_reused = 0;
+    set->tcp_count--;
+}
+
+
 /**
  * Make tcp connection ready for reading.
  * \param[in] tcp tcp connection
@@ -245,8 +436,12 @@ tcp_set_cleanup(tcp_set_type* set)
     if (!set) {
         return;
     }
-    for (i=0; i < TCPSET_MAX; i++) {
+    for (i=0; i < set->tcp_max; i++) {
+        if (set->tcp_conn[i] && set->tcp_conn[i]->fd != -1) {
+            close(set->tcp_conn[i]->fd);
+        }
         tcp_conn_cleanup(set->tcp_conn[i]);
     }
+    free(set->tcp_conn);
     free(set);
 }
@@ -34,15 +34,19 @@
 
 #include "config.h"
 #include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
 
 typedef struct tcp_conn_struct tcp_conn_type;
 typedef struct tcp_set_struct tcp_set_type;
 
 #include "status.h"
 #include "wire/buffer.h"
+#include "wire/netio.h"
 #include "wire/xfrd.h"
 
-#define TCPSET_MAX 50
+#define TCPSET_MAX 50 /* default max number of tcp connections */
+#define TCPSET_IDLE_TIMEOUT 30 /* seconds an unused connection is kept open */
 
 /**
  * tcp connection.
@@ -56,8 +60,20 @@ struct tcp_conn_struct {
    uint16_t msglen;
    /* packet buffer of connection */
    buffer_type* packet;
+   /* remote address of connection */
+   struct sockaddr_storage to;
+   socklen_t to_len;
+   /* when the last transfer over the connection completed */
+   time_t idle_since;
+   /* watches the connection for close or timeout while idle */
+   netio_handler_type idle_handler;
+   struct timespec idle_timeout;
    /* state: reading or writing */
    unsigned is_reading : 1;
+   /* open, but not used by a transfer */
+   unsigned is_idle : 1;
+   /* used before, the remote end may have closed it meanwhile */
+   unsigned is_reused : 1;
 };
 
 /*
@@ -65,10 +81,15 @@ struct tcp_conn_struct {
  *
  */
 struct tcp_set_struct {
-    tcp_conn_type* tcp_conn[TCPSET_MAX];
-    xfrd_type* tcp_waiting_first;
-    xfrd_type* tcp_waiting_last;
+    tcp_conn_type** tcp_conn;
+    /* max number of connections */
+    size_t tcp_max;
+    /* max number of connections in use to one remote, 0 is no limit */
+    size_t tcp_max_remote;
+    /* number of open connections, idle ones included */
     size_t tcp_count;
+    /* netio that watches the idle connections */
+    netio_type* netio;
 };
 
 /**
@@ -81,11 +102,67 @@ tcp_conn_type* tcp_conn_create(void);
 
 /**
  * Create a set of tcp connections.
- * \param[in] allocator memory allocator
+ * \param[in] netio netio that watches the idle connections
+ * \param[in] max max number of connections
+ * \param[in] max_remote max number of connections in use to one remote,
+ *            0 for no limit
  * \return tcp_set_type* set of tcp connection.
  *
  */
-tcp_set_type* tcp_set_create(void);
+tcp_set_type* tcp_set_create(netio_type* netio, size_t max,
+    size_t max_remote);
+
+/**
+ * Count the connections that are in use to a remote.
+ * \param[in] set set of tcp connections
+ * \param[in] to remote address
+ * \param[in] to_len length of remote address
+ * \return size_t number of connections in use
+ *
+ */
+size_t tcp_set_count_remote(tcp_set_type* set, struct sockaddr_storage* to,
+    socklen_t to_len);
+
+/**
+ * Keep a connection open after a completed transfer. While idle, the
+ * connection is closed when the remote end closes it or after
+ * TCPSET_IDLE_TIMEOUT.
+ * \param[in] set set of tcp connections
+ * \param[in] i index of the connection
+ * \param[in] now current time
+ *
+ */
+void tcp_set_keep_idle(tcp_set_type* set, int i, time_t now);
+
+/**
+ * Take an idle connection to a remote. Idle connections that have been
+ * unused for longer than TCPSET_IDLE_TIMEOUT are closed on the way.
+ * \param[in] set set of tcp connections
+ * \param[in] to remote address
+ * \param[in] to_len length of remote address
+ * \param[in] now current time
+ * \return int index of the connection, -1 if there is none
+ *
+ */
+int tcp_set_take_idle(tcp_set_type* set, struct sockaddr_storage* to,
+    socklen_t to_len, time_t now);
+
+/**
+ * Find a free connection slot. If all slots are taken, the connection
+ * that has been idle the longest is closed to make room.
+ * \param[in] set set of tcp connections
+ * \return int index of the free slot, -1 if all connections are in use
+ *
+ */
+int tcp_set_free_slot(tcp_set_type* set);
+
+/**
+ * Close a connection and free its slot.
+ * \param[in] set set of tcp connections
+ * \param[in] i index of the connection
+ *
+ */
+void tcp_set_close(tcp_set_type* set, int i);
 
 /**
  * Make tcp connection ready for reading.
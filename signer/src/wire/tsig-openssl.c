@@ -44,13 +44,7 @@ static void init_context(void *context,
                          tsig_key_type *key);
 static void update(void *context, const void *data, size_t size);
 static void final(void *context, uint8_t *digest, size_t *size);
-
-typedef struct tsig_cleanup_table_struct tsig_cleanup_table_type;
-struct tsig_cleanup_table_struct {
-    tsig_cleanup_table_type* next;
-    void* cleanup;
-};
-static tsig_cleanup_table_type* tsig_cleanup_table = NULL;
+static void free_context(void *context);
 
 
 /**
@@ -85,6 +79,7 @@ tsig_openssl_init_algorithm(const char* digest, const char* name, const char* wi
     algorithm->hmac_init = init_context;
     algorithm->hmac_update = update;
     algorithm->hmac_final = final;
+    algorithm->hmac_free = free_context;
     tsig_handler_add_algo(algorithm);
     return 1;
 }
@@ -97,7 +92,6 @@ tsig_openssl_init_algorithm(const char* digest, const char* name, const char* wi
 ods_status
 tsig_handler_openssl_init()
 {
-    tsig_cleanup_table = NULL;
     OpenSSL_add_all_digests();
     ods_log_debug("[%s] add md5", tsig_str);
     if (!tsig_openssl_init_algorithm("md5", "hmac-md5",
@@ -123,29 +117,17 @@ tsig_handler_openssl_init()
 }
 
 static void
-cleanup_context(void *data)
+free_context(void *data)
 {
     HMAC_CTX* context = (HMAC_CTX*) data;
 #ifdef HAVE_SSL_NEW_HMAC
     HMAC_CTX_free(context);
 #else
     HMAC_CTX_cleanup(context);
+    free(context);
 #endif
 }
 
-static void
-context_add_cleanup(void* context)
-{
-    tsig_cleanup_table_type* entry = NULL;
-    if (!context) {
-        return;
-    }
-    CHECKALLOC(entry = (tsig_cleanup_table_type *) malloc(sizeof(tsig_cleanup_table_type)));
-    entry->cleanup = context;
-    entry->next = tsig_cleanup_table;
-    tsig_cleanup_table = entry;
-}
-
 static void*
 create_context()
 {
@@ -157,7 +139,6 @@ create_context()
     CHECKALLOC(context = (HMAC_CTX*) malloc(sizeof(HMAC_CTX)));
     HMAC_CTX_init(context);
 #endif
-    context_add_cleanup(context);
     return context;
 }
 
@@ -166,6 +147,14 @@ init_context(void* context, tsig_algo_type *algorithm, tsig_key_type *key)
 {
     HMAC_CTX* ctx = (HMAC_CTX*) context;
     const EVP_MD* md = (const EVP_MD*) algorithm->data;
+#ifdef HAVE_SSL_NEW_HMAC
+    /* start from the inner and outer digests computed with the key */
+    if (key->hmac_state && key->hmac_state != context &&
+        key->hmac_algo == algorithm &&
+        HMAC_CTX_copy(ctx, (HMAC_CTX*) key->hmac_state)) {
+        return;
+    }
+#endif
     HMAC_Init_ex(ctx, key->data, key->size, md, NULL);
 }
 
@@ -193,12 +182,6 @@ final(void* context, uint8_t* digest, size_t* size)
 void
 tsig_handler_openssl_finalize(void)
 {
-    tsig_cleanup_table_type* entry = tsig_cleanup_table;
-
-    while (entry) {
-        cleanup_context(entry->cleanup);
-        entry = entry->next;
-    }
     EVP_cleanup();
 }
 
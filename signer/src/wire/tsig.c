@@ -132,10 +132,23 @@ tsig_handler_cleanup(void)
 {
     tsig_algo_table_type* aentry = NULL, *anext = NULL;
     tsig_key_table_type* kentry = NULL, *knext = NULL;
+
+    kentry = tsig_key_table;
+    while (kentry) {
+        knext = kentry->next;
+        if (kentry->key->hmac_state) {
+            kentry->key->hmac_algo->hmac_free(kentry->key->hmac_state);
+        }
+        ldns_rdf_deep_free(kentry->key->dname);
+        free((void*)kentry->key->data);
+        free((void*)kentry->key);
+        free(kentry);
+        kentry = knext;
+    }
+
 #ifdef HAVE_SSL
     tsig_handler_openssl_finalize();
 #endif
-
     aentry = tsig_algo_table;
     while (aentry) {
         anext = aentry->next;
@@ -144,16 +157,6 @@ tsig_handler_cleanup(void)
         free(aentry);
         aentry = anext;
     }
-
-    kentry = tsig_key_table;
-    while (kentry) {
-        knext = kentry->next;
-        ldns_rdf_deep_free(kentry->key->dname);
-        free((void*)kentry->key->data);
-        free((void*)kentry->key);
-        free(kentry);
-        kentry = knext;
-    }
 }
 
 
@@ -191,6 +194,13 @@ tsig_key_create(tsig_type* tsig)
     key->dname = dname;
     key->size = size;
     key->data = data;
+    key->hmac_state = NULL;
+    key->hmac_algo = tsig_lookup_algo(tsig->algorithm);
+    if (key->hmac_algo) {
+        /* run the key schedule once, messages start from a copy */
+        key->hmac_state = key->hmac_algo->hmac_create();
+        key->hmac_algo->hmac_init(key->hmac_state, key->hmac_algo, key);
+    }
     tsig_handler_add_key(key);
     return key;
 }
@@ -275,11 +285,34 @@ tsig_rr_create()
     trr->algo_name = NULL;
     trr->mac_data = NULL;
     trr->other_data = NULL;
+    trr->context = NULL;
+    trr->algo = NULL;
+    trr->prior_mac_data = NULL;
     tsig_rr_reset(trr, NULL, NULL);
     return trr;
 }
 
 
+/**
+ * Free HMAC context of TSIG RR.
+ *
+ */
+static void
+tsig_rr_free_context(tsig_rr_type* trr)
+{
+    if (trr->prior_mac_data != trr->mac_data) {
+        /* otherwise freed as mac data */
+        free(trr->prior_mac_data);
+    }
+    trr->prior_mac_data = NULL;
+    if (trr->context) {
+        ods_log_assert(trr->algo);
+        trr->algo->hmac_free(trr->context);
+    }
+    trr->context = NULL;
+}
+
+
 /**
  * Reset TSIG RR.
  *
@@ -290,6 +323,7 @@ tsig_rr_reset(tsig_rr_type* trr, tsig_algo_type* algo, tsig_key_type* key)
     if (!trr) {
         return;
     }
+    tsig_rr_free_context(trr);
     tsig_rr_free(trr);
     trr->status = TSIG_NOT_PRESENT;
     trr->position = 0;
@@ -830,6 +864,7 @@ tsig_rr_cleanup(tsig_rr_type* trr)
     if (!trr) {
         return;
     }
+    tsig_rr_free_context(trr);
     tsig_rr_free(trr);
     free(trr);
 }
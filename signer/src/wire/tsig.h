@@ -70,6 +70,8 @@ struct tsig_lookup_table_struct
         const char* short_name;
 };
 
+typedef struct tsig_algo_struct tsig_algo_type;
+
 /**
  * TSIG key.
  *
@@ -79,13 +81,15 @@ struct tsig_key_struct {
     ldns_rdf* dname;
     size_t size;
     const uint8_t* data;
+    /* HMAC context initialized with the key, for hmac_algo */
+    void* hmac_state;
+    tsig_algo_type* hmac_algo;
 };
 
 /**
  * TSIG algorithm.
  *
  */
-typedef struct tsig_algo_struct tsig_algo_type;
 struct tsig_algo_struct {
     const char* txt_name;
     ldns_rdf* wf_name;
@@ -100,6 +104,8 @@ struct tsig_algo_struct {
     void(*hmac_update)(void* context, const void* data, size_t size);
     /* finalize digest */
     void(*hmac_final)(void* context, uint8_t* digest, size_t* size);
+    /* free an HMAC context */
+    void(*hmac_free)(void* context);
 };
 
 /**
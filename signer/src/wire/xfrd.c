@@ -71,6 +71,9 @@ static xfrd_pkt_status xfrd_handle_packet(xfrd_type* xfrd,
 static void xfrd_tcp_obtain(xfrd_type* xfrd, tcp_set_type* set);
 static void xfrd_tcp_read(xfrd_type* xfrd, tcp_set_type* set);
 static void xfrd_tcp_release(xfrd_type* xfrd, tcp_set_type* set, int open_waiting);
+static void xfrd_tcp_keep(xfrd_type* xfrd, tcp_set_type* set);
+static void xfrd_tcp_reopen(xfrd_type* xfrd, tcp_set_type* set);
+static int xfrd_tcp_start(xfrd_type* xfrd, tcp_set_type* set);
 static void xfrd_tcp_write(xfrd_type* xfrd, tcp_set_type* set);
 static void xfrd_tcp_xfr(xfrd_type* xfrd, tcp_set_type* set);
 static int xfrd_tcp_open(xfrd_type* xfrd, tcp_set_type* set);
@@ -369,6 +372,7 @@ xfrd_create(xfrhandler_type* xfrhandler, zone_type* zone)
     xfrd->handler.event_types =
         NETIO_EVENT_READ|NETIO_EVENT_TIMEOUT;
     xfrd->handler.event_handler = xfrd_handle_zone;
+    xfrd->handler.list = NULL;
     xfrd_set_timer_time(xfrd, 0);
     xfrd_recover(xfrd);
     return xfrd;
@@ -388,6 +392,19 @@ xfrd_time(xfrd_type* xfrd)
 }
 
 
+/**
+ * Tell netio that the handler changed. Needed when the handler of a zone
+ * is changed from another thread or from the callback of another zone.
+ *
+ */
+static void
+xfrd_update_handler(xfrd_type* xfrd)
+{
+    xfrhandler_type* xfrhandler = (xfrhandler_type*) xfrd->xfrhandler;
+    netio_update_handler(xfrhandler->netio, &xfrd->handler);
+}
+
+
 /**
  * Set timer.
  *
@@ -419,6 +436,7 @@ xfrd_set_timer(xfrd_type* xfrd, time_t t)
     xfrd->handler.timeout = &xfrd->timeout;
     xfrd->timeout.tv_sec = t;
     xfrd->timeout.tv_nsec = 0;
+    xfrd_update_handler(xfrd);
 }
 
 
@@ -431,6 +449,7 @@ xfrd_unset_timer(xfrd_type* xfrd)
 {
     ods_log_assert(xfrd);
     xfrd->handler.timeout = NULL;
+    xfrd_update_handler(xfrd);
 }
 
 
@@ -646,6 +665,29 @@ xfrd_tsig_process(xfrd_type* xfrd, buffer_type* buffer)
 }
 
 
+/**
+ * Write a record to the transfer spool.
+ *
+ */
+static int
+xfrd_spool_write(FILE* fd, uint8_t type, const uint8_t* data, size_t len)
+{
+    uint8_t hdr[XFRD_SPOOL_HDRLEN];
+    ods_log_assert(fd);
+    ods_log_assert(len <= 0xffff);
+    hdr[0] = type;
+    hdr[1] = (uint8_t) (len >> 8);
+    hdr[2] = (uint8_t) (len & 0xff);
+    if (fwrite(hdr, 1, sizeof(hdr), fd) != sizeof(hdr)) {
+        return 0;
+    }
+    if (len && fwrite(data, 1, len, fd) != len) {
+        return 0;
+    }
+    return 1;
+}
+
+
 /**
  * Commit answer on disk.
  *
@@ -674,7 +716,10 @@ xfrd_commit_packet(xfrd_type* xfrd)
     fd = ods_fopen(xfrfile, NULL, "a");
     free((void*)xfrfile);
     if (fd) {
-        fprintf(fd, ";;ENDPACKET\n");
+        if (!xfrd_spool_write(fd, XFRD_SPOOL_END, NULL, 0)) {
+            ods_log_crit("[%s] unable to commit xfr zone %s: write failed "
+                "(%s)", xfrd_str, zone->name, strerror(errno));
+        }
         ods_fclose(fd);
     } else {
         pthread_mutex_unlock(&xfrd->rw_lock);
@@ -729,21 +774,18 @@ xfrd_dump_packet(xfrd_type* xfrd, buffer_type* buffer)
     zone_type* zone = NULL;
     char* xfrfile = NULL;
     FILE* fd = NULL;
-    ldns_pkt* pkt = NULL;
-    ldns_status status = LDNS_STATUS_OK;
+    int ret = 1;
     ods_log_assert(buffer);
     ods_log_assert(xfrd);
     zone = (zone_type*) xfrd->zone;
     ods_log_assert(zone);
     ods_log_assert(zone->name);
-    status = ldns_wire2pkt(&pkt, buffer_begin(buffer), buffer_limit(buffer));
-    if (status != LDNS_STATUS_OK) {
-        ods_log_crit("[%s] unable to dump packet zone %s: ldns_wire2pkt() "
-            "failed (%s)", xfrd_str, zone->name,
-            ldns_get_errorstr_by_id(status));
+    if (buffer_limit(buffer) > 0xffff) {
+        ods_log_crit("[%s] unable to dump packet zone %s: packet too large "
+            "(%lu)", xfrd_str, zone->name,
+            (unsigned long) buffer_limit(buffer));
         return;
     }
-    ods_log_assert(pkt);
     xfrfile = ods_build_path(zone->name, ".xfrd", 0, 1);
     if (!xfrfile) {
         ods_log_crit("[%s] unable to dump packet zone %s: build path failed",
@@ -764,13 +806,20 @@ xfrd_dump_packet(xfrd_type* xfrd, buffer_type* buffer)
         return;
     }
     ods_log_assert(fd);
+    /* the message was validated by xfrd_parse_packet(), spool it as is */
     if (xfrd->msg_seq_nr == 0) {
-        fprintf(fd, ";;BEGINPACKET\n");
+        ret = xfrd_spool_write(fd, XFRD_SPOOL_BEGIN, NULL, 0);
+    }
+    if (ret) {
+        ret = xfrd_spool_write(fd, XFRD_SPOOL_DATA, buffer_begin(buffer),
+            buffer_limit(buffer));
+    }
+    if (!ret) {
+        ods_log_crit("[%s] unable to dump packet zone %s: write failed (%s)",
+            xfrd_str, zone->name, strerror(errno));
     }
-    ldns_rr_list_print(fd, ldns_pkt_answer(pkt));
     ods_fclose(fd);
     pthread_mutex_unlock(&xfrd->rw_lock);
-    ldns_pkt_free(pkt);
 }
 
 
@@ -1287,6 +1336,10 @@ xfrd_tcp_write(xfrd_type* xfrd, tcp_set_type* set)
                 xfrd_str, zone->name, strerror(error));
             return; /* try again later */
         }
+        if (error != 0 && tcp->is_reused) {
+            xfrd_tcp_reopen(xfrd, set);
+            return;
+        }
         if (error != 0) {
             ods_log_error("[%s] zone %s cannot tcp connect to %s: %s",
                 xfrd_str, zone->name, xfrd->master->address, strerror(errno));
@@ -1296,6 +1349,10 @@ xfrd_tcp_write(xfrd_type* xfrd, tcp_set_type* set)
         }
     }
     ret = tcp_conn_write(tcp);
+    if (ret == -1 && tcp->is_reused) {
+        xfrd_tcp_reopen(xfrd, set);
+        return;
+    }
     if(ret == -1) {
         ods_log_error("[%s] zone %s cannot tcp write to %s: %s",
             xfrd_str, zone->name, xfrd->master->address, strerror(errno));
@@ -1341,6 +1398,8 @@ xfrd_tcp_open(xfrd_type* xfrd, tcp_set_type* set)
     ods_log_debug("[%s] zone %s open tcp connection to %s", xfrd_str,
         zone->name, xfrd->master->address);
     set->tcp_conn[xfrd->tcp_conn]->is_reading = 0;
+    set->tcp_conn[xfrd->tcp_conn]->is_idle = 0;
+    set->tcp_conn[xfrd->tcp_conn]->is_reused = 0;
     set->tcp_conn[xfrd->tcp_conn]->total_bytes = 0;
     set->tcp_conn[xfrd->tcp_conn]->msglen = 0;
     if (xfrd->master->family == AF_INET6) {
@@ -1365,6 +1424,8 @@ xfrd_tcp_open(xfrd_type* xfrd, tcp_set_type* set)
         return 0;
     }
     to_len = xfrd_acl_sockaddr_to(xfrd->master, &to);
+    set->tcp_conn[xfrd->tcp_conn]->to = to;
+    set->tcp_conn[xfrd->tcp_conn]->to_len = to_len;
     /* bind it */
     interface_type interface = xfrd->xfrhandler->engine->dnshandler->interfaces->interfaces[0];
     if (!interface.address) {
@@ -1407,6 +1468,59 @@ xfrd_tcp_open(xfrd_type* xfrd, tcp_set_type* set)
 }
 
 
+/**
+ * Start tcp transfer, over an idle connection to the master if there is
+ * one. Returns 1 if started, 0 if the master has too many connections in
+ * use and -1 if all connections are in use.
+ *
+ */
+static int
+xfrd_tcp_start(xfrd_type* xfrd, tcp_set_type* set)
+{
+    struct sockaddr_storage to;
+    socklen_t to_len;
+    tcp_conn_type* tcp = NULL;
+    int i = 0;
+
+    ods_log_assert(set);
+    ods_log_assert(xfrd);
+    ods_log_assert(xfrd->tcp_conn == -1);
+    ods_log_assert(xfrd->master);
+    to_len = xfrd_acl_sockaddr_to(xfrd->master, &to);
+    if (set->tcp_max_remote &&
+        tcp_set_count_remote(set, &to, to_len) >= set->tcp_max_remote) {
+        return 0;
+    }
+    i = tcp_set_take_idle(set, &to, to_len, xfrd_time(xfrd));
+    if (i == -1) {
+        /* find a free tcp_buffer */
+        i = tcp_set_free_slot(set);
+        if (i == -1) {
+            return -1;
+        }
+        set->tcp_count++;
+    }
+    xfrd->tcp_conn = i;
+    xfrd->tcp_waiting = 0;
+    /* stop udp use (if any) */
+    if (xfrd->handler.fd != -1) {
+        xfrd_udp_release(xfrd);
+    }
+    tcp = set->tcp_conn[i];
+    if (tcp->is_reused) {
+        ods_log_debug("[%s] zone %s reuse tcp connection to %s", xfrd_str,
+            ((zone_type*) xfrd->zone)->name, xfrd->master->address);
+        xfrd->handler.fd = tcp->fd;
+        xfrd->handler.event_types = NETIO_EVENT_WRITE|NETIO_EVENT_TIMEOUT;
+        xfrd_set_timer(xfrd, xfrd_time(xfrd) + XFRD_TCP_TIMEOUT);
+    } else if (!xfrd_tcp_open(xfrd, set)) {
+        return 1;
+    }
+    xfrd_tcp_xfr(xfrd, set);
+    return 1;
+}
+
+
 /**
  * Obtain tcp.
  *
@@ -1415,37 +1529,25 @@ static void
 xfrd_tcp_obtain(xfrd_type* xfrd, tcp_set_type* set)
 {
     xfrhandler_type* xfrhandler;
-    int i = 0;
+    int ret = 0;
 
     ods_log_assert(set);
     ods_log_assert(xfrd);
     ods_log_assert(xfrd->tcp_conn == -1);
     ods_log_assert(xfrd->tcp_waiting == 0);
-    if (set->tcp_count < TCPSET_MAX) {
-        ods_log_assert(!set->tcp_waiting_first);
-        set->tcp_count ++;
-        /* find a free tcp_buffer */
-        for (i=0; i < TCPSET_MAX; i++) {
-            if (set->tcp_conn[i]->fd == -1) {
-                xfrd->tcp_conn = i;
-                break;
-            }
-        }
-        ods_log_assert(xfrd->tcp_conn != -1);
-        xfrd->tcp_waiting = 0;
-        /* stop udp use (if any) */
-        if (xfrd->handler.fd != -1) {
-            xfrd_udp_release(xfrd);
-        }
-        if (!xfrd_tcp_open(xfrd, set)) {
-            return;
-        }
-        xfrd_tcp_xfr(xfrd, set);
+    ret = xfrd_tcp_start(xfrd, set);
+    if (ret == 1) {
         return;
     }
     /* wait, at end of line */
-    ods_log_verbose("[%s] max number of tcp connections (%d) reached",
-        xfrd_str, TCPSET_MAX);
+    if (ret == 0) {
+        ods_log_verbose("[%s] max number of tcp connections to %s (%lu) "
+            "reached", xfrd_str, xfrd->master->address,
+            (unsigned long) set->tcp_max_remote);
+    } else {
+        ods_log_verbose("[%s] max number of tcp connections (%lu) reached",
+            xfrd_str, (unsigned long) set->tcp_max);
+    }
     xfrd->tcp_waiting = 1;
     xfrd_unset_timer(xfrd);
 
@@ -1523,6 +1625,11 @@ xfrd_tcp_read(xfrd_type* xfrd, tcp_set_type* set)
     ods_log_assert(xfrd->tcp_conn != -1);
     tcp = set->tcp_conn[xfrd->tcp_conn];
     ret = tcp_conn_read(tcp);
+    if (ret == -1 && tcp->is_reused && xfrd->msg_seq_nr == 0 &&
+        tcp->total_bytes == 0) {
+        xfrd_tcp_reopen(xfrd, set);
+        return;
+    }
     if (ret == -1) {
         xfrd_set_timer_now(xfrd);
         xfrd_tcp_release(xfrd, set, 1);
@@ -1540,9 +1647,9 @@ xfrd_tcp_read(xfrd_type* xfrd, tcp_set_type* set)
             break;
         case XFRD_PKT_XFR:
         case XFRD_PKT_NEWLEASE:
-            ods_log_verbose("[%s] tcp read %s: release connection", xfrd_str,
+            ods_log_verbose("[%s] tcp read %s: keep connection", xfrd_str,
                 XFRD_PKT_XFR?"xfr":"newlease");
-            xfrd_tcp_release(xfrd, set, 1);
+            xfrd_tcp_keep(xfrd, set);
             ods_log_assert(xfrd->round_num == -1);
             break;
         case XFRD_PKT_NOTIMPL:
@@ -1562,6 +1669,45 @@ xfrd_tcp_read(xfrd_type* xfrd, tcp_set_type* set)
 }
 
 
+/**
+ * Open as many waiting TCP connections as there are free slots in set,
+ * skipping those whose master has too many connections in use.
+ *
+ */
+static void
+xfrd_tcp_open_waiting(xfrhandler_type* xfrhandler, tcp_set_type* set)
+{
+    xfrd_type* prev_xfrd = NULL;
+    xfrd_type* waiting_xfrd = xfrhandler->tcp_waiting_first;
+    xfrd_type* next_xfrd = NULL;
+    int ret = 0;
+
+    while (waiting_xfrd) {
+        next_xfrd = waiting_xfrd->tcp_waiting_next;
+        /* if xfrd_tcp_open() fails its slot in set->tcp_conn[]
+         * is released. Continue to next. We don't put it back in the
+         * waiting queue, it would keep the signer busy retrying, making
+         * things only worse. */
+        ret = xfrd_tcp_start(waiting_xfrd, set);
+        if (ret == -1) {
+            return;
+        }
+        xfrd_update_handler(waiting_xfrd);
+        if (ret == 1) {
+            if (prev_xfrd) {
+                prev_xfrd->tcp_waiting_next = next_xfrd;
+            } else {
+                xfrhandler->tcp_waiting_first = next_xfrd;
+            }
+            waiting_xfrd->tcp_waiting_next = NULL;
+        } else {
+            prev_xfrd = waiting_xfrd;
+        }
+        waiting_xfrd = next_xfrd;
+    }
+}
+
+
 /**
  * Release tcp connection from set for xfrd. If there are waiting TCP
  * connections open as many as free slots in set. This step is skipped
@@ -1570,7 +1716,6 @@ xfrd_tcp_read(xfrd_type* xfrd, tcp_set_type* set)
 static void
 xfrd_tcp_release(xfrd_type* xfrd, tcp_set_type* set, int open_waiting)
 {
-    xfrhandler_type* xfrhandler;
     int conn = 0;
     zone_type* zone = NULL;
 
@@ -1588,42 +1733,64 @@ xfrd_tcp_release(xfrd_type* xfrd, tcp_set_type* set, int open_waiting)
     xfrd->tcp_waiting = 0;
     xfrd->handler.fd = -1;
     xfrd->handler.event_types = NETIO_EVENT_READ|NETIO_EVENT_TIMEOUT;
-
-    if (set->tcp_conn[conn]->fd != -1) {
-        close(set->tcp_conn[conn]->fd);
-    }
-    set->tcp_conn[conn]->fd = -1;
-    set->tcp_count --;
+    tcp_set_close(set, conn);
 
     /* see if there are any connections waiting for a slot. Or return. */
     if (!open_waiting) return;
-    xfrhandler = (xfrhandler_type*) xfrd->xfrhandler;
-    while (xfrhandler->tcp_waiting_first && set->tcp_count < TCPSET_MAX) {
-        int i;
-        xfrd_type* waiting_xfrd = xfrhandler->tcp_waiting_first;
-        xfrhandler->tcp_waiting_first = waiting_xfrd->tcp_waiting_next;
-        waiting_xfrd->tcp_waiting_next = NULL;
+    xfrd_tcp_open_waiting((xfrhandler_type*) xfrd->xfrhandler, set);
+}
 
-        /* find a free tcp_buffer */
-        for (i=0; i < TCPSET_MAX; i++) {
-            if (set->tcp_conn[i]->fd == -1) {
-                waiting_xfrd->tcp_conn = i;
-                set->tcp_count++;
-                break;
-            }
-        }
-        waiting_xfrd->tcp_waiting = 0;
-        /* stop udp use (if any) */
-        if (waiting_xfrd->handler.fd != -1) {
-            xfrd_udp_release(waiting_xfrd);
-        }
-        /* if xfrd_tcp_open() fails its slot in set->tcp_conn[]
-         * is released. Continue to next. We don't put it back in the
-         * waiting queue, it would keep the signer busy retrying, making
-         * things only worse. */
-        if (xfrd_tcp_open(waiting_xfrd, set)) {
-            xfrd_tcp_xfr(waiting_xfrd, set);
-        }
+
+/**
+ * Release tcp connection from set for xfrd after a completed transfer,
+ * but keep it open for the next transfer from the same master.
+ *
+ */
+static void
+xfrd_tcp_keep(xfrd_type* xfrd, tcp_set_type* set)
+{
+    zone_type* zone = NULL;
+
+    ods_log_assert(set);
+    ods_log_assert(xfrd);
+    ods_log_assert(xfrd->master);
+    ods_log_assert(xfrd->master->address);
+    ods_log_assert(xfrd->tcp_conn != -1);
+    ods_log_assert(xfrd->tcp_waiting == 0);
+    zone = (zone_type*) xfrd->zone;
+    ods_log_debug("[%s] zone %s keep tcp connection to %s", xfrd_str,
+        zone->name, xfrd->master->address);
+    tcp_set_keep_idle(set, xfrd->tcp_conn, xfrd_time(xfrd));
+    xfrd->tcp_conn = -1;
+    xfrd->tcp_waiting = 0;
+    xfrd->handler.fd = -1;
+    xfrd->handler.event_types = NETIO_EVENT_READ|NETIO_EVENT_TIMEOUT;
+    xfrd_tcp_open_waiting((xfrhandler_type*) xfrd->xfrhandler, set);
+}
+
+
+/**
+ * Reopen a reused tcp connection that the master has closed meanwhile.
+ *
+ */
+static void
+xfrd_tcp_reopen(xfrd_type* xfrd, tcp_set_type* set)
+{
+    tcp_conn_type* tcp = NULL;
+    zone_type* zone = NULL;
+
+    ods_log_assert(set);
+    ods_log_assert(xfrd);
+    ods_log_assert(xfrd->tcp_conn != -1);
+    zone = (zone_type*) xfrd->zone;
+    ods_log_verbose("[%s] zone %s tcp connection to %s was closed, reopen",
+        xfrd_str, zone->name, xfrd->master->address);
+    tcp = set->tcp_conn[xfrd->tcp_conn];
+    close(tcp->fd);
+    tcp->fd = -1;
+    xfrd->handler.fd = -1;
+    if (xfrd_tcp_open(xfrd, set)) {
+        xfrd_tcp_xfr(xfrd, set);
     }
 }
 
@@ -1877,6 +2044,7 @@ xfrd_udp_release(xfrd_type* xfrd)
             /* see if this zone needs udp connection */
             if (wf->tcp_conn == -1) {
                 wf->handler.fd = xfrd_udp_send_request_ixfr(wf);
+                xfrd_update_handler(wf);
                 if (wf->handler.fd != -1) {
                     return;
                 }
@@ -68,6 +68,17 @@ typedef struct xfrd_struct xfrd_type;
 #define XFRD_TCP_TIMEOUT 120 /* seconds, before a tcp request times out */
 #define XFRD_UDP_TIMEOUT 5 /* seconds, before a udp request times out */
 
+/*
+ * Record types in the <zone>.xfrd spool. Each record is a type byte and
+ * a 16 bit length, followed by that many bytes of data. Data records hold
+ * a received DNS message in wire format, a transfer is enclosed by a
+ * begin and an end record.
+ */
+#define XFRD_SPOOL_BEGIN 0x01
+#define XFRD_SPOOL_DATA 0x02
+#define XFRD_SPOOL_END 0x03
+#define XFRD_SPOOL_HDRLEN 3
+
 /*
  * Zone transfer SOA information.
  */
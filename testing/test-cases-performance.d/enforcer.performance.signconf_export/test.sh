@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+#
+#TEST: Times writing the signer configuration files of a large number of
+#TEST: zones, forced for all zones, and a second time when unchanged.
+
+NUMBER_ZONES=${NUMBER_ZONES:-10000}
+RESULTS_OUTPUT="performance_results.log"
+
+# Generate zonelist file $1 containing $2 zones
+generate_zonelist_xml() {
+  awk -v n=$2 -v root=$INSTALL_ROOT 'BEGIN {
+    print "<?xml version=\"1.0\" encoding=\"UTF-8\"?><ZoneList>"
+    for (i = 1; i <= n; i++) {
+      printf "<Zone name=\"txt%d\"><Policy>default</Policy>", i
+      printf "<SignerConfiguration>%s/var/opendnssec/signconf/txt%d.xml</SignerConfiguration>", root, i
+      printf "<Adapters><Input><Adapter type=\"File\">%s/var/opendnssec/unsigned/zone.txt%d</Adapter></Input>", root, i
+      printf "<Output><Adapter type=\"File\">%s/var/opendnssec/signed/txt%d</Adapter></Output></Adapters></Zone>\n", root, i
+    }
+    print "</ZoneList>"
+  }' > $1
+}
+
+# Force the export of all signconfs and write the number of signconf files
+# and the wall time in seconds to the results as test $1
+time_signconf() {
+  local name=$1 start end files
+  start=`date +%s%N`
+  $INSTALL_ROOT/sbin/ods-enforcer signconf > signconf.out || return 1
+  end=`date +%s%N`
+  files=`ls $INSTALL_ROOT/var/opendnssec/signconf | grep -c '^txt.*\.xml$'`
+  echo "$name,$files,`echo "3k $end $start - 1000000000 / p" | dc`" >> $RESULTS_OUTPUT
+  rm -f signconf.out
+  [ $files -ge $NUMBER_ZONES ]
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env &&
+ods_start_enforcer &&
+
+generate_zonelist_xml zonelist.large.xml $NUMBER_ZONES &&
+cp -- zonelist.large.xml $INSTALL_ROOT/etc/opendnssec/zonelist.xml &&
+rm -f zonelist.large.xml &&
+log_this ods-enforcer-zonelist-import ods-enforcer zonelist import &&
+
+echo "export,files,seconds" > $RESULTS_OUTPUT &&
+time_signconf "signconf" &&
+time_signconf "signconf unchanged" &&
+
+ods_stop_enforcer &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat $RESULTS_OUTPUT &&
+
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+ods_kill
+return 1
@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+#
+#TEST: Times listing a large number of zones, one million lines of output
+#TEST: through the command channel, as a table and as JSON lines.
+
+NUMBER_ZONES=${NUMBER_ZONES:-1000000}
+RESULTS_OUTPUT="performance_results.log"
+
+# Generate zonelist file $1 containing $2 zones, awk as a shell loop takes
+# too long for this number of zones.
+generate_zonelist_xml() {
+  awk -v n=$2 -v root=$INSTALL_ROOT 'BEGIN {
+    print "<?xml version=\"1.0\" encoding=\"UTF-8\"?><ZoneList>"
+    for (i = 1; i <= n; i++) {
+      printf "<Zone name=\"txt%d\"><Policy>default</Policy>", i
+      printf "<SignerConfiguration>%s/var/opendnssec/signconf/txt%d.xml</SignerConfiguration>", root, i
+      printf "<Adapters><Input><Adapter type=\"File\">%s/var/opendnssec/unsigned/zone.txt%d</Adapter></Input>", root, i
+      printf "<Output><Adapter type=\"File\">%s/var/opendnssec/signed/txt%d</Adapter></Output></Adapters></Zone>\n", root, i
+    }
+    print "</ZoneList>"
+  }' > $1
+}
+
+# Run ods-enforcer with arguments $2.. and write the wall time in seconds
+# and the number of lines of output to the results as test $1
+time_list() {
+  local name=$1 start end lines
+  shift
+  start=`date +%s%N`
+  $INSTALL_ROOT/sbin/ods-enforcer "$@" > list.out || return 1
+  end=`date +%s%N`
+  lines=`wc -l < list.out`
+  echo "$name,$lines,`echo "3k $end $start - 1000000000 / p" | dc`" >> $RESULTS_OUTPUT
+  rm -f list.out
+  [ $lines -ge $NUMBER_ZONES ]
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env &&
+ods_start_enforcer &&
+
+generate_zonelist_xml zonelist.large.xml $NUMBER_ZONES &&
+cp -- zonelist.large.xml $INSTALL_ROOT/etc/opendnssec/zonelist.xml &&
+rm -f zonelist.large.xml &&
+log_this ods-enforcer-zonelist-import ods-enforcer zonelist import &&
+
+echo "listing,lines,seconds" > $RESULTS_OUTPUT &&
+time_list "zone list" zone list &&
+time_list "zone list --json" zone list --json &&
+
+ods_stop_enforcer &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat $RESULTS_OUTPUT &&
+
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+ods_kill
+return 1
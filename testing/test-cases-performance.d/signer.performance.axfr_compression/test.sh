@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+#
+#TEST: Times AXFRs of a large signed zone whose names share long suffixes,
+#TEST: as compressed by the signer, and records their size.
+
+NUMBER_DCS=${NUMBER_DCS:-4}
+NUMBER_RACKS=${NUMBER_RACKS:-25}
+NUMBER_HOSTS=${NUMBER_HOSTS:-100}
+NUMBER_AXFRS=${NUMBER_AXFRS:-20}
+RESULTS_OUTPUT="performance_results.log"
+
+# Generate zone file $1 for ods. with hostH.rackR.dcD.ods. names, an MX
+# and a CNAME per rack pointing into it
+generate_zone() {
+  awk -v dcs=$NUMBER_DCS -v racks=$NUMBER_RACKS -v hosts=$NUMBER_HOSTS 'BEGIN {
+    print "$ORIGIN ods."
+    print "ods. 600 IN SOA ns1.ods. postmaster.ods. 1000 9000 4500 1209600 3600"
+    print "ods. 600 IN NS ns1.ods."
+    print "ods. 600 IN MX 10 mail.ods."
+    print "mail.ods. 600 IN A 192.0.2.1"
+    print "ns1.ods. 600 IN A 192.0.2.1"
+    for (d = 1; d <= dcs; d++) {
+      for (r = 1; r <= racks; r++) {
+        printf "rack%d.dc%d.ods. 600 IN MX 10 host1.rack%d.dc%d.ods.\n", r, d, r, d
+        printf "www.rack%d.dc%d.ods. 600 IN CNAME host1.rack%d.dc%d.ods.\n", r, d, r, d
+        for (h = 1; h <= hosts; h++) {
+          printf "host%d.rack%d.dc%d.ods. 600 IN A 10.%d.%d.%d\n", h, r, d, d, r, h
+          printf "host%d.rack%d.dc%d.ods. 600 IN AAAA 2001:db8:%x:%x::%x\n", h, r, d, d, r, h
+        }
+      }
+    }
+  }' > $1
+}
+
+# Transfer the zone NUMBER_AXFRS times and write the messages and bytes
+# of one transfer and the seconds per transfer to the results as test $1
+time_axfrs() {
+  local name=$1 start end i size
+  start=`date +%s%N`
+  for (( i=1 ; i <= NUMBER_AXFRS ; i+=1 )); do
+    dig -p 15354 @127.0.0.1 axfr ods > axfr.out || return 1
+  done
+  end=`date +%s%N`
+  # dig refuses transfers with bad compression pointers
+  grep -q 'XFR size' axfr.out || return 1
+  size=`sed -n 's/.*XFR size: .*messages \([0-9]*\), bytes \([0-9]*\).*/\1,\2/p' axfr.out`
+  echo "$name,$size,`echo "3k $end $start - 1000000000 / $NUMBER_AXFRS / p" | dc`" >> $RESULTS_OUTPUT
+  rm -f axfr.out
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+mkdir -p unsigned &&
+generate_zone unsigned/ods &&
+
+ods_reset_env &&
+
+ods_start_ods-control &&
+syslog_waitfor 900 'ods-signerd: .*\[STATS\] ods' &&
+
+echo "test,messages,bytes,seconds per axfr" > $RESULTS_OUTPUT &&
+time_axfrs "axfr" &&
+
+ods_stop_ods-control &&
+rm -rf unsigned &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat $RESULTS_OUTPUT &&
+
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+rm -rf unsigned
+ods_kill
+return 1
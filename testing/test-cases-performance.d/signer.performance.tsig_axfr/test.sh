@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+#
+#TEST: Times TSIG signed AXFRs of a large signed zone, every message of
+#TEST: the transfer is signed with hmac-sha256.
+
+NUMBER_NAMES=${NUMBER_NAMES:-20000}
+NUMBER_AXFRS=${NUMBER_AXFRS:-20}
+TSIG_KEY="hmac-sha256:secret.example.com:sw0nMPCswVbes1tmQTm1pcMmpNRK+oGMYN+qKNR/BwQ="
+RESULTS_OUTPUT="performance_results.log"
+
+# Generate zone file $1 for ods. with $2 names
+generate_zone() {
+  awk -v n=$2 'BEGIN {
+    print "$ORIGIN ods."
+    print "$TTL 600"
+    print "ods. IN SOA ns1.ods. postmaster.ods. 1000 9000 4500 1209600 3600"
+    print "ods. IN NS ns1.ods."
+    print "ns1.ods. IN A 192.0.2.1"
+    for (i = 1; i <= n; i++) {
+      printf "host%d.ods. IN A 192.0.%d.%d\n", i, int(i / 250) % 250, i % 250 + 1
+    }
+  }' > $1
+}
+
+# Transfer the zone NUMBER_AXFRS times and write the messages and bytes
+# of one transfer and the seconds per transfer to the results as test $1
+time_axfrs() {
+  local name=$1 start end i size
+  start=`date +%s%N`
+  for (( i=1 ; i <= NUMBER_AXFRS ; i+=1 )); do
+    dig -p 15354 -y $TSIG_KEY @127.0.0.1 axfr ods > axfr.out || return 1
+  done
+  end=`date +%s%N`
+  # dig checks the TSIG of every message
+  grep -q 'XFR size' axfr.out || return 1
+  ! grep -q "Couldn't verify" axfr.out || return 1
+  size=`sed -n 's/.*XFR size: .*messages \([0-9]*\), bytes \([0-9]*\).*/\1,\2/p' axfr.out`
+  echo "$name,$size,`echo "3k $end $start - 1000000000 / $NUMBER_AXFRS / p" | dc`" >> $RESULTS_OUTPUT
+  rm -f axfr.out
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+mkdir -p unsigned &&
+generate_zone unsigned/ods $NUMBER_NAMES &&
+
+ods_reset_env &&
+
+ods_start_ods-control &&
+syslog_waitfor 900 'ods-signerd: .*\[STATS\] ods' &&
+
+echo "test,messages,bytes,seconds per axfr" > $RESULTS_OUTPUT &&
+time_axfrs "tsig axfr" &&
+
+ods_stop_ods-control &&
+rm -rf unsigned &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat $RESULTS_OUTPUT &&
+
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+rm -rf unsigned
+ods_kill
+return 1
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+#
+#TEST: Measures the SOA queries per second the signer answers over UDP on
+#TEST: loopback, with one query and with a window of queries in flight.
+
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-10}
+RESULTS_OUTPUT="performance_results.log"
+
+# Send SOA queries with window $2 for SECONDS_PER_RUN seconds and write the
+# queries sent, answers and answers per second to the results as test $1
+time_queries() {
+  local name=$1 result
+  result=`./udpquery 127.0.0.1 15354 ods. $SECONDS_PER_RUN $2` || return 1
+  echo "$name,$2,$result" >> $RESULTS_OUTPUT
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+cc -O2 -o udpquery udpquery.c &&
+
+ods_reset_env &&
+
+ods_start_ods-control &&
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+
+## The zone is served before it is measured
+log_this_timeout soa 10 drill -p 15354 @127.0.0.1 soa ods &&
+log_grep soa stdout 'ods\..*IN.*SOA.*ns1\.ods\..*postmaster\.ods\.' &&
+
+echo "test,window,queries,answers,answers/s" > $RESULTS_OUTPUT &&
+time_queries "soa serial" 1 &&
+time_queries "soa window" 64 &&
+
+ods_stop_ods-control &&
+rm -f udpquery &&
+
+echo &&
+echo "************OK******************" &&
+echo &&
+cat $RESULTS_OUTPUT &&
+
+return 0
+
+echo
+echo "************ERROR******************"
+echo
+rm -f udpquery
+ods_kill
+return 1
@@ -0,0 +1,113 @@
+/*
+ * Send SOA queries for a zone over UDP for a number of seconds, keeping a
+ * window of queries outstanding, and print the number of queries, answers
+ * and answers per second.
+ *
+ * usage: udpquery address port zone seconds [window]
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double
+now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* SOA query for zone in wire format, returns its length */
+static size_t
+make_query(uint8_t* q, const char* zone)
+{
+  size_t n = 12;
+  const char* p = zone;
+  memset(q, 0, 12);
+  q[2] = 0x00; /* opcode query, no recursion */
+  q[5] = 1; /* qdcount */
+  while (*p && strcmp(p, ".") != 0) {
+    const char* dot = strchr(p, '.');
+    size_t len = dot ? (size_t) (dot - p) : strlen(p);
+    q[n++] = len;
+    memcpy(q + n, p, len);
+    n += len;
+    p += len;
+    if (*p == '.') p++;
+  }
+  q[n++] = 0;
+  q[n++] = 0; q[n++] = 6; /* SOA */
+  q[n++] = 0; q[n++] = 1; /* IN */
+  return n;
+}
+
+int
+main(int argc, char* argv[])
+{
+  struct sockaddr_in to;
+  struct pollfd pfd;
+  uint8_t query[300], answer[4096];
+  unsigned long queries = 0, answers = 0;
+  uint16_t id = 0;
+  int fd, window, outstanding = 0;
+  size_t len;
+  double start, end, seconds;
+
+  if (argc < 5) {
+    fprintf(stderr, "usage: %s address port zone seconds [window]\n", argv[0]);
+    return 2;
+  }
+  seconds = atof(argv[4]);
+  window = argc > 5 ? atoi(argv[5]) : 64;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_port = htons(atoi(argv[2]));
+  if (inet_pton(AF_INET, argv[1], &to.sin_addr) != 1) {
+    fprintf(stderr, "bad address %s\n", argv[1]);
+    return 2;
+  }
+  len = make_query(query, argv[3]);
+  if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) == -1 ||
+      connect(fd, (struct sockaddr*) &to, sizeof(to)) == -1) {
+    perror("socket");
+    return 1;
+  }
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  start = now();
+  end = start + seconds;
+  while (now() < end) {
+    while (outstanding < window) {
+      id++;
+      query[0] = id >> 8;
+      query[1] = id & 0xff;
+      if (send(fd, query, len, 0) == -1) {
+        if (errno == ECONNREFUSED) continue;
+        break;
+      }
+      queries++;
+      outstanding++;
+    }
+    if (poll(&pfd, 1, 100) <= 0) {
+      /* count what did not come back as lost */
+      outstanding = 0;
+      continue;
+    }
+    while (recv(fd, answer, sizeof(answer), MSG_DONTWAIT) > 0) {
+      answers++;
+      if (outstanding > 0) outstanding--;
+    }
+  }
+  seconds = now() - start;
+  printf("%lu,%lu,%.1f\n", queries, answers, answers / seconds);
+  close(fd);
+  return answers > 0 ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+
+#TEST: Test name compression in the Output DNS Adapter
+#TEST: Sign a zone with many names that share suffixes, transfer it with
+#TEST: drill and dig and check that AXFR and IXFR decode to the signed zone.
+
+## Strip comments and empty lines, and sort for comparing.
+rrs_sorted ()
+{
+	sed -e '/^;/d' -e '/^[[:space:]]*$/d' "$1" | sort -u
+}
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env &&
+
+## Start OpenDNSSEC
+ods_start_ods-control &&
+
+## Wait for signed zone file
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+## AXFR must decode to exactly the signed zone
+log_this_timeout axfr 10 drill -p 15354 @127.0.0.1 axfr ods &&
+log_grep axfr stdout 'ods\..*3600.*IN.*SOA.*ns1\.ods\..*postmaster\.ods\..*1001.*9000.*4500.*1209600.*3600' &&
+log_grep axfr stdout 'ods\..*600.*IN.*MX.*20.*mail\.backup\.ods\.' &&
+log_grep axfr stdout 'www\.rack3\.dc2\.ods\..*600.*IN.*CNAME.*host1\.rack3\.dc2\.ods\.' &&
+log_grep axfr stdout 'ns2\.sub\.rack1\.dc1\.ods\..*600.*IN.*AAAA.*2001:db8::3' &&
+rrs_sorted "$INSTALL_ROOT/var/opendnssec/signed/ods" > signed.sorted &&
+rrs_sorted _log.$BUILD_TAG.axfr.stdout > axfr.sorted &&
+diff signed.sorted axfr.sorted &&
+
+## A second parser, which also reports the transfer size
+log_this_timeout dig-axfr 10 dig -p 15354 @127.0.0.1 axfr ods &&
+log_grep dig-axfr stdout 'XFR size: ' &&
+log_grep dig-axfr stdout 'host25\.rack4\.dc2\.ods\..*600.*IN.*AAAA.*2001:db8:2:4::25' &&
+! (log_grep dig-axfr stdout 'communications error\|FORMERR\|Transfer failed') &&
+
+## Update zonefile to create journal
+cp -- ./unsigned/ods.2 "$INSTALL_ROOT/var/opendnssec/unsigned/ods" &&
+ods-signer sign ods &&
+syslog_waitfor 10 'ods-signerd: .*\[STATS\] ods 1002' &&
+
+## IXFR with the new names compressed against the old ones
+log_this_timeout dig 10 dig -p 15354 @127.0.0.1 ixfr=1001 ods &&
+log_grep dig stdout 'ods\..*3600.*IN.*SOA.*ns1\.ods\..*postmaster\.ods\..*1002.*9000.*4500.*1209600.*3600' &&
+log_grep dig stdout 'host26\.rack4\.dc2\.ods\..*600.*IN.*A.*192\.0\.24\.26' &&
+log_grep dig stdout 'www2\.rack4\.dc2\.ods\..*600.*IN.*CNAME.*host26\.rack4\.dc2\.ods\.' &&
+log_grep dig stdout 'host26\.rack4\.dc2\.ods\..*600.*IN.*RRSIG.*A.*ods\.' &&
+! (log_grep dig stdout 'communications error\|FORMERR\|Transfer failed') &&
+
+## And AXFR of the new version
+log_this_timeout axfr-1002 10 drill -p 15354 @127.0.0.1 axfr ods &&
+rrs_sorted "$INSTALL_ROOT/var/opendnssec/signed/ods" > signed.sorted &&
+rrs_sorted _log.$BUILD_TAG.axfr-1002.stdout > axfr.sorted &&
+diff signed.sorted axfr.sorted &&
+
+## Stop
+ods_stop_ods-control &&
+return 0
+
+## Test failed. Kill stuff
+ods_kill
+return 1
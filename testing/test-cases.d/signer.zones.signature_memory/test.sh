@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+
+#TEST: Sign with a zero <SignatureMemory> budget so every signature is
+#TEST: swapped out to the on-disk store as soon as it is added, then
+#TEST: re-sign to fill the journal and check the signatures are intact
+#TEST: in the signed file, in AXFR and in IXFR.
+
+if [ -n "$HAVE_MYSQL" ]; then
+        ods_setup_conf conf.xml conf-mysql.xml
+fi &&
+
+ods_reset_env &&
+
+## Start OpenDNSSEC
+ods_start_ods-control &&
+
+## Wait for signed zone file
+syslog_waitfor 60 'ods-signerd: .*\[STATS\] ods' &&
+test -f "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+$GREP -q -- 'ods\..*3600.*IN.*RRSIG.*SOA.*ods\.' "$INSTALL_ROOT/var/opendnssec/signed/ods" &&
+
+## Signatures are read back from the store for AXFR
+log_this_timeout axfr 10 drill -p 15354 @127.0.0.1 axfr ods &&
+log_grep axfr stdout 'ods\..*3600.*IN.*SOA.*ns1\.ods\..*postmaster\.ods\..*1001.*9000.*4500.*1209600.*3600' &&
+log_grep axfr stdout 'ods\..*3600.*IN.*RRSIG.*SOA.*ods\.' &&
+log_grep axfr stdout 'mail\.ods\..*600.*IN.*RRSIG.*A.*ods\.' &&
+signed_rrsigs=`$GREP -c -- 'IN[[:space:]]*RRSIG' "$INSTALL_ROOT/var/opendnssec/signed/ods"` &&
+axfr_rrsigs=`$GREP -c -- 'IN[[:space:]]*RRSIG' _log.$BUILD_TAG.axfr.stdout` &&
+test "$signed_rrsigs" -gt 0 &&
+test "$signed_rrsigs" -eq "$axfr_rrsigs" &&
+
+## Update zonefile to create journal, new signatures go to the journal
+## and the store at the same time
+cp -- ./unsigned/ods.2 "$INSTALL_ROOT/var/opendnssec/unsigned/ods" &&
+ods-signer sign ods &&
+syslog_waitfor 10 'ods-signerd: .*\[STATS\] ods 1002 RR\[count=3 time*' &&
+
+## See if we can get an IXFR back with the new signatures
+log_this_timeout dig 10 dig -p 15354 @127.0.0.1 ixfr=1001 ods &&
+log_grep dig stdout 'ods\..*3600.*IN.*SOA.*ns1\.ods\..*postmaster\.ods\..*1002.*9000.*4500.*1209600.*3600' &&
+log_grep dig stdout 'ods\..*3600.*IN.*RRSIG.*SOA.*ods\.' &&
+log_grep dig stdout 'label35\.ods\..*3600.*IN.*NS.*ns1\.label35\.ods\.' &&
+log_grep dig stdout 'IN.*RRSIG.*NSEC3.*ods\.' &&
+
+## Stop
+ods_stop_ods-control &&
+return 0
+
+## Test failed. Kill stuff
+ods_kill
+return 1